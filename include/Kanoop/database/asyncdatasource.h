@@ -0,0 +1,159 @@
+/**
+ *  AsyncDataSource
+ *
+ *  Runs a DataSource on a dedicated worker thread so that callers on UI or
+ *  event-loop threads never block on database I/O.
+ *
+ *  The DataSource is created and opened on the worker thread, which is the only
+ *  thread that ever touches it, satisfying QSqlDatabase's thread affinity. Work
+ *  is submitted as closures or SQL with bound values, and results are returned
+ *  as QFutures which support continuations.
+ */
+#ifndef ASYNCDATASOURCE_H
+#define ASYNCDATASOURCE_H
+
+#include <Kanoop/utility/loggingbaseclass.h>
+#include <Kanoop/database/databasecredentials.h>
+#include <Kanoop/database/queryresult.h>
+#include <QFuture>
+#include <QMutex>
+#include <QPromise>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <utility>
+
+class DataSource;
+class AsyncDataSourceWorker;
+
+/** @brief Executes DataSource work on a dedicated worker thread, returning QFuture results.
+ *
+ *  Submitted work is queued and executed in submission order. The worker drains
+ *  everything queued each time it wakes, so a burst of small queries costs one
+ *  thread hop rather than one per query. The worker runs an event loop, so the
+ *  DataSource's own queued work, such as DataSource::queueWrite() batches, is
+ *  delivered between submissions.
+ *
+ *  Work may be submitted from any thread. start() and stop() are called by the
+ *  owner, not concurrently with each other.
+ *
+ *  Failures are reported through the future: closures may throw, and SQL which
+ *  fails to prepare or execute completes the future with a CommonException
+ *  holding DataSource::errorText().
+ *
+ *  @code
+ *  AsyncDataSource async(credentials, AsyncDataSource::factory<MyDatabase>());
+ *  async.start();
+ *  async.execute("SELECT name FROM items WHERE id = ?", { 42 })
+ *      .then(this, [this](const QueryResult& result) { showName(result.value(0, 0).toString()); });
+ *  @endcode
+ */
+class AsyncDataSource : public LoggingBaseClass
+{
+public:
+    /** @brief Factory used to create the DataSource (or subclass) on the worker thread. */
+    typedef std::function<DataSource*()> Factory;
+
+    /** @brief Construct an asynchronous data source. Call start() to open the connection.
+     *  @param credentials The connection credentials.
+     *  @param factory Creates the DataSource. If empty, a plain DataSource is created.
+     */
+    explicit AsyncDataSource(const DatabaseCredentials& credentials, const Factory& factory = Factory());
+
+    /** @brief Destructor. Completes all queued work, then closes the connection and stops the worker. */
+    virtual ~AsyncDataSource();
+
+    /** @brief Build a factory which creates default-constructed instances of T.
+     *  @return The factory.
+     */
+    template <typename T>
+    static Factory factory() { return [] () -> DataSource* { return new T(); }; }
+
+    /** @brief Start the worker thread and open the connection on it.
+     *  @return true if the connection opened successfully.
+     */
+    bool start();
+
+    /** @brief Complete all queued work, close the connection and stop the worker thread. */
+    void stop();
+
+    /** @brief Return true if the worker is running with an open connection.
+     *  @return true if running.
+     */
+    bool isRunning() const;
+
+    /** @brief Get the credentials.
+     *  @return The connection credentials.
+     */
+    DatabaseCredentials credentials() const { return _credentials; }
+
+    /** @brief Queue a closure to run on the worker thread.
+     *
+     *  The closure receives the worker's DataSource (cast it to the type created by
+     *  the factory) and its return value becomes the result of the future.
+     *  Exceptions thrown by the closure are delivered through the future.
+     *  @param fn A copyable callable taking DataSource*.
+     *  @return A future for the closure's return value.
+     */
+    template <typename Fn>
+    auto submit(Fn fn) -> QFuture<decltype(fn(std::declval<DataSource*>()))>
+    {
+        typedef decltype(fn(std::declval<DataSource*>())) Result;
+        std::shared_ptr<QPromise<Result>> promise = std::make_shared<QPromise<Result>>();
+        QFuture<Result> future = promise->future();
+        promise->start();
+
+        bool queued = enqueue([promise, fn](DataSource* dataSource) mutable {
+            try
+            {
+                fulfil(*promise, fn, dataSource);
+            }
+            catch(...)
+            {
+                promise->setException(std::current_exception());
+            }
+            promise->finish();
+        });
+
+        if(queued == false) {
+            promise->setException(notRunningException());
+            promise->finish();
+        }
+        return future;
+    }
+
+    /** @brief Queue a SQL statement with positional bound values.
+     *  @param sql The SQL statement.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @return A future for the detached result rows.
+     */
+    QFuture<QueryResult> execute(const QString& sql, const QVariantList& bindings = QVariantList());
+
+    /** @brief Get the number of closures waiting to run.
+     *  @return The queue depth.
+     */
+    int pendingCount() const;
+
+private:
+    typedef std::function<void(DataSource*)> Task;
+
+    template <typename Result, typename Fn>
+    static void fulfil(QPromise<Result>& promise, Fn& fn, DataSource* dataSource) { promise.addResult(fn(dataSource)); }
+
+    template <typename Fn>
+    static void fulfil(QPromise<void>&, Fn& fn, DataSource* dataSource) { fn(dataSource); }
+
+    bool enqueue(const Task& task);
+    static std::exception_ptr notRunningException();
+    static QueryResult executeOnWorker(DataSource* dataSource, const QString& sql, const QVariantList& bindings);
+
+    Q_DISABLE_COPY(AsyncDataSource)
+
+    DatabaseCredentials _credentials;
+    Factory _factory;
+    // start() and stop() swap the worker while other threads submit work
+    mutable QMutex _workerMutex;
+    AsyncDataSourceWorker* _worker = nullptr;
+};
+
+#endif // ASYNCDATASOURCE_H
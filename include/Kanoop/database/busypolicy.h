@@ -0,0 +1,122 @@
+/**
+ *  BusyPolicy
+ *
+ *  How a DataSource responds when SQLite reports that the database is locked
+ *  by another connection or process (SQLITE_BUSY / SQLITE_LOCKED).
+ *
+ *  SQLite's busy_timeout makes a connection wait inside SQLite for a lock to be
+ *  released. Beyond that, statements which run outside a transaction can be
+ *  retried with exponential backoff: a statement which failed with SQLITE_BUSY
+ *  made no changes. Writers can also take the write lock when their transaction
+ *  begins (BEGIN IMMEDIATE), so that contention surfaces at BEGIN, where a
+ *  retry is always safe, rather than part way through the transaction.
+ */
+#ifndef BUSYPOLICY_H
+#define BUSYPOLICY_H
+
+#include <QtGlobal>
+
+class QSqlError;
+
+/** @brief SQLite lock contention settings applied by DataSource. */
+class BusyPolicy
+{
+public:
+    /** @brief Construct a policy which neither retries nor changes the busy timeout. */
+    BusyPolicy() {}
+
+    /** @brief A policy for databases shared between processes: a short busy timeout,
+     *  up to eight retries of reads from 10 ms to 1 s, and immediate transactions.
+     *  @return The policy.
+     */
+    static BusyPolicy contended();
+
+    /** @brief Get how long SQLite itself waits for a lock before reporting SQLITE_BUSY.
+     *  @return The timeout in milliseconds, or -1 to use the SQLite performance profile's busy timeout.
+     */
+    int busyTimeout() const { return _busyTimeout; }
+    /** @brief Set how long SQLite itself waits for a lock before reporting SQLITE_BUSY.
+     *
+     *  Takes precedence over SqlitePerformanceProfile::busyTimeout().
+     *  @param value The timeout in milliseconds, or -1 to use the profile's.
+     */
+    void setBusyTimeout(int value) { _busyTimeout = qMax(-1, value); }
+
+    /** @brief Get the maximum number of times a statement which failed with SQLITE_BUSY is retried.
+     *  @return The retry limit, 0 for no retries (the default).
+     */
+    int maxRetries() const { return _maxRetries; }
+    /** @brief Set the maximum number of times a statement which failed with SQLITE_BUSY is retried.
+     *
+     *  Only statements outside a transaction are retried, since inside one the
+     *  lock may be held against this connection's own earlier work. BEGIN IMMEDIATE
+     *  and COMMIT are retried too.
+     *  @param value The retry limit.
+     */
+    void setMaxRetries(int value) { _maxRetries = qMax(0, value); }
+
+    /** @brief Get the backoff before the first retry.
+     *  @return The backoff in milliseconds.
+     */
+    int initialBackoffMs() const { return _initialBackoffMs; }
+    /** @brief Set the backoff before the first retry. Each further retry doubles it.
+     *  @param value The backoff in milliseconds.
+     */
+    void setInitialBackoffMs(int value) { _initialBackoffMs = qMax(1, value); }
+
+    /** @brief Get the longest backoff between retries.
+     *  @return The backoff in milliseconds.
+     */
+    int maxBackoffMs() const { return _maxBackoffMs; }
+    /** @brief Set the longest backoff between retries.
+     *  @param value The backoff in milliseconds.
+     */
+    void setMaxBackoffMs(int value) { _maxBackoffMs = qMax(1, value); }
+
+    /** @brief Return true if writes outside a transaction are retried as well as reads.
+     *  @return true if writes are retried.
+     */
+    bool retryWrites() const { return _retryWrites; }
+    /** @brief Set whether writes outside a transaction are retried as well as reads.
+     *
+     *  A write which failed with SQLITE_BUSY made no changes, so retrying it is
+     *  safe for the database, but the application may prefer to decide for itself.
+     *  @param value true to retry writes.
+     */
+    void setRetryWrites(bool value) { _retryWrites = value; }
+
+    /** @brief Return true if outermost transactions begin with BEGIN IMMEDIATE.
+     *  @return true if transactions are immediate.
+     */
+    bool immediateTransactions() const { return _immediateTransactions; }
+    /** @brief Set whether outermost transactions begin with BEGIN IMMEDIATE, taking the write lock at once.
+     *
+     *  A deferred transaction which reads and then writes can fail with SQLITE_BUSY
+     *  at the first write, when it cannot be retried. An immediate one waits (and
+     *  retries) at BEGIN instead, at the cost of holding the write lock for read-only transactions.
+     *  @param value true for immediate transactions.
+     */
+    void setImmediateTransactions(bool value) { _immediateTransactions = value; }
+
+    /** @brief Get the backoff before a retry, before jitter.
+     *  @param retry The retry number, starting at 0.
+     *  @return initialBackoffMs() doubled for each earlier retry, capped at maxBackoffMs().
+     */
+    int backoffMs(int retry) const;
+
+    /** @brief Return true if an error from a SQLite connection reports that the database is locked (SQLITE_BUSY or SQLITE_LOCKED).
+     *  @param error The error.
+     *  @return true for lock contention.
+     */
+    static bool isBusyError(const QSqlError& error);
+
+private:
+    int _busyTimeout = -1;
+    int _maxRetries = 0;
+    int _initialBackoffMs = 10;
+    int _maxBackoffMs = 1000;
+    bool _retryWrites = false;
+    bool _immediateTransactions = false;
+};
+
+#endif // BUSYPOLICY_H
@@ -0,0 +1,270 @@
+/**
+ *  ColumnarResult
+ *
+ *  A query result decoded column by column into typed buffers, as returned by
+ *  DataSource::fetchColumns().
+ *
+ *  Integer columns are held in a QVector<qint64> and real columns in a
+ *  QVector<double>. Text and blob columns share one byte arena per column, with
+ *  an offset per row marking where each value starts. Every column has a null
+ *  bitmap with one bit per row. No cell is held in a QVariant, so reading
+ *  millions of numbers costs little more than the numbers themselves.
+ */
+#ifndef COLUMNARRESULT_H
+#define COLUMNARRESULT_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QList>
+#include <QMetaType>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+/** @brief Query result held as one typed buffer per column. */
+class ColumnarResult
+{
+public:
+    /** @brief Storage type of a column. */
+    enum Type
+    {
+        Auto,       ///< Chosen from the column's declared type
+        Integer,    ///< 64-bit integers
+        Real,       ///< Doubles
+        Text,       ///< UTF-8 text in a byte arena
+        Blob,       ///< Bytes in a byte arena
+    };
+
+    /** @brief One column of values. */
+    class Column
+    {
+    public:
+        /** @brief Construct an empty column.
+         *  @param name The column name.
+         *  @param type The storage type. Must not be Auto.
+         */
+        Column(const QString& name = QString(), Type type = Text) :
+            _name(name), _type(type)
+        {
+            if(isArena()) {
+                _offsets.append(0);
+            }
+        }
+
+        /** @brief Get the column name.
+         *  @return The name.
+         */
+        QString name() const { return _name; }
+
+        /** @brief Get the storage type.
+         *  @return The type.
+         */
+        Type type() const { return _type; }
+
+        /** @brief Get the number of rows.
+         *  @return The row count.
+         */
+        int rowCount() const { return _rowCount; }
+
+        /** @brief Return true if a value is NULL.
+         *  @param row The row.
+         *  @return true if NULL.
+         */
+        bool isNull(int row) const { return (_nulls.at(row >> 3) >> (row & 7)) & 1; }
+
+        /** @brief Get the number of NULL values.
+         *  @return The NULL count.
+         */
+        int nullCount() const { return _nullCount; }
+
+        /** @brief Get a value of an Integer column.
+         *  @param row The row.
+         *  @return The value, 0 if NULL.
+         */
+        qint64 integer(int row) const { return _integers.at(row); }
+
+        /** @brief Get a value of a Real column.
+         *  @param row The row.
+         *  @return The value, 0 if NULL.
+         */
+        double real(int row) const { return _reals.at(row); }
+
+        /** @brief Get a value of a Text or Blob column as a view into the arena.
+         *  @param row The row.
+         *  @return The bytes, empty if NULL. Valid as long as the result is unchanged.
+         */
+        QByteArrayView bytes(int row) const { return QByteArrayView(_arena.constData() + _offsets.at(row), _offsets.at(row + 1) - _offsets.at(row)); }
+
+        /** @brief Get a value of a Text column.
+         *  @param row The row.
+         *  @return The text, a null string if NULL.
+         */
+        QString text(int row) const { return isNull(row) ? QString() : QString::fromUtf8(bytes(row)); }
+
+        /** @brief Get a value of any column as a QVariant.
+         *  @param row The row.
+         *  @return The value, or an invalid QVariant if NULL.
+         */
+        QVariant value(int row) const;
+
+        /** @brief Get the values of an Integer column.
+         *  @return One value per row, 0 where NULL.
+         */
+        const QVector<qint64>& integers() const { return _integers; }
+
+        /** @brief Get the values of a Real column.
+         *  @return One value per row, 0 where NULL.
+         */
+        const QVector<double>& reals() const { return _reals; }
+
+        /** @brief Get the bytes of a Text or Blob column.
+         *  @return Every value, end to end.
+         */
+        const QByteArray& arena() const { return _arena; }
+
+        /** @brief Get the offsets of the values of a Text or Blob column in the arena.
+         *  @return rowCount() + 1 offsets; row i spans offsets[i] to offsets[i + 1].
+         */
+        const QVector<qint64>& offsets() const { return _offsets; }
+
+        /** @brief Get the NULL bitmap.
+         *  @return One bit per row, least significant bit first; a set bit is NULL.
+         */
+        const QByteArray& nullBitmap() const { return _nulls; }
+
+        /** @brief Reserve space for a number of rows.
+         *  @param rows The expected row count.
+         */
+        void reserve(int rows);
+
+        /** @brief Append a NULL. */
+        void appendNull()
+        {
+            appendRow(true);
+            _nullCount++;
+            switch(_type) {
+            case Integer:
+                _integers.append(0);
+                break;
+            case Real:
+                _reals.append(0);
+                break;
+            default:
+                _offsets.append(_arena.size());
+                break;
+            }
+        }
+
+        /** @brief Append a value to an Integer column.
+         *  @param value The value.
+         */
+        void appendInteger(qint64 value) { appendRow(false); _integers.append(value); }
+
+        /** @brief Append a value to a Real column.
+         *  @param value The value.
+         */
+        void appendReal(double value) { appendRow(false); _reals.append(value); }
+
+        /** @brief Append a value to a Text or Blob column.
+         *  @param data The bytes.
+         *  @param size The number of bytes.
+         */
+        void appendBytes(const char* data, qsizetype size)
+        {
+            appendRow(false);
+            _arena.append(data, size);
+            _offsets.append(_arena.size());
+        }
+
+        /** @brief Append a QVariant, converted to the column type.
+         *  @param value The value.
+         */
+        void appendValue(const QVariant& value);
+
+    private:
+        bool isArena() const { return _type == Text || _type == Blob; }
+
+        void appendRow(bool null)
+        {
+            if((_rowCount & 7) == 0) {
+                _nulls.append('\0');
+            }
+            if(null) {
+                _nulls[_rowCount >> 3] = char(_nulls.at(_rowCount >> 3) | (1 << (_rowCount & 7)));
+            }
+            _rowCount++;
+        }
+
+        QString _name;
+        Type _type;
+        int _rowCount = 0;
+        int _nullCount = 0;
+        QVector<qint64> _integers;
+        QVector<double> _reals;
+        QByteArray _arena;
+        QVector<qint64> _offsets;
+        QByteArray _nulls;
+    };
+
+    /** @brief Construct an empty result. */
+    ColumnarResult() {}
+
+    /** @brief Get the storage type which suits values of a meta type.
+     *  @param type The meta type, e.g. of a QSqlField.
+     *  @return Integer for integral types and bool, Real for floating point, Blob for QByteArray, otherwise Text.
+     */
+    static Type typeFor(QMetaType type);
+
+    /** @brief Add a column.
+     *  @param name The column name.
+     *  @param type The storage type. Must not be Auto.
+     */
+    void addColumn(const QString& name, Type type) { _columns.append(Column(name, type)); }
+
+    /** @brief Get the number of columns.
+     *  @return The column count.
+     */
+    int columnCount() const { return _columns.count(); }
+
+    /** @brief Get the number of rows.
+     *  @return The row count.
+     */
+    int rowCount() const { return _columns.isEmpty() ? 0 : _columns.first().rowCount(); }
+
+    /** @brief Get a column.
+     *  @param index The column index.
+     *  @return The column.
+     */
+    const Column& column(int index) const { return _columns.at(index); }
+    /** @brief Get a column for appending to.
+     *  @param index The column index.
+     *  @return The column.
+     */
+    Column& column(int index) { return _columns[index]; }
+
+    /** @brief Get the index of a column.
+     *  @param name The column name, compared case-insensitively.
+     *  @return The index, or -1 if there is no such column.
+     */
+    int columnIndex(const QString& name) const;
+
+    /** @brief Get the column names.
+     *  @return The names, in order.
+     */
+    QStringList columnNames() const;
+
+    /** @brief Return true if the result was decoded directly from a native SQLite statement.
+     *  @return true if decoded natively, false if through QSqlQuery::value().
+     */
+    bool isNative() const { return _native; }
+    /** @brief Set whether the result was decoded directly from a native SQLite statement.
+     *  @param value true if decoded natively.
+     */
+    void setNative(bool value) { _native = value; }
+
+private:
+    QList<Column> _columns;
+    bool _native = false;
+};
+
+#endif // COLUMNARRESULT_H
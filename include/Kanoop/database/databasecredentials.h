@@ -8,6 +8,7 @@
 #ifndef DATABASECREDENTIALS_H
 #define DATABASECREDENTIALS_H
 
+#include <Kanoop/database/sqliteperformanceprofile.h>
 #include <QString>
 
 /** @brief Represents a set of database connection credentials for use by the DataSource class. */
@@ -78,6 +79,15 @@ public:
      */
     void setEngine(const QString& value) { _engine = value; }
 
+    /** @brief Get the SQLite performance profile applied when a connection is opened.
+     *  @return The profile. Empty (the default) changes nothing.
+     */
+    SqlitePerformanceProfile sqliteProfile() const { return _sqliteProfile; }
+    /** @brief Set the SQLite performance profile applied when a connection is opened.
+     *  @param value The profile. Ignored for engines other than SQLite.
+     */
+    void setSqliteProfile(const SqlitePerformanceProfile& value) { _sqliteProfile = value; }
+
     /** @brief Return true if the engine is SQLite.
      *  @return true if the engine is SQLite.
      */
@@ -100,6 +110,7 @@ private:
     QString _username;
     QString _password;
     QString _engine;
+    SqlitePerformanceProfile _sqliteProfile;
 };
 
 #endif // DATABASECREDENTIALS_H
@@ -0,0 +1,160 @@
+/**
+ *  DatabaseValidator
+ *
+ *  Graded validation of SQLite database files.
+ *
+ *  The cheapest level reads only the 100-byte file header, which is enough to
+ *  decide whether a file is a SQLite database at all. PRAGMA quick_check skips
+ *  the index cross-checks of a full PRAGMA integrity_check, which on large
+ *  databases is the difference between seconds and minutes. Either check may be
+ *  limited to a number of errors, or run table by table on a worker thread with
+ *  progress and cancellation.
+ */
+#ifndef DATABASEVALIDATOR_H
+#define DATABASEVALIDATOR_H
+
+#include <QFuture>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <functional>
+
+class QSqlQuery;
+
+/** @brief Validates SQLite database files at a selectable level of thoroughness.
+ *
+ *  @code
+ *  DatabaseValidator validator(filename, DatabaseValidator::IntegrityCheck);
+ *  QFuture<DatabaseValidator::Result> future = validator.validateInBackground();
+ *  QFutureWatcher<DatabaseValidator::Result>* watcher = new QFutureWatcher<DatabaseValidator::Result>(this);
+ *  connect(watcher, &QFutureWatcherBase::progressValueChanged, progressBar, &QProgressBar::setValue);
+ *  watcher->setFuture(future);
+ *  @endcode
+ */
+class DatabaseValidator
+{
+public:
+    /** @brief How thoroughly to validate. */
+    enum Level
+    {
+        /** @brief No validation; always valid. */
+        NoValidation,
+        /** @brief Check the file header only. Does not open a connection. */
+        HeaderOnly,
+        /** @brief PRAGMA quick_check: page and record structure, without comparing indexes to their tables. */
+        QuickCheck,
+        /** @brief PRAGMA integrity_check: everything quick_check does, plus index contents and constraints. */
+        IntegrityCheck
+    };
+
+    /** @brief Outcome of a validation. */
+    struct Result
+    {
+        /** @brief true if the database passed. */
+        bool valid = false;
+        /** @brief true if the check was cancelled before it completed. */
+        bool cancelled = false;
+        /** @brief Problems found, up to the error limit. Empty if valid. */
+        QStringList errors;
+        /** @brief Number of tables checked, when checking table by table. */
+        int tablesChecked = 0;
+        /** @brief Number of tables to check, when checking table by table. */
+        int tableCount = 0;
+        /** @brief Elapsed time in milliseconds. */
+        qint64 elapsedMs = 0;
+    };
+
+    /** @brief Called before checking each table, and after the last. Return false to cancel.
+     *  @param tablesChecked The number of tables checked so far.
+     *  @param tableCount The total number of tables.
+     */
+    typedef std::function<bool(int tablesChecked, int tableCount)> ProgressCallback;
+
+    /** @brief Default limit on the number of errors reported. Matches SQLite's own default. */
+    static const int DefaultMaxErrors = 100;
+
+    /** @brief Construct a validator for a database file.
+     *  @param filename The path of the database file.
+     *  @param level How thoroughly to validate.
+     *  @param maxErrors Stop after this many errors.
+     */
+    explicit DatabaseValidator(const QString& filename, Level level = QuickCheck, int maxErrors = DefaultMaxErrors) :
+        _filename(filename), _level(level), _maxErrors(qMax(1, maxErrors)) {}
+
+    /** @brief Get the path of the database file.
+     *  @return The file path.
+     */
+    QString filename() const { return _filename; }
+
+    /** @brief Get the validation level.
+     *  @return The level.
+     */
+    Level level() const { return _level; }
+    /** @brief Set the validation level.
+     *  @param value The level.
+     */
+    void setLevel(Level value) { _level = value; }
+
+    /** @brief Get the maximum number of errors reported before the check stops.
+     *  @return The error limit.
+     */
+    int maxErrors() const { return _maxErrors; }
+    /** @brief Set the maximum number of errors reported before the check stops.
+     *
+     *  A limit of 1 is the fastest way to answer "is this database intact?".
+     *  @param value The error limit, at least 1.
+     */
+    void setMaxErrors(int value) { _maxErrors = qMax(1, value); }
+
+    /** @brief Validate the file on the calling thread, using a private read-only connection.
+     *
+     *  Without a progress callback the check runs as one PRAGMA. With one, it runs
+     *  table by table so that it can report progress and be cancelled between
+     *  tables; the per-table form does not make the file-wide free list and page
+     *  accounting checks.
+     *  @param progress Optional progress callback.
+     *  @return The result.
+     */
+    Result validate(const ProgressCallback& progress = ProgressCallback()) const;
+
+    /** @brief Validate the file table by table on a thread pool thread.
+     *
+     *  The future's progress range is the number of tables, and cancelling the
+     *  future stops the check after the table being checked. A cancelled future
+     *  has no result.
+     *  @return A future for the result.
+     */
+    QFuture<Result> validateInBackground() const;
+
+    /** @brief Validate an open SQLite connection on the calling thread.
+     *
+     *  At the HeaderOnly level the header is validated by reading the schema, which
+     *  also works for in-memory databases.
+     *  @param db An open SQLite connection.
+     *  @param level How thoroughly to validate.
+     *  @param maxErrors Stop after this many errors.
+     *  @param progress Optional progress callback; see validate().
+     *  @return The result.
+     */
+    static Result check(const QSqlDatabase& db, Level level, int maxErrors = DefaultMaxErrors, const ProgressCallback& progress = ProgressCallback());
+
+    /** @brief Return true if the file starts with a valid SQLite header.
+     *
+     *  Reads the first 100 bytes and checks the magic string and page size. An
+     *  empty file, which SQLite would treat as a new database, is not accepted.
+     *  @param filename The path of the file.
+     *  @return true if the header is valid.
+     */
+    static bool hasSqliteHeader(const QString& filename);
+
+    /** @brief Size of the SQLite file header in bytes. */
+    static const int HeaderSize = 100;
+
+private:
+    static bool runCheck(QSqlQuery& query, const QString& sql, int maxErrors, Result* result);
+
+    QString _filename;
+    Level _level;
+    int _maxErrors;
+};
+
+#endif // DATABASEVALIDATOR_H
@@ -11,8 +11,38 @@
 #define DATASOURCE_H
 
 #include <Kanoop/utility/loggingbaseclass.h>
+#include <Kanoop/database/busypolicy.h>
+#include <Kanoop/database/columnarresult.h>
 #include <Kanoop/database/databasecredentials.h>
+#include <Kanoop/database/databasevalidator.h>
+#include <Kanoop/database/datasourcemetrics.h>
+#include <Kanoop/database/importspec.h>
+#include <Kanoop/database/inclause.h>
+#include <Kanoop/database/queryloadable.h>
+#include <Kanoop/database/queryrouting.h>
+#include <Kanoop/database/recordparser.h>
+#include <Kanoop/database/recordwriter.h>
+#include <Kanoop/database/resultcache.h>
+#include <Kanoop/database/schemamigrations.h>
+#include <Kanoop/database/sqlitestatement.h>
+#include <Kanoop/database/statementcache.h>
+#include <Kanoop/database/writequeue.h>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QHash>
+#include <QIODevice>
+#include <QMutex>
+#include <QSet>
 #include <QSqlDatabase>
+#include <QSqlError>
+#include <QVariant>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+class QThread;
 
 /** @brief Abstract database access layer providing connection management, query execution, and utility methods.
  *
@@ -23,6 +53,127 @@ class DataSource : public QObject,
 {
     Q_OBJECT
 public:
+    /** @brief Statistics reported by bulkInsert() and bulkInsertRows(). */
+    struct BulkInsertStatistics
+    {
+        /** @brief Number of rows inserted. */
+        qint64 rows = 0;
+        /** @brief Number of statement executions used to insert the rows. */
+        qint64 statements = 0;
+        /** @brief Number of transactions (chunks) committed. */
+        int transactions = 0;
+        /** @brief Total elapsed time in milliseconds. */
+        qint64 elapsedMs = 0;
+
+        /** @brief Get the insertion rate.
+         *  @return Rows inserted per second.
+         */
+        double rowsPerSecond() const { return elapsedMs > 0 ? (rows * 1000.0) / elapsedMs : rows * 1000.0; }
+    };
+
+    /** @brief Progress and statistics reported by executeScript(). */
+    struct ScriptStatistics
+    {
+        /** @brief Number of statements executed. */
+        qint64 statements = 0;
+        /** @brief Number of bytes read from the script. */
+        qint64 bytesRead = 0;
+        /** @brief Size of the script in bytes, or -1 if it is read from a sequential device. */
+        qint64 bytesTotal = -1;
+        /** @brief Number of batch transactions committed. */
+        int transactions = 0;
+        /** @brief Elapsed time in milliseconds. */
+        qint64 elapsedMs = 0;
+
+        /** @brief Get the fraction of the script read so far.
+         *  @return The fraction from 0 to 1, or -1 if the size of the script is unknown.
+         */
+        double fractionRead() const { return bytesTotal > 0 ? (double)bytesRead / bytesTotal : (bytesTotal == 0 ? 1.0 : -1.0); }
+    };
+
+    /** @brief Called by executeScript() as the script is read. Return false to cancel. */
+    typedef std::function<bool(const ScriptStatistics& progress)> ScriptProgressCallback;
+
+    /** @brief Progress and statistics reported by importData(). */
+    struct ImportStatistics
+    {
+        /** @brief Number of records parsed into rows. */
+        qint64 rowsRead = 0;
+        /** @brief Number of rows inserted and committed. */
+        qint64 rowsInserted = 0;
+        /** @brief Number of malformed records skipped. */
+        qint64 errorRows = 0;
+        /** @brief The first 100 skipped records, with their line numbers and the reason. */
+        QList<RecordParser::Error> errors;
+        /** @brief Number of bytes read from the file. */
+        qint64 bytesRead = 0;
+        /** @brief Size of the file in bytes, or -1 if it is read from a sequential device. */
+        qint64 bytesTotal = -1;
+        /** @brief Number of transactions committed. */
+        int transactions = 0;
+        /** @brief Elapsed time in milliseconds. */
+        qint64 elapsedMs = 0;
+
+        /** @brief Get the insertion rate.
+         *  @return Rows inserted per second.
+         */
+        double rowsPerSecond() const { return elapsedMs > 0 ? (rowsInserted * 1000.0) / elapsedMs : rowsInserted * 1000.0; }
+
+        /** @brief Get the fraction of the file read so far.
+         *  @return The fraction from 0 to 1, or -1 if the size of the file is unknown.
+         */
+        double fractionRead() const { return bytesTotal > 0 ? (double)bytesRead / bytesTotal : (bytesTotal == 0 ? 1.0 : -1.0); }
+    };
+
+    /** @brief Called by importData() after each bulkInsertChunkSize() rows are committed. Return false to cancel. */
+    typedef std::function<bool(const ImportStatistics& progress)> ImportProgressCallback;
+
+    /** @brief Progress and statistics reported by exportData(). */
+    struct ExportStatistics
+    {
+        /** @brief Number of rows written. */
+        qint64 rows = 0;
+        /** @brief Number of bytes of CSV or NDJSON encoded, before any compression. */
+        qint64 bytesEncoded = 0;
+        /** @brief Number of bytes written to the device. */
+        qint64 bytesWritten = 0;
+        /** @brief Elapsed time in milliseconds. */
+        qint64 elapsedMs = 0;
+
+        /** @brief Get the export rate.
+         *  @return Rows written per second.
+         */
+        double rowsPerSecond() const { return elapsedMs > 0 ? (rows * 1000.0) / elapsedMs : rows * 1000.0; }
+    };
+
+    /** @brief Called by exportData() each time its buffer is written out. Return false to cancel. */
+    typedef std::function<bool(const ExportStatistics& progress)> ExportProgressCallback;
+
+    /** @brief Progress and statistics reported by backupTo(). */
+    struct BackupStatistics
+    {
+        /** @brief Number of pages in the source database. */
+        qint64 pageCount = 0;
+        /** @brief Number of pages copied so far. */
+        qint64 pagesCopied = 0;
+        /** @brief Number of copy steps taken. */
+        int steps = 0;
+        /** @brief Number of steps retried because a writer held the source locked. */
+        int busyRetries = 0;
+        /** @brief true if the copy was made incrementally with SQLite's online backup API. */
+        bool incremental = false;
+        /** @brief Elapsed time in milliseconds. */
+        qint64 elapsedMs = 0;
+
+        /** @brief Get the fraction of the database copied so far.
+         *  @return The fraction from 0 to 1.
+         */
+        double fractionCopied() const { return pageCount > 0 ? (double)pagesCopied / pageCount : 0.0; }
+    };
+
+    /** @brief Called by backupTo() after each step. Return false to cancel. */
+    typedef std::function<bool(const BackupStatistics& progress)> BackupProgressCallback;
+
     /** @brief Construct a DataSource with default (empty) credentials. */
     explicit DataSource() :
         QObject(),
@@ -81,19 +232,391 @@ public:
      */
     void setCreateOnOpenFailure(bool value) { _createOnOpenFailure = value; }
 
+    /** @brief Get the maximum number of prepared statements cached by prepareQuery().
+     *  @return The cache size, 0 if statement caching is disabled (the default).
+     */
+    int statementCacheSize() const { return _statementCache.capacity(); }
+    /** @brief Set the maximum number of prepared statements cached by prepareQuery().
+     *
+     *  When enabled, preparing SQL text which is already cached returns the cached
+     *  statement reset and unbound instead of preparing it again. Any earlier result
+     *  set from the same SQL text must be finished with before it is prepared again.
+     *  @param value The cache size, or 0 to disable statement caching.
+     */
+    void setStatementCacheSize(int value) { _statementCache.setCapacity(value); }
+
+    /** @brief Get the prepared statement cache hit, miss and eviction counters.
+     *  @return The statement cache statistics.
+     */
+    StatementCache::Statistics statementCacheStatistics() const { return _statementCache.statistics(); }
+
+    /** @brief Get the memory budget of the result cache used by executeCached().
+     *  @return The budget in bytes, 0 if result caching is disabled (the default).
+     */
+    qint64 resultCacheBudget() const { return _resultCache.budget(); }
+    /** @brief Set the memory budget of the result cache used by executeCached().
+     *
+     *  Cached results are dropped when a statement executed through this data
+     *  source writes a table they read, including through a view. When the library
+     *  links SQLite directly (the KANOOP_DATABASE_NATIVE_SQLITE option) an update
+     *  hook also catches rows changed by triggers and foreign key actions; it is
+     *  installed by openConnection(), so enable the cache before opening. Writes
+     *  made by other connections or processes are not seen: call
+     *  invalidateResultCache() after them.
+     *  @param value The budget in bytes, or 0 to disable result caching.
+     */
+    void setResultCacheBudget(qint64 value) { _resultCache.setBudget(value); }
+
+    /** @brief Get the result cache hit, miss, eviction and invalidation counters.
+     *  @return The result cache statistics.
+     */
+    ResultCache::Statistics resultCacheStatistics() const { return _resultCache.statistics(); }
+
+    /** @brief Discard every cached result. */
+    void invalidateResultCache() { _resultCache.invalidate(); }
+
+    /** @brief Discard the cached results which read a table, e.g. after another process wrote it.
+     *  @param table The table name (case-insensitive).
+     */
+    void invalidateResultCache(const QString& table) { _resultCache.invalidateTable(table); }
+
+    /** @brief Get the SQLite performance profile set on this data source.
+     *  @return The profile, which is empty unless set.
+     */
+    SqlitePerformanceProfile sqliteProfile() const { return _sqliteProfile; }
+    /** @brief Set the SQLite performance profile applied by openConnection().
+     *
+     *  A non-empty profile set here takes precedence over the one in the credentials.
+     *  @param value The profile.
+     */
+    void setSqliteProfile(const SqlitePerformanceProfile& value) { _sqliteProfile = value; }
+
+    /** @brief Get the SQLite performance profile which openConnection() applies.
+     *  @return The data source profile if set, otherwise the credentials profile.
+     */
+    SqlitePerformanceProfile effectiveSqliteProfile() const { return _sqliteProfile.isEmpty() ? _credentials.sqliteProfile() : _sqliteProfile; }
+
+    /** @brief Read the PRAGMA settings currently in effect on the open SQLite connection.
+     *
+     *  Must be called from the thread which opened the connection.
+     *  @return The settings in effect, or an empty profile if the connection is not an open SQLite connection.
+     */
+    SqlitePerformanceProfile currentSqliteProfile();
+
+    /** @brief Get the number of rows bulkInsert() commits per transaction.
+     *  @return The chunk size in rows.
+     */
+    int bulkInsertChunkSize() const { return _bulkInsertChunkSize; }
+    /** @brief Set the number of rows bulkInsert() commits per transaction.
+     *  @param value The chunk size in rows.
+     */
+    void setBulkInsertChunkSize(int value) { _bulkInsertChunkSize = qMax(1, value); }
+
+    /** @brief Get the maximum number of bound variables allowed in a single statement.
+     *  @return The bound variable limit.
+     */
+    int maxBoundVariables() const { return _maxBoundVariables; }
+    /** @brief Set the maximum number of bound variables allowed in a single statement.
+     *
+     *  Defaults to 999, the SQLITE_MAX_VARIABLE_NUMBER of SQLite builds prior to 3.32.
+     *  @param value The bound variable limit.
+     */
+    void setMaxBoundVariables(int value) { _maxBoundVariables = qMax(1, value); }
+
+    /** @brief Get the number of statements executeScript() commits per transaction.
+     *  @return The batch size in statements.
+     */
+    int scriptBatchSize() const { return _scriptBatchSize; }
+    /** @brief Set the number of statements executeScript() commits per transaction.
+     *  @param value The batch size in statements.
+     */
+    void setScriptBatchSize(int value) { _scriptBatchSize = qMax(1, value); }
+
+    /** @brief Get the number of bytes exportData() encodes before writing them out.
+     *  @return The flush size in bytes.
+     */
+    int exportFlushSize() const { return _exportFlushSize; }
+    /** @brief Set the number of bytes exportData() encodes before writing them out.
+     *  @param value The flush size in bytes.
+     */
+    void setExportFlushSize(int value) { _exportFlushSize = qMax(1, value); }
+
+    /** @brief Get the number of values above which an InClause is staged in a temporary table.
+     *  @return The staging threshold. The effective threshold is also capped at maxBoundVariables().
+     */
+    int inClauseStagingThreshold() const { return _inClauseStagingThreshold; }
+    /** @brief Set the number of values above which an InClause is staged in a temporary table.
+     *
+     *  Leave room below maxBoundVariables() for the statement's other parameters.
+     *  @param value The staging threshold.
+     */
+    void setInClauseStagingThreshold(int value) { _inClauseStagingThreshold = qMax(1, value); }
+
+    /** @brief Get the policy for SQLite lock contention.
+     *  @return The busy policy.
+     */
+    BusyPolicy busyPolicy() const { return _busyPolicy; }
+    /** @brief Set the policy for SQLite lock contention: busy timeout, retries and immediate transactions.
+     *
+     *  The busy timeout is applied by openConnection(), so set the policy before opening.
+     *  Lock waits are counted in the statement metrics.
+     *  @param value The busy policy.
+     */
+    void setBusyPolicy(const BusyPolicy& value) { _busyPolicy = value; }
+
+    /** @brief Get the level of the integrity check run by openConnection() on SQLite databases.
+     *  @return The validation level. NoValidation (the default) skips the check.
+     */
+    DatabaseValidator::Level integrityCheckLevel() const { return _integrityCheckLevel; }
+    /** @brief Set the level of the integrity check run by openConnection() on SQLite databases.
+     *
+     *  A full IntegrityCheck reads the whole database, which on large files can
+     *  delay opening by minutes; QuickCheck is usually the better choice at startup.
+     *  @param value The validation level.
+     */
+    void setIntegrityCheckLevel(DatabaseValidator::Level value) { _integrityCheckLevel = value; }
+
+    /** @brief Get the number of pages backupTo() copies per step.
+     *  @return The pages per step.
+     */
+    int backupPagesPerStep() const { return _backupPagesPerStep; }
+    /** @brief Set the number of pages backupTo() copies per step.
+     *
+     *  The source is locked against writers only while a step runs, so smaller
+     *  steps delay writers less at the cost of a slower backup.
+     *
+     *  Only used with the online backup API (isOnlineBackupAvailable()), which the
+     *  default build does not have. Without it backupTo() makes the copy in one
+     *  VACUUM INTO, which in a rollback journal mode blocks writers for the whole
+     *  copy; in WAL mode writers continue.
+     *  @param value The pages per step.
+     */
+    void setBackupPagesPerStep(int value) { _backupPagesPerStep = qMax(1, value); }
+
+    /** @brief Get the pause between backupTo() steps, which lets writers in.
+     *  @return The pause in milliseconds.
+     */
+    int backupStepDelayMs() const { return _backupStepDelayMs; }
+    /** @brief Set the pause between backupTo() steps, which lets writers in.
+     *
+     *  Ignored without the online backup API (isOnlineBackupAvailable()), as in
+     *  the default build, where backupTo() copies in a single step.
+     *  @param value The pause in milliseconds. 0 only yields the thread.
+     */
+    void setBackupStepDelayMs(int value) { _backupStepDelayMs = qMax(0, value); }
+
+    /** @brief Get the maximum number of queued writes committed in one transaction.
+     *  @return The batch size.
+     */
+    int writeBatchSize() const { return _writeBatchSize; }
+    /** @brief Set the maximum number of queued writes committed in one transaction.
+     *
+     *  A batch is flushed as soon as this many writes are waiting, without waiting for the window to close.
+     *  @param value The batch size.
+     */
+    void setWriteBatchSize(int value) { _writeBatchSize = qMax(1, value); }
+
+    /** @brief Get how long the first queued write waits for others to join its batch.
+     *  @return The batch window in milliseconds.
+     */
+    int writeBatchWindowMs() const { return _writeBatchWindowMs; }
+    /** @brief Set how long the first queued write waits for others to join its batch.
+     *
+     *  Longer windows give larger batches at the cost of latency for each write.
+     *  @param value The batch window in milliseconds. 0 flushes on the next pass of the event loop.
+     */
+    void setWriteBatchWindowMs(int value) { _writeBatchWindowMs = qMax(0, value); }
+
+    /** @brief Get the maximum number of read-only connections opened beside the writer connection.
+     *  @return The limit, 0 if reads share the writer connection (the default).
+     */
+    int readConnectionLimit() const { return _readConnectionLimit; }
+    /** @brief Set the maximum number of read-only connections opened beside the writer connection.
+     *
+     *  Applies to file-backed SQLite databases, and pays off in WAL journal mode,
+     *  where readers do not block the writer or each other. Each thread which
+     *  prepares a SELECT is given its own read connection, opened on first use
+     *  with SQLITE_OPEN_READONLY and PRAGMA query_only, until the limit is reached;
+     *  later threads read through the writer, which only works on the owning thread.
+     *  Everything other than a SELECT, every statement inside a Transaction, and
+     *  SELECTs of last_insert_rowid(), changes() or total_changes(), which report on
+     *  the writer's own connection, go to the writer. Use QueryRouting to override
+     *  the choice.
+     *
+     *  A read connection is closed by its own thread when that thread finishes.
+     *  closeConnection() closes the calling thread's read connection at once; those
+     *  of other threads stop being used and are closed as their threads finish.
+     *
+     *  Read connections see only committed data, and cannot see the writer's TEMP
+     *  tables or databases ATTACHed to it; read those with QueryRouting::Writer.
+     *  A read query holds its connection's snapshot until it is finished, so
+     *  finish() queries read by hand once done with them.
+     *  @param value The limit, or 0 to route everything to the writer connection.
+     */
+    void setReadConnectionLimit(int value) { _readConnectionLimit = qMax(0, value); }
+
+    /** @brief Get the number of read connections currently open.
+     *  @return The number of read connections.
+     */
+    int readConnectionCount() const;
+
+    /** @brief Return true if per-statement metrics are collected.
+     *  @return true if metrics collection is enabled.
+     */
+    bool metricsEnabled() const { return _metrics.isEnabled(); }
+    /** @brief Enable or disable per-statement latency and row count metrics. Disabled by default.
+     *  @param value true to collect metrics.
+     */
+    void setMetricsEnabled(bool value) { _metrics.setEnabled(value); }
+
+    /** @brief Get the execution time above which statements are logged with their bound values.
+     *  @return The threshold in milliseconds, or -1 if disabled (the default).
+     */
+    int slowQueryThresholdMs() const { return _metrics.slowQueryThresholdMs(); }
+    /** @brief Set the execution time above which statements are logged with their bound values.
+     *  @param value The threshold in milliseconds, or -1 to disable.
+     */
+    void setSlowQueryThresholdMs(int value) { _metrics.setSlowQueryThresholdMs(value); }
+
+    /** @brief Get the metrics collector.
+     *
+     *  The collector is internally synchronized, so snapshot() and toPrometheus()
+     *  may be called from any thread.
+     *  @return The metrics collector.
+     */
+    const DataSourceMetrics& metrics() const { return _metrics; }
+    /** @brief Get the metrics collector.
+     *  @return The metrics collector.
+     */
+    DataSourceMetrics& metrics() { return _metrics; }
+
     /** @brief Get a human-readable string describing the last error.
      *  @return The error description string.
      */
     QString errorText() const;
 
     /** @brief Check whether the given file is a valid SQLite database.
+     *
+     *  Runs a full integrity check, reading the whole file. To merely identify a
+     *  SQLite file, use the DatabaseValidator::HeaderOnly level instead.
      *  @param filename The file path to check.
-     *  @return true if the file is a SQLite database.
+     *  @return true if the file is a SQLite database which passes PRAGMA integrity_check.
      */
     static bool isSqlite(const QString& filename);
 
+    /** @brief Check whether the given file is a SQLite database, validated to the given level.
+     *  @param filename The file path to check.
+     *  @param level How thoroughly to validate. HeaderOnly reads 100 bytes without opening a connection; NoValidation is treated as HeaderOnly.
+     *  @return true if the file is a SQLite database which passes the check.
+     */
+    static bool isSqlite(const QString& filename, DatabaseValidator::Level level);
+
+    /** @brief Copy this SQLite database to a file while it remains in use.
+     *
+     *  With SQLite's online backup API (see isOnlineBackupAvailable()) the copy is
+     *  made backupPagesPerStep() pages at a time, pausing backupStepDelayMs()
+     *  between steps so that writers are not held off for long. Otherwise it is
+     *  made in one VACUUM INTO, which holds a read transaction for the whole copy;
+     *  in a rollback journal mode that blocks writers until it completes. The copy is written beside the destination and
+     *  renamed over it when complete, so a failed or cancelled backup leaves any
+     *  previous file in place.
+     *  @param filename The destination file.
+     *  @param progress Optional callback after each step. Return false to cancel.
+     *  @param statistics Optional pointer to receive the final statistics.
+     *  @return true if the backup completed.
+     */
+    bool backupTo(const QString& filename, const BackupProgressCallback& progress = BackupProgressCallback(), BackupStatistics* statistics = nullptr);
+
+    /** @brief Copy this SQLite database into another open SQLite DataSource, replacing its contents.
+     *
+     *  A destination opened on ":memory:" gives a private snapshot for read-only
+     *  analytics which never contends with writers to the file:
+     *  @code
+     *  MyDatabase snapshot(DatabaseCredentials(":memory:"));
+     *  if(snapshot.openConnection() && database.backupTo(&snapshot)) {
+     *      runReports(snapshot);
+     *  }
+     *  @endcode
+     *  Both data sources must belong to the calling thread. Without the online backup
+     *  API the source is attached to the destination's connection and copied in one
+     *  read transaction; that requires a file-backed source and does not copy virtual tables.
+     *  @param destination The open destination data source.
+     *  @param progress Optional callback after each step. Return false to cancel.
+     *  @param statistics Optional pointer to receive the final statistics.
+     *  @return true if the backup completed.
+     */
+    bool backupTo(DataSource* destination, const BackupProgressCallback& progress = BackupProgressCallback(), BackupStatistics* statistics = nullptr);
+
+    /** @brief Return true if backupTo() can use SQLite's online backup API.
+     *  @return true if backupTo() copies incrementally.
+     *  @see isNativeSqliteAvailable()
+     */
+    static bool isOnlineBackupAvailable();
+
+    /** @brief Return true if SQLite is linked directly and may be called on the driver's connections.
+     *
+     *  Enabled by the KANOOP_DATABASE_NATIVE_SQLITE CMake option, which is only safe
+     *  when Qt's QSQLITE driver is built against the same SQLite. openConnection()
+     *  compares sqlite_source_id() on the new connection with the linked library,
+     *  and if they differ turns every native path off for the rest of the process:
+     *  prepareSqlite() fails, and backups, fetchColumns() and the result cache fall
+     *  back to their QtSql implementations.
+     *  @return true if native SQLite features are in use.
+     */
+    static bool isNativeSqliteAvailable();
+
+    /** @brief Queue a write to be group-committed with others. May be called from any thread.
+     *
+     *  Writes are executed in the order queued, on the thread which owns this data
+     *  source, in batches of up to writeBatchSize() per transaction. Each write runs
+     *  in its own savepoint, so one failing write does not undo the others. The
+     *  future completes only after the batch has committed, so a completed write is
+     *  exactly as durable as one made by executeQuery().
+     *
+     *  Batches are flushed from the owning thread's event loop. A data source
+     *  whose thread has no event loop must call flushWrites() itself.
+     *  @code
+     *  database->queueWrite("UPDATE counters SET hits = hits + 1 WHERE id = ?", { id })
+     *      .onFailed([](const CommonException& e) { qWarning() << e.message(); });
+     *  @endcode
+     *  @param sql The INSERT, UPDATE or DELETE statement.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @return A future for the number of rows affected. A failed write completes it with a CommonException.
+     */
+    QFuture<int> queueWrite(const QString& sql, const QVariantList& bindings = QVariantList());
+
+    /** @brief Execute all queued writes now. Must be called on the owning thread.
+     *
+     *  Called automatically when a batch window closes, when a batch fills, and by closeConnection().
+     *  Inside a transaction nothing is executed, since the writes would only become durable
+     *  when that transaction commits; the queue is flushed from the event loop once the
+     *  outermost transaction ends. A thread without an event loop calls this again after it.
+     *  @return true if every write executed now succeeded.
+     */
+    bool flushWrites();
+
+    /** @brief Get the number of queued writes not yet executed.
+     *  @return The queue depth.
+     */
+    int pendingWriteCount() const { return _writeQueue.count(); }
+
+    /** @brief Get group commit counters for writes made through queueWrite().
+     *  @return The counters.
+     */
+    WriteQueue::Statistics writeQueueStatistics() const { return _writeQueue.statistics(); }
+
+signals:
+    /** @brief Emitted by backupTo() after each step.
+     *  @param pagesCopied The number of pages copied so far.
+     *  @param pageCount The number of pages in the source database.
+     */
+    void backupProgress(qint64 pagesCopied, qint64 pageCount);
+
 protected:
     /** @brief Prepare a QSqlQuery from the given SQL string.
+     *
+     *  If statement caching is enabled, a previously prepared statement for the same
+     *  SQL text is returned reset and unbound.
      *  @param sql The SQL statement to prepare.
      *  @param success Optional pointer set to true on success, false on failure.
      *  @return The prepared QSqlQuery.
@@ -113,6 +636,18 @@ protected:
      */
     bool executeQuery(QSqlQuery& query);
 
+    /** @brief Execute a query and return its result, served from the result cache when possible.
+     *
+     *  The result is cached under the SQL text and bound values if result caching
+     *  is enabled (see setResultCacheBudget()) and no Transaction is active, since
+     *  a transaction's writes may yet be rolled back.
+     *  @param sql The SQL statement, normally a SELECT.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @param success Optional pointer set to true on success, false on failure.
+     *  @return The result. Empty on failure.
+     */
+    QueryResult executeCached(const QString& sql, const QVariantList& bindings = QVariantList(), bool* success = nullptr);
+
     /** @brief Check whether a query completed without error.
      *  @param query The query to check.
      *  @return true if the query was successful.
@@ -121,24 +656,369 @@ protected:
 
     /** @brief Execute multiple SQL statements in sequence.
      *  @param queries The list of SQL statements to execute.
+     *  @param atomic If true, run all statements in a single Transaction which is rolled back if any fails.
      *  @return true if all statements executed successfully.
      */
-    bool executeMultiple(const QStringList& queries);
+    bool executeMultiple(const QStringList& queries, bool atomic = false);
+
+    /** @brief Execute a SQL script as it is read from a device.
+     *
+     *  The device is read in fixed-size chunks and each statement is executed as
+     *  soon as it is complete, so memory use is bounded by the longest statement
+     *  rather than the size of the script. Statements are committed in
+     *  transactions of scriptBatchSize() statements. Once the script issues a
+     *  statement which cannot run inside a transaction or has no effect in one
+     *  (BEGIN, COMMIT, VACUUM, ATTACH, PRAGMA foreign_keys, ...) the open batch is
+     *  committed and the rest of the script runs as written, so a sqlite3 .dump
+     *  replays with foreign keys off. The connection's foreign key setting is
+     *  restored when the script ends.
+     *
+     *  A sequential device such as a pipe or QProcess is read until waiting for
+     *  more data brings none. A process still running after 30 seconds without
+     *  output fails the script rather than ending it early.
+     *
+     *  Statements are not added to the statement cache.
+     *  @param device The device to read UTF-8 SQL text from. Must be open for reading.
+     *  @param progress Optional callback invoked after each chunk is processed. Return false to cancel.
+     *  @param statistics Optional pointer which receives statement counts and timing.
+     *  @return true if every statement executed. On failure or cancellation the
+     *  open batch is rolled back; batches committed before it remain.
+     */
+    bool executeScript(QIODevice* device, const ScriptProgressCallback& progress = ScriptProgressCallback(), ScriptStatistics* statistics = nullptr);
+
+    /** @brief Execute a SQL script file as it is read.
+     *  @param filename The path of the script.
+     *  @param progress Optional callback invoked after each chunk is processed. Return false to cancel.
+     *  @param statistics Optional pointer which receives statement counts and timing.
+     *  @return true if every statement executed.
+     *  @see executeScript()
+     */
+    bool executeScriptFile(const QString& filename, const ScriptProgressCallback& progress = ScriptProgressCallback(), ScriptStatistics* statistics = nullptr);
+
+    /** @brief Return true if a Transaction is active on this data source.
+     *  @return true if inside a transaction.
+     */
+    bool inTransaction() const { return _transactionDepth > 0; }
+
+    /** @brief Insert many rows into a table from column-oriented data.
+     *
+     *  Rows are inserted with multi-row INSERT statements sized to stay within
+     *  maxBoundVariables(), executed with QSqlQuery::execBatch() and committed in
+     *  transactions of bulkInsertChunkSize() rows.
+     *  @param table The table name.
+     *  @param columns The column names.
+     *  @param columnValues One list of values per column, all of the same length.
+     *  @param statistics Optional pointer which receives row counts and timing.
+     *  @return true if every row was inserted. Rows in chunks committed before a failure remain inserted.
+     */
+    bool bulkInsert(const QString& table, const QStringList& columns, const QList<QVariantList>& columnValues, BulkInsertStatistics* statistics = nullptr);
+
+    /** @brief Insert many rows into a table from row-oriented data.
+     *  @param table The table name.
+     *  @param columns The column names.
+     *  @param rows One list of values per row, each with one value per column.
+     *  @param statistics Optional pointer which receives row counts and timing.
+     *  @return true if every row was inserted.
+     *  @see bulkInsert()
+     */
+    bool bulkInsertRows(const QString& table, const QStringList& columns, const QList<QVariantList>& rows, BulkInsertStatistics* statistics = nullptr);
+
+    /** @brief Import CSV or NDJSON records into a table as they are read from a device.
+     *
+     *  The device is read in fixed-size chunks and parsed by a RecordParser, which
+     *  maps each record's fields onto the specification's columns and converts
+     *  them to the column types. Rows are inserted with bulkInsert() and committed
+     *  in transactions of bulkInsertChunkSize() rows, so memory use is bounded by
+     *  one transaction's rows rather than the size of the file.
+     *
+     *  Malformed records are skipped and reported in the statistics, up to
+     *  ImportSpec::maxErrorRows(). With ImportSpec::parseThread() the file is parsed
+     *  on a separate thread, at most a few chunks ahead of the inserts. The device
+     *  is always read on the calling thread; a sequential device is read until
+     *  waiting for more data brings none, as in executeScript().
+     *  @param device The device to read UTF-8 records from. Must be open for reading.
+     *  @param spec The target table, record format and column mapping.
+     *  @param progress Optional callback invoked after each bulkInsertChunkSize() rows are committed. Return false to cancel.
+     *  @param statistics Optional pointer which receives row and error counts and timing.
+     *  @return true if the whole file was read and every parsed row inserted. On
+     *  failure or cancellation, transactions committed before it remain.
+     */
+    bool importData(QIODevice* device, const ImportSpec& spec, const ImportProgressCallback& progress = ImportProgressCallback(), ImportStatistics* statistics = nullptr);
+
+    /** @brief Import a CSV or NDJSON file into a table as it is read.
+     *  @param filename The path of the file.
+     *  @param spec The target table, record format and column mapping.
+     *  @param progress Optional callback invoked after each bulkInsertChunkSize() rows are committed. Return false to cancel.
+     *  @param statistics Optional pointer which receives row and error counts and timing.
+     *  @return true if the whole file was imported.
+     *  @see importData()
+     */
+    bool importFile(const QString& filename, const ImportSpec& spec, const ImportProgressCallback& progress = ImportProgressCallback(), ImportStatistics* statistics = nullptr);
+
+    /** @brief Run a query and write its rows to a device as CSV or NDJSON as they are read.
+     *
+     *  The query runs with a forward-only cursor and each row is encoded by a
+     *  RecordWriter into one reusable buffer, written out every exportFlushSize()
+     *  bytes, so memory use is constant however large the result.
+     *  @param device The device to write to. Must be open for writing.
+     *  @param sql The SELECT statement.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @param format The record format. CSV has a header line of column names if the format has one.
+     *  @param compression RecordWriter::Gzip to compress the output. Requires zlib (see RecordWriter::isGzipAvailable()).
+     *  @param progress Optional callback invoked each time the buffer is written out. Return false to cancel.
+     *  @param statistics Optional pointer which receives row and byte counts and timing.
+     *  @return true if every row was written.
+     */
+    bool exportData(QIODevice* device, const QString& sql, const QVariantList& bindings, const RecordFormat& format,
+                    RecordWriter::Compression compression = RecordWriter::NoCompression,
+                    const ExportProgressCallback& progress = ExportProgressCallback(), ExportStatistics* statistics = nullptr);
+
+    /** @brief Run a query and write its rows to a file as CSV or NDJSON.
+     *  @param filename The path of the file, which is replaced.
+     *  @param sql The SELECT statement.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @param format The record format.
+     *  @param compression RecordWriter::Gzip to compress the output.
+     *  @param progress Optional callback invoked each time the buffer is written out. Return false to cancel.
+     *  @param statistics Optional pointer which receives row and byte counts and timing.
+     *  @return true if every row was written.
+     *  @see exportData()
+     */
+    bool exportFile(const QString& filename, const QString& sql, const QVariantList& bindings, const RecordFormat& format,
+                    RecordWriter::Compression compression = RecordWriter::NoCompression,
+                    const ExportProgressCallback& progress = ExportProgressCallback(), ExportStatistics* statistics = nullptr);
+
+    /** @brief Prepare and execute a SELECT with a forward-only cursor.
+     *
+     *  Forward-only queries let the driver discard each row once it has been read,
+     *  rather than caching the whole result set for scrolling.
+     *  @param sql The SQL statement.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @param success Optional pointer set to true on success, false on failure.
+     *  @return The executed query, positioned before the first row.
+     */
+    QSqlQuery executeForwardOnly(const QString& sql, const QVariantList& bindings = QVariantList(), bool* success = nullptr);
+
+    /** @brief Execute a SELECT and decode the whole result into typed column buffers.
+     *
+     *  Numbers land in QVector<qint64> and QVector<double>, and text and blobs in a
+     *  byte arena per column, without a QVariant per cell. On SQLite, when built with
+     *  KANOOP_DATABASE_NATIVE_SQLITE, values are read straight from the native
+     *  statement; otherwise they are read through QSqlQuery::value().
+     *  @param sql The SQL statement.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @param types Storage type of each column. Missing entries, and Auto, are chosen from the column's declared type.
+     *  @param success Optional pointer set to true on success, false on failure.
+     *  @return The result, or an empty result on failure.
+     */
+    ColumnarResult fetchColumns(const QString& sql, const QVariantList& bindings = QVariantList(),
+                                const QList<ColumnarResult::Type>& types = QList<ColumnarResult::Type>(), bool* success = nullptr);
+
+    /** @brief Prepare a native SQLite statement on this data source's connection.
+     *
+     *  The statement is prepared once per SQL text and kept until the connection
+     *  closes; preparing the same SQL again returns it reset, with its previous
+     *  bindings. While another SqliteStatement still holds it, a separate statement
+     *  is prepared instead, so two live statements never share bindings or rows;
+     *  it is finalized once no SqliteStatement refers to it.
+     *
+     *  A statement always runs on the data source's own connection, never a read
+     *  connection, and takes part in any open Transaction. Writes through it
+     *  invalidate the result cache like any other.
+     *  Requires SQLite linked directly (KANOOP_DATABASE_NATIVE_SQLITE).
+     *  @param sql A single SQL statement.
+     *  @param success Optional pointer set to true on success, false on failure.
+     *  @return The statement, invalid on failure.
+     */
+    SqliteStatement prepareSqlite(const QString& sql, bool* success = nullptr);
+
+    /** @brief Load each row of a query into a new T and pass it to a callback.
+     *
+     *  Rows are read through a forward-only cursor and each T is destroyed once the
+     *  callback returns, so memory use does not grow with the size of the result.
+     *  @param sql The SQL statement.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @param callback Called as bool(T&) for each row. Return false to stop early.
+     *  @return true unless the query failed, reading a row failed or a row failed to load.
+     *  Stopping early is not a failure.
+     */
+    template <typename T, typename Callback>
+    bool forEachRow(const QString& sql, const QVariantList& bindings, Callback callback)
+    {
+        static_assert(std::is_base_of<QueryLoadable, T>::value, "T must derive from QueryLoadable");
+
+        bool success;
+        qint64 rows = 0;
+        QSqlQuery query = executeForwardOnly(sql, bindings, &success);
+        while(success && query.next()) {
+            T item;
+            rows++;
+            if(item.loadFromQuery(query) == false) {
+                recordLoadFailure(sql);
+                success = false;
+            }
+            else if(callback(item) == false) {
+                break;
+            }
+        }
+        // next() also returns false when reading a row fails, e.g. SQLITE_BUSY part way through
+        if(success && query.lastError().type() != QSqlError::NoError) {
+            recordQueryError(query);
+            logFailure(query);
+            success = false;
+        }
+        recordRowsFetched(query, rows);
+        query.finish();
+        return success;
+    }
+
+    /** @brief Load the rows of a query into lists of T, delivered chunkSize rows at a time.
+     *
+     *  The same list is cleared and reused for every chunk, so peak memory is bounded
+     *  by the chunk size rather than the size of the result.
+     *  @param sql The SQL statement.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @param chunkSize Maximum number of rows per chunk.
+     *  @param callback Called as bool(QList<T>&) for each chunk. Return false to stop early.
+     *  @return true unless the query failed or a row failed to load.
+     */
+    template <typename T, typename Callback>
+    bool forEachChunk(const QString& sql, const QVariantList& bindings, int chunkSize, Callback callback)
+    {
+        chunkSize = qMax(chunkSize, 1);
+        QList<T> chunk;
+        chunk.reserve(chunkSize);
+        bool more = true;
+        bool success = forEachRow<T>(sql, bindings, [&chunk, &more, &callback, chunkSize](T& item) {
+            chunk.append(std::move(item));
+            if(chunk.count() >= chunkSize) {
+                more = callback(chunk);
+                chunk.clear();
+            }
+            return more;
+        });
+        if(success && more && chunk.isEmpty() == false) {
+            callback(chunk);
+        }
+        return success;
+    }
+
+    /** @brief Load every row of a query into a list of T.
+     *  @param sql The SQL statement.
+     *  @param bindings Values bound in order to the statement's placeholders.
+     *  @param reserveHint Expected row count, used to size the list up front. Zero for no hint.
+     *  @param success Optional pointer set to true on success, false on failure.
+     *  @return The loaded objects. On failure, those loaded before the failure.
+     */
+    template <typename T>
+    QList<T> loadAll(const QString& sql, const QVariantList& bindings = QVariantList(), qsizetype reserveHint = 0, bool* success = nullptr)
+    {
+        QList<T> result;
+        if(reserveHint > 0) {
+            result.reserve(reserveHint);
+        }
+        bool loaded = forEachRow<T>(sql, bindings, [&result](T& item) {
+            result.append(std::move(item));
+            return true;
+        });
+        if(success != nullptr) {
+            *success = loaded;
+        }
+        return result;
+    }
 
     /** @brief Return the SQL used to create the database schema. Override in subclasses.
      *  @return The SQL creation string, or an empty string by default.
      */
     virtual QString createSql() const { return QString(); }
 
+    /** @brief Return the path of a SQL script used to create the database schema. Override in subclasses.
+     *
+     *  When non-empty, this takes precedence over createSql() and the script is
+     *  streamed through executeScript() rather than loaded whole.
+     *  @return The script path, or an empty string by default.
+     */
+    virtual QString createSqlFile() const { return QString(); }
+
     /** @brief Perform any necessary database migrations. Override in subclasses.
+     *
+     *  The default implementation calls applyMigrations(), which does nothing
+     *  unless migrations have been registered.
      *  @return true on success.
      */
-    virtual bool migrate() { return true; }
+    virtual bool migrate() { return applyMigrations(); }
+
+    /** @brief Return the schema version which createSql() or createSqlFile() produces. Override in subclasses.
+     *
+     *  A newly created database is stamped with this version, so registered
+     *  migrations up to and including it are not applied to it.
+     *  @return The schema version, 0 by default.
+     */
+    virtual int createSchemaVersion() const { return 0; }
+
+    /** @brief Register an SQL migration step, typically from the subclass constructor.
+     *  @param version The schema version the step brings the database to. Must be positive and unique.
+     *  @param description Human-readable description.
+     *  @param sql One or more semicolon-separated statements.
+     *  @return false if the version is not positive or already registered.
+     */
+    bool registerMigration(int version, const QString& description, const QString& sql) { return _migrations.add(version, description, sql); }
+
+    /** @brief Register a migration step implemented in code.
+     *  @param version The schema version the step brings the database to. Must be positive and unique.
+     *  @param description Human-readable description.
+     *  @param step The closure which performs the migration. Return false on failure.
+     *  @param checksumSource Text identifying the closure's behaviour, hashed into the recorded checksum. Defaults to the description.
+     *  @return false if the version is not positive or already registered.
+     */
+    bool registerMigration(int version, const QString& description, const SchemaMigrations::Step& step, const QString& checksumSource = QString()) { return _migrations.add(version, description, step, checksumSource); }
+
+    /** @brief Get the registered migrations.
+     *  @return The migration registry.
+     */
+    const SchemaMigrations& migrations() const { return _migrations; }
+
+    /** @brief Apply the registered migrations newer than the database's schema version.
+     *
+     *  When the schema is current this costs a single version read. Otherwise each
+     *  pending step runs in its own transaction together with its history record
+     *  and version update, so a failed step leaves the database at the previous
+     *  version. Steps containing statements which cannot run in a transaction
+     *  (BEGIN, COMMIT, VACUUM, ATTACH, PRAGMA foreign_keys, ...) run without one,
+     *  and the connection's foreign key setting is restored after such a step.
+     *
+     *  On SQLite the version is kept in PRAGMA user_version; on other engines it
+     *  is the highest version in the history table.
+     *  @return true if the schema is now at migrations().latestVersion() or newer.
+     */
+    bool applyMigrations();
+
+    /** @brief Read the database's schema version.
+     *  @param success Optional pointer set to true on success, false on failure.
+     *  @return The schema version, 0 for a database which has never been migrated.
+     */
+    int schemaVersion(bool* success = nullptr);
+
+    /** @brief Read the migration history table.
+     *  @param success Optional pointer set to true on success, false on failure.
+     *  @return The applied migrations in ascending version order. Empty if none have been applied.
+     */
+    QList<SchemaMigrations::AppliedMigration> migrationHistory(bool* success = nullptr);
 
-    /** @brief Run an integrity check on the database. Override in subclasses.
+    /** @brief Compare the recorded checksum of each applied migration with the registered step.
+     *
+     *  Not run by applyMigrations(), to keep startup cheap. Call it from tests or diagnostics.
+     *  @return The versions whose registered step has changed since it was applied.
+     */
+    QList<int> changedMigrations();
+
+    /** @brief Run an integrity check on the database. Called by openConnection() after migrate().
+     *
+     *  The default implementation validates SQLite databases to integrityCheckLevel(),
+     *  logging any problems found. Override to check other databases or application invariants.
      *  @return true if the database passes the integrity check.
      */
-    virtual bool integrityCheck() { return true; }
+    virtual bool integrityCheck();
 
     /** @brief Log a SQL statement at the given log level.
      *  @param file The source file name (use __FILE__).
@@ -156,7 +1036,10 @@ protected:
     /** @brief Set the data source error string.
      *  @param value The error description.
      */
-    void setDataSourceError(const QString& value) { _dataSourceError = value; }
+    void setDataSourceError(const QString& value) { QMutexLocker locker(&_errorMutex); _dataSourceError = value; }
+
+    /** @brief Discard all cached prepared statements. Call after changing the schema outside of executeQuery(). */
+    void invalidateStatementCache() { _statementCache.invalidate(); }
 
     /** @brief Delete and recreate the SQLite database file from createSql().
      *  @return true on success.
@@ -188,6 +1071,9 @@ protected:
     QSqlDatabase _db;
 
     /** @brief Build a comma-delimited string from a list of values.
+     *
+     *  Inlined literals make every distinct list a distinct statement. Prefer
+     *  InClause, which binds the values as parameters.
      *  @param list The list of values to join.
      *  @return A comma-separated string representation.
      */
@@ -195,18 +1081,24 @@ protected:
     static QString commaDelimitedList(const QList<T> &list);
 
     /** @brief Build a comma-delimited string from a list of integers.
+     *
+     *  Prefer InClause for IN lists.
      *  @param list The list of integers.
      *  @return A comma-separated string of integers.
      */
     static QString commaDelimitedIntList(const QList<int> &list);
 
     /** @brief Build a comma-delimited string from a list of UUIDs.
+     *
+     *  Prefer InClause for IN lists.
      *  @param list The list of QUuid values.
      *  @return A comma-separated string of UUIDs.
      */
     static QString commaDelimitedUuidList(const QList<QUuid>& list);
 
     /** @brief Build a comma-delimited string from a list of strings.
+     *
+     *  Prefer InClause for IN lists.
      *  @param list The string list.
      *  @return A comma-separated, quoted string.
      */
@@ -220,22 +1112,137 @@ protected:
 
 
 private:
+    friend class AsyncDataSource;
+    friend class InClause;
+    friend class QueryRouting;
+    friend class SqliteStatement;
+    friend class Transaction;
+
+    /** @brief A temporary table used to stage the values of an InClause. */
+    struct InListTable
+    {
+        QString columnType;
+        bool inUse = false;
+    };
+
+    /** @brief A read-only connection owned by one thread. */
+    struct ReadConnection
+    {
+        QSqlDatabase db;
+        QString connectionName;
+        StatementCache statementCache;
+        QMetaObject::Connection finishedHook;
+    };
+
     bool checkExecutingThread() const;
     void recordQueryError(const QSqlQuery& query);
+    void recordError(const QSqlError& error);
+    void recordNativeError(const QString& sql, int code, const QString& message);
+    void recordNativeWrite(const QString& sql);
+    void finalizeSqliteStatements();
+    void releaseUnsharedSqliteStatements();
+    static bool isSchemaChange(const QString& sql);
+    static bool requiresAutocommit(const QStringList& statements);
+    static bool requiresAutocommit(const QString& statement);
+    bool executeScriptStatement(const QString& sql);
+    bool applyMigration(const SchemaMigrations::Migration& migration);
+    bool setSchemaVersion(int version);
+    int acquireInListTable(const QVariantList& values);
+    void releaseInListTable(int table);
+    static QString inListTableName(int table) { return QString("_kdb_inlist_%1").arg(table); }
+    void recordLoadFailure(const QString& sql);
+    void recordExecution(const QSqlQuery& query, qint64 usecs, bool success, qint64 rowsAffected = -1);
+    void recordRowsFetched(const QSqlQuery& query, qint64 rows);
+    static QString boundValuesText(const QSqlQuery& query);
+    int beginTransaction();
+    bool commitTransaction(int depth);
+    bool rollbackTransaction(int depth);
+    void unwindTransactions(int depth);
+    void scheduleDeferredWrites();
+    bool executeTransactionControl(const QString& sql, bool retryBusy = false);
+    bool execRetryingBusy(QSqlQuery& query, bool retryable);
+    static QString multiRowInsertSql(const QString& table, const QStringList& columns, int rowCount);
+    bool executeBulkStatement(const QString& table, const QStringList& columns, const QList<QVariantList>& columnValues,
+                              qsizetype firstRow, int rowsPerStatement, int executions, BulkInsertStatistics& statistics);
     void createSqliteDatabase();
     bool setSqliteForeignKeyChecking(bool value);
+    bool applySqliteProfile(bool newDatabase);
+    QVariant readPragma(const QString& name);
+    QString backupPages(const QSqlDatabase& destination, const BackupProgressCallback& progress, BackupStatistics& statistics);
+    bool reportBackupProgress(const BackupProgressCallback& progress, const BackupStatistics& statistics);
+    bool copyFromAttached(const QString& filename);
+    bool executeWriteBatch(const QList<WriteQueue::Write>& batch);
+    QueryRouting::Route setQueryRoute(QueryRouting::Route route);
+    ReadConnection* routeToReader(const QString& sql);
+    std::shared_ptr<ReadConnection> openReadConnection();
+    bool isReaderQuery(const QSqlQuery& query) const;
+    void closeReadConnections();
+    void verifyNativeSqlite();
+    void installBusyHandler();
+    static int sqliteBusyHandler(void* context, int count);
+    void readerThreadFinished(QThread* thread);
+    static void closeReadConnection(ReadConnection* reader);
+    static bool isReadStatement(const QString& sql);
+    void invalidateResults(const QString& sql);
+    void recordTableWrite(const QString& table);
+    void invalidateTransactionWrites();
+    QStringList resultDependencies(const QString& sql);
+    void installUpdateHook();
 
     DatabaseCredentials _credentials;
     QString _connectionName;
+    SqlitePerformanceProfile _sqliteProfile;
+    BusyPolicy _busyPolicy;
+    DataSourceMetrics _metrics;
+    SchemaMigrations _migrations;
 
     bool _createOnOpenFailure = true;
+    int _bulkInsertChunkSize = 10000;
+    int _maxBoundVariables = 999;
+    int _scriptBatchSize = 1000;
+    int _exportFlushSize = RecordWriter::DefaultFlushSize;
+    int _inClauseStagingThreshold = 500;
+    DatabaseValidator::Level _integrityCheckLevel = DatabaseValidator::NoValidation;
+    int _backupPagesPerStep = 256;
+    int _backupStepDelayMs = 5;
+    // Read by queueWrite() on producer threads
+    std::atomic<int> _writeBatchSize { 500 };
+    std::atomic<int> _writeBatchWindowMs { 5 };
+    int _readConnectionLimit = 0;
+    // Read by routeToReader() and execRetryingBusy() on reader threads
+    std::atomic<int> _transactionDepth { 0 };
 
     QString _dataSourceError;
     QString _driverError;
     QString _databaseError;
     QString _nativeError;
+    mutable QMutex _errorMutex;
+
+    StatementCache _statementCache;
+    QHash<QString, std::shared_ptr<SqliteStatement::Handle>> _sqliteStatements;
+    // Prepared because the cached statement for the same SQL was still being stepped
+    QList<std::shared_ptr<SqliteStatement::Handle>> _unsharedSqliteStatements;
+    QList<InListTable> _inListTables;
+    WriteQueue _writeQueue;
+
+    QHash<QThread*, std::shared_ptr<ReadConnection>> _readConnections;
+    QHash<QThread*, QueryRouting::Route> _queryRoutes;
+    int _readConnectionSerial = 0;
+    mutable QMutex _readMutex;
+
+    ResultCache _resultCache;
+    QSet<QString> _transactionWrites;
+    QSet<QByteArray> _hookedTables;
+    QHash<QString, QStringList> _viewTables;
+    bool _viewTablesLoaded = false;
+    QMutex _viewMutex;
+
+    std::atomic<int64_t> _threadId { 0 };
 
-    int64_t _threadId = 0;
+    // The writer connection's busy handler, only used on the owning thread
+    int _busyHandlerTimeoutMs = 0;
+    QElapsedTimer _busyHandlerTimer;
+    qint64 _busyHandlerWaitUsecs = 0;
 };
 
 #endif // DATASOURCE_H
@@ -0,0 +1,245 @@
+/**
+ *  DataSourceMetrics
+ *
+ *  Per-statement execution counts, latency histograms and row counts for a DataSource.
+ *
+ *  Statements are grouped by their normalized SQL text, with literals replaced by
+ *  placeholders and whitespace collapsed, so the same query issued with different
+ *  values is counted once. Collection is opt-in and costs a single flag test when
+ *  disabled.
+ *
+ *  Recording happens on the DataSource's thread. Snapshots and the Prometheus
+ *  text dump may be taken from any thread.
+ */
+#ifndef DATASOURCEMETRICS_H
+#define DATASOURCEMETRICS_H
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <array>
+
+/** @brief Collects per-statement execution metrics for a DataSource. */
+class DataSourceMetrics
+{
+public:
+    /** @brief Fixed-bucket latency histogram with microsecond resolution. */
+    class Histogram
+    {
+    public:
+        /** @brief Number of finite bucket bounds. A final overflow bucket follows them. */
+        static const int BoundCount = 17;
+
+        /** @brief Get the upper bounds of the finite buckets.
+         *  @return The bucket upper bounds in microseconds, ascending.
+         */
+        static const std::array<qint64, BoundCount>& bounds();
+
+        /** @brief Add a sample.
+         *  @param usecs The sample in microseconds.
+         */
+        void record(qint64 usecs);
+
+        /** @brief Add another histogram's samples to this one.
+         *  @param other The histogram to add.
+         */
+        void merge(const Histogram& other);
+
+        /** @brief Get the number of samples.
+         *  @return The sample count.
+         */
+        qint64 count() const { return _count; }
+
+        /** @brief Get the sum of all samples.
+         *  @return The sum in microseconds.
+         */
+        qint64 sumUsecs() const { return _sumUsecs; }
+
+        /** @brief Get the largest sample.
+         *  @return The maximum in microseconds.
+         */
+        qint64 maxUsecs() const { return _maxUsecs; }
+
+        /** @brief Get the number of samples in a bucket.
+         *  @param bucket The bucket index, 0 to BoundCount. Bucket BoundCount is the overflow bucket.
+         *  @return The number of samples in the bucket (not cumulative).
+         */
+        qint64 bucketCount(int bucket) const { return _buckets[bucket]; }
+
+        /** @brief Estimate a percentile by interpolating within its bucket.
+         *  @param fraction The percentile as a fraction, e.g. 0.95.
+         *  @return The estimated value in microseconds, or 0 if there are no samples.
+         */
+        double percentile(double fraction) const;
+
+    private:
+        std::array<qint64, BoundCount + 1> _buckets = {};
+        qint64 _count = 0;
+        qint64 _sumUsecs = 0;
+        qint64 _maxUsecs = 0;
+    };
+
+    /** @brief Metrics for one normalized statement. */
+    struct StatementStatistics
+    {
+        /** @brief The normalized SQL text. */
+        QString statement;
+        /** @brief Number of executions, successful or not. */
+        qint64 executions = 0;
+        /** @brief Number of failed preparations and executions. */
+        qint64 failures = 0;
+        /** @brief Rows returned by queries, where known. */
+        qint64 rowsReturned = 0;
+        /** @brief Rows inserted, updated or deleted. */
+        qint64 rowsAffected = 0;
+        /** @brief Number of times the statement was prepared (statement cache misses). */
+        qint64 prepares = 0;
+        /** @brief Total time spent preparing the statement in microseconds. */
+        qint64 prepareUsecs = 0;
+        /** @brief Number of executions which found the database locked at least once.
+         *
+         *  Executions which SQLite's busy timeout carried through to success are only seen when
+         *  the native SQLite API is available (see DataSource::isNativeSqliteAvailable()), and then
+         *  only on the writer connection and until the application issues its own PRAGMA busy_timeout.
+         *  Otherwise only executions whose first attempt failed with SQLITE_BUSY are counted.
+         */
+        qint64 lockWaits = 0;
+        /** @brief Number of retries after the database was found locked. */
+        qint64 lockRetries = 0;
+        /** @brief Number of executions which failed because the database stayed locked. */
+        qint64 lockTimeouts = 0;
+        /** @brief Time spent waiting for locks in microseconds, including SQLite's busy timeout and retry backoff.
+         *
+         *  Subject to the same limits as lockWaits.
+         */
+        qint64 lockWaitUsecs = 0;
+        /** @brief Execution latency. */
+        Histogram latency;
+
+        /** @brief Get the median execution latency.
+         *  @return The p50 latency in milliseconds.
+         */
+        double p50Ms() const { return latency.percentile(0.50) / 1000.0; }
+        /** @brief Get the 95th percentile execution latency.
+         *  @return The p95 latency in milliseconds.
+         */
+        double p95Ms() const { return latency.percentile(0.95) / 1000.0; }
+        /** @brief Get the 99th percentile execution latency.
+         *  @return The p99 latency in milliseconds.
+         */
+        double p99Ms() const { return latency.percentile(0.99) / 1000.0; }
+    };
+
+    /** @brief Construct a disabled metrics collector. */
+    DataSourceMetrics() {}
+
+    /** @brief Return true if metrics are being collected.
+     *  @return true if enabled.
+     */
+    bool isEnabled() const { return _enabled; }
+    /** @brief Enable or disable metrics collection. Collected metrics are kept when disabled.
+     *  @param value true to collect metrics.
+     */
+    void setEnabled(bool value) { _enabled = value; }
+
+    /** @brief Get the execution time above which a statement is logged as slow.
+     *  @return The threshold in milliseconds, or -1 if slow-query logging is disabled (the default).
+     */
+    int slowQueryThresholdMs() const { return _slowQueryThresholdMs; }
+    /** @brief Set the execution time above which a statement is logged with its bound values.
+     *
+     *  Slow-query logging works whether or not metrics collection is enabled.
+     *  @param value The threshold in milliseconds, or -1 to disable.
+     */
+    void setSlowQueryThresholdMs(int value) { _slowQueryThresholdMs = value; }
+
+    /** @brief Get the maximum number of distinct statements tracked.
+     *  @return The statement limit.
+     */
+    int maxStatements() const { return _maxStatements; }
+    /** @brief Set the maximum number of distinct statements tracked.
+     *
+     *  Statements first seen after the limit is reached are counted under OtherStatement.
+     *  @param value The statement limit.
+     */
+    void setMaxStatements(int value) { _maxStatements = qMax(1, value); }
+
+    /** @brief Record the preparation of a statement.
+     *  @param sql The SQL text as prepared.
+     *  @param usecs The time taken in microseconds.
+     *  @param success false if the statement failed to prepare, which counts as a failure.
+     */
+    void recordPrepare(const QString& sql, qint64 usecs, bool success = true);
+
+    /** @brief Record the execution of a statement.
+     *  @param sql The SQL text as executed.
+     *  @param usecs The time taken in microseconds.
+     *  @param success true if the execution succeeded.
+     *  @param rowsReturned Rows returned, or 0 if not known.
+     *  @param rowsAffected Rows inserted, updated or deleted.
+     */
+    void recordExecution(const QString& sql, qint64 usecs, bool success, qint64 rowsReturned, qint64 rowsAffected);
+
+    /** @brief Record an execution which found the database locked.
+     *  @param sql The SQL text as executed.
+     *  @param usecs The time spent waiting in microseconds.
+     *  @param retries The number of retries made.
+     *  @param success false if the execution finally failed because the database stayed locked.
+     */
+    void recordLockWait(const QString& sql, qint64 usecs, int retries, bool success);
+
+    /** @brief Record rows read from a statement's result after execution.
+     *  @param sql The SQL text as executed.
+     *  @param rows The number of rows read.
+     */
+    void recordRowsReturned(const QString& sql, qint64 rows);
+
+    /** @brief Get a copy of the metrics for every statement.
+     *  @return The statement metrics, ordered by total execution time, longest first.
+     */
+    QList<StatementStatistics> snapshot() const;
+
+    /** @brief Get the metrics of all statements combined.
+     *  @return The combined metrics, with an empty statement text.
+     */
+    StatementStatistics totals() const;
+
+    /** @brief Discard all collected metrics. */
+    void reset();
+
+    /** @brief Render the metrics in the Prometheus text exposition format.
+     *  @param prefix The metric name prefix.
+     *  @param labels Labels added to every sample, e.g. the name of the data source.
+     *  @return The exposition text.
+     */
+    QString toPrometheus(const QString& prefix = QStringLiteral("kanoop_db"), const QMap<QString, QString>& labels = QMap<QString, QString>()) const;
+
+    /** @brief Normalize SQL so that statements differing only in literal values group together.
+     *
+     *  String and numeric literals become '?', whitespace runs become a single
+     *  space and placeholder lists such as IN (?, ?, ?) become (?).
+     *  @param sql The SQL text.
+     *  @return The normalized SQL text.
+     */
+    static QString normalize(const QString& sql);
+
+    /** @brief Statement text under which statements beyond maxStatements() are counted. */
+    static const QString OtherStatement;
+
+private:
+    StatementStatistics& entry(const QString& sql);
+
+    Q_DISABLE_COPY(DataSourceMetrics)
+
+    mutable QMutex _mutex;
+    QHash<QString, StatementStatistics> _statements;
+    QHash<QString, QString> _normalized;
+
+    bool _enabled = false;
+    int _slowQueryThresholdMs = -1;
+    int _maxStatements = 1000;
+};
+
+#endif // DATASOURCEMETRICS_H
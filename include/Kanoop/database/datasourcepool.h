@@ -0,0 +1,267 @@
+/**
+ *  DataSourcePool
+ *
+ *  A pool of DataSource connections which share one set of credentials.
+ *
+ *  QSqlDatabase connections may only be used from the thread which opened them,
+ *  so the pool lazily opens one connection per worker thread and hands it out
+ *  through a DataSourceLease, which gives it back to the pool on destruction.
+ *  A connection is only ever closed on its own thread: when that thread finishes,
+ *  or, when it is evicted by another thread, by the owning thread's event loop.
+ */
+#ifndef DATASOURCEPOOL_H
+#define DATASOURCEPOOL_H
+
+#include <Kanoop/utility/loggingbaseclass.h>
+#include <Kanoop/database/databasecredentials.h>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QWaitCondition>
+#include <functional>
+
+class DataSource;
+class DataSourcePool;
+class QThread;
+
+/** @brief RAII handle to a DataSource leased from a DataSourcePool.
+ *
+ *  The lease is only valid on the thread which acquired it, and must be released
+ *  before that thread finishes. The connection is returned to the pool when the
+ *  lease is destroyed or released.
+ */
+class DataSourceLease
+{
+public:
+    /** @brief Construct an empty (invalid) lease. */
+    DataSourceLease() {}
+
+    /** @brief Move constructor. The other lease becomes invalid.
+     *  @param other The lease to take ownership from.
+     */
+    DataSourceLease(DataSourceLease&& other) noexcept;
+
+    /** @brief Move assignment. Any connection currently held is released first.
+     *  @param other The lease to take ownership from.
+     *  @return Reference to this lease.
+     */
+    DataSourceLease& operator=(DataSourceLease&& other) noexcept;
+
+    /** @brief Destructor. Returns the connection to the pool. */
+    ~DataSourceLease();
+
+    /** @brief Get the leased data source.
+     *  @return The data source, or nullptr if the lease is invalid.
+     */
+    DataSource* dataSource() const { return _dataSource; }
+
+    /** @brief Get the leased data source cast to the concrete subclass created by the pool factory.
+     *  @return The data source as T, or nullptr if the lease is invalid or of another type.
+     */
+    template <typename T>
+    T* as() const { return dynamic_cast<T*>(_dataSource); }
+
+    /** @brief Access the leased data source.
+     *  @return The data source.
+     */
+    DataSource* operator->() const { return _dataSource; }
+
+    /** @brief Return true if this lease holds a connection.
+     *  @return true if valid.
+     */
+    bool isValid() const { return _dataSource != nullptr; }
+
+    /** @brief Return the connection to the pool before the lease is destroyed. */
+    void release();
+
+private:
+    friend class DataSourcePool;
+    DataSourceLease(DataSourcePool* pool, DataSource* dataSource) :
+        _pool(pool), _dataSource(dataSource) {}
+
+    Q_DISABLE_COPY(DataSourceLease)
+
+    DataSourcePool* _pool = nullptr;
+    DataSource* _dataSource = nullptr;
+};
+
+/** @brief Pool of thread-affine DataSource connections sharing the same credentials.
+ *
+ *  Each thread calling acquire() is given its own connection, opened on first use
+ *  with a unique connection name. Nested acquisitions on the same thread share the
+ *  connection. When maximumConnections() threads already hold connections, acquire()
+ *  retires the longest-idle connection of another thread, or waits up to
+ *  acquireTimeout() milliseconds for one to become idle.
+ *
+ *  When a QThread finishes, its connection is closed on that thread and its slot
+ *  freed. A connection evicted or retired by another thread leaves the pool at
+ *  once, and is closed through deleteLater() by its owning thread's event loop,
+ *  or when that thread finishes. Threads not started by QThread do not report
+ *  finishing, so their connections are only closed by eviction.
+ *
+ *  Leases must not outlive the pool.
+ */
+class DataSourcePool : public LoggingBaseClass
+{
+public:
+    /** @brief Factory used to create the DataSource (or subclass) for each connection. */
+    typedef std::function<DataSource*()> Factory;
+
+    /** @brief Snapshot of pool usage and wait-time metrics. */
+    struct Metrics
+    {
+        /** @brief Number of successful acquire() calls. */
+        qint64 acquisitions = 0;
+        /** @brief Number of acquire() calls which timed out waiting for a connection. */
+        qint64 timeouts = 0;
+        /** @brief Number of connections which failed to open. */
+        qint64 openFailures = 0;
+        /** @brief Number of connections opened. */
+        qint64 connectionsOpened = 0;
+        /** @brief Number of connections closed by idle eviction, retirement or their thread finishing. */
+        qint64 connectionsEvicted = 0;
+        /** @brief Total time spent in acquire(), including connection opening, in microseconds. */
+        qint64 totalWaitUsecs = 0;
+        /** @brief Longest single acquire() time in microseconds. */
+        qint64 maxWaitUsecs = 0;
+        /** @brief Number of connections currently held by the pool. */
+        int connections = 0;
+        /** @brief Number of connections currently leased. */
+        int activeConnections = 0;
+    };
+
+    /** @brief Construct a pool for the given credentials.
+     *  @param credentials The credentials used for every connection.
+     *  @param factory Creates the DataSource for each connection. If empty, a plain DataSource is created.
+     */
+    explicit DataSourcePool(const DatabaseCredentials& credentials, const Factory& factory = Factory());
+
+    /** @brief Destructor. Closes all connections. */
+    virtual ~DataSourcePool();
+
+    /** @brief Build a factory which creates default-constructed instances of T.
+     *  @return The factory.
+     */
+    template <typename T>
+    static Factory factory() { return [] () -> DataSource* { return new T(); }; }
+
+    /** @brief Lease the calling thread's connection, opening it if necessary.
+     *  @param success Optional pointer set to true on success, false on timeout or open failure.
+     *  @return The lease, which is invalid on failure.
+     */
+    DataSourceLease acquire(bool* success = nullptr);
+
+    /** @brief Close connections which have been idle longer than idleTimeout(),
+     *  keeping at least minimumConnections() open.
+     *  @return The number of connections closed.
+     */
+    int evictIdleConnections();
+
+    /** @brief Close every connection which is not currently leased.
+     *  @return The number of connections closed.
+     */
+    int closeIdleConnections();
+
+    /** @brief Get the pool credentials.
+     *  @return The credentials shared by all connections.
+     */
+    DatabaseCredentials credentials() const { return _credentials; }
+
+    /** @brief Get the minimum number of connections kept open by idle eviction.
+     *  @return The minimum connection count.
+     */
+    int minimumConnections() const { return _minimumConnections; }
+    /** @brief Set the minimum number of connections kept open by idle eviction.
+     *  @param value The minimum connection count.
+     */
+    void setMinimumConnections(int value) { _minimumConnections = value; }
+
+    /** @brief Get the maximum number of open connections.
+     *  @return The maximum connection count.
+     */
+    int maximumConnections() const { return _maximumConnections; }
+    /** @brief Set the maximum number of open connections.
+     *  @param value The maximum connection count (at least 1).
+     */
+    void setMaximumConnections(int value) { _maximumConnections = qMax(1, value); }
+
+    /** @brief Get the time after which an unleased connection may be evicted.
+     *  @return The idle timeout in milliseconds.
+     */
+    int idleTimeout() const { return _idleTimeout; }
+    /** @brief Set the time after which an unleased connection may be evicted.
+     *  @param value The idle timeout in milliseconds.
+     */
+    void setIdleTimeout(int value) { _idleTimeout = value; }
+
+    /** @brief Get the time acquire() waits for a connection when the pool is at capacity.
+     *  @return The acquire timeout in milliseconds.
+     */
+    int acquireTimeout() const { return _acquireTimeout; }
+    /** @brief Set the time acquire() waits for a connection when the pool is at capacity.
+     *  @param value The acquire timeout in milliseconds.
+     */
+    void setAcquireTimeout(int value) { _acquireTimeout = value; }
+
+    /** @brief Get the prefix used to build unique connection names.
+     *  @return The connection name prefix.
+     */
+    QString connectionNamePrefix() const { return _connectionNamePrefix; }
+    /** @brief Set the prefix used to build unique connection names.
+     *  @param value The connection name prefix.
+     */
+    void setConnectionNamePrefix(const QString& value) { _connectionNamePrefix = value; }
+
+    /** @brief Get the number of connections currently held by the pool.
+     *  @return The connection count.
+     */
+    int connectionCount() const;
+
+    /** @brief Get a snapshot of the pool metrics.
+     *  @return The metrics.
+     */
+    Metrics metrics() const;
+
+    /** @brief Reset the cumulative metric counters. */
+    void resetMetrics();
+
+private:
+    friend class DataSourceLease;
+
+    class Connection
+    {
+    public:
+        DataSource* dataSource = nullptr;
+        int leaseCount = 0;
+        QElapsedTimer idleTimer;
+        QMetaObject::Connection finishedHook;
+    };
+
+    void releaseLease(DataSource* dataSource);
+    void threadFinished(QThread* thread);
+    QThread* findRetirableConnection() const;
+    QList<Connection*> takeIdleConnections(qint64 minimumIdleTime, int keep);
+    void closeConnections(const QList<Connection*>& connections);
+    void recordWait(qint64 usecs);
+
+    DatabaseCredentials _credentials;
+    Factory _factory;
+
+    int _minimumConnections = 0;
+    int _maximumConnections = 8;
+    int _idleTimeout = 60000;
+    int _acquireTimeout = 30000;
+    QString _connectionNamePrefix;
+
+    QHash<QThread*, Connection*> _connections;
+    mutable QMutex _mutex;
+    QWaitCondition _released;
+    QMutex _openMutex;
+    qint64 _connectionSerial = 0;
+    QElapsedTimer _sweepTimer;
+
+    Metrics _metrics;
+};
+
+#endif // DATASOURCEPOOL_H
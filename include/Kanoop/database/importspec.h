@@ -0,0 +1,123 @@
+/**
+ *  ImportSpec
+ *
+ *  What DataSource::importData() loads: the target table, the record format of
+ *  the file, and how the file's fields map onto the table's columns.
+ *
+ *  Each column names the field it is read from and optionally the type the
+ *  field's text is converted to before it is bound. Without a conversion
+ *  type, CSV fields are bound as strings and NDJSON values as their JSON type,
+ *  leaving the database to apply its own column affinity.
+ */
+#ifndef IMPORTSPEC_H
+#define IMPORTSPEC_H
+
+#include <Kanoop/database/recordformat.h>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+
+/** @brief Table, record format and field to column mapping for a data import. */
+class ImportSpec
+{
+public:
+    /** @brief A column of the target table and the field it is read from. */
+    struct Column
+    {
+        /** @brief The field name, from the CSV header or the NDJSON object keys. Ignored for CSV without a header. */
+        QString field;
+        /** @brief The column name in the target table. */
+        QString column;
+        /** @brief The type the field is converted to, or QMetaType::UnknownType to bind it unconverted. */
+        QMetaType::Type type = QMetaType::UnknownType;
+    };
+
+    /** @brief Construct an empty specification. */
+    ImportSpec() {}
+
+    /** @brief Construct a specification for a table.
+     *  @param table The target table.
+     *  @param format The record format of the file.
+     */
+    explicit ImportSpec(const QString& table, const RecordFormat& format = RecordFormat()) :
+        _table(table), _format(format) {}
+
+    /** @brief Get the target table.
+     *  @return The table name.
+     */
+    QString table() const { return _table; }
+    /** @brief Set the target table.
+     *  @param value The table name.
+     */
+    void setTable(const QString& value) { _table = value; }
+
+    /** @brief Get the record format of the file.
+     *  @return The format.
+     */
+    RecordFormat format() const { return _format; }
+    /** @brief Set the record format of the file.
+     *  @param value The format.
+     */
+    void setFormat(const RecordFormat& value) { _format = value; }
+
+    /** @brief Get the column mapping.
+     *  @return The columns, in insert order.
+     */
+    QList<Column> columns() const { return _columns; }
+    /** @brief Set the column mapping.
+     *
+     *  If no columns are given, every field of the CSV header, or every key of
+     *  the first NDJSON object, is imported unconverted into a column of the
+     *  same name.
+     *  @param value The columns.
+     */
+    void setColumns(const QList<Column>& value) { _columns = value; }
+
+    /** @brief Add a column read from the field of the same name.
+     *  @param column The column and field name.
+     *  @param type The type to convert the field to, or QMetaType::UnknownType.
+     */
+    void addColumn(const QString& column, QMetaType::Type type = QMetaType::UnknownType) { addColumn(column, column, type); }
+    /** @brief Add a column read from a differently named field.
+     *  @param field The field name.
+     *  @param column The column name.
+     *  @param type The type to convert the field to, or QMetaType::UnknownType.
+     */
+    void addColumn(const QString& field, const QString& column, QMetaType::Type type = QMetaType::UnknownType) { _columns.append(Column{ field, column, type }); }
+
+    /** @brief Get the number of malformed records which may be skipped before the import fails.
+     *  @return The error row limit. 0 (the default) fails on the first one.
+     */
+    int maxErrorRows() const { return _maxErrorRows; }
+    /** @brief Set the number of malformed records which may be skipped before the import fails.
+     *
+     *  Malformed records are those with the wrong number of fields, invalid
+     *  JSON, or a field which does not convert to its column's type. Rows the
+     *  database rejects, e.g. for a constraint violation, always fail the import.
+     *  @param value The error row limit.
+     */
+    void setMaxErrorRows(int value) { _maxErrorRows = qMax(0, value); }
+
+    /** @brief Return true if the file is parsed on a separate thread.
+     *  @return true if parsing is threaded.
+     */
+    bool parseThread() const { return _parseThread; }
+    /** @brief Set whether the file is parsed on a separate thread while rows are
+     *  inserted on the data source's thread.
+     *
+     *  The device itself is still read on the calling thread, so any device,
+     *  including sockets and processes, may be used.
+     *  @param value true to parse on a separate thread.
+     */
+    void setParseThread(bool value) { _parseThread = value; }
+
+private:
+    QString _table;
+    RecordFormat _format;
+    QList<Column> _columns;
+    int _maxErrorRows = 0;
+    bool _parseThread = false;
+};
+
+#endif // IMPORTSPEC_H
@@ -0,0 +1,129 @@
+/**
+ *  InClause
+ *
+ *  Bound-parameter expansion of an SQL IN (...) list.
+ *
+ *  Values are bound as parameters rather than inlined as literals. The number of
+ *  placeholders is rounded up to a power of two, padding with the last value, so
+ *  lists of similar length produce identical SQL text and reuse one prepared
+ *  statement. Lists longer than the DataSource's staging threshold are inserted
+ *  into a reusable temporary table and the clause selects from it instead.
+ */
+#ifndef INCLAUSE_H
+#define INCLAUSE_H
+
+#include <QList>
+#include <QStringList>
+#include <QUuid>
+#include <QVariant>
+
+class DataSource;
+
+/** @brief Bound-parameter IN list with bucketed placeholder counts.
+ *
+ *  @code
+ *  InClause ids(this, InClause::values(idList));
+ *  QList<Item> items = loadAll<Item>("SELECT id, name FROM items WHERE id IN " + ids.sql(), ids.bindings());
+ *  @endcode
+ *
+ *  A staged clause holds its temporary table until it is destroyed, so it must
+ *  outlive the queries which use it, and must not outlive its DataSource.
+ */
+class InClause
+{
+public:
+    /** @brief Construct a clause of placeholders, without staging.
+     *  @param values The values in the list.
+     *  @param maxPlaceholders Upper bound on the bucket size. Lists longer than this get exactly one placeholder per value.
+     */
+    explicit InClause(const QVariantList& values, int maxPlaceholders = DefaultMaxPlaceholders);
+
+    /** @brief Construct a clause for a data source, staging long lists in a temporary table.
+     *
+     *  Lists of up to DataSource::inClauseStagingThreshold() values (capped at
+     *  DataSource::maxBoundVariables()) become placeholders. Longer lists are
+     *  inserted into a temporary table on the data source's connection.
+     *  @param dataSource The data source the clause will be used with.
+     *  @param values The values in the list.
+     */
+    InClause(DataSource* dataSource, const QVariantList& values);
+
+    /** @brief Destructor. Releases the temporary table for reuse if the list was staged. */
+    ~InClause();
+
+    /** @brief Get the parenthesized SQL to follow IN.
+     *
+     *  Either a placeholder list such as (?,?,?,?) or a sub-select of the staged
+     *  values. An empty list gives (NULL), which matches nothing; check isEmpty()
+     *  before using the clause with NOT IN.
+     *  @return The SQL fragment.
+     */
+    QString sql() const { return _sql; }
+
+    /** @brief Get the values to bind to the placeholders of sql(), in order.
+     *  @return The padded values, or an empty list if the values were staged.
+     */
+    QVariantList bindings() const { return _bindings; }
+
+    /** @brief Get the number of values in the list, before padding.
+     *  @return The value count.
+     */
+    qsizetype count() const { return _count; }
+
+    /** @brief Return true if the list has no values.
+     *  @return true if empty.
+     */
+    bool isEmpty() const { return _count == 0; }
+
+    /** @brief Return true if the values were staged in a temporary table.
+     *  @return true if staged.
+     */
+    bool isStaged() const { return _table >= 0; }
+
+    /** @brief Return false if staging the values failed. sql() then matches nothing.
+     *  @return true if the clause is usable.
+     */
+    bool isValid() const { return _valid; }
+
+    /** @brief Get the number of placeholders used for a list.
+     *  @param count The number of values.
+     *  @param maxPlaceholders Upper bound on the bucket size.
+     *  @return The smallest power of two not less than count, capped at maxPlaceholders; or count if it exceeds maxPlaceholders.
+     */
+    static int bucketSize(qsizetype count, int maxPlaceholders = DefaultMaxPlaceholders);
+
+    /** @brief Convert a list of integers to bindable values.
+     *  @param list The integers.
+     *  @return The values.
+     */
+    static QVariantList values(const QList<int>& list);
+
+    /** @brief Convert a list of UUIDs to bindable values, formatted without braces as commaDelimitedUuidList() does.
+     *  @param list The UUIDs.
+     *  @return The values.
+     */
+    static QVariantList values(const QList<QUuid>& list);
+
+    /** @brief Convert a list of strings to bindable values.
+     *  @param list The strings.
+     *  @return The values.
+     */
+    static QVariantList values(const QStringList& list);
+
+    /** @brief Default upper bound on the bucket size, SQLite's historical bound variable limit. */
+    static const int DefaultMaxPlaceholders = 999;
+
+private:
+    void buildPlaceholders(const QVariantList& values, int maxPlaceholders);
+
+    Q_DISABLE_COPY(InClause)
+
+    DataSource* _dataSource = nullptr;
+    QString _sql;
+    QVariantList _bindings;
+    qsizetype _count = 0;
+    int _table = -1;
+    bool _valid = true;
+};
+
+#endif // INCLAUSE_H
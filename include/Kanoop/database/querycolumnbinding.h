@@ -0,0 +1,214 @@
+/**
+ *  QueryColumnBinding
+ *
+ *  Resolves column names to result set indexes once per result set.
+ *
+ *  QSqlQuery::value(const QString&) searches the record's field names on every
+ *  call, which dominates row decoding for wide or long result sets. A binding
+ *  performs that search once, when it first sees a result set, and thereafter
+ *  reads values by cached index.
+ */
+#ifndef QUERYCOLUMNBINDING_H
+#define QUERYCOLUMNBINDING_H
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStringList>
+#include <array>
+
+class QSqlResult;
+
+/** @brief Tracks which result set a column binding was resolved against. */
+class QueryColumnBindingBase
+{
+public:
+    /** @brief Get the number of times the column names have been resolved.
+     *  @return The resolve count. Once per distinct result set when used as intended.
+     */
+    int resolveCount() const { return _resolveCount; }
+
+protected:
+    QueryColumnBindingBase() {}
+
+    /** @brief Check whether a query's result set differs from the one last resolved.
+     *
+     *  Result sets are identified by the driver result object and the SQL text,
+     *  so a cached prepared statement executed repeatedly is resolved only once.
+     *  Past the first row of a result set only the result object is compared, so
+     *  the per-row cost does not grow with the length of the SQL. A binding must
+     *  therefore see the first row of each result set it decodes.
+     *  @param query The query about to be decoded.
+     *  @return true if the column names must be resolved again.
+     */
+    bool needsResolve(const QSqlQuery& query);
+
+    /** @brief Forget the result set last resolved, forcing the next bind to resolve. */
+    void reset() { _result = nullptr; _lastQuery.clear(); }
+
+private:
+    const QSqlResult* _result = nullptr;
+    QString _lastQuery;
+    int _resolveCount = 0;
+};
+
+/** @brief Column binding for a list of column names chosen at runtime.
+ *
+ *  @code
+ *  bool Item::loadFromQuery(const QSqlQuery& query)
+ *  {
+ *      enum { Id, Name };
+ *      static thread_local QueryColumnBinding binding({ "id", "name" });
+ *      binding.bind(query);
+ *      _id = binding.value(query, Id).toInt();
+ *      _name = binding.value(query, Name).toString();
+ *      return binding.isComplete();
+ *  }
+ *  @endcode
+ */
+class QueryColumnBinding : public QueryColumnBindingBase
+{
+public:
+    /** @brief Construct an empty binding. */
+    QueryColumnBinding() {}
+
+    /** @brief Construct a binding for the given columns.
+     *  @param columns The column names, in the order they will be referenced.
+     */
+    explicit QueryColumnBinding(const QStringList& columns);
+
+    /** @brief Get the column names.
+     *  @return The column names.
+     */
+    QStringList columns() const { return _columns; }
+
+    /** @brief Set the column names. The next bind() resolves them.
+     *  @param value The column names, in the order they will be referenced.
+     */
+    void setColumns(const QStringList& value);
+
+    /** @brief Resolve the column names against a query if its result set has changed.
+     *  @param query The query positioned on the row about to be decoded.
+     *  @return true if every column is present in the result set.
+     */
+    bool bind(const QSqlQuery& query);
+
+    /** @brief Return true if every column was found in the last result set bound.
+     *  @return true if complete.
+     */
+    bool isComplete() const { return _complete; }
+
+    /** @brief Get the result set index of a column.
+     *  @param column The position of the column in columns().
+     *  @return The result set index, or -1 if the column is not present.
+     */
+    int index(int column) const { return _indexes.at(column); }
+
+    /** @brief Read the value of a column from the query's current row.
+     *  @param query The query passed to the last bind().
+     *  @param column The position of the column in columns().
+     *  @return The value, or an invalid QVariant if the column is not present.
+     */
+    QVariant value(const QSqlQuery& query, int column) const
+    {
+        int index = _indexes.at(column);
+        return index >= 0 ? query.value(index) : QVariant();
+    }
+
+    /** @brief Get the columns which were not found in the last result set bound.
+     *  @return The missing column names.
+     */
+    QStringList missingColumns() const;
+
+private:
+    QStringList _columns;
+    QList<int> _indexes;
+    bool _complete = false;
+};
+
+/** @brief Column binding for a column list fixed at compile time.
+ *
+ *  Indexes are held in a std::array and the column names are not copied, so
+ *  decoding a row involves no allocation beyond the values themselves.
+ *
+ *  @code
+ *  bool Item::loadFromQuery(const QSqlQuery& query)
+ *  {
+ *      enum { Id, Name };
+ *      static constexpr const char* Columns[] = { "id", "name" };
+ *      const auto& binding = bindColumns<Item>(query, Columns);
+ *      _id = binding.value(query, Id).toInt();
+ *      _name = binding.value(query, Name).toString();
+ *      return binding.isComplete();
+ *  }
+ *  @endcode
+ */
+template <size_t N>
+class StaticQueryColumnBinding : public QueryColumnBindingBase
+{
+public:
+    /** @brief Construct a binding for the given columns.
+     *  @param columns The column names. The array must outlive the binding.
+     */
+    explicit StaticQueryColumnBinding(const char* const (&columns)[N]) :
+        _columns(columns) { _indexes.fill(-1); }
+
+    /** @brief Resolve the column names against a query if its result set or column list has changed.
+     *  @param query The query positioned on the row about to be decoded.
+     *  @param columns The column names. Pass the same array on every call.
+     *  @return true if every column is present in the result set.
+     */
+    bool bind(const QSqlQuery& query, const char* const (&columns)[N])
+    {
+        if(columns != _columns) {
+            _columns = columns;
+            reset();
+        }
+        return bind(query);
+    }
+
+    /** @brief Resolve the column names against a query if its result set has changed.
+     *  @param query The query positioned on the row about to be decoded.
+     *  @return true if every column is present in the result set.
+     */
+    bool bind(const QSqlQuery& query)
+    {
+        if(needsResolve(query)) {
+            QSqlRecord record = query.record();
+            _complete = true;
+            for(size_t i = 0;i < N;i++) {
+                _indexes[i] = record.indexOf(QString::fromUtf8(_columns[i]));
+                _complete = _complete && _indexes[i] >= 0;
+            }
+        }
+        return _complete;
+    }
+
+    /** @brief Return true if every column was found in the last result set bound.
+     *  @return true if complete.
+     */
+    bool isComplete() const { return _complete; }
+
+    /** @brief Get the result set index of a column.
+     *  @param column The position of the column in the column list.
+     *  @return The result set index, or -1 if the column is not present.
+     */
+    int index(size_t column) const { return _indexes[column]; }
+
+    /** @brief Read the value of a column from the query's current row.
+     *  @param query The query passed to the last bind().
+     *  @param column The position of the column in the column list.
+     *  @return The value, or an invalid QVariant if the column is not present.
+     */
+    QVariant value(const QSqlQuery& query, size_t column) const
+    {
+        int index = _indexes[column];
+        return index >= 0 ? query.value(index) : QVariant();
+    }
+
+private:
+    const char* const* _columns;
+    std::array<int, N> _indexes;
+    bool _complete = false;
+};
+
+#endif // QUERYCOLUMNBINDING_H
@@ -9,6 +9,7 @@
 #ifndef QUERYLOADABLE_H
 #define QUERYLOADABLE_H
 #include <QSqlQuery>
+#include <Kanoop/database/querycolumnbinding.h>
 
 /** @brief Pure abstract interface for classes that can populate themselves from an active QSqlQuery. */
 class QueryLoadable
@@ -27,6 +28,22 @@ protected:
      */
     static QDateTime utcTime(const QVariant& value);
 
+    /** @brief Resolve a fixed list of column names against a query, once per result set.
+     *
+     *  Each Tag keeps one binding per thread, so loading a result set resolves the
+     *  names on the first row only and decodes every row by cached index.
+     *  @param query The active QSqlQuery positioned at the row to load from.
+     *  @param columns The column names. Pass the same static array on every call.
+     *  @return The binding, whose value(query, i) reads columns[i] from the current row.
+     */
+    template <typename Tag, size_t N>
+    static const StaticQueryColumnBinding<N>& bindColumns(const QSqlQuery& query, const char* const (&columns)[N])
+    {
+        static thread_local StaticQueryColumnBinding<N> binding(columns);
+        binding.bind(query, columns);
+        return binding;
+    }
+
     /** @brief Convert a single-character string to an enum value by casting the first character.
      *  @param value The string representation of the enum.
      *  @return The enum value, or a default-constructed T if the string is empty.
@@ -0,0 +1,106 @@
+/**
+ *  QueryResult
+ *
+ *  A materialized, detached copy of a query result set.
+ *
+ *  Unlike QSqlQuery, a QueryResult does not refer to the database connection,
+ *  so it may be passed between threads and outlive the connection it came from.
+ */
+#ifndef QUERYRESULT_H
+#define QUERYRESULT_H
+
+#include <QList>
+#include <QStringList>
+#include <QVariant>
+
+class QSqlQuery;
+
+/** @brief Detached copy of the rows, column names and execution details of a query. */
+class QueryResult
+{
+public:
+    /** @brief Construct an empty result. */
+    QueryResult() {}
+
+    /** @brief Read the remaining rows of an executed query into a new result.
+     *  @param query An executed query. It is advanced to the end of its result set.
+     *  @param success Optional pointer set to false if reading a row failed, leaving the
+     *  error in the query's lastError(), and to true otherwise.
+     *  @return The result. On failure, the rows read before the failure.
+     */
+    static QueryResult fromQuery(QSqlQuery& query, bool* success = nullptr);
+
+    /** @brief Get the column names.
+     *  @return The column names in result order.
+     */
+    QStringList columns() const { return _columns; }
+
+    /** @brief Get the index of a column.
+     *  @param name The column name (case-insensitive).
+     *  @return The column index, or -1 if not found.
+     */
+    int columnIndex(const QString& name) const;
+
+    /** @brief Get the number of rows.
+     *  @return The row count.
+     */
+    int rowCount() const { return _rows.count(); }
+
+    /** @brief Return true if there are no rows.
+     *  @return true if empty.
+     */
+    bool isEmpty() const { return _rows.isEmpty(); }
+
+    /** @brief Get all rows.
+     *  @return The rows, each holding one value per column.
+     */
+    const QList<QVariantList>& rows() const { return _rows; }
+
+    /** @brief Get a single row.
+     *  @param row The row index.
+     *  @return The row's values, one per column.
+     */
+    const QVariantList& row(int row) const { return _rows.at(row); }
+
+    /** @brief Get a single value by column index.
+     *  @param row The row index.
+     *  @param column The column index.
+     *  @return The value, or an invalid QVariant if out of range.
+     */
+    QVariant value(int row, int column) const;
+
+    /** @brief Get a single value by column name.
+     *  @param row The row index.
+     *  @param column The column name (case-insensitive).
+     *  @return The value, or an invalid QVariant if not found.
+     */
+    QVariant value(int row, const QString& column) const { return value(row, columnIndex(column)); }
+
+    /** @brief Get the number of rows affected by a data-modifying statement.
+     *  @return The affected row count, or -1 if not applicable.
+     */
+    int numRowsAffected() const { return _numRowsAffected; }
+
+    /** @brief Get the row ID of the most recently inserted row, if the driver supports it.
+     *  @return The last insert ID.
+     */
+    QVariant lastInsertId() const { return _lastInsertId; }
+
+    /** @brief Append a row. Used when building a result by hand.
+     *  @param values The row's values, one per column.
+     */
+    void appendRow(const QVariantList& values) { _rows.append(values); }
+
+    /** @brief Set the column names. Used when building a result by hand.
+     *  @param value The column names.
+     */
+    void setColumns(const QStringList& value) { _columns = value; }
+
+private:
+    QStringList _columns;
+    QList<QVariantList> _rows;
+    int _numRowsAffected = -1;
+    QVariant _lastInsertId;
+};
+
+#endif // QUERYRESULT_H
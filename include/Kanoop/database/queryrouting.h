@@ -0,0 +1,60 @@
+/**
+ *  QueryRouting
+ *
+ *  A scoped override of the connection a DataSource routes queries to.
+ *
+ *  When a DataSource has read connections (see DataSource::setReadConnectionLimit())
+ *  it sends SELECTs to them and everything else to its writer connection. A read
+ *  connection sees only committed data, and may briefly lag the writer, so code
+ *  which must read its own writes routes its reads to the writer for a scope.
+ */
+#ifndef QUERYROUTING_H
+#define QUERYROUTING_H
+
+#include <QtGlobal>
+
+class DataSource;
+
+/** @brief RAII override of DataSource query routing for the calling thread.
+ *
+ *  The override applies to queries prepared on the calling thread until the
+ *  QueryRouting is destroyed, when the previous routing is restored. Scopes may
+ *  be nested.
+ *
+ *  @code
+ *  executeQuery("UPDATE accounts SET balance = balance - 10 WHERE id = 1");
+ *  QueryRouting routing(this, QueryRouting::Writer);
+ *  QSqlQuery query = executeQuery("SELECT balance FROM accounts WHERE id = 1");
+ *  @endcode
+ */
+class QueryRouting
+{
+public:
+    /** @brief The connection queries are sent to. */
+    enum Route
+    {
+        /** @brief SELECTs go to a read connection, everything else to the writer. */
+        Automatic,
+        /** @brief Every query goes to the writer connection. */
+        Writer,
+        /** @brief Every query goes to a read connection, where writes fail. */
+        Reader,
+    };
+
+    /** @brief Override query routing on the calling thread.
+     *  @param dataSource The data source whose routing is overridden.
+     *  @param route The route for queries prepared while this object exists.
+     */
+    QueryRouting(DataSource* dataSource, Route route);
+
+    /** @brief Destructor. Restores the previous routing. */
+    ~QueryRouting();
+
+private:
+    Q_DISABLE_COPY(QueryRouting)
+
+    DataSource* _dataSource;
+    Route _previous;
+};
+
+#endif // QUERYROUTING_H
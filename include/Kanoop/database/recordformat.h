@@ -0,0 +1,94 @@
+/**
+ *  RecordFormat
+ *
+ *  Describes a delimited text or newline-delimited JSON file of records, as
+ *  read by DataSource::importData() and written by DataSource::exportData().
+ *
+ *  CSV follows RFC 4180: fields are separated by the delimiter, quoted with
+ *  double quotes when they contain the delimiter, a quote or a line break, and
+ *  quotes inside quoted fields are doubled. NDJSON holds one JSON object per
+ *  line, whose keys name the fields.
+ */
+#ifndef RECORDFORMAT_H
+#define RECORDFORMAT_H
+
+#include <QString>
+
+/** @brief File format of records for import and export. */
+class RecordFormat
+{
+public:
+    /** @brief Record file formats. */
+    enum Type
+    {
+        Csv,        ///< Delimited text, one record per line
+        Ndjson,     ///< Newline-delimited JSON, one object per line
+    };
+
+    /** @brief Construct a comma-separated format with a header line. */
+    RecordFormat() {}
+
+    /** @brief Construct a format of the given type with default settings.
+     *  @param type The format.
+     */
+    explicit RecordFormat(Type type) :
+        _type(type) {}
+
+    /** @brief A delimited text format.
+     *  @param delimiter The field delimiter, e.g. ',' or '\\t'.
+     *  @param header true if the first line names the fields.
+     *  @return The format.
+     */
+    static RecordFormat csv(char delimiter = ',', bool header = true);
+
+    /** @brief A newline-delimited JSON format.
+     *  @return The format.
+     */
+    static RecordFormat ndjson() { return RecordFormat(Ndjson); }
+
+    /** @brief Get the format type.
+     *  @return The type.
+     */
+    Type type() const { return _type; }
+    /** @brief Set the format type.
+     *  @param value The type.
+     */
+    void setType(Type value) { _type = value; }
+
+    /** @brief Get the CSV field delimiter.
+     *  @return The delimiter.
+     */
+    char delimiter() const { return _delimiter; }
+    /** @brief Set the CSV field delimiter. Must not be a double quote or line break.
+     *  @param value The delimiter.
+     */
+    void setDelimiter(char value) { _delimiter = value; }
+
+    /** @brief Return true if the first line of a CSV file names the fields.
+     *  @return true if there is a header line.
+     */
+    bool hasHeader() const { return _header; }
+    /** @brief Set whether the first line of a CSV file names the fields.
+     *
+     *  Without a header, fields are matched to columns by position.
+     *  @param value true if there is a header line.
+     */
+    void setHeader(bool value) { _header = value; }
+
+    /** @brief Get the text of an unquoted CSV field which stands for NULL.
+     *  @return The NULL text. Empty by default, so that an empty unquoted field is NULL and "" is an empty string.
+     */
+    QString nullText() const { return _nullText; }
+    /** @brief Set the text of an unquoted CSV field which stands for NULL, e.g. "\\N".
+     *  @param value The NULL text.
+     */
+    void setNullText(const QString& value) { _nullText = value; }
+
+private:
+    Type _type = Csv;
+    char _delimiter = ',';
+    bool _header = true;
+    QString _nullText;
+};
+
+#endif // RECORDFORMAT_H
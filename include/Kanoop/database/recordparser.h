@@ -0,0 +1,111 @@
+/**
+ *  RecordParser
+ *
+ *  Resumable parser for the CSV and NDJSON records imported by
+ *  DataSource::importData().
+ *
+ *  Data is fed in chunks as it is read. Each complete record is mapped onto
+ *  the import's columns and its fields converted to the column types; a
+ *  partial record at the end of a chunk is held until the next one, so memory
+ *  use is bounded by the chunk size and the longest record rather than the
+ *  size of the file.
+ *
+ *  A record which cannot be converted is reported as an error with its line
+ *  number and skipped. Only a malformed file (a missing header field, or a
+ *  quoted field left open at the end) stops parsing.
+ */
+#ifndef RECORDPARSER_H
+#define RECORDPARSER_H
+
+#include <Kanoop/database/importspec.h>
+#include <QByteArray>
+#include <QJsonValue>
+#include <QList>
+#include <QVariant>
+
+/** @brief Streaming CSV / NDJSON parser producing typed rows for an ImportSpec. */
+class RecordParser
+{
+public:
+    /** @brief A record which was skipped. */
+    struct Error
+    {
+        /** @brief Line number of the start of the record, from 1. */
+        qint64 line = 0;
+        /** @brief Why it was skipped. */
+        QString message;
+    };
+
+    /** @brief Construct a parser.
+     *  @param spec The import specification giving the format and columns.
+     */
+    explicit RecordParser(const ImportSpec& spec);
+
+    /** @brief Parse the next chunk of the file.
+     *  @param data The chunk.
+     *  @param atEnd true if this is the end of the file, so that a final record without a line break is complete.
+     *  @param rows Receives one row per complete record, with one value per column.
+     *  @return false if the file is malformed. See errorText().
+     */
+    bool parse(const QByteArray& data, bool atEnd, QList<QVariantList>& rows);
+
+    /** @brief Get the target column names.
+     *  @return The columns, empty until the header or first NDJSON object has been parsed if none were specified.
+     */
+    QStringList columns() const { return _columns; }
+
+    /** @brief Get the records skipped since the last call, and forget them.
+     *  @return The skipped records.
+     */
+    QList<Error> takeErrors();
+
+    /** @brief Get the number of records skipped in total.
+     *  @return The error count.
+     */
+    qint64 errorCount() const { return _errorCount; }
+
+    /** @brief Get why parsing stopped.
+     *  @return The error, empty if parse() has not failed.
+     */
+    QString errorText() const { return _errorText; }
+
+    /** @brief Convert the text of a field to a type.
+     *
+     *  Numbers are read in the C locale, booleans from true/false, yes/no, t/f
+     *  or 1/0, dates and times as ISO 8601 and byte arrays as base64.
+     *  @param text The text.
+     *  @param type The type, or QMetaType::UnknownType to keep the text.
+     *  @param ok Set to false if the text does not convert.
+     *  @return The converted value.
+     */
+    static QVariant convertText(const QString& text, QMetaType::Type type, bool* ok);
+
+private:
+    struct Field
+    {
+        QByteArray text;
+        bool quoted = false;
+    };
+
+    bool parseCsv(bool atEnd, QList<QVariantList>& rows);
+    bool parseNdjson(bool atEnd, QList<QVariantList>& rows);
+    qsizetype scanCsvRecord(qsizetype start, bool atEnd, QList<Field>& fields, int* lines);
+    bool resolveHeader(const QList<Field>& header);
+    QVariant convertJson(const QJsonValue& value, QMetaType::Type type, bool* ok);
+    void addError(qint64 line, const QString& message);
+
+    ImportSpec _spec;
+    QList<ImportSpec::Column> _specColumns;
+    QStringList _columns;
+    QList<int> _fieldIndexes;
+    int _fieldCount = 0;
+    bool _headerParsed = false;
+
+    QByteArray _buffer;
+    qint64 _line = 1;
+    QList<Error> _errors;
+    qint64 _errorCount = 0;
+    QString _errorText;
+};
+
+#endif // RECORDPARSER_H
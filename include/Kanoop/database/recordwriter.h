@@ -0,0 +1,130 @@
+/**
+ *  RecordWriter
+ *
+ *  Writes rows to a QIODevice as CSV or NDJSON, as exported by
+ *  DataSource::exportData().
+ *
+ *  Rows are encoded into one reusable buffer, which is written to the device
+ *  whenever it reaches the flush size, so memory use stays constant however
+ *  many rows are written. The output may be gzip-compressed on the way out
+ *  when the library is built with zlib (see isGzipAvailable()).
+ *
+ *  CSV is written so that RecordParser reads it back unchanged: NULL is the
+ *  format's NULL text, and strings which need it (including empty strings
+ *  when NULL is empty) are quoted. Byte arrays are written as base64 and dates
+ *  and times as ISO 8601, in both formats.
+ */
+#ifndef RECORDWRITER_H
+#define RECORDWRITER_H
+
+#include <Kanoop/database/recordformat.h>
+#include <QByteArray>
+#include <QIODevice>
+#include <QStringList>
+#include <QVariant>
+#include <memory>
+
+class QSqlQuery;
+
+/** @brief Buffered CSV / NDJSON row writer with optional gzip compression. */
+class RecordWriter
+{
+public:
+    /** @brief Output compression. */
+    enum Compression
+    {
+        NoCompression,
+        Gzip,           ///< gzip (RFC 1952), readable by gzip and zcat
+    };
+
+    /** @brief Default number of bytes buffered before they are written. */
+    static const int DefaultFlushSize = 256 * 1024;
+
+    /** @brief Construct a writer.
+     *  @param device The device to write to. Must be open for writing.
+     *  @param format The record format.
+     *  @param compression The output compression.
+     *  @param flushSize The number of encoded bytes buffered before they are written.
+     */
+    RecordWriter(QIODevice* device, const RecordFormat& format, Compression compression = NoCompression, int flushSize = DefaultFlushSize);
+    ~RecordWriter();
+
+    /** @brief Return true if the library was built with zlib, so Gzip compression can be used.
+     *  @return true if gzip is available.
+     */
+    static bool isGzipAvailable();
+
+    /** @brief Set the column names and write the CSV header line if the format has one.
+     *
+     *  Must be called before the first row. NDJSON uses the names as object keys.
+     *  @param columns The column names.
+     *  @return false if the header could not be written.
+     */
+    bool begin(const QStringList& columns);
+
+    /** @brief Write the current row of a query.
+     *  @param query A query positioned on a row, with the columns given to begin().
+     *  @return false if a write to the device failed.
+     */
+    bool writeRow(const QSqlQuery& query);
+
+    /** @brief Write a row of values.
+     *  @param values One value per column given to begin().
+     *  @return false if a write to the device failed.
+     */
+    bool writeRow(const QVariantList& values);
+
+    /** @brief Write out everything buffered and end the compressed stream.
+     *  @return false if a write to the device failed.
+     */
+    bool finish();
+
+    /** @brief Get the number of rows written.
+     *  @return The row count.
+     */
+    qint64 rowCount() const { return _rowCount; }
+
+    /** @brief Get the number of bytes encoded, before any compression.
+     *  @return The encoded size.
+     */
+    qint64 bytesEncoded() const { return _bytesEncoded; }
+
+    /** @brief Get the number of bytes written to the device.
+     *  @return The written size.
+     */
+    qint64 bytesWritten() const { return _bytesWritten; }
+
+    /** @brief Get why writing failed.
+     *  @return The error, empty if nothing has failed.
+     */
+    QString errorText() const { return _errorText; }
+
+private:
+    Q_DISABLE_COPY(RecordWriter)
+
+    struct GzipStream;
+
+    void appendValue(const QVariant& value, int column);
+    void appendCsvText(const QByteArray& text);
+    static void appendJsonString(QByteArray& out, const QByteArray& utf8);
+    bool endRow();
+    bool flush(bool finish);
+    bool writeToDevice(const char* data, qint64 size);
+    static QByteArray textOf(const QVariant& value);
+
+    QIODevice* _device;
+    RecordFormat _format;
+    int _flushSize;
+    QByteArray _nullText;
+    QList<QByteArray> _jsonKeys;
+    int _columnCount = 0;
+
+    QByteArray _buffer;
+    std::unique_ptr<GzipStream> _gzip;
+    qint64 _rowCount = 0;
+    qint64 _bytesEncoded = 0;
+    qint64 _bytesWritten = 0;
+    QString _errorText;
+};
+
+#endif // RECORDWRITER_H
@@ -0,0 +1,172 @@
+/**
+ *  ResultCache
+ *
+ *  A memory-bounded, least-recently-used cache of query results keyed by SQL
+ *  text and bound values. Used by DataSource::executeCached().
+ *
+ *  Each result records the tables its query reads. A write to any of those
+ *  tables drops it. Every invalidation advances a generation counter, so a
+ *  result read while a write was in progress is not cached after it.
+ */
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <Kanoop/database/queryresult.h>
+#include <QByteArray>
+#include <QHash>
+#include <QMultiHash>
+#include <QMutex>
+#include <QStringList>
+#include <list>
+
+/** @brief Thread-safe LRU cache of query results, invalidated by table. */
+class ResultCache
+{
+public:
+    /** @brief Cache usage counters. */
+    struct Statistics
+    {
+        /** @brief Number of lookups which returned a cached result. */
+        qint64 hits = 0;
+        /** @brief Number of lookups which found no cached result. */
+        qint64 misses = 0;
+        /** @brief Number of results discarded to stay within the budget. */
+        qint64 evictions = 0;
+        /** @brief Number of results discarded because a table they read was written. */
+        qint64 invalidations = 0;
+        /** @brief Number of results not cached because a write happened while they were read, or they exceed the budget. */
+        qint64 rejections = 0;
+        /** @brief Number of results currently cached. */
+        int size = 0;
+        /** @brief Estimated memory used by the cached results, in bytes. */
+        qint64 bytes = 0;
+        /** @brief Memory budget in bytes. */
+        qint64 budget = 0;
+
+        /** @brief Get the fraction of lookups which were hits.
+         *  @return The hit ratio from 0 to 1.
+         */
+        double hitRatio() const { return hits + misses > 0 ? (double)hits / (hits + misses) : 0.0; }
+    };
+
+    /** @brief Construct a cache with the given memory budget.
+     *  @param budget The budget in bytes, or 0 to disable caching.
+     */
+    explicit ResultCache(qint64 budget = 0) :
+        _budget(budget) {}
+
+    /** @brief Get the memory budget.
+     *  @return The budget in bytes, 0 if caching is disabled.
+     */
+    qint64 budget() const;
+    /** @brief Set the memory budget, evicting the least recently used results as needed.
+     *  @param value The budget in bytes, or 0 to disable caching.
+     */
+    void setBudget(qint64 value);
+
+    /** @brief Return true if the cache has a non-zero budget.
+     *  @return true if caching is enabled.
+     */
+    bool isEnabled() const { return _budget > 0; }
+
+    /** @brief Build the cache key for a statement.
+     *  @param sql The SQL text.
+     *  @param bindings The values bound to its placeholders.
+     *  @return The key.
+     */
+    static QByteArray key(const QString& sql, const QVariantList& bindings);
+
+    /** @brief Look up a result and make it the most recently used.
+     *  @param key The key from key().
+     *  @param result Receives the cached result on a hit.
+     *  @return true on a hit.
+     */
+    bool find(const QByteArray& key, QueryResult& result);
+
+    /** @brief Get the invalidation generation. Read it before running the query whose result will be inserted.
+     *  @return The generation.
+     */
+    quint64 generation() const;
+
+    /** @brief Add a result to the cache.
+     *  @param key The key from key().
+     *  @param result The result.
+     *  @param tables The tables the query reads.
+     *  @param generation The generation() read before the query ran.
+     *  @return true if cached; false if an invalidation has happened since, or the result exceeds the budget.
+     */
+    bool insert(const QByteArray& key, const QueryResult& result, const QStringList& tables, quint64 generation);
+
+    /** @brief Discard the results which read a table.
+     *  @param table The table name (case-insensitive).
+     */
+    void invalidateTable(const QString& table);
+
+    /** @brief Discard every cached result, counting each as an invalidation. */
+    void invalidate();
+
+    /** @brief Discard every cached result. */
+    void clear();
+
+    /** @brief Get the number of cached results.
+     *  @return The result count.
+     */
+    int size() const;
+
+    /** @brief Get a snapshot of the usage counters.
+     *  @return The statistics.
+     */
+    Statistics statistics() const;
+
+    /** @brief Reset the usage counters. */
+    void resetStatistics();
+
+    /** @brief Estimate the memory a result occupies.
+     *  @param result The result.
+     *  @return The estimate in bytes.
+     */
+    static qint64 estimateSize(const QueryResult& result);
+
+    /** @brief Find the tables a query reads: the names following FROM, JOIN and commas in a FROM list.
+     *
+     *  Names are lower-cased and stripped of quotes and schema prefixes. Views,
+     *  CTE names and table-valued functions are reported as written.
+     *  @param sql The SQL text.
+     *  @return The table names, without duplicates.
+     */
+    static QStringList tablesRead(const QString& sql);
+
+    /** @brief Find the table an INSERT, REPLACE, UPDATE or DELETE statement writes.
+     *  @param sql The SQL text.
+     *  @return The lower-cased table name, or an empty string if the statement is not one of these.
+     */
+    static QString tableWritten(const QString& sql);
+
+private:
+    struct Entry
+    {
+        QByteArray key;
+        QueryResult result;
+        QStringList tables;
+        qint64 bytes = 0;
+    };
+    typedef std::list<Entry> EntryList;
+
+    Q_DISABLE_COPY(ResultCache)
+
+    void remove(EntryList::iterator entry);
+    void evict(qint64 keepBytes);
+    static QStringList tokens(const QString& sql);
+    static QString tableName(const QString& token);
+
+    mutable QMutex _mutex;
+    qint64 _budget;
+    qint64 _bytes = 0;
+    quint64 _generation = 0;
+    EntryList _entries;
+    QHash<QByteArray, EntryList::iterator> _index;
+    QMultiHash<QString, QByteArray> _tableIndex;
+    Statistics _statistics;
+};
+
+#endif // RESULTCACHE_H
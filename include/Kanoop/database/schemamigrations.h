@@ -0,0 +1,116 @@
+/**
+ *  SchemaMigrations
+ *
+ *  An ordered registry of schema migration steps, keyed by version.
+ *
+ *  Each step is either SQL text or a closure. DataSource::applyMigrations()
+ *  runs the steps newer than the database's schema version, each in its own
+ *  transaction, and records them in a history table with a checksum and timing.
+ */
+#ifndef SCHEMAMIGRATIONS_H
+#define SCHEMAMIGRATIONS_H
+
+#include <QDateTime>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <functional>
+
+/** @brief Ordered registry of versioned schema migration steps. */
+class SchemaMigrations
+{
+public:
+    /** @brief A migration step implemented in code. Return false on failure. */
+    typedef std::function<bool()> Step;
+
+    /** @brief A registered migration. */
+    struct Migration
+    {
+        /** @brief The schema version the migration brings the database to. */
+        int version = 0;
+        /** @brief Human-readable description. */
+        QString description;
+        /** @brief The SQL script, empty for a closure step. */
+        QString sql;
+        /** @brief The closure, empty for an SQL step. */
+        Step step;
+        /** @brief SHA-256 of the SQL script, or of the checksum source of a closure step. */
+        QString checksum;
+    };
+
+    /** @brief A migration as recorded in the history table. */
+    struct AppliedMigration
+    {
+        /** @brief The schema version. */
+        int version = 0;
+        /** @brief The description at the time it was applied. */
+        QString description;
+        /** @brief The checksum at the time it was applied. */
+        QString checksum;
+        /** @brief When the migration was applied, in UTC. */
+        QDateTime appliedAt;
+        /** @brief Time taken to apply the migration in milliseconds. */
+        qint64 elapsedMs = 0;
+    };
+
+    /** @brief Construct an empty registry. */
+    SchemaMigrations() {}
+
+    /** @brief Register an SQL migration.
+     *  @param version The version the migration brings the schema to. Must be positive and unique.
+     *  @param description Human-readable description.
+     *  @param sql One or more semicolon-separated statements.
+     *  @return false if the version is not positive or is already registered.
+     */
+    bool add(int version, const QString& description, const QString& sql);
+
+    /** @brief Register a migration implemented in code.
+     *  @param version The version the migration brings the schema to. Must be positive and unique.
+     *  @param description Human-readable description.
+     *  @param step The closure which performs the migration.
+     *  @param checksumSource Text identifying the closure's behaviour, e.g. a revision string, hashed into the checksum. Defaults to the description.
+     *  @return false if the version is not positive or is already registered.
+     */
+    bool add(int version, const QString& description, const Step& step, const QString& checksumSource = QString());
+
+    /** @brief Get the migrations newer than a schema version, in ascending order.
+     *  @param currentVersion The schema version of the database.
+     *  @return The migrations to apply.
+     */
+    QList<Migration> pending(int currentVersion) const;
+
+    /** @brief Get a registered migration.
+     *  @param version The version.
+     *  @return The migration, or nullptr if none is registered for the version.
+     */
+    const Migration* find(int version) const;
+
+    /** @brief Get the highest registered version.
+     *  @return The latest version, or 0 if none are registered.
+     */
+    int latestVersion() const { return _migrations.isEmpty() ? 0 : _migrations.lastKey(); }
+
+    /** @brief Return true if no migrations are registered.
+     *  @return true if empty.
+     */
+    bool isEmpty() const { return _migrations.isEmpty(); }
+
+    /** @brief Get the number of registered migrations.
+     *  @return The migration count.
+     */
+    qsizetype count() const { return _migrations.count(); }
+
+    /** @brief Compute the checksum recorded for a migration.
+     *  @param text The SQL script or checksum source.
+     *  @return The hex-encoded SHA-256 of the UTF-8 text.
+     */
+    static QString checksum(const QString& text);
+
+    /** @brief Name of the migration history table. */
+    static const QString HistoryTable;
+
+private:
+    QMap<int, Migration> _migrations;
+};
+
+#endif // SCHEMAMIGRATIONS_H
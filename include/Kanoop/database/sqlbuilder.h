@@ -0,0 +1,180 @@
+/**
+ *  SqlBuilder
+ *
+ *  Appends SQL text and literals to a single growing buffer.
+ *
+ *  Numbers, UUIDs and timestamps are formatted directly into the buffer without
+ *  temporary strings. Strings are scanned for the characters which need escaping
+ *  and copied in runs between them; a string needing no escaping is copied whole.
+ *
+ *  Prefer bound parameters (see InClause) for values in statements which are
+ *  executed repeatedly. SqlBuilder is for statements which must carry literals.
+ */
+#ifndef SQLBUILDER_H
+#define SQLBUILDER_H
+
+#include <QDateTime>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QUuid>
+#include <type_traits>
+#include <utility>
+
+/** @brief Builds SQL text with typed, escaped literal appenders. */
+class SqlBuilder
+{
+public:
+    /** @brief Construct an empty builder.
+     *  @param reserve Number of characters to allocate up front.
+     */
+    explicit SqlBuilder(qsizetype reserve = 0)
+    {
+        if(reserve > 0) {
+            _buffer.reserve(reserve);
+        }
+    }
+
+    /** @brief Append SQL text verbatim.
+     *  @param sql The text.
+     *  @return This builder.
+     */
+    SqlBuilder& append(QStringView sql) { _buffer.append(sql); return *this; }
+
+    /** @brief Append SQL text verbatim.
+     *  @param sql The text.
+     *  @return This builder.
+     */
+    SqlBuilder& append(QLatin1StringView sql) { _buffer.append(sql); return *this; }
+
+    /** @brief Append a character verbatim.
+     *  @param c The character.
+     *  @return This builder.
+     */
+    SqlBuilder& append(QChar c) { _buffer.append(c); return *this; }
+
+    /** @brief Append an integer or floating point number.
+     *  @param value The number.
+     *  @return This builder.
+     */
+    template <typename T>
+    SqlBuilder& appendNumber(T value)
+    {
+        static_assert(std::is_arithmetic<T>::value, "T must be a number");
+        if constexpr(std::is_floating_point<T>::value) {
+            appendDouble(value);
+        }
+        else if constexpr(std::is_signed<T>::value) {
+            appendSigned(value);
+        }
+        else {
+            appendUnsigned(value);
+        }
+        return *this;
+    }
+
+    /** @brief Append a UUID as a quoted literal without braces, e.g. '0f8fad5b-d9cb-469f-a165-70867728950e'.
+     *  @param value The UUID.
+     *  @return This builder.
+     */
+    SqlBuilder& appendUuid(const QUuid& value);
+
+    /** @brief Append a timestamp as a quoted UTC literal, e.g. '2025-01-11 14:03:07.250'.
+     *  @param value The timestamp. It is converted to UTC.
+     *  @return This builder.
+     */
+    SqlBuilder& appendTimestamp(const QDateTime& value);
+
+    /** @brief Append a string as a quoted, escaped literal.
+     *  @param value The string.
+     *  @return This builder.
+     */
+    SqlBuilder& appendString(QStringView value) { _buffer.append('\''); appendEscaped(value); _buffer.append('\''); return *this; }
+
+    /** @brief Append a string escaped for use inside a quoted literal, without the quotes.
+     *
+     *  Single quotes are doubled and NUL characters, which SQL text may not
+     *  contain, become '?'.
+     *  @param value The string.
+     *  @return This builder.
+     */
+    SqlBuilder& appendEscaped(QStringView value);
+
+    /** @brief Append NULL.
+     *  @return This builder.
+     */
+    SqlBuilder& appendNull() { _buffer.append(QLatin1StringView("NULL")); return *this; }
+
+    /** @brief Append a comma-delimited list of numbers.
+     *  @param list The numbers.
+     *  @return This builder.
+     */
+    template <typename T>
+    SqlBuilder& appendNumberList(const QList<T>& list)
+    {
+        for(qsizetype i = 0;i < list.count();i++) {
+            if(i > 0) {
+                _buffer.append(',');
+            }
+            appendNumber(list.at(i));
+        }
+        return *this;
+    }
+
+    /** @brief Append a comma-delimited list of quoted UUIDs.
+     *  @param list The UUIDs.
+     *  @return This builder.
+     */
+    SqlBuilder& appendUuidList(const QList<QUuid>& list);
+
+    /** @brief Append a comma-delimited list of quoted, escaped strings.
+     *  @param list The strings.
+     *  @return This builder.
+     */
+    SqlBuilder& appendStringList(const QStringList& list);
+
+    /** @brief Get the text built so far.
+     *  @return The SQL text.
+     */
+    QString toString() const { return _buffer; }
+
+    /** @brief Take the text built so far, leaving the builder empty.
+     *  @return The SQL text.
+     */
+    QString take() { return std::exchange(_buffer, QString()); }
+
+    /** @brief Get the length of the text built so far.
+     *  @return The length in characters.
+     */
+    qsizetype length() const { return _buffer.length(); }
+
+    /** @brief Allocate space for more text.
+     *  @param size The total number of characters to allocate for.
+     */
+    void reserve(qsizetype size) { _buffer.reserve(size); }
+
+    /** @brief Discard the text built so far, keeping the allocation. */
+    void clear() { _buffer.resize(0); }
+
+    /** @brief Find the first character of a string which needs escaping.
+     *  @param value The string.
+     *  @return The index of the character, or -1 if none need escaping.
+     */
+    static qsizetype findEscape(QStringView value);
+
+    /** @brief Escape a string for use inside a quoted literal.
+     *  @param unescaped The string.
+     *  @return The escaped string. If nothing needed escaping, the input itself, without copying.
+     */
+    static QString escaped(const QString& unescaped);
+
+private:
+    void appendSigned(qint64 value);
+    void appendUnsigned(quint64 value);
+    void appendDouble(double value);
+    void appendDigits(quint64 value, int minimumDigits);
+
+    QString _buffer;
+};
+
+#endif // SQLBUILDER_H
@@ -0,0 +1,190 @@
+/**
+ *  SqlitePerformanceProfile
+ *
+ *  A set of SQLite PRAGMA settings (journal mode, synchronous, cache and mmap
+ *  sizes, etc.) which DataSource applies each time it opens a SQLite connection.
+ *
+ *  Settings left unset are not applied, leaving the SQLite default in place.
+ */
+#ifndef SQLITEPERFORMANCEPROFILE_H
+#define SQLITEPERFORMANCEPROFILE_H
+
+#include <QStringList>
+
+/** @brief SQLite PRAGMA settings applied by DataSource when a connection is opened. */
+class SqlitePerformanceProfile
+{
+public:
+    /** @brief Value of PRAGMA journal_mode. */
+    enum JournalMode
+    {
+        JournalModeUnset,   ///< Leave the journal mode unchanged
+        JournalDelete,      ///< DELETE (SQLite default)
+        JournalTruncate,    ///< TRUNCATE
+        JournalPersist,     ///< PERSIST
+        JournalMemory,      ///< MEMORY
+        JournalWal,         ///< WAL (write-ahead log)
+        JournalOff,         ///< OFF (no rollback journal)
+    };
+
+    /** @brief Value of PRAGMA synchronous. */
+    enum Synchronous
+    {
+        SynchronousUnset = -1,  ///< Leave synchronous unchanged
+        SynchronousOff = 0,     ///< OFF
+        SynchronousNormal = 1,  ///< NORMAL
+        SynchronousFull = 2,    ///< FULL (SQLite default)
+        SynchronousExtra = 3,   ///< EXTRA
+    };
+
+    /** @brief Value of PRAGMA temp_store. */
+    enum TempStore
+    {
+        TempStoreUnset = -1,    ///< Leave temp_store unchanged
+        TempStoreDefault = 0,   ///< DEFAULT (compile-time setting)
+        TempStoreFile = 1,      ///< FILE
+        TempStoreMemory = 2,    ///< MEMORY
+    };
+
+    /** @brief Construct an empty profile which changes nothing. */
+    SqlitePerformanceProfile() {}
+
+    /** @brief Favour durability: WAL with synchronous FULL.
+     *  @return The profile.
+     */
+    static SqlitePerformanceProfile durable();
+
+    /** @brief Balanced durability and throughput: WAL with synchronous NORMAL, larger cache, memory-mapped I/O.
+     *
+     *  A power loss may lose the most recent transactions, but will not corrupt the database.
+     *  @return The profile.
+     */
+    static SqlitePerformanceProfile balanced();
+
+    /** @brief Maximum write throughput for bulk loading: WAL with synchronous OFF, large cache, infrequent checkpoints.
+     *
+     *  Only for data which can be reloaded from its source: with synchronous OFF an operating
+     *  system crash or power loss may corrupt the database, not just lose recent transactions.
+     *  An application crash alone is safe. Switch to balanced() once the load is done.
+     *  @return The profile.
+     */
+    static SqlitePerformanceProfile bulkLoad();
+
+    /** @brief Get the journal mode.
+     *  @return The journal mode.
+     */
+    JournalMode journalMode() const { return _journalMode; }
+    /** @brief Set the journal mode.
+     *  @param value The journal mode.
+     */
+    void setJournalMode(JournalMode value) { _journalMode = value; }
+
+    /** @brief Get the synchronous setting.
+     *  @return The synchronous setting.
+     */
+    Synchronous synchronous() const { return _synchronous; }
+    /** @brief Set the synchronous setting.
+     *  @param value The synchronous setting.
+     */
+    void setSynchronous(Synchronous value) { _synchronous = value; }
+
+    /** @brief Get the page cache size.
+     *  @return The cache size in KiB, or -1 if unset.
+     */
+    qint64 cacheSizeKiB() const { return _cacheSizeKiB; }
+    /** @brief Set the page cache size.
+     *  @param value The cache size in KiB, or -1 to leave unchanged.
+     */
+    void setCacheSizeKiB(qint64 value) { _cacheSizeKiB = value; }
+
+    /** @brief Get the maximum size of memory-mapped I/O.
+     *  @return The mmap size in bytes, or -1 if unset.
+     */
+    qint64 mmapSize() const { return _mmapSize; }
+    /** @brief Set the maximum size of memory-mapped I/O.
+     *  @param value The mmap size in bytes (0 disables), or -1 to leave unchanged.
+     */
+    void setMmapSize(qint64 value) { _mmapSize = value; }
+
+    /** @brief Get the temporary table and index storage.
+     *  @return The temp store setting.
+     */
+    TempStore tempStore() const { return _tempStore; }
+    /** @brief Set the temporary table and index storage.
+     *  @param value The temp store setting.
+     */
+    void setTempStore(TempStore value) { _tempStore = value; }
+
+    /** @brief Get the page size used when a new database file is created.
+     *  @return The page size in bytes, or -1 if unset.
+     */
+    int pageSize() const { return _pageSize; }
+    /** @brief Set the page size used when a new database file is created. Has no effect on existing files.
+     *  @param value The page size in bytes (a power of two from 512 to 65536), or -1 to leave unchanged.
+     */
+    void setPageSize(int value) { _pageSize = value; }
+
+    /** @brief Get the busy timeout.
+     *  @return The time to wait on a locked database in milliseconds, or -1 if unset.
+     */
+    int busyTimeout() const { return _busyTimeout; }
+    /** @brief Set the busy timeout.
+     *  @param value The time to wait on a locked database in milliseconds, or -1 to leave unchanged.
+     */
+    void setBusyTimeout(int value) { _busyTimeout = value; }
+
+    /** @brief Get the WAL auto-checkpoint threshold.
+     *  @return The threshold in pages, or -1 if unset.
+     */
+    int walAutoCheckpoint() const { return _walAutoCheckpoint; }
+    /** @brief Set the WAL auto-checkpoint threshold.
+     *  @param value The threshold in pages (0 disables), or -1 to leave unchanged.
+     */
+    void setWalAutoCheckpoint(int value) { _walAutoCheckpoint = value; }
+
+    /** @brief Return true if no setting has been made.
+     *  @return true if the profile changes nothing.
+     */
+    bool isEmpty() const;
+
+    /** @brief Build the PRAGMA statements which apply this profile.
+     *  @param newDatabase true to include settings which only take effect on an empty database (page_size).
+     *  @return The PRAGMA statements, in the order they must be executed.
+     */
+    QStringList pragmas(bool newDatabase) const;
+
+    /** @brief Get the PRAGMA keyword for a journal mode.
+     *  @param value The journal mode.
+     *  @return The keyword (e.g. "WAL"), or an empty string if unset.
+     */
+    static QString journalModeToString(JournalMode value);
+
+    /** @brief Parse a PRAGMA journal_mode result.
+     *  @param value The keyword (case-insensitive).
+     *  @return The journal mode, or JournalModeUnset if not recognized.
+     */
+    static JournalMode journalModeFromString(const QString& value);
+
+    /** @brief Compare two profiles.
+     *  @param other The profile to compare with.
+     *  @return true if every setting is equal.
+     */
+    bool operator==(const SqlitePerformanceProfile& other) const;
+    /** @brief Compare two profiles.
+     *  @param other The profile to compare with.
+     *  @return true if any setting differs.
+     */
+    bool operator!=(const SqlitePerformanceProfile& other) const { return !(*this == other); }
+
+private:
+    JournalMode _journalMode = JournalModeUnset;
+    Synchronous _synchronous = SynchronousUnset;
+    qint64 _cacheSizeKiB = -1;
+    qint64 _mmapSize = -1;
+    TempStore _tempStore = TempStoreUnset;
+    int _pageSize = -1;
+    int _busyTimeout = -1;
+    int _walAutoCheckpoint = -1;
+};
+
+#endif // SQLITEPERFORMANCEPROFILE_H
@@ -0,0 +1,230 @@
+/**
+ *  SqliteStatement
+ *
+ *  A native SQLite prepared statement on a DataSource's connection, returned by
+ *  DataSource::prepareSqlite().
+ *
+ *  Binding, stepping and reading columns call sqlite3_* directly, without the
+ *  QSqlQuery and QVariant layers, for small hot statements such as key lookups.
+ *  The statement belongs to the data source: it is prepared once per SQL text,
+ *  reused each time the same SQL is prepared again unless another SqliteStatement
+ *  still holds it, and finalized when the connection closes, after which any
+ *  SqliteStatement still held is invalid.
+ *
+ *  Only available when SQLite is linked directly (KANOOP_DATABASE_NATIVE_SQLITE).
+ */
+#ifndef SQLITESTATEMENT_H
+#define SQLITESTATEMENT_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QVariant>
+#include <memory>
+
+class DataSource;
+struct sqlite3;
+struct sqlite3_stmt;
+
+/** @brief Native SQLite statement with typed bind, step and column calls. */
+class SqliteStatement
+{
+public:
+    /** @brief Construct an invalid statement. */
+    SqliteStatement() {}
+
+    /** @brief Return true if native statements are compiled in.
+     *  @return true when built with KANOOP_DATABASE_NATIVE_SQLITE and the driver runs the same SQLite.
+     *  @see DataSource::isNativeSqliteAvailable()
+     */
+    static bool isAvailable();
+
+    /** @brief Return true if the statement is prepared and its connection is still open.
+     *  @return true if usable.
+     */
+    bool isValid() const;
+
+    /** @brief Get the SQL text.
+     *  @return The SQL the statement was prepared from.
+     */
+    QString sql() const;
+
+    /** @brief Get the number of placeholders.
+     *  @return The highest parameter index.
+     */
+    int parameterCount() const;
+
+    /** @brief Get the index of a named placeholder.
+     *  @param name The name including its prefix, e.g. ":key".
+     *  @return The 1-based index, or 0 if there is no such placeholder.
+     */
+    int parameterIndex(const QString& name) const;
+
+    /** @brief Bind NULL.
+     *  @param index The 1-based placeholder index.
+     *  @return true on success.
+     */
+    bool bindNull(int index);
+
+    /** @brief Bind a 64-bit integer.
+     *  @param index The 1-based placeholder index.
+     *  @param value The value.
+     *  @return true on success.
+     */
+    bool bindInteger(int index, qint64 value);
+
+    /** @brief Bind a double.
+     *  @param index The 1-based placeholder index.
+     *  @param value The value.
+     *  @return true on success.
+     */
+    bool bindReal(int index, double value);
+
+    /** @brief Bind text.
+     *  @param index The 1-based placeholder index.
+     *  @param value The value. A null string binds NULL.
+     *  @return true on success.
+     */
+    bool bindText(int index, const QString& value);
+
+    /** @brief Bind UTF-8 text, copied by SQLite.
+     *  @param index The 1-based placeholder index.
+     *  @param value The UTF-8 bytes.
+     *  @return true on success.
+     */
+    bool bindUtf8(int index, QByteArrayView value);
+
+    /** @brief Bind a blob, copied by SQLite.
+     *  @param index The 1-based placeholder index.
+     *  @param value The bytes.
+     *  @return true on success.
+     */
+    bool bindBlob(int index, QByteArrayView value);
+
+    /** @brief Bind a QVariant by its type: integers and bool as integers, floating point as reals, QByteArray as a blob, anything else as text.
+     *  @param index The 1-based placeholder index.
+     *  @param value The value. A null QVariant binds NULL.
+     *  @return true on success.
+     */
+    bool bind(int index, const QVariant& value);
+
+    /** @brief Bind values in order to placeholders 1..n.
+     *  @param values The values.
+     *  @return true on success.
+     */
+    bool bindAll(const QVariantList& values);
+
+    /** @brief Advance to the next row, executing the statement on the first call.
+     *
+     *  Returns false both at the end of the rows and on failure; use hasError() to tell them apart.
+     *  Once finished, the next call starts the statement again with the same bindings.
+     *  @return true if a row is available.
+     */
+    bool step();
+
+    /** @brief Execute a statement which returns no rows.
+     *  @return true on success.
+     */
+    bool exec();
+
+    /** @brief Return true if the last step() failed.
+     *  @return true on failure.
+     */
+    bool hasError() const;
+
+    /** @brief Reset the statement so it can be executed again. Bindings are kept.
+     *  @return true on success.
+     */
+    bool reset();
+
+    /** @brief Reset the statement and set every placeholder to NULL.
+     *  @return true on success.
+     */
+    bool clearBindings();
+
+    /** @brief Get the number of columns in the result.
+     *  @return The column count.
+     */
+    int columnCount() const;
+
+    /** @brief Get a column name.
+     *  @param column The 0-based column index.
+     *  @return The name.
+     */
+    QString columnName(int column) const;
+
+    /** @brief Return true if a value of the current row is NULL.
+     *  @param column The 0-based column index.
+     *  @return true if NULL.
+     */
+    bool isNull(int column) const;
+
+    /** @brief Get a value of the current row as an integer.
+     *  @param column The 0-based column index.
+     *  @return The value, converted by SQLite if need be.
+     */
+    qint64 integer(int column) const;
+
+    /** @brief Get a value of the current row as a double.
+     *  @param column The 0-based column index.
+     *  @return The value, converted by SQLite if need be.
+     */
+    double real(int column) const;
+
+    /** @brief Get a value of the current row as text.
+     *  @param column The 0-based column index.
+     *  @return The value, a null string if NULL.
+     */
+    QString text(int column) const;
+
+    /** @brief Get a value of the current row as bytes without copying.
+     *  @param column The 0-based column index.
+     *  @return The bytes, valid until the next step(), reset() or bind.
+     */
+    QByteArrayView bytes(int column) const;
+
+    /** @brief Get a value of the current row as a copy of its bytes.
+     *  @param column The 0-based column index.
+     *  @return The bytes.
+     */
+    QByteArray blob(int column) const { return bytes(column).toByteArray(); }
+
+    /** @brief Get a value of the current row as a QVariant of its SQLite storage class.
+     *  @param column The 0-based column index.
+     *  @return A qint64, double, QString or QByteArray, or an invalid QVariant if NULL.
+     */
+    QVariant value(int column) const;
+
+    /** @brief Get the number of rows changed by the last completed INSERT, UPDATE or DELETE on the connection.
+     *  @return The row count.
+     */
+    int rowsAffected() const;
+
+    /** @brief Get the rowid of the last INSERT on the connection.
+     *  @return The rowid.
+     */
+    qint64 lastInsertId() const;
+
+    /** @brief Get the last error from this statement.
+     *  @return The SQLite error message, or an empty string.
+     */
+    QString errorText() const;
+
+private:
+    struct Handle;
+
+    SqliteStatement(DataSource* dataSource, const std::shared_ptr<Handle>& handle) :
+        _dataSource(dataSource), _handle(handle) {}
+
+    static std::shared_ptr<Handle> prepare(sqlite3* db, const QString& sql, QString* error);
+    static void finalize(Handle* handle);
+
+    bool bindResult(int rc);
+
+    DataSource* _dataSource = nullptr;
+    std::shared_ptr<Handle> _handle;
+
+    friend class DataSource;
+};
+
+#endif // SQLITESTATEMENT_H
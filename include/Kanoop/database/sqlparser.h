@@ -1,8 +1,14 @@
 #ifndef SQLPARSER_H
 #define SQLPARSER_H
 #include <QStringList>
+#include <Kanoop/database/sqlscanner.h>
 
-/** @brief Parses a multi-statement SQL string into individual SQL statements. */
+/** @brief Parses a multi-statement SQL string into individual SQL statements.
+ *
+ *  The string is scanned once by SqlScanner. Semicolons inside string literals,
+ *  quoted identifiers, comments, dollar-quoted bodies and CREATE TRIGGER bodies
+ *  do not split statements.
+ */
 class SqlParser
 {
 public:
@@ -12,23 +18,42 @@ public:
     SqlParser(const QString& sql);
 
     /** @brief Get the list of parsed SQL statements.
-     *  @return The list of individual SQL statements.
+     *  @return The list of individual SQL statements, with comments removed.
      */
-    QStringList statements() const { return _statements; }
+    QStringList statements() const;
+
+    /** @brief Get the parsed statements as views into sql(), without copying.
+     *
+     *  The views remain valid for the lifetime of the parser. Comments inside a
+     *  statement are included, which SQLite and the other drivers accept.
+     *  @return The list of statement views.
+     */
+    QList<QStringView> statementViews() const;
+
+    /** @brief Get the location of each statement within sql().
+     *  @return The list of statement ranges.
+     */
+    QList<SqlScanner::Statement> statementRanges() const { return _ranges; }
+
+    /** @brief Get the number of parsed statements.
+     *  @return The statement count.
+     */
+    qsizetype count() const { return _ranges.count(); }
+
+    /** @brief Get the parsed SQL string.
+     *  @return The SQL string the statement ranges refer to.
+     */
+    QString sql() const { return _sql; }
 
     /** @brief Return true if parsing completed successfully.
-     *  @return true if the SQL was parsed without error.
+     *  @return true if at least one statement was found and the SQL did not end inside a literal, comment or trigger body.
      */
     bool isValid() const { return _valid; }
 
 private:
-    void parse(const QString& sql);
-    void startNewStatement();
-
-    QStringList _statements;
-    bool _valid;
-
-    QStringList _working;
+    QString _sql;
+    QList<SqlScanner::Statement> _ranges;
+    bool _valid = false;
 };
 
 #endif // SQLPARSER_H
@@ -0,0 +1,134 @@
+/**
+ *  SqlScanner
+ *
+ *  Single-pass, resumable SQL statement splitter.
+ *
+ *  Scans a buffer character by character, finding the semicolons which end
+ *  statements while skipping those inside string literals, quoted identifiers,
+ *  comments, PostgreSQL dollar-quoted bodies and CREATE TRIGGER ... BEGIN ... END
+ *  bodies. Statements are reported as offsets into the caller's buffer, so no
+ *  text is copied.
+ *
+ *  Scanning may be resumed as more text is appended to the buffer, which lets
+ *  scripts be split as they are read rather than after loading them whole.
+ */
+#ifndef SQLSCANNER_H
+#define SQLSCANNER_H
+
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+/** @brief Resumable single-pass scanner which splits SQL text into statements. */
+class SqlScanner
+{
+public:
+    /** @brief Location of one statement within the scanned buffer. */
+    struct Statement
+    {
+        /** @brief Location of a comment within a statement. */
+        struct Comment
+        {
+            /** @brief Offset of the first character of the comment. */
+            qsizetype start = 0;
+            /** @brief Offset one past the last character of the comment. */
+            qsizetype end = 0;
+        };
+
+        /** @brief Offset of the first character of the statement. Leading whitespace and comments are excluded. */
+        qsizetype start = 0;
+        /** @brief Offset one past the last character of the statement, including the terminating semicolon if any. */
+        qsizetype end = 0;
+        /** @brief Comments inside the statement, in order. Usually empty. */
+        QList<Comment> comments;
+
+        /** @brief Get the length of the statement.
+         *  @return The length in characters.
+         */
+        qsizetype length() const { return end - start; }
+
+        /** @brief Get the statement as a view into the buffer it was found in.
+         *  @param buffer The scanned buffer.
+         *  @return The statement text, including any comments inside it.
+         */
+        QStringView view(QStringView buffer) const { return buffer.mid(start, end - start); }
+
+        /** @brief Get the statement text with its comments removed.
+         *  @param buffer The scanned buffer.
+         *  @return The statement text.
+         */
+        QString text(QStringView buffer) const;
+    };
+
+    /** @brief Construct a scanner positioned at the start of a buffer. */
+    SqlScanner() {}
+
+    /** @brief Scan for the next complete statement.
+     *
+     *  Call repeatedly with the same buffer until it returns false. If more text
+     *  may follow, append it to the buffer and call again; scanning resumes where
+     *  it stopped.
+     *  @param buffer The text to scan. Earlier calls must have seen a prefix of it.
+     *  @param atEnd true if no more text will be appended, so that a final statement without a semicolon is returned.
+     *  @param statement Receives the statement's location.
+     *  @return true if a statement was found.
+     */
+    bool next(QStringView buffer, bool atEnd, Statement* statement);
+
+    /** @brief Get the offset before which the buffer is no longer needed.
+     *  @return The number of leading characters which may be passed to discard().
+     */
+    qsizetype consumed() const { return _start >= 0 ? _start : _pos; }
+
+    /** @brief Adjust for characters removed from the front of the buffer.
+     *  @param count The number of characters removed. Must not exceed consumed().
+     */
+    void discard(qsizetype count);
+
+    /** @brief Return true if the scanner is not inside a literal, comment or compound statement body.
+     *
+     *  After the final call to next(), false means the text ended inside an
+     *  unterminated quote, block comment, dollar quote or trigger body.
+     *  @return true if complete.
+     */
+    bool isComplete() const { return (_state == Normal || _state == LineComment) && _depth == 0; }
+
+    /** @brief Reset the scanner to the start of a new buffer. */
+    void reset() { *this = SqlScanner(); }
+
+private:
+    enum State
+    {
+        Normal,
+        SingleQuote,
+        DoubleQuote,
+        Backtick,
+        LineComment,
+        BlockComment,
+        DollarQuote
+    };
+
+    void beginStatement();
+    void endComment(qsizetype end);
+    void keyword(QStringView word);
+    void finishStatement(qsizetype end, Statement* statement);
+    static bool isWordChar(QChar c) { return c.isLetterOrNumber() || c == '_' || c == '$'; }
+
+    State _state = Normal;
+    qsizetype _pos = 0;
+    qsizetype _start = -1;
+    qsizetype _commentStart = -1;
+    bool _lineStart = true;
+    bool _afterWordChar = false;
+    QString _dollarTag;
+
+    // Per-statement keyword tracking for trigger bodies
+    int _wordIndex = 0;
+    bool _createStatement = false;
+    bool _compound = false;
+    int _depth = 0;
+    int _caseDepth = 0;
+    QList<Statement::Comment> _comments;
+};
+
+#endif // SQLSCANNER_H
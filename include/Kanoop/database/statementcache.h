@@ -0,0 +1,124 @@
+/**
+ *  StatementCache
+ *
+ *  A size-bounded, least-recently-used cache of prepared QSqlQuery objects
+ *  keyed by SQL text. Used by DataSource::prepareQuery() so that hot statements
+ *  are parsed and planned by the database only once per connection.
+ */
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <QHash>
+#include <QSqlQuery>
+#include <QString>
+#include <list>
+
+/** @brief Size-bounded LRU cache of prepared statements for a single database connection.
+ *
+ *  Cached statements share their underlying result with the queries handed out
+ *  from the cache. A cache hit resets the statement and clears its bound values,
+ *  so a SELECT whose result is still active (not yet finish()ed) is not reused:
+ *  the lookup misses, and the freshly prepared statement takes its place. Call
+ *  QSqlQuery::finish() when done with a result to let its statement be reused.
+ */
+class StatementCache
+{
+public:
+    /** @brief Cache usage counters. */
+    struct Statistics
+    {
+        /** @brief Number of lookups which returned a cached statement. */
+        qint64 hits = 0;
+        /** @brief Number of lookups which found no cached statement. */
+        qint64 misses = 0;
+        /** @brief Number of lookups which found the cached SELECT with its result still active. */
+        qint64 busy = 0;
+        /** @brief Number of statements discarded to stay within capacity. */
+        qint64 evictions = 0;
+        /** @brief Number of times the whole cache was invalidated. */
+        qint64 invalidations = 0;
+        /** @brief Number of statements currently cached. */
+        int size = 0;
+        /** @brief Maximum number of statements cached. */
+        int capacity = 0;
+    };
+
+    /** @brief Construct a cache holding up to the given number of statements.
+     *  @param capacity The maximum number of statements, or 0 to disable caching.
+     */
+    explicit StatementCache(int capacity = 0) :
+        _capacity(capacity) {}
+
+    /** @brief Get the maximum number of cached statements.
+     *  @return The capacity, 0 if caching is disabled.
+     */
+    int capacity() const { return _capacity; }
+    /** @brief Set the maximum number of cached statements, evicting the least recently used as needed.
+     *  @param value The capacity, or 0 to disable caching.
+     */
+    void setCapacity(int value);
+
+    /** @brief Return true if the cache has a non-zero capacity.
+     *  @return true if caching is enabled.
+     */
+    bool isEnabled() const { return _capacity > 0; }
+
+    /** @brief Look up a prepared statement and make it the most recently used.
+     *  @param sql The SQL text.
+     *  @return The cached statement, reset to scrollable and with its bound values cleared, or nullptr on a cache miss
+     *          or when the cached SELECT's result is still active.
+     */
+    const QSqlQuery* find(const QString& sql);
+
+    /** @brief Add a successfully prepared statement to the cache.
+     *  @param sql The SQL text the statement was prepared from.
+     *  @param query The prepared statement.
+     */
+    void insert(const QString& sql, const QSqlQuery& query);
+
+    /** @brief Discard every cached statement. */
+    void clear();
+
+    /** @brief Discard every cached statement and count it as an invalidation. */
+    void invalidate();
+
+    /** @brief Get the number of cached statements.
+     *  @return The statement count.
+     */
+    int size() const { return _index.count(); }
+
+    /** @brief Get a snapshot of the usage counters.
+     *  @return The statistics.
+     */
+    Statistics statistics() const;
+
+    /** @brief Reset the usage counters. */
+    void resetStatistics() { _statistics = Statistics(); }
+
+    /** @brief Create a query which shares the prepared result of a cached statement.
+     *  @param query The cached statement.
+     *  @return A query sharing the same prepared result.
+     */
+    static QSqlQuery share(const QSqlQuery& query);
+
+private:
+    class Entry
+    {
+    public:
+        Entry(const QString& sql, QSqlQuery&& query) :
+            sql(sql), query(std::move(query)) {}
+
+        QString sql;
+        QSqlQuery query;
+    };
+    typedef std::list<Entry> EntryList;
+
+    void evict(int keep);
+
+    int _capacity;
+    EntryList _entries;
+    QHash<QString, EntryList::iterator> _index;
+    Statistics _statistics;
+};
+
+#endif // STATEMENTCACHE_H
@@ -0,0 +1,71 @@
+/**
+ *  Transaction
+ *
+ *  A scoped database transaction on a DataSource.
+ *
+ *  The transaction begins on construction and is rolled back on destruction
+ *  unless commit() was called, so an early return or exception leaves the
+ *  database unchanged. Transactions may be nested; inner transactions are
+ *  implemented with SAVEPOINTs.
+ */
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include <QtGlobal>
+
+class DataSource;
+
+/** @brief RAII database transaction which rolls back unless committed.
+ *
+ *  The outermost Transaction on a DataSource issues BEGIN / COMMIT. Transactions
+ *  created while another is active use SAVEPOINT / RELEASE, and rolling one back
+ *  only undoes the work done since it began. Nested transactions must be finished
+ *  in the reverse order they were created; finishing one while a transaction nested
+ *  inside it is still active rolls both back, and commit() returns false.
+ *
+ *  @code
+ *  Transaction transaction(this);
+ *  executeQuery("INSERT ...");
+ *  executeQuery("UPDATE ...");
+ *  return transaction.commit();
+ *  @endcode
+ */
+class Transaction
+{
+public:
+    /** @brief Begin a transaction (or savepoint, if one is already active) on the data source.
+     *  @param dataSource The data source whose connection the transaction runs on.
+     */
+    explicit Transaction(DataSource* dataSource);
+
+    /** @brief Destructor. Rolls the transaction back if it is still active. */
+    ~Transaction();
+
+    /** @brief Return true if the transaction began and has not yet been committed or rolled back.
+     *  @return true if active.
+     */
+    bool isActive() const { return _depth > 0; }
+
+    /** @brief Return true if this transaction is nested inside another (implemented as a savepoint).
+     *  @return true if nested.
+     */
+    bool isNested() const { return _depth > 1; }
+
+    /** @brief Commit the transaction, or release the savepoint if nested.
+     *  @return true on success. An outermost transaction whose commit fails is rolled back.
+     */
+    bool commit();
+
+    /** @brief Roll the transaction back, or roll back to the savepoint if nested.
+     *  @return true on success.
+     */
+    bool rollback();
+
+private:
+    Q_DISABLE_COPY(Transaction)
+
+    DataSource* _dataSource;
+    int _depth = 0;
+};
+
+#endif // TRANSACTION_H
@@ -0,0 +1,95 @@
+/**
+ *  WriteQueue
+ *
+ *  Thread-safe queue of pending writes for DataSource's group commit.
+ *
+ *  Producers on any thread add writes; the data source's owning thread takes
+ *  them in batches and executes each batch in one transaction, so that many
+ *  small writes share one commit (and, on SQLite, one fsync).
+ */
+#ifndef WRITEQUEUE_H
+#define WRITEQUEUE_H
+
+#include <QList>
+#include <QMutex>
+#include <QPromise>
+#include <QString>
+#include <QVariant>
+#include <memory>
+
+/** @brief Thread-safe queue of writes waiting to be group-committed by a DataSource. */
+class WriteQueue
+{
+public:
+    /** @brief A queued write. */
+    struct Write
+    {
+        /** @brief The SQL statement. */
+        QString sql;
+        /** @brief Values bound in order to the statement's placeholders. */
+        QVariantList bindings;
+        /** @brief Completed with the number of rows affected once the write is committed. */
+        std::shared_ptr<QPromise<int>> promise;
+    };
+
+    /** @brief Group commit counters. */
+    struct Statistics
+    {
+        /** @brief Number of writes executed. */
+        qint64 writes = 0;
+        /** @brief Number of writes which failed, including those lost to a failed commit. */
+        qint64 failures = 0;
+        /** @brief Number of batch transactions. */
+        qint64 batches = 0;
+        /** @brief Number of writes in the largest batch. */
+        int largestBatch = 0;
+
+        /** @brief Get the average number of writes per batch.
+         *  @return The average batch size.
+         */
+        double writesPerBatch() const { return batches > 0 ? (double)writes / batches : 0.0; }
+    };
+
+    /** @brief Construct an empty queue. */
+    WriteQueue() {}
+
+    /** @brief Add a write to the queue. May be called from any thread.
+     *  @param write The write.
+     *  @return The number of writes queued, including this one.
+     */
+    int enqueue(const Write& write);
+
+    /** @brief Remove writes from the front of the queue.
+     *  @param maxCount The maximum number of writes to take.
+     *  @return The writes, in the order they were queued.
+     */
+    QList<Write> take(int maxCount);
+
+    /** @brief Get the number of writes waiting.
+     *  @return The queue depth.
+     */
+    int count() const;
+
+    /** @brief Record the outcome of a batch.
+     *  @param writes The number of writes in the batch.
+     *  @param failures The number of them which failed.
+     */
+    void recordBatch(int writes, int failures);
+
+    /** @brief Get the group commit counters.
+     *  @return The counters.
+     */
+    Statistics statistics() const;
+
+    /** @brief Reset the group commit counters. */
+    void resetStatistics();
+
+private:
+    Q_DISABLE_COPY(WriteQueue)
+
+    mutable QMutex _mutex;
+    QList<Write> _pending;
+    Statistics _statistics;
+};
+
+#endif // WRITEQUEUE_H
@@ -0,0 +1,230 @@
+#include "asyncdatasource.h"
+#include "datasource.h"
+
+#include <Kanoop/commonexception.h>
+#include <QMutex>
+#include <QSqlQuery>
+#include <QThread>
+#include <QWaitCondition>
+
+class AsyncDataSourceWorker : public QThread
+{
+public:
+    typedef std::function<void(DataSource*)> Task;
+
+    AsyncDataSourceWorker(const DatabaseCredentials& credentials, const AsyncDataSource::Factory& factory) :
+        QThread(),
+        _credentials(credentials),
+        _factory(factory) {}
+
+    bool waitForOpen()
+    {
+        QMutexLocker locker(&_mutex);
+        while(_openComplete == false) {
+            _openChanged.wait(&_mutex);
+        }
+        return _open;
+    }
+
+    bool enqueue(const Task& task)
+    {
+        QMutexLocker locker(&_mutex);
+        if(_open == false || _stopping == true) {
+            return false;
+        }
+        _queue.append(task);
+        // One queued call drains everything submitted before it runs
+        if(_queue.count() == 1) {
+            QMetaObject::invokeMethod(_context, [this]() { drain(); }, Qt::QueuedConnection);
+        }
+        return true;
+    }
+
+    void requestStop()
+    {
+        QMutexLocker locker(&_mutex);
+        if(_open && _stopping == false) {
+            _stopping = true;
+            QMetaObject::invokeMethod(_context, [this]() { drain(); }, Qt::QueuedConnection);
+        }
+    }
+
+    bool isOpen() const
+    {
+        QMutexLocker locker(&_mutex);
+        return _open && _stopping == false;
+    }
+
+    int pendingCount() const
+    {
+        QMutexLocker locker(&_mutex);
+        return _queue.count();
+    }
+
+protected:
+    void run() override
+    {
+        DataSource* dataSource = _factory ? _factory() : new DataSource();
+        dataSource->setCredentials(_credentials);
+        bool open = dataSource->openConnection();
+
+        // Tasks arrive as queued calls on this object, so the same event loop also delivers
+        // the data source's own queued calls and timers, such as its group-committed writes
+        QObject context;
+        {
+            QMutexLocker locker(&_mutex);
+            _dataSource = dataSource;
+            _context = &context;
+            _open = open;
+            _openComplete = true;
+            _openChanged.wakeAll();
+        }
+
+        if(open) {
+            exec();
+            dataSource->closeConnection();
+        }
+
+        {
+            QMutexLocker locker(&_mutex);
+            _open = false;
+            _context = nullptr;
+            _dataSource = nullptr;
+        }
+        delete dataSource;
+    }
+
+private:
+    void drain()
+    {
+        // Take everything queued in one go so a burst of submissions costs a single wake-up
+        QList<Task> batch;
+        bool stopping;
+        {
+            QMutexLocker locker(&_mutex);
+            batch.swap(_queue);
+            stopping = _stopping;
+        }
+
+        for(const Task& task : std::as_const(batch)) {
+            task(_dataSource);
+        }
+
+        // Nothing is queued once stopping, so this batch was the last
+        if(stopping) {
+            quit();
+        }
+    }
+
+    DatabaseCredentials _credentials;
+    AsyncDataSource::Factory _factory;
+    DataSource* _dataSource = nullptr;
+    QObject* _context = nullptr;
+
+    mutable QMutex _mutex;
+    QWaitCondition _openChanged;
+    QList<Task> _queue;
+    bool _openComplete = false;
+    bool _open = false;
+    bool _stopping = false;
+};
+
+AsyncDataSource::AsyncDataSource(const DatabaseCredentials& credentials, const Factory& factory) :
+    LoggingBaseClass("db"),
+    _credentials(credentials),
+    _factory(factory)
+{
+}
+
+AsyncDataSource::~AsyncDataSource()
+{
+    stop();
+}
+
+bool AsyncDataSource::start()
+{
+    {
+        QMutexLocker locker(&_workerMutex);
+        if(_worker != nullptr) {
+            return _worker->isOpen();
+        }
+    }
+
+    AsyncDataSourceWorker* worker = new AsyncDataSourceWorker(_credentials, _factory);
+    worker->start();
+    if(worker->waitForOpen() == false) {
+        logText(LVL_ERROR, QString("Failed to open asynchronous data source %1").arg(_credentials.schema()));
+        worker->wait();
+        delete worker;
+        return false;
+    }
+
+    QMutexLocker locker(&_workerMutex);
+    _worker = worker;
+    return true;
+}
+
+void AsyncDataSource::stop()
+{
+    // Detached first, so that work submitted while the queue drains, even by the tasks
+    // themselves, is refused rather than waiting on a worker being deleted
+    AsyncDataSourceWorker* worker;
+    {
+        QMutexLocker locker(&_workerMutex);
+        worker = _worker;
+        _worker = nullptr;
+    }
+
+    if(worker != nullptr) {
+        worker->requestStop();
+        worker->wait();
+        delete worker;
+    }
+}
+
+bool AsyncDataSource::isRunning() const
+{
+    QMutexLocker locker(&_workerMutex);
+    return _worker != nullptr && _worker->isOpen();
+}
+
+QFuture<QueryResult> AsyncDataSource::execute(const QString& sql, const QVariantList& bindings)
+{
+    return submit([sql, bindings](DataSource* dataSource) {
+        return executeOnWorker(dataSource, sql, bindings);
+    });
+}
+
+int AsyncDataSource::pendingCount() const
+{
+    QMutexLocker locker(&_workerMutex);
+    return _worker != nullptr ? _worker->pendingCount() : 0;
+}
+
+bool AsyncDataSource::enqueue(const Task& task)
+{
+    QMutexLocker locker(&_workerMutex);
+    return _worker != nullptr && _worker->enqueue(task);
+}
+
+std::exception_ptr AsyncDataSource::notRunningException()
+{
+    return std::make_exception_ptr(CommonException("Asynchronous data source is not running"));
+}
+
+QueryResult AsyncDataSource::executeOnWorker(DataSource* dataSource, const QString& sql, const QVariantList& bindings)
+{
+    bool success;
+    QSqlQuery query = dataSource->executeForwardOnly(sql, bindings, &success);
+    if(success == false) {
+        throw CommonException(dataSource->errorText());
+    }
+    QueryResult result = QueryResult::fromQuery(query, &success);
+    dataSource->recordRowsFetched(query, result.rowCount());
+    if(success == false) {
+        dataSource->recordQueryError(query);
+        dataSource->logFailure(query);
+        throw CommonException(dataSource->errorText());
+    }
+    return result;
+}
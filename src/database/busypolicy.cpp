@@ -0,0 +1,30 @@
+#include "busypolicy.h"
+#include <QSqlError>
+
+BusyPolicy BusyPolicy::contended()
+{
+    BusyPolicy policy;
+    policy.setBusyTimeout(250);
+    policy.setMaxRetries(8);
+    policy.setInitialBackoffMs(10);
+    policy.setMaxBackoffMs(1000);
+    policy.setImmediateTransactions(true);
+    return policy;
+}
+
+int BusyPolicy::backoffMs(int retry) const
+{
+    qint64 backoff = (qint64)_initialBackoffMs << qBound(0, retry, 30);
+    return (int)qMin(backoff, (qint64)_maxBackoffMs);
+}
+
+bool BusyPolicy::isBusyError(const QSqlError& error)
+{
+    // Extended result codes keep the primary code in the low byte
+    static const int SqliteBusy = 5;
+    static const int SqliteLocked = 6;
+
+    bool ok;
+    int code = error.nativeErrorCode().toInt(&ok) & 0xff;
+    return ok && (code == SqliteBusy || code == SqliteLocked);
+}
@@ -0,0 +1,107 @@
+#include "columnarresult.h"
+
+QVariant ColumnarResult::Column::value(int row) const
+{
+    if(isNull(row)) {
+        return QVariant();
+    }
+    switch(_type) {
+    case Integer:
+        return _integers.at(row);
+    case Real:
+        return _reals.at(row);
+    case Blob:
+        return bytes(row).toByteArray();
+    default:
+        return text(row);
+    }
+}
+
+void ColumnarResult::Column::reserve(int rows)
+{
+    _nulls.reserve((rows + 7) / 8);
+    switch(_type) {
+    case Integer:
+        _integers.reserve(rows);
+        break;
+    case Real:
+        _reals.reserve(rows);
+        break;
+    default:
+        _offsets.reserve(rows + 1);
+        break;
+    }
+}
+
+void ColumnarResult::Column::appendValue(const QVariant& value)
+{
+    if(value.isNull()) {
+        appendNull();
+        return;
+    }
+    switch(_type) {
+    case Integer:
+        appendInteger(value.toLongLong());
+        break;
+    case Real:
+        appendReal(value.toDouble());
+        break;
+    case Blob:
+    {
+        QByteArray data = value.toByteArray();
+        appendBytes(data.constData(), data.size());
+        break;
+    }
+    default:
+    {
+        QByteArray data = value.toString().toUtf8();
+        appendBytes(data.constData(), data.size());
+        break;
+    }
+    }
+}
+
+ColumnarResult::Type ColumnarResult::typeFor(QMetaType type)
+{
+    switch(type.id()) {
+    case QMetaType::Bool:
+    case QMetaType::Char:
+    case QMetaType::SChar:
+    case QMetaType::UChar:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Long:
+    case QMetaType::ULong:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+        return Integer;
+    case QMetaType::Float:
+    case QMetaType::Double:
+        return Real;
+    case QMetaType::QByteArray:
+        return Blob;
+    default:
+        return Text;
+    }
+}
+
+int ColumnarResult::columnIndex(const QString& name) const
+{
+    for(int i = 0;i < _columns.count();i++) {
+        if(_columns.at(i).name().compare(name, Qt::CaseInsensitive) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QStringList ColumnarResult::columnNames() const
+{
+    QStringList result;
+    for(const Column& column : _columns) {
+        result.append(column.name());
+    }
+    return result;
+}
@@ -0,0 +1,169 @@
+#include "databasevalidator.h"
+#include "sqlbuilder.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPromise>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThreadPool>
+#include <QUuid>
+#include <memory>
+
+DatabaseValidator::Result DatabaseValidator::validate(const ProgressCallback& progress) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Result result;
+    if(_level == NoValidation) {
+        result.valid = true;
+    }
+    else if(hasSqliteHeader(_filename) == false) {
+        result.errors.append(QString("%1 is not a SQLite database").arg(_filename));
+    }
+    else if(_level == HeaderOnly) {
+        result.valid = true;
+    }
+    else {
+        QString connectionName = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+            db.setDatabaseName(_filename);
+            db.setConnectOptions("QSQLITE_OPEN_READONLY");
+            if(db.open() == true) {
+                result = check(db, _level, _maxErrors, progress);
+                db.close();
+            }
+            else {
+                result.errors.append(db.lastError().text());
+            }
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+    }
+
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+QFuture<DatabaseValidator::Result> DatabaseValidator::validateInBackground() const
+{
+    std::shared_ptr<QPromise<Result>> promise = std::make_shared<QPromise<Result>>();
+    QFuture<Result> future = promise->future();
+    promise->start();
+
+    DatabaseValidator validator(*this);
+    QThreadPool::globalInstance()->start([promise, validator]() {
+        Result result = validator.validate([promise](int tablesChecked, int tableCount) {
+            if(tablesChecked == 0) {
+                promise->setProgressRange(0, tableCount);
+            }
+            promise->setProgressValue(tablesChecked);
+            return promise->isCanceled() == false;
+        });
+        promise->addResult(result);
+        promise->finish();
+    });
+    return future;
+}
+
+DatabaseValidator::Result DatabaseValidator::check(const QSqlDatabase& db, Level level, int maxErrors, const ProgressCallback& progress)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Result result;
+    maxErrors = qMax(1, maxErrors);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    switch(level) {
+    case NoValidation:
+        result.valid = true;
+        break;
+
+    case HeaderOnly:
+        // Reading the schema reads page one, which fails if the header is not SQLite's
+        if(query.exec("SELECT COUNT(*) FROM sqlite_master") == false) {
+            result.errors.append(query.lastError().text());
+        }
+        break;
+
+    case QuickCheck:
+    case IntegrityCheck:
+    {
+        const QString pragma = level == QuickCheck ? "quick_check" : "integrity_check";
+        if(!progress) {
+            runCheck(query, QString("PRAGMA %1(%2)").arg(pragma).arg(maxErrors), maxErrors, &result);
+            break;
+        }
+
+        // Table by table, so progress can be reported and the check cancelled in between.
+        // Virtual tables have no b-tree of their own to check.
+        QStringList tables;
+        if(query.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND rootpage > 0 ORDER BY name") == false) {
+            result.errors.append(query.lastError().text());
+            break;
+        }
+        while(query.next()) {
+            tables.append(query.value(0).toString());
+        }
+        query.finish();
+
+        result.tableCount = tables.count();
+        for(const QString& table : std::as_const(tables)) {
+            if(progress(result.tablesChecked, result.tableCount) == false) {
+                result.cancelled = true;
+                break;
+            }
+            QString sql = QString("PRAGMA %1('%2')").arg(pragma, SqlBuilder::escaped(table));
+            bool executed = runCheck(query, sql, maxErrors, &result);
+            result.tablesChecked++;
+            if(executed == false || result.errors.count() >= maxErrors) {
+                break;
+            }
+        }
+        if(result.cancelled == false) {
+            progress(result.tablesChecked, result.tableCount);
+        }
+        break;
+    }
+    }
+
+    result.valid = result.errors.isEmpty() && result.cancelled == false;
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+bool DatabaseValidator::hasSqliteHeader(const QString& filename)
+{
+    QFile file(filename);
+    if(file.open(QIODevice::ReadOnly) == false) {
+        return false;
+    }
+
+    QByteArray header = file.read(HeaderSize);
+    if(header.size() < HeaderSize || header.startsWith(QByteArrayView("SQLite format 3\0", 16)) == false) {
+        return false;
+    }
+
+    // Big-endian page size: a power of two from 512 to 32768, or 1 meaning 65536
+    uint pageSize = ((uchar)header.at(16) << 8) | (uchar)header.at(17);
+    return pageSize == 1 || (pageSize >= 512 && pageSize <= 32768 && (pageSize & (pageSize - 1)) == 0);
+}
+
+bool DatabaseValidator::runCheck(QSqlQuery& query, const QString& sql, int maxErrors, Result* result)
+{
+    if(query.exec(sql) == false) {
+        // A badly damaged file may fail outright rather than report rows
+        result->errors.append(query.lastError().text());
+        return false;
+    }
+    while(query.next() && result->errors.count() < maxErrors) {
+        QString row = query.value(0).toString();
+        if(row.compare("ok", Qt::CaseInsensitive) != 0) {
+            result->errors.append(row);
+        }
+    }
+    query.finish();
+    return true;
+}
@@ -1,14 +1,206 @@
 #include "datasource.h"
+#include "sqlbuilder.h"
 #include "sqlparser.h"
+#include "sqlscanner.h"
+#include "transaction.h"
 #include <Kanoop/commonexception.h>
 #include <Kanoop/datetimeutil.h>
 #include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QRegularExpression>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlResult>
+#include <QStringDecoder>
 #include <QThread>
+#include <QTimer>
 #include <QUuid>
+#include <QWaitCondition>
+#include <exception>
+#include <memory>
+
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+#include <QSqlDriver>
+#include <sqlite3.h>
+
+// Set once a connection shows that Qt's QSQLITE driver runs a different SQLite from the
+// one linked here. A handle from one copy passed to the other corrupts memory, so from
+// then on no native path is taken.
+static std::atomic<bool> nativeSqliteMismatch { false };
+
+static sqlite3* sqliteHandle(const QSqlDatabase& db)
+{
+    if(nativeSqliteMismatch) {
+        return nullptr;
+    }
+    QVariant handle = db.driver()->handle();
+    if(handle.isValid() && qstrcmp(handle.typeName(), "sqlite3*") == 0) {
+        return *static_cast<sqlite3* const*>(handle.constData());
+    }
+    return nullptr;
+}
+
+static sqlite3_stmt* sqliteStatement(const QSqlQuery& query)
+{
+    if(nativeSqliteMismatch) {
+        return nullptr;
+    }
+    QVariant handle = query.result()->handle();
+    if(handle.isValid() && qstrcmp(handle.typeName(), "sqlite3_stmt*") == 0) {
+        return *static_cast<sqlite3_stmt* const*>(handle.constData());
+    }
+    return nullptr;
+}
+
+static void recordUpdatedTable(void* context, int operation, const char* database, const char* table, sqlite3_int64 rowid)
+{
+    Q_UNUSED(operation);
+    Q_UNUSED(database);
+    Q_UNUSED(rowid);
+    // Called for every changed row, so only allocate for a table not yet recorded
+    QSet<QByteArray>* tables = static_cast<QSet<QByteArray>*>(context);
+    if(tables->contains(QByteArray::fromRawData(table, qstrlen(table))) == false) {
+        tables->insert(QByteArray(table));
+    }
+}
+#endif
+
+// Called after a read returned no bytes. A pipe, socket or process may simply not
+// have delivered everything yet, so it ends only when waiting brings nothing more.
+// A process still running when the wait times out sets timedOut instead.
+static bool deviceAtEnd(QIODevice* device, int timeoutMs, bool* timedOut)
+{
+    *timedOut = false;
+    if(device->isSequential() == false) {
+        return true;
+    }
+    if(device->bytesAvailable() > 0 || device->waitForReadyRead(timeoutMs) || device->bytesAvailable() > 0) {
+        return false;
+    }
+
+    QProcess* process = qobject_cast<QProcess*>(device);
+    if(process != nullptr && process->state() != QProcess::NotRunning) {
+        *timedOut = true;
+    }
+    return true;
+}
+
+// One chunk of an import file, read and then parsed into rows
+struct ImportChunk
+{
+    QByteArray bytes;
+    bool atEnd = false;
+    QList<QVariantList> rows;
+    QList<RecordParser::Error> errors;
+    QStringList columns;
+    qint64 bytesRead = 0;
+};
+
+// Bounded hand-off of chunks between importData() and its parse thread
+class ImportChunkQueue
+{
+public:
+    static const int MaxChunks = 4;
+
+    bool put(ImportChunk&& chunk)
+    {
+        QMutexLocker locker(&_mutex);
+        while(_chunks.count() >= MaxChunks && _cancelled == false) {
+            _notFull.wait(&_mutex);
+        }
+        if(_cancelled) {
+            return false;
+        }
+        _chunks.append(std::move(chunk));
+        _notEmpty.wakeOne();
+        return true;
+    }
+
+    // Returns false once the producer has finished and every chunk has been taken
+    bool take(ImportChunk* chunk)
+    {
+        QMutexLocker locker(&_mutex);
+        while(_chunks.isEmpty() && _finished == false) {
+            _notEmpty.wait(&_mutex);
+        }
+        if(_chunks.isEmpty()) {
+            return false;
+        }
+        *chunk = _chunks.takeFirst();
+        _notFull.wakeOne();
+        return true;
+    }
+
+    void finish(const QString& error = QString())
+    {
+        QMutexLocker locker(&_mutex);
+        _finished = true;
+        _error = error;
+        _notEmpty.wakeAll();
+    }
+
+    void cancel()
+    {
+        QMutexLocker locker(&_mutex);
+        _cancelled = true;
+        _notFull.wakeAll();
+    }
+
+    QString error() const
+    {
+        QMutexLocker locker(&_mutex);
+        return _error;
+    }
+
+private:
+    mutable QMutex _mutex;
+    QWaitCondition _notEmpty;
+    QWaitCondition _notFull;
+    QList<ImportChunk> _chunks;
+    QString _error;
+    bool _finished = false;
+    bool _cancelled = false;
+};
+
+// Read the next chunk of an import file. An empty chunk not at the end means the device was waited on.
+static void readImportChunk(QIODevice* device, ImportChunk* chunk)
+{
+    static const qint64 ReadSize = 64 * 1024;
+    static const int SequentialReadTimeoutMs = 30000;
+
+    *chunk = ImportChunk();
+    chunk->bytes = device->read(ReadSize);
+    chunk->bytesRead = chunk->bytes.size();
+    if(chunk->bytes.isEmpty()) {
+        bool timedOut;
+        chunk->atEnd = deviceAtEnd(device, SequentialReadTimeoutMs, &timedOut);
+        if(timedOut) {
+            throw CommonException(QString("No import data received for %1 ms").arg(SequentialReadTimeoutMs));
+        }
+    }
+}
+
+// Parse a chunk read by readImportChunk() into rows. Returns false if the file is malformed.
+static bool parseImportChunk(RecordParser& parser, ImportChunk* chunk)
+{
+    if(chunk->bytes.isEmpty() && chunk->atEnd == false) {
+        return true;
+    }
+
+    bool result = parser.parse(chunk->bytes, chunk->atEnd, chunk->rows);
+    chunk->bytes.clear();
+    if(result) {
+        chunk->errors = parser.takeErrors();
+        chunk->columns = parser.columns();
+    }
+    return result;
+}
 
 DataSource::~DataSource()
 {
@@ -67,6 +259,10 @@ bool DataSource::openConnection()
         }
 
         if(_credentials.isSqlite()) {
+            if(applySqliteProfile(false) == false) {
+                throw CommonException("Failed to apply SQLite performance profile");
+            }
+
             // sqlite does not enable foreign key checking by default
             setSqliteForeignKeyChecking(true);
         }
@@ -76,15 +272,24 @@ bool DataSource::openConnection()
             throw CommonException("Database migration failed");
         }
 
+        // Migration may have changed the schema under any statements it cached
+        _statementCache.invalidate();
+
         if(integrityCheck() == false) {
             throw CommonException("Database integrity check failed");
         }
 
+        if(_credentials.isSqlite() && _resultCache.isEnabled()) {
+            installUpdateHook();
+        }
+
         result = true;
     }
     catch(const CommonException& e)
     {
         logText(LVL_ERROR, QString("DataSource Open Exception: %1 [%2]").arg(e.message()).arg(QSqlError(_db.lastError()).databaseText()));
+        closeReadConnections();
+        _statementCache.clear();
         _db = QSqlDatabase();
         QSqlDatabase::removeDatabase(_connectionName);
         result = false;
@@ -98,6 +303,21 @@ bool DataSource::closeConnection()
     bool result = false;
 
     if(_db.isOpen() == true) {
+        // Closing rolls back an open transaction anyway. End it first, so that writes
+        // still waiting for their batch window are committed on their own, not dropped.
+        unwindTransactions(1);
+        if(_writeQueue.count() > 0 && checkExecutingThread()) {
+            flushWrites();
+        }
+        closeReadConnections();
+        _statementCache.clear();
+        finalizeSqliteStatements();
+        _resultCache.clear();
+        _transactionWrites.clear();
+        _hookedTables.clear();
+        _viewTablesLoaded = false;
+        _inListTables.clear();
+        _transactionDepth = 0;
         _db.close();
         _db = QSqlDatabase();
         QSqlDatabase::removeDatabase(_connectionName);
@@ -107,8 +327,51 @@ bool DataSource::closeConnection()
     return result;
 }
 
+SqlitePerformanceProfile DataSource::currentSqliteProfile()
+{
+    SqlitePerformanceProfile result;
+    if(_db.isOpen() == false || isSqlite() == false || checkExecutingThread() == false) {
+        return result;
+    }
+
+    result.setJournalMode(SqlitePerformanceProfile::journalModeFromString(readPragma("journal_mode").toString()));
+
+    QVariant value;
+    if((value = readPragma("synchronous")).isValid()) {
+        result.setSynchronous(static_cast<SqlitePerformanceProfile::Synchronous>(value.toInt()));
+    }
+    if((value = readPragma("temp_store")).isValid()) {
+        result.setTempStore(static_cast<SqlitePerformanceProfile::TempStore>(value.toInt()));
+    }
+    if((value = readPragma("page_size")).isValid()) {
+        result.setPageSize(value.toInt());
+    }
+    if((value = readPragma("cache_size")).isValid()) {
+        // Positive values are in pages, negative values in KiB
+        qint64 cacheSize = value.toLongLong();
+        result.setCacheSizeKiB(cacheSize < 0 ? -cacheSize : (cacheSize * qMax(0, result.pageSize())) / 1024);
+    }
+    if((value = readPragma("mmap_size")).isValid()) {
+        result.setMmapSize(value.toLongLong());
+    }
+    if((value = readPragma("busy_timeout")).isValid()) {
+        result.setBusyTimeout(value.toInt());
+    }
+    if((value = readPragma("wal_autocheckpoint")).isValid()) {
+        result.setWalAutoCheckpoint(value.toInt());
+    }
+    return result;
+}
+
+int DataSource::readConnectionCount() const
+{
+    QMutexLocker locker(&_readMutex);
+    return _readConnections.count();
+}
+
 QString DataSource::errorText() const
 {
+    QMutexLocker locker(&_errorMutex);
     QString result;
     QTextStream output(&result);
     if(_dataSourceError.isEmpty() == false) {
@@ -128,35 +391,275 @@ QString DataSource::errorText() const
 
 bool DataSource::isSqlite(const QString& filename)
 {
-    if (!QFile::exists(filename)) {
-        return false;
+    return isSqlite(filename, DatabaseValidator::IntegrityCheck);
+}
+
+bool DataSource::isSqlite(const QString& filename, DatabaseValidator::Level level)
+{
+    // A single error is enough to answer the question
+    return DatabaseValidator(filename, level == DatabaseValidator::NoValidation ? DatabaseValidator::HeaderOnly : level, 1).validate().valid;
+}
+
+bool DataSource::backupTo(const QString& filename, const BackupProgressCallback& progress, BackupStatistics* statistics)
+{
+    bool result = false;
+    BackupStatistics stats;
+    QElapsedTimer timer;
+    timer.start();
+
+    // Written beside the destination and renamed over it once complete
+    QString partialFilename = filename + ".partial";
+    try
+    {
+        if(isSqlite() == false || _db.isOpen() == false) {
+            throw CommonException("Backup requires an open SQLite database");
+        }
+
+        if(checkExecutingThread() == false) {
+            throw CommonException("Backup executed from wrong thread");
+        }
+
+        if(QFileInfo(filename) == QFileInfo(_db.databaseName())) {
+            throw CommonException("Cannot back up a database onto itself");
+        }
+
+        if(QFile::exists(partialFilename) && QFile::remove(partialFilename) == false) {
+            throw CommonException(QString("Failed to remove stale backup %1").arg(partialFilename));
+        }
+
+        if(isOnlineBackupAvailable()) {
+            QString error;
+            QString connectionName = QUuid::createUuid().toString(QUuid::WithoutBraces);
+            {
+                QSqlDatabase destination = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+                destination.setDatabaseName(partialFilename);
+                if(destination.open() == false) {
+                    error = QString("Failed to create backup %1: %2").arg(partialFilename).arg(destination.lastError().text());
+                }
+                else {
+                    error = backupPages(destination, progress, stats);
+                    destination.close();
+                }
+            }
+            QSqlDatabase::removeDatabase(connectionName);
+            if(error.isEmpty() == false) {
+                throw CommonException(error);
+            }
+        }
+        else {
+            // A consistent, compacted copy in one statement
+            stats.pageCount = readPragma("page_count").toLongLong();
+            if(reportBackupProgress(progress, stats) == false) {
+                throw CommonException("Backup cancelled");
+            }
+            if(executeTransactionControl(QString("VACUUM INTO '%1'").arg(SqlBuilder::escaped(partialFilename))) == false) {
+                throw CommonException(QString("Failed to back up to %1").arg(filename));
+            }
+            stats.pagesCopied = stats.pageCount;
+            stats.steps = 1;
+        }
+
+        if(QFile::exists(filename) && QFile::remove(filename) == false) {
+            throw CommonException(QString("Failed to replace %1").arg(filename));
+        }
+        if(QFile::rename(partialFilename, filename) == false) {
+            throw CommonException(QString("Failed to rename %1 to %2").arg(partialFilename).arg(filename));
+        }
+
+        stats.elapsedMs = timer.elapsed();
+        reportBackupProgress(progress, stats);
+        result = true;
     }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+        QFile::remove(partialFilename);
+    }
+
+    stats.elapsedMs = timer.elapsed();
+    if(result) {
+        logText(LVL_DEBUG, QString("Backed up %1 pages to %2 in %3 steps in %4ms")
+                .arg(stats.pagesCopied).arg(filename).arg(stats.steps).arg(stats.elapsedMs));
+    }
+    if(statistics != nullptr) {
+        *statistics = stats;
+    }
+    return result;
+}
+
+bool DataSource::backupTo(DataSource* destination, const BackupProgressCallback& progress, BackupStatistics* statistics)
+{
+    bool result = false;
+    BackupStatistics stats;
+    QElapsedTimer timer;
+    timer.start();
 
-    QString connectionName = QUuid::createUuid().toString(QUuid::WithoutBraces);
-    bool valid = false;
+    try
     {
-        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
-        db.setDatabaseName(filename);
-        if(db.open() == true) {
-            QSqlQuery query(db);
-            if(query.exec("PRAGMA integrity_check;") && query.next() &&
-               query.value(0).toString().compare("ok", Qt::CaseInsensitive) == 0) {
-                valid = true;
+        if(isSqlite() == false || _db.isOpen() == false) {
+            throw CommonException("Backup requires an open SQLite database");
+        }
+
+        if(destination == nullptr || destination == this || destination->isSqlite() == false || destination->isOpen() == false) {
+            throw CommonException("Backup destination must be another open SQLite data source");
+        }
+
+        if(checkExecutingThread() == false || destination->checkExecutingThread() == false) {
+            throw CommonException("Backup executed from wrong thread");
+        }
+
+        // The destination's schema is about to be replaced under any statements it cached
+        destination->_statementCache.clear();
+
+        if(isOnlineBackupAvailable()) {
+            QString error = backupPages(destination->_db, progress, stats);
+            if(error.isEmpty() == false) {
+                throw CommonException(error);
+            }
+        }
+        else {
+            QString filename = _db.databaseName();
+            if(filename.isEmpty() || filename == ":memory:") {
+                throw CommonException("An in-memory database can only be copied with the online backup API");
+            }
+            stats.pageCount = readPragma("page_count").toLongLong();
+            if(reportBackupProgress(progress, stats) == false) {
+                throw CommonException("Backup cancelled");
             }
-            db.close();
+            if(destination->copyFromAttached(filename) == false) {
+                throw CommonException(QString("Failed to copy %1: %2").arg(filename).arg(destination->errorText()));
+            }
+            stats.pagesCopied = stats.pageCount;
+            stats.steps = 1;
         }
+
+        stats.elapsedMs = timer.elapsed();
+        reportBackupProgress(progress, stats);
+        result = true;
+    }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+    }
+
+    // Even a failed copy may have replaced some of what the destination had cached
+    destination->_resultCache.invalidate();
+    {
+        QMutexLocker locker(&destination->_viewMutex);
+        destination->_viewTablesLoaded = false;
+    }
+
+    stats.elapsedMs = timer.elapsed();
+    if(result) {
+        logText(LVL_DEBUG, QString("Backed up %1 pages to %2 in %3 steps in %4ms")
+                .arg(stats.pagesCopied).arg(destination->_db.databaseName()).arg(stats.steps).arg(stats.elapsedMs));
     }
-    QSqlDatabase::removeDatabase(connectionName);
-    return valid;
+    if(statistics != nullptr) {
+        *statistics = stats;
+    }
+    return result;
 }
 
-QSqlQuery DataSource::prepareQuery(const QString& sql, bool* success)
+bool DataSource::isOnlineBackupAvailable()
 {
-    bool result;
+    return isNativeSqliteAvailable();
+}
+
+bool DataSource::isNativeSqliteAvailable()
+{
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+    return nativeSqliteMismatch == false;
+#else
+    return false;
+#endif
+}
+
+void DataSource::verifyNativeSqlite()
+{
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+    if(nativeSqliteMismatch) {
+        return;
+    }
+
     QSqlQuery query(_db);
-    if((result = query.prepare(sql)) == false) {
-        recordQueryError(query);
-        logFailure(query);
+    if(query.exec("SELECT sqlite_source_id()") && query.next()) {
+        QString driverSource = query.value(0).toString();
+        QString linkedSource = QString::fromLatin1(sqlite3_sourceid());
+        if(driverSource != linkedSource) {
+            nativeSqliteMismatch = true;
+            logText(LVL_WARNING, QString("The QSQLITE driver runs SQLite %1 but this library is linked against %2; native SQLite features are disabled")
+                    .arg(driverSource, linkedSource));
+        }
+    }
+#endif
+}
+
+QFuture<int> DataSource::queueWrite(const QString& sql, const QVariantList& bindings)
+{
+    std::shared_ptr<QPromise<int>> promise = std::make_shared<QPromise<int>>();
+    QFuture<int> future = promise->future();
+    promise->start();
+
+    int pending = _writeQueue.enqueue(WriteQueue::Write{ sql, bindings, promise });
+    if(pending == 1) {
+        // The first write of a batch opens the window for others to join it
+        QMetaObject::invokeMethod(this, [this]() {
+            QTimer::singleShot(_writeBatchWindowMs.load(), this, [this]() { flushWrites(); });
+        }, Qt::QueuedConnection);
+    }
+    else if(pending == _writeBatchSize) {
+        QMetaObject::invokeMethod(this, [this]() { flushWrites(); }, Qt::QueuedConnection);
+    }
+    return future;
+}
+
+bool DataSource::flushWrites()
+{
+    // Inside a transaction a batch would only be a savepoint, and its futures would complete
+    // before anything was durable. The queue is flushed again once the transaction ends.
+    if(_transactionDepth > 0) {
+        return true;
+    }
+
+    bool result = true;
+    for(;;) {
+        QList<WriteQueue::Write> batch = _writeQueue.take(_writeBatchSize);
+        if(batch.isEmpty()) {
+            break;
+        }
+        if(executeWriteBatch(batch) == false) {
+            result = false;
+        }
+    }
+    return result;
+}
+
+QSqlQuery DataSource::prepareQuery(const QString& sql, bool* success)
+{
+    // Each read connection belongs to one thread, so its statement cache needs no locking
+    ReadConnection* reader = _readConnectionLimit > 0 ? routeToReader(sql) : nullptr;
+    StatementCache& statementCache = reader != nullptr ? reader->statementCache : _statementCache;
+
+    bool result = true;
+    const QSqlQuery* cached = statementCache.find(sql);
+    QSqlQuery query = cached != nullptr ? StatementCache::share(*cached) : QSqlQuery(reader != nullptr ? reader->db : _db);
+    if(cached == nullptr) {
+        QElapsedTimer timer;
+        if(_metrics.isEnabled()) {
+            timer.start();
+        }
+        if((result = query.prepare(sql)) == false) {
+            recordQueryError(query);
+            logFailure(query);
+        }
+        else {
+            statementCache.insert(sql, query);
+        }
+        if(_metrics.isEnabled()) {
+            _metrics.recordPrepare(sql, timer.nsecsElapsed() / 1000, result);
+        }
     }
 
     if(success != nullptr) {
@@ -183,11 +686,69 @@ QSqlQuery DataSource::executeQuery(const QString& sql, bool* success)
 bool DataSource::executeQuery(QSqlQuery& query)
 {
     bool result;
-    if((result = checkExecutingThread()) == true) {
-        if((result = query.exec()) == false) {
+    bool reader = isReaderQuery(query);
+    if((result = (reader || checkExecutingThread())) == true) {
+        QElapsedTimer timer;
+        bool timed = _metrics.isEnabled() || _metrics.slowQueryThresholdMs() >= 0;
+        if(timed) {
+            timer.start();
+        }
+        // A statement which failed with SQLITE_BUSY made no changes, so outside a transaction it can run again
+        bool retryable = (reader || _transactionDepth == 0) && _busyPolicy.maxRetries() > 0 &&
+                         (_busyPolicy.retryWrites() || isReadStatement(query.lastQuery()));
+        result = execRetryingBusy(query, retryable);
+        if(timed) {
+            recordExecution(query, timer.nsecsElapsed() / 1000, result);
+        }
+
+        if(result == false) {
             recordQueryError(query);
             logFailure(query);
         }
+        else if(reader == false) {
+            if(_statementCache.size() > 0 && isSchemaChange(query.lastQuery())) {
+                _statementCache.invalidate();
+            }
+            if(_resultCache.isEnabled()) {
+                invalidateResults(query.lastQuery());
+            }
+        }
+    }
+    return result;
+}
+
+QueryResult DataSource::executeCached(const QString& sql, const QVariantList& bindings, bool* success)
+{
+    QueryResult result;
+    bool querySuccess = true;
+    QByteArray key;
+    if(_resultCache.isEnabled()) {
+        key = ResultCache::key(sql, bindings);
+    }
+
+    if(key.isEmpty() || _resultCache.find(key, result) == false) {
+        // Read first, so that a write made while the query runs keeps its result out of the cache
+        quint64 generation = _resultCache.generation();
+        QSqlQuery query = executeForwardOnly(sql, bindings, &querySuccess);
+        if(querySuccess) {
+            result = QueryResult::fromQuery(query, &querySuccess);
+            if(querySuccess == false) {
+                // A result cut short by a failed read is neither returned nor cached
+                recordQueryError(query);
+                logFailure(query);
+                result = QueryResult();
+            }
+            recordRowsFetched(query, result.rowCount());
+            bool inTransaction = isReaderQuery(query) == false && _transactionDepth > 0;
+            query.finish();
+            if(querySuccess && key.isEmpty() == false && inTransaction == false) {
+                _resultCache.insert(key, result, resultDependencies(sql), generation);
+            }
+        }
+    }
+
+    if(success != nullptr) {
+        *success = querySuccess;
     }
     return result;
 }
@@ -195,7 +756,7 @@ bool DataSource::executeQuery(QSqlQuery& query)
 bool DataSource::querySuccessful(const QSqlQuery& query)
 {
     bool result;
-    if((result = checkExecutingThread()) == true) {
+    if((result = (isReaderQuery(query) || checkExecutingThread())) == true) {
         if((result = query.isActive()) == false) {
             recordQueryError(query);
             logFailure(query);
@@ -204,8 +765,13 @@ bool DataSource::querySuccessful(const QSqlQuery& query)
     return result;
 }
 
-bool DataSource::executeMultiple(const QStringList& queries)
+bool DataSource::executeMultiple(const QStringList& queries, bool atomic)
 {
+    if(atomic) {
+        Transaction transaction(this);
+        return transaction.isActive() && executeMultiple(queries, false) && transaction.commit();
+    }
+
     bool result = true;
     for(const QString& statement : queries) {
         executeQuery(statement, &result);
@@ -216,178 +782,2119 @@ bool DataSource::executeMultiple(const QStringList& queries)
     return result;
 }
 
-void DataSource::logSql(const char* file, int line, Log::LogLevel level, const QString& sql)
-{
-    logText(file, line, level, QString("\n%1").arg(sql));
-}
-
-void DataSource::logFailure(const QSqlQuery& query) const
-{
-    logText(LVL_ERROR, QString("QUERY FAILED: %1\nSQL Follows:\n%2")
-            .arg(errorText()).arg(query.lastQuery()));
-}
-
-bool DataSource::recreateSqliteDatabase()
+bool DataSource::bulkInsert(const QString& table, const QStringList& columns, const QList<QVariantList>& columnValues, BulkInsertStatistics* statistics)
 {
-    if(_db.isOpen()) {
-        _db.close();
-    }
+    bool result = false;
+    BulkInsertStatistics stats;
+    QElapsedTimer timer;
+    timer.start();
 
     try
     {
-        createSqliteDatabase();
-    }
-    catch(const CommonException& e)
-    {
-        logText(LVL_ERROR, QString("Database recreation failed: %1").arg(e.message()));
-        return false;
-    }
-    return true;
-}
+        if(columns.isEmpty() || columns.count() != columnValues.count()) {
+            throw CommonException(QString("Bulk insert into %1 has %2 columns but %3 value lists").arg(table).arg(columns.count()).arg(columnValues.count()));
+        }
 
-QDateTime DataSource::utcTime(const QVariant& value)
-{
-    QDateTime timestamp = value.toDateTime();
-    timestamp.setTimeZone(QTimeZone::utc());
+        qsizetype rowCount = columnValues.first().count();
+        for(const QVariantList& values : columnValues) {
+            if(values.count() != rowCount) {
+                throw CommonException(QString("Bulk insert into %1 has value lists of differing lengths").arg(table));
+            }
+        }
+
+        int columnCount = columns.count();
+        if(columnCount > _maxBoundVariables) {
+            throw CommonException(QString("Bulk insert into %1 has more columns than the bound variable limit").arg(table));
+        }
+
+        if(checkExecutingThread() == false) {
+            throw CommonException("Bulk insert from wrong thread");
+        }
+
+        // Fill each statement with as many rows as the bound variable limit allows,
+        // and make each transaction a whole number of statements.
+        int rowsPerStatement = qMin(_maxBoundVariables / columnCount, _bulkInsertChunkSize);
+        qsizetype rowsPerChunk = (_bulkInsertChunkSize / rowsPerStatement) * rowsPerStatement;
+
+        for(qsizetype chunkStart = 0;chunkStart < rowCount;chunkStart += rowsPerChunk) {
+            qsizetype chunkRows = qMin(rowsPerChunk, rowCount - chunkStart);
+            int fullStatements = chunkRows / rowsPerStatement;
+            int remainder = chunkRows % rowsPerStatement;
+
+            Transaction transaction(this);
+            if(transaction.isActive() == false) {
+                throw CommonException(QString("Failed to begin bulk insert transaction: %1").arg(errorText()));
+            }
+
+            if(fullStatements > 0 &&
+               executeBulkStatement(table, columns, columnValues, chunkStart, rowsPerStatement, fullStatements, stats) == false) {
+                throw CommonException(QString("Bulk insert into %1 failed").arg(table));
+            }
+            if(remainder > 0 &&
+               executeBulkStatement(table, columns, columnValues, chunkStart + (qsizetype)fullStatements * rowsPerStatement, remainder, 1, stats) == false) {
+                throw CommonException(QString("Bulk insert into %1 failed").arg(table));
+            }
+
+            if(transaction.commit() == false) {
+                throw CommonException(QString("Failed to commit bulk insert transaction: %1").arg(errorText()));
+            }
+            stats.rows += chunkRows;
+            stats.transactions++;
+        }
+
+        result = true;
+    }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+    }
+
+    stats.elapsedMs = timer.elapsed();
+    if(result) {
+        logText(LVL_DEBUG, QString("Bulk inserted %1 rows into %2 in %3ms (%4 rows/sec)")
+                .arg(stats.rows).arg(table).arg(stats.elapsedMs).arg(stats.rowsPerSecond(), 0, 'f', 0));
+    }
+    if(statistics != nullptr) {
+        *statistics = stats;
+    }
+    return result;
+}
+
+bool DataSource::bulkInsertRows(const QString& table, const QStringList& columns, const QList<QVariantList>& rows, BulkInsertStatistics* statistics)
+{
+    QList<QVariantList> columnValues(columns.count());
+    for(QVariantList& values : columnValues) {
+        values.reserve(rows.count());
+    }
+
+    for(const QVariantList& row : rows) {
+        if(row.count() != columns.count()) {
+            QString message = QString("Bulk insert into %1 has a row with %2 values for %3 columns").arg(table).arg(row.count()).arg(columns.count());
+            setDataSourceError(message);
+            logText(LVL_ERROR, message);
+            if(statistics != nullptr) {
+                *statistics = BulkInsertStatistics();
+            }
+            return false;
+        }
+        for(int i = 0;i < row.count();i++) {
+            columnValues[i].append(row.at(i));
+        }
+    }
+    return bulkInsert(table, columns, columnValues, statistics);
+}
+
+bool DataSource::importData(QIODevice* device, const ImportSpec& spec, const ImportProgressCallback& progress, ImportStatistics* statistics)
+{
+    static const int MaxReportedErrors = 100;
+
+    bool result = false;
+    ImportStatistics stats;
+    QElapsedTimer timer;
+    timer.start();
+
+    RecordParser parser(spec);
+    ImportChunkQueue unparsed;
+    ImportChunkQueue parsed;
+    QThread* parseThread = nullptr;
+
+    try
+    {
+        if(device == nullptr || device->isReadable() == false) {
+            throw CommonException("Import device is not open for reading");
+        }
+
+        if(spec.table().isEmpty()) {
+            throw CommonException("Import has no target table");
+        }
+
+        if(checkExecutingThread() == false) {
+            throw CommonException("Import executed from wrong thread");
+        }
+
+        if(device->isSequential() == false) {
+            stats.bytesTotal = device->size() - device->pos();
+        }
+
+        if(spec.parseThread()) {
+            // Only the parsing moves; the device is still read here, on the thread it belongs to
+            parseThread = QThread::create([&parser, &unparsed, &parsed]() {
+                ImportChunk chunk;
+                while(unparsed.take(&chunk)) {
+                    bool atEnd = chunk.atEnd;
+                    if(parseImportChunk(parser, &chunk) == false) {
+                        parsed.finish(parser.errorText());
+                        return;
+                    }
+                    if(parsed.put(std::move(chunk)) == false || atEnd) {
+                        break;
+                    }
+                }
+                parsed.finish();
+            });
+            parseThread->start();
+        }
+
+        QStringList columns;
+        QList<QVariantList> rows;
+        auto insertRows = [this, &spec, &progress, &timer, &stats, &columns, &rows]() {
+            QList<QVariantList> batch = rows.count() > _bulkInsertChunkSize ? rows.mid(0, _bulkInsertChunkSize) : rows;
+            rows.remove(0, batch.count());
+
+            BulkInsertStatistics inserted;
+            bool success = bulkInsertRows(spec.table(), columns, batch, &inserted);
+            stats.rowsInserted += inserted.rows;
+            stats.transactions += inserted.transactions;
+            if(success == false) {
+                throw CommonException(QString("Import into %1 failed after %2 rows: %3").arg(spec.table()).arg(stats.rowsInserted).arg(errorText()));
+            }
+
+            if(progress) {
+                stats.elapsedMs = timer.elapsed();
+                if(progress(stats) == false) {
+                    throw CommonException(QString("Import into %1 cancelled after %2 rows").arg(spec.table()).arg(stats.rowsInserted));
+                }
+            }
+        };
+
+        // Rows are buffered up to one transaction's worth
+        ImportChunk chunk;
+        bool readAtEnd = false;
+        int chunksAhead = 0;
+        bool atEnd = false;
+        while(atEnd == false) {
+            if(parseThread != nullptr) {
+                // Every chunk handed over comes back parsed, so taking one never waits on a read
+                while(readAtEnd == false && chunksAhead < ImportChunkQueue::MaxChunks) {
+                    readImportChunk(device, &chunk);
+                    readAtEnd = chunk.atEnd;
+                    if(chunk.bytes.isEmpty() == false || readAtEnd) {
+                        unparsed.put(std::move(chunk));
+                        chunksAhead++;
+                    }
+                }
+
+                atEnd = parsed.take(&chunk) == false;
+                if(atEnd) {
+                    if(parsed.error().isEmpty() == false) {
+                        throw CommonException(parsed.error());
+                    }
+                    chunk = ImportChunk();
+                }
+                else {
+                    chunksAhead--;
+                }
+            }
+            else {
+                readImportChunk(device, &chunk);
+                atEnd = chunk.atEnd;
+                if(parseImportChunk(parser, &chunk) == false) {
+                    throw CommonException(parser.errorText());
+                }
+            }
+
+            stats.bytesRead += chunk.bytesRead;
+            stats.rowsRead += chunk.rows.count();
+            if(chunk.errors.isEmpty() == false) {
+                stats.errorRows += chunk.errors.count();
+                for(int i = 0;i < chunk.errors.count() && stats.errors.count() < MaxReportedErrors;i++) {
+                    stats.errors.append(chunk.errors.at(i));
+                }
+                if(stats.errorRows > spec.maxErrorRows()) {
+                    const RecordParser::Error& error = chunk.errors.last();
+                    throw CommonException(QString("Import into %1 stopped after %2 malformed records, line %3: %4")
+                                          .arg(spec.table()).arg(stats.errorRows).arg(error.line).arg(error.message));
+                }
+            }
+
+            if(chunk.columns.isEmpty() == false) {
+                columns = chunk.columns;
+            }
+            rows.append(std::move(chunk.rows));
+            while(rows.count() >= _bulkInsertChunkSize || (atEnd && rows.isEmpty() == false)) {
+                insertRows();
+            }
+        }
+
+        result = true;
+    }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+    }
+
+    if(parseThread != nullptr) {
+        // Unblocks the parse thread if the import stopped part way through
+        unparsed.finish();
+        parsed.cancel();
+        parseThread->wait();
+        delete parseThread;
+    }
+
+    stats.elapsedMs = timer.elapsed();
+    if(result) {
+        logText(LVL_DEBUG, QString("Imported %1 rows into %2 in %3 transactions in %4ms (%5 rows/sec), skipped %6 malformed records")
+                .arg(stats.rowsInserted).arg(spec.table()).arg(stats.transactions).arg(stats.elapsedMs)
+                .arg(stats.rowsPerSecond(), 0, 'f', 0).arg(stats.errorRows));
+    }
+    if(statistics != nullptr) {
+        *statistics = stats;
+    }
+    return result;
+}
+
+bool DataSource::importFile(const QString& filename, const ImportSpec& spec, const ImportProgressCallback& progress, ImportStatistics* statistics)
+{
+    QFile file(filename);
+    if(file.open(QFile::ReadOnly) == false) {
+        QString message = QString("Failed to open import file %1: %2").arg(filename).arg(file.errorString());
+        setDataSourceError(message);
+        logText(LVL_ERROR, message);
+        if(statistics != nullptr) {
+            *statistics = ImportStatistics();
+        }
+        return false;
+    }
+    return importData(&file, spec, progress, statistics);
+}
+
+bool DataSource::exportData(QIODevice* device, const QString& sql, const QVariantList& bindings, const RecordFormat& format,
+                            RecordWriter::Compression compression, const ExportProgressCallback& progress, ExportStatistics* statistics)
+{
+    bool result = false;
+    ExportStatistics stats;
+    QElapsedTimer timer;
+    timer.start();
+
+    RecordWriter writer(device, format, compression, _exportFlushSize);
+    auto updateStatistics = [&stats, &writer, &timer]() {
+        stats.rows = writer.rowCount();
+        stats.bytesEncoded = writer.bytesEncoded();
+        stats.bytesWritten = writer.bytesWritten();
+        stats.elapsedMs = timer.elapsed();
+    };
+
+    try
+    {
+        if(writer.errorText().isEmpty() == false) {
+            throw CommonException(writer.errorText());
+        }
+
+        bool success;
+        QSqlQuery query = executeForwardOnly(sql, bindings, &success);
+        if(success == false) {
+            throw CommonException(QString("Export query failed: %1").arg(errorText()));
+        }
+
+        QSqlRecord record = query.record();
+        QStringList columns;
+        for(int i = 0;i < record.count();i++) {
+            columns.append(record.fieldName(i));
+        }
+        if(writer.begin(columns) == false) {
+            throw CommonException(writer.errorText());
+        }
+
+        qint64 written = writer.bytesWritten();
+        while(query.next()) {
+            if(writer.writeRow(query) == false) {
+                throw CommonException(writer.errorText());
+            }
+            if(progress && writer.bytesWritten() != written) {
+                written = writer.bytesWritten();
+                updateStatistics();
+                if(progress(stats) == false) {
+                    throw CommonException(QString("Export cancelled after %1 rows").arg(writer.rowCount()));
+                }
+            }
+        }
+        if(query.lastError().type() != QSqlError::NoError) {
+            recordQueryError(query);
+            throw CommonException(QString("Export failed reading row %1: %2").arg(writer.rowCount() + 1).arg(query.lastError().text()));
+        }
+        recordRowsFetched(query, writer.rowCount());
+        query.finish();
+
+        if(writer.finish() == false) {
+            throw CommonException(writer.errorText());
+        }
+        result = true;
+    }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+    }
+
+    updateStatistics();
+    if(result) {
+        logText(LVL_DEBUG, QString("Exported %1 rows (%2 bytes, %3 written) in %4ms (%5 rows/sec)")
+                .arg(stats.rows).arg(stats.bytesEncoded).arg(stats.bytesWritten).arg(stats.elapsedMs).arg(stats.rowsPerSecond(), 0, 'f', 0));
+    }
+    if(statistics != nullptr) {
+        *statistics = stats;
+    }
+    return result;
+}
+
+bool DataSource::exportFile(const QString& filename, const QString& sql, const QVariantList& bindings, const RecordFormat& format,
+                            RecordWriter::Compression compression, const ExportProgressCallback& progress, ExportStatistics* statistics)
+{
+    // The writer already writes in large blocks, so QFile's own buffer would only add a copy
+    QFile file(filename);
+    if(file.open(QFile::WriteOnly | QFile::Truncate | QFile::Unbuffered) == false) {
+        QString message = QString("Failed to open export file %1: %2").arg(filename).arg(file.errorString());
+        setDataSourceError(message);
+        logText(LVL_ERROR, message);
+        if(statistics != nullptr) {
+            *statistics = ExportStatistics();
+        }
+        return false;
+    }
+    return exportData(&file, sql, bindings, format, compression, progress, statistics);
+}
+
+bool DataSource::executeScript(QIODevice* device, const ScriptProgressCallback& progress, ScriptStatistics* statistics)
+{
+    static const qint64 ReadSize = 64 * 1024;
+    static const int SequentialReadTimeoutMs = 30000;
+
+    bool result = false;
+    ScriptStatistics stats;
+    QElapsedTimer timer;
+    timer.start();
+
+    std::unique_ptr<Transaction> batch;
+    QVariant foreignKeys;
+    int batchStatements = 0;
+    auto commitBatch = [this, &batch, &batchStatements, &stats]() {
+        if(batch != nullptr) {
+            bool committed = batch->commit();
+            batch.reset();
+            if(committed == false) {
+                throw CommonException(QString("Failed to commit script transaction: %1").arg(errorText()));
+            }
+            stats.transactions++;
+            batchStatements = 0;
+        }
+    };
+
+    try
+    {
+        if(device == nullptr || device->isReadable() == false) {
+            throw CommonException("Script device is not open for reading");
+        }
+
+        if(checkExecutingThread() == false) {
+            throw CommonException("Script executed from wrong thread");
+        }
+
+        // Dumps turn foreign keys off to load tables in any order; the connection's setting is put back afterwards
+        if(isSqlite()) {
+            foreignKeys = readPragma("foreign_keys");
+        }
+
+        if(device->isSequential() == false) {
+            stats.bytesTotal = device->size() - device->pos();
+        }
+
+        // Only the statement in progress and one chunk are held in memory
+        QStringDecoder decoder(QStringDecoder::Utf8);
+        SqlScanner scanner;
+        SqlScanner::Statement statement;
+        QString buffer;
+        bool batching = true;
+        bool atEnd = false;
+        while(atEnd == false) {
+            QByteArray bytes = device->read(ReadSize);
+            if(bytes.isEmpty()) {
+                bool timedOut;
+                atEnd = deviceAtEnd(device, SequentialReadTimeoutMs, &timedOut);
+                if(timedOut) {
+                    throw CommonException(QString("No script data received for %1 ms").arg(SequentialReadTimeoutMs));
+                }
+                if(atEnd == false) {
+                    continue;
+                }
+
+                // The decoder holds back a sequence cut off by the end of the script until another byte follows it
+                QString tail = decoder.decode(QByteArrayView("\n"));
+                Q_UNUSED(tail);
+                if(decoder.hasError()) {
+                    throw CommonException(QString("Script ends inside a UTF-8 sequence (byte %1)").arg(stats.bytesRead));
+                }
+            }
+            else {
+                stats.bytesRead += bytes.size();
+                QString text = decoder.decode(bytes);
+                buffer.append(text);
+                if(decoder.hasError()) {
+                    throw CommonException(QString("Script is not valid UTF-8 (before byte %1)").arg(stats.bytesRead));
+                }
+            }
+
+            while(scanner.next(buffer, atEnd, &statement)) {
+                if(atEnd && scanner.isComplete() == false) {
+                    throw CommonException("Script ends inside an unterminated quote, comment or trigger body");
+                }
+
+                QString sql = statement.text(buffer);
+                if(batching && requiresAutocommit(sql)) {
+                    // The script manages its own transactions from here on
+                    commitBatch();
+                    batching = false;
+                }
+
+                if(batching && batch == nullptr) {
+                    batch = std::make_unique<Transaction>(this);
+                    if(batch->isActive() == false) {
+                        throw CommonException(QString("Failed to begin script transaction: %1").arg(errorText()));
+                    }
+                }
+
+                if(executeScriptStatement(sql) == false) {
+                    throw CommonException(QString("Script statement %1 failed").arg(stats.statements + 1));
+                }
+                stats.statements++;
+
+                if(batch != nullptr && ++batchStatements >= _scriptBatchSize) {
+                    commitBatch();
+                }
+            }
+
+            qsizetype consumed = scanner.consumed();
+            buffer.remove(0, consumed);
+            scanner.discard(consumed);
+
+            if(progress) {
+                stats.elapsedMs = timer.elapsed();
+                if(progress(stats) == false) {
+                    throw CommonException(QString("Script cancelled after %1 statements").arg(stats.statements));
+                }
+            }
+        }
+
+        commitBatch();
+        result = true;
+    }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+    }
+
+    // Rolls back the open batch on failure
+    batch.reset();
+    if(foreignKeys.isValid() && readPragma("foreign_keys") != foreignKeys) {
+        setSqliteForeignKeyChecking(foreignKeys.toBool());
+    }
+
+    stats.elapsedMs = timer.elapsed();
+    if(result) {
+        logText(LVL_DEBUG, QString("Executed %1 script statements (%2 bytes) in %3 transactions in %4ms")
+                .arg(stats.statements).arg(stats.bytesRead).arg(stats.transactions).arg(stats.elapsedMs));
+    }
+    if(statistics != nullptr) {
+        *statistics = stats;
+    }
+    return result;
+}
+
+bool DataSource::executeScriptFile(const QString& filename, const ScriptProgressCallback& progress, ScriptStatistics* statistics)
+{
+    QFile file(filename);
+    if(file.open(QFile::ReadOnly) == false) {
+        QString message = QString("Failed to open script %1: %2").arg(filename).arg(file.errorString());
+        setDataSourceError(message);
+        logText(LVL_ERROR, message);
+        if(statistics != nullptr) {
+            *statistics = ScriptStatistics();
+        }
+        return false;
+    }
+    return executeScript(&file, progress, statistics);
+}
+
+bool DataSource::applyMigrations()
+{
+    if(_migrations.isEmpty()) {
+        return true;
+    }
+
+    bool result = false;
+    try
+    {
+        bool success;
+        int current = schemaVersion(&success);
+        if(success == false) {
+            throw CommonException(QString("Failed to read schema version: %1").arg(errorText()));
+        }
+
+        int latest = _migrations.latestVersion();
+        if(current > latest) {
+            logText(LVL_WARNING, QString("Schema version %1 is newer than the latest migration (%2)").arg(current).arg(latest));
+        }
+
+        QList<SchemaMigrations::Migration> pending = _migrations.pending(current);
+        if(pending.isEmpty() == false) {
+            executeQuery(QString("CREATE TABLE IF NOT EXISTS %1 (version INTEGER PRIMARY KEY, description VARCHAR(255), "
+                                 "checksum VARCHAR(64), applied_at VARCHAR(32), elapsed_ms BIGINT)").arg(SchemaMigrations::HistoryTable), &success);
+            if(success == false) {
+                throw CommonException(QString("Failed to create migration history table: %1").arg(errorText()));
+            }
+
+            for(const SchemaMigrations::Migration& migration : pending) {
+                if(applyMigration(migration) == false) {
+                    throw CommonException(QString("Migration to schema version %1 (%2) failed").arg(migration.version).arg(migration.description));
+                }
+            }
+        }
+        result = true;
+    }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+    }
+    return result;
+}
+
+int DataSource::schemaVersion(bool* success)
+{
+    bool result = false;
+    int version = 0;
+    if(checkExecutingThread() == true) {
+        if(isSqlite()) {
+            QVariant value = readPragma("user_version");
+            result = value.isValid();
+            version = value.toInt();
+        }
+        else {
+            QSqlQuery query(_db);
+            if(query.exec(QString("SELECT MAX(version) FROM %1").arg(SchemaMigrations::HistoryTable)) && query.next()) {
+                version = query.value(0).toInt();
+                result = true;
+            }
+            else if(_db.tables().contains(SchemaMigrations::HistoryTable, Qt::CaseInsensitive) == false) {
+                // Never migrated
+                result = true;
+            }
+            else {
+                recordQueryError(query);
+                logFailure(query);
+            }
+        }
+    }
+
+    if(success != nullptr) {
+        *success = result;
+    }
+    return version;
+}
+
+QList<SchemaMigrations::AppliedMigration> DataSource::migrationHistory(bool* success)
+{
+    QList<SchemaMigrations::AppliedMigration> result;
+    bool querySuccess = checkExecutingThread();
+    if(querySuccess && _db.tables().contains(SchemaMigrations::HistoryTable, Qt::CaseInsensitive)) {
+        QSqlQuery query = executeQuery(QString("SELECT version, description, checksum, applied_at, elapsed_ms FROM %1 ORDER BY version")
+                                       .arg(SchemaMigrations::HistoryTable), &querySuccess);
+        while(querySuccess && query.next()) {
+            SchemaMigrations::AppliedMigration migration;
+            migration.version = query.value(0).toInt();
+            migration.description = query.value(1).toString();
+            migration.checksum = query.value(2).toString();
+            migration.appliedAt = QDateTime::fromString(query.value(3).toString(), Qt::ISODateWithMs);
+            migration.elapsedMs = query.value(4).toLongLong();
+            result.append(migration);
+        }
+    }
+
+    if(success != nullptr) {
+        *success = querySuccess;
+    }
+    return result;
+}
+
+QList<int> DataSource::changedMigrations()
+{
+    QList<int> result;
+    for(const SchemaMigrations::AppliedMigration& applied : migrationHistory()) {
+        const SchemaMigrations::Migration* migration = _migrations.find(applied.version);
+        if(migration != nullptr && migration->checksum != applied.checksum) {
+            logText(LVL_WARNING, QString("Migration %1 (%2) has changed since it was applied").arg(applied.version).arg(migration->description));
+            result.append(applied.version);
+        }
+    }
+    return result;
+}
+
+bool DataSource::integrityCheck()
+{
+    if(_integrityCheckLevel == DatabaseValidator::NoValidation || isSqlite() == false) {
+        return true;
+    }
+
+    DatabaseValidator::Result result = DatabaseValidator::check(_db, _integrityCheckLevel);
+    for(const QString& error : std::as_const(result.errors)) {
+        logText(LVL_ERROR, QString("Integrity check: %1").arg(error));
+    }
+    if(result.valid == false) {
+        setDataSourceError(QString("Integrity check found %1 problem(s)").arg(result.errors.count()));
+    }
+    else {
+        logText(LVL_DEBUG, QString("Integrity check passed in %1ms").arg(result.elapsedMs));
+    }
+    return result.valid;
+}
+
+QSqlQuery DataSource::executeForwardOnly(const QString& sql, const QVariantList& bindings, bool* success)
+{
+    bool result;
+    QSqlQuery query = prepareQuery(sql, &result);
+    if(result) {
+        // Must precede exec(), which is where the driver decides whether to cache rows
+        query.setForwardOnly(true);
+        for(const QVariant& value : bindings) {
+            query.addBindValue(value);
+        }
+        result = executeQuery(query);
+    }
+
+    if(success != nullptr) {
+        *success = result;
+    }
+    return query;
+}
+
+ColumnarResult DataSource::fetchColumns(const QString& sql, const QVariantList& bindings, const QList<ColumnarResult::Type>& types, bool* success)
+{
+    bool result = false;
+    ColumnarResult columns;
+
+    try
+    {
+        bool querySuccess;
+        QSqlQuery query = executeForwardOnly(sql, bindings, &querySuccess);
+        if(querySuccess == false) {
+            throw CommonException(QString("Columnar query failed: %1").arg(errorText()));
+        }
+
+        QSqlRecord record = query.record();
+        for(int i = 0;i < record.count();i++) {
+            ColumnarResult::Type type = i < types.count() ? types.at(i) : ColumnarResult::Auto;
+            if(type == ColumnarResult::Auto) {
+                type = ColumnarResult::typeFor(record.field(i).metaType());
+            }
+            columns.addColumn(record.fieldName(i), type);
+        }
+
+        int columnCount = columns.columnCount();
+        bool decoded = false;
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+        sqlite3_stmt* stmt = sqliteStatement(query);
+        if(stmt != nullptr) {
+            // exec() has already stepped to the first row, if there is one
+            int rc = sqlite3_data_count(stmt) > 0 ? SQLITE_ROW : SQLITE_DONE;
+            while(rc == SQLITE_ROW) {
+                for(int i = 0;i < columnCount;i++) {
+                    ColumnarResult::Column& column = columns.column(i);
+                    if(sqlite3_column_type(stmt, i) == SQLITE_NULL) {
+                        column.appendNull();
+                        continue;
+                    }
+                    switch(column.type()) {
+                    case ColumnarResult::Integer:
+                        column.appendInteger(sqlite3_column_int64(stmt, i));
+                        break;
+                    case ColumnarResult::Real:
+                        column.appendReal(sqlite3_column_double(stmt, i));
+                        break;
+                    case ColumnarResult::Blob:
+                    {
+                        const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, i));
+                        column.appendBytes(data, sqlite3_column_bytes(stmt, i));
+                        break;
+                    }
+                    default:
+                    {
+                        const char* data = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+                        column.appendBytes(data, sqlite3_column_bytes(stmt, i));
+                        break;
+                    }
+                    }
+                }
+                rc = sqlite3_step(stmt);
+            }
+            if(rc != SQLITE_DONE) {
+                throw CommonException(QString("Columnar fetch failed reading row %1: %2")
+                                      .arg(columns.rowCount() + 1).arg(QString::fromUtf8(sqlite3_errmsg(sqlite3_db_handle(stmt)))));
+            }
+            columns.setNative(true);
+            decoded = true;
+        }
+#endif
+        if(decoded == false) {
+            while(query.next()) {
+                for(int i = 0;i < columnCount;i++) {
+                    columns.column(i).appendValue(query.value(i));
+                }
+            }
+            if(query.lastError().type() != QSqlError::NoError) {
+                recordQueryError(query);
+                throw CommonException(QString("Columnar fetch failed reading row %1: %2").arg(columns.rowCount() + 1).arg(query.lastError().text()));
+            }
+        }
+        recordRowsFetched(query, columns.rowCount());
+        query.finish();
+        result = true;
+    }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+        columns = ColumnarResult();
+    }
+
+    if(success != nullptr) {
+        *success = result;
+    }
+    return columns;
+}
+
+SqliteStatement DataSource::prepareSqlite(const QString& sql, bool* success)
+{
+    SqliteStatement statement;
+
+    try
+    {
+        if(isSqlite() == false || _db.isOpen() == false) {
+            throw CommonException("Native statements require an open SQLite database");
+        }
+
+        if(checkExecutingThread() == false) {
+            throw CommonException("Native statement prepared from wrong thread");
+        }
+
+        releaseUnsharedSqliteStatements();
+
+        // A cached statement another SqliteStatement still holds would share its bindings and
+        // rows with this caller, so this caller gets a statement of its own instead
+        std::shared_ptr<SqliteStatement::Handle> handle = _sqliteStatements.value(sql);
+        bool inUse = handle != nullptr && handle.use_count() > 2;
+        if(handle != nullptr && inUse == false) {
+            statement = SqliteStatement(this, handle);
+            statement.reset();
+        }
+        else {
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+            sqlite3* db = sqliteHandle(_db);
+            if(db == nullptr) {
+                throw CommonException("No native SQLite handle for the connection");
+            }
+
+            QElapsedTimer timer;
+            if(_metrics.isEnabled()) {
+                timer.start();
+            }
+            QString error;
+            handle = SqliteStatement::prepare(db, sql, &error);
+            if(_metrics.isEnabled()) {
+                _metrics.recordPrepare(sql, timer.nsecsElapsed() / 1000, handle != nullptr);
+            }
+            if(handle == nullptr) {
+                recordNativeError(sql, sqlite3_errcode(db), error);
+                throw CommonException(QString("Failed to prepare native statement: %1").arg(error));
+            }
+            if(inUse) {
+                _unsharedSqliteStatements.append(handle);
+            }
+            else {
+                _sqliteStatements.insert(sql, handle);
+            }
+            statement = SqliteStatement(this, handle);
+#else
+            throw CommonException("Native SQLite statements require KANOOP_DATABASE_NATIVE_SQLITE");
+#endif
+        }
+    }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+    }
+
+    if(success != nullptr) {
+        *success = statement.isValid();
+    }
+    return statement;
+}
+
+void DataSource::logSql(const char* file, int line, Log::LogLevel level, const QString& sql)
+{
+    logText(file, line, level, QString("\n%1").arg(sql));
+}
+
+void DataSource::logFailure(const QSqlQuery& query) const
+{
+    logText(LVL_ERROR, QString("QUERY FAILED: %1\nSQL Follows:\n%2")
+            .arg(errorText()).arg(query.lastQuery()));
+}
+
+bool DataSource::recreateSqliteDatabase()
+{
+    // Everything tied to the old file goes with it, as in closeConnection()
+    closeReadConnections();
+    _statementCache.clear();
+    finalizeSqliteStatements();
+    _resultCache.clear();
+    _transactionWrites.clear();
+    _hookedTables.clear();
+    _viewTablesLoaded = false;
+    _inListTables.clear();
+    _transactionDepth = 0;
+    if(_db.isOpen()) {
+        _db.close();
+    }
+
+    try
+    {
+        createSqliteDatabase();
+    }
+    catch(const CommonException& e)
+    {
+        logText(LVL_ERROR, QString("Database recreation failed: %1").arg(e.message()));
+        return false;
+    }
+    return true;
+}
+
+QDateTime DataSource::utcTime(const QVariant& value)
+{
+    QDateTime timestamp = value.toDateTime();
+    timestamp.setTimeZone(QTimeZone::utc());
     return timestamp;
 }
 
-QString DataSource::currentTimestamp()
+QString DataSource::currentTimestamp()
+{
+    return DateTimeUtil::currentToStandardString();
+}
+
+QString DataSource::commaDelimitedIntList(const QList<int>& list)
+{
+    SqlBuilder builder(list.count() * 8);
+    builder.appendNumberList(list);
+    return builder.take();
+}
+
+QString DataSource::commaDelimitedUuidList(const QList<QUuid>& list)
+{
+    SqlBuilder builder(list.count() * 39);
+    builder.appendUuidList(list);
+    return builder.take();
+}
+
+QString DataSource::commaDelimitedStringList(const QStringList& list)
+{
+    SqlBuilder builder;
+    builder.appendStringList(list);
+    return builder.take();
+}
+
+QString DataSource::escapedString(const QString& unescaped)
+{
+    return SqlBuilder::escaped(unescaped);
+}
+
+bool DataSource::checkExecutingThread() const
+{
+    bool result = (int64_t)QThread::currentThreadId() == _threadId;
+    if(result == false) {
+        logText(LVL_ERROR, QString(
+                    "ERROR: Executing thread for database connection %1 is not the thread used to open the connection. "
+                    "QSqlDatabase is not thread-safe.")
+                .arg(_connectionName));
+    }
+    return result;
+}
+
+void DataSource::recordQueryError(const QSqlQuery& query)
+{
+    recordError(query.lastError());
+}
+
+void DataSource::recordError(const QSqlError& error)
+{
+    // Read connections report errors from their own threads
+    QMutexLocker locker(&_errorMutex);
+    _driverError = error.driverText();
+    _databaseError = error.databaseText();
+    _nativeError = error.nativeErrorCode();
+}
+
+void DataSource::recordNativeError(const QString& sql, int code, const QString& message)
+{
+    recordError(QSqlError(QString(), message, QSqlError::StatementError, QString::number(code)));
+    logText(LVL_ERROR, QString("QUERY FAILED: %1\nSQL Follows:\n%2").arg(errorText()).arg(sql));
+}
+
+void DataSource::recordNativeWrite(const QString& sql)
+{
+    if(_statementCache.size() > 0 && isSchemaChange(sql)) {
+        _statementCache.invalidate();
+    }
+    if(_resultCache.isEnabled()) {
+        invalidateResults(sql);
+    }
+}
+
+void DataSource::finalizeSqliteStatements()
+{
+    // Statements must be finalized before the connection closes; any SqliteStatement still held becomes invalid
+    for(const std::shared_ptr<SqliteStatement::Handle>& handle : std::as_const(_sqliteStatements)) {
+        SqliteStatement::finalize(handle.get());
+    }
+    _sqliteStatements.clear();
+    for(const std::shared_ptr<SqliteStatement::Handle>& handle : std::as_const(_unsharedSqliteStatements)) {
+        SqliteStatement::finalize(handle.get());
+    }
+    _unsharedSqliteStatements.clear();
+}
+
+void DataSource::releaseUnsharedSqliteStatements()
+{
+    // Finalize the extra statements which no SqliteStatement refers to any more
+    for(int i = _unsharedSqliteStatements.count() - 1;i >= 0;i--) {
+        if(_unsharedSqliteStatements.at(i).use_count() == 1) {
+            SqliteStatement::finalize(_unsharedSqliteStatements.at(i).get());
+            _unsharedSqliteStatements.removeAt(i);
+        }
+    }
+}
+
+void DataSource::recordLoadFailure(const QString& sql)
+{
+    static const QString message("Failed to load row from query result");
+    setDataSourceError(message);
+    logText(LVL_ERROR, QString("%1\nSQL Follows:\n%2").arg(message).arg(sql));
+}
+
+void DataSource::recordExecution(const QSqlQuery& query, qint64 usecs, bool success, qint64 rowsAffected)
+{
+    if(_metrics.isEnabled()) {
+        qint64 rowsReturned = 0;
+        if(success && query.isSelect()) {
+            // Only known here if the driver reports result sizes; otherwise counted as rows are fetched
+            rowsReturned = query.size();
+        }
+        else if(success && rowsAffected < 0) {
+            rowsAffected = query.numRowsAffected();
+        }
+        _metrics.recordExecution(query.lastQuery(), usecs, success, rowsReturned, rowsAffected);
+    }
+
+    int threshold = _metrics.slowQueryThresholdMs();
+    if(threshold >= 0 && usecs >= threshold * 1000LL) {
+        logText(LVL_WARNING, QString("SLOW QUERY (%1 ms): %2%3")
+                .arg(usecs / 1000.0, 0, 'f', 3)
+                .arg(query.lastQuery())
+                .arg(boundValuesText(query)));
+    }
+}
+
+void DataSource::recordRowsFetched(const QSqlQuery& query, qint64 rows)
+{
+    if(_metrics.isEnabled() && query.size() < 0) {
+        _metrics.recordRowsReturned(query.lastQuery(), rows);
+    }
+}
+
+QString DataSource::boundValuesText(const QSqlQuery& query)
+{
+    static const int MaxValues = 50;
+    static const int MaxValueLength = 100;
+
+    QVariantList values = query.boundValues();
+    if(values.isEmpty()) {
+        return QString();
+    }
+
+    QStringList text;
+    for(int i = 0;i < values.count() && i < MaxValues;i++) {
+        const QVariant& value = values.at(i);
+        if(value.isNull()) {
+            text.append("NULL");
+        }
+        else if(value.typeId() == QMetaType::QVariantList) {
+            text.append(QString("[%1 values]").arg(value.toList().count()));
+        }
+        else {
+            QString string = value.toString();
+            if(string.length() > MaxValueLength) {
+                string = string.left(MaxValueLength) + "...";
+            }
+            text.append(QString("'%1'").arg(string));
+        }
+    }
+    if(values.count() > MaxValues) {
+        text.append(QString("... %1 more").arg(values.count() - MaxValues));
+    }
+    return QString("\nBound values: %1").arg(text.join(", "));
+}
+
+bool DataSource::isSchemaChange(const QString& sql)
+{
+    QStringView statement = QStringView(sql).trimmed();
+    return  statement.startsWith(QLatin1String("CREATE"), Qt::CaseInsensitive) ||
+            statement.startsWith(QLatin1String("DROP"), Qt::CaseInsensitive) ||
+            statement.startsWith(QLatin1String("ALTER"), Qt::CaseInsensitive);
+}
+
+bool DataSource::requiresAutocommit(const QStringList& statements)
+{
+    for(const QString& statement : statements) {
+        if(requiresAutocommit(statement)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DataSource::requiresAutocommit(const QString& statement)
+{
+    // Scripts which manage their own transactions, or contain statements SQLite
+    // refuses to run inside one, cannot be wrapped in a single transaction.
+    // PRAGMA foreign_keys is silently ignored inside a transaction.
+    static const QStringList prefixes = {
+        "BEGIN", "COMMIT", "END", "ROLLBACK", "SAVEPOINT", "RELEASE", "VACUUM", "ATTACH", "DETACH",
+        "PRAGMA JOURNAL_MODE", "PRAGMA FOREIGN_KEYS"
+    };
+
+    QString normalized = statement.simplified();
+    for(const QString& prefix : prefixes) {
+        if(normalized.startsWith(prefix, Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DataSource::executeScriptStatement(const QString& sql)
+{
+    // Script statements are mostly one-offs, so keep them out of the statement cache
+    QSqlQuery query(_db);
+    query.setForwardOnly(true);
+    if(query.prepare(sql) == false) {
+        recordQueryError(query);
+        logFailure(query);
+        return false;
+    }
+    return executeQuery(query);
+}
+
+int DataSource::beginTransaction()
+{
+    int depth = _transactionDepth + 1;
+    bool result;
+    if(depth == 1) {
+        if((result = checkExecutingThread()) == true) {
+            if(isSqlite() && _busyPolicy.immediateTransactions()) {
+                // Wait for the write lock here, where a retry is safe, rather than at the first write
+                result = executeTransactionControl("BEGIN IMMEDIATE", true);
+            }
+            else if((result = _db.transaction()) == false) {
+                recordError(_db.lastError());
+            }
+            if(result == false) {
+                logText(LVL_ERROR, QString("Failed to begin transaction: %1").arg(errorText()));
+            }
+        }
+    }
+    else {
+        result = executeTransactionControl(QString("SAVEPOINT kanoop_sp_%1").arg(depth));
+    }
+
+    if(result == false) {
+        return 0;
+    }
+    _transactionDepth = depth;
+    return depth;
+}
+
+bool DataSource::commitTransaction(int depth)
+{
+    if(depth != _transactionDepth) {
+        logText(LVL_ERROR, QString("Transaction at depth %1 committed while depth %2 is active").arg(depth).arg(_transactionDepth.load()));
+        unwindTransactions(depth);
+        return false;
+    }
+
+    bool result;
+    if(depth == 1) {
+        if((result = checkExecutingThread()) == true) {
+            if(isSqlite()) {
+                // A COMMIT which fails with SQLITE_BUSY leaves the transaction open, so it can be retried
+                result = executeTransactionControl("COMMIT", true);
+            }
+            else if((result = _db.commit()) == false) {
+                recordError(_db.lastError());
+            }
+            if(result == false) {
+                logText(LVL_ERROR, QString("Failed to commit transaction: %1").arg(errorText()));
+                _db.rollback();
+            }
+        }
+        invalidateTransactionWrites();
+        scheduleDeferredWrites();
+    }
+    else {
+        result = executeTransactionControl(QString("RELEASE SAVEPOINT kanoop_sp_%1").arg(depth));
+    }
+
+    _transactionDepth = depth - 1;
+    return result;
+}
+
+bool DataSource::rollbackTransaction(int depth)
+{
+    if(depth != _transactionDepth) {
+        logText(LVL_ERROR, QString("Transaction at depth %1 rolled back while depth %2 is active").arg(depth).arg(_transactionDepth.load()));
+        unwindTransactions(depth);
+        return false;
+    }
+
+    bool result;
+    if(depth == 1) {
+        if((result = checkExecutingThread()) == true && (result = _db.rollback()) == false) {
+            recordError(_db.lastError());
+            logText(LVL_ERROR, QString("Failed to roll back transaction: %1").arg(errorText()));
+        }
+        invalidateTransactionWrites();
+        scheduleDeferredWrites();
+    }
+    else {
+        // ROLLBACK TO leaves the savepoint on the stack, so release it as well
+        result = executeTransactionControl(QString("ROLLBACK TO SAVEPOINT kanoop_sp_%1").arg(depth)) &&
+                 executeTransactionControl(QString("RELEASE SAVEPOINT kanoop_sp_%1").arg(depth));
+    }
+
+    _transactionDepth = depth - 1;
+    return result;
+}
+
+void DataSource::installBusyHandler()
+{
+    _busyHandlerTimeoutMs = 0;
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+    // Waits as long as the busy_timeout it replaces, but also reports that it waited
+    sqlite3* handle = sqliteHandle(_db);
+    int timeout = readPragma("busy_timeout").toInt();
+    if(handle != nullptr && timeout > 0) {
+        _busyHandlerTimeoutMs = timeout;
+        sqlite3_busy_handler(handle, sqliteBusyHandler, this);
+    }
+#endif
+}
+
+int DataSource::sqliteBusyHandler(void* context, int count)
+{
+    // The same back-off as SQLite's own busy_timeout handler
+    static const int DelaysMs[] = { 1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100 };
+    static const int DelayCount = sizeof(DelaysMs) / sizeof(DelaysMs[0]);
+
+    DataSource* dataSource = static_cast<DataSource*>(context);
+    if(count == 0) {
+        dataSource->_busyHandlerTimer.start();
+    }
+    qint64 remainingMs = dataSource->_busyHandlerTimeoutMs - dataSource->_busyHandlerTimer.elapsed();
+    if(remainingMs <= 0) {
+        return 0;
+    }
+
+    QElapsedTimer slept;
+    slept.start();
+    QThread::msleep(qMin(qint64(DelaysMs[qMin(count, DelayCount - 1)]), remainingMs));
+    dataSource->_busyHandlerWaitUsecs += slept.nsecsElapsed() / 1000;
+    return 1;
+}
+
+void DataSource::scheduleDeferredWrites()
+{
+    if(_writeQueue.count() > 0) {
+        QMetaObject::invokeMethod(this, [this]() { flushWrites(); }, Qt::QueuedConnection);
+    }
+}
+
+void DataSource::unwindTransactions(int depth)
+{
+    // Nested transactions still open inside this one were abandoned by their owners. Roll them
+    // back along with this level, so that the depth stays in step with the database. A level
+    // which has already ended leaves nothing to do.
+    while(depth > 0 && _transactionDepth >= depth) {
+        rollbackTransaction(_transactionDepth.load());
+    }
+}
+
+bool DataSource::executeTransactionControl(const QString& sql, bool retryBusy)
+{
+    bool result;
+    if((result = checkExecutingThread()) == true) {
+        QSqlQuery query(_db);
+        if((result = (query.prepare(sql) && execRetryingBusy(query, retryBusy))) == false) {
+            recordQueryError(query);
+            logFailure(query);
+        }
+    }
+    return result;
+}
+
+bool DataSource::execRetryingBusy(QSqlQuery& query, bool retryable)
+{
+    QElapsedTimer timer;
+    bool measureHandler = false;
+    if(_metrics.isEnabled()) {
+        timer.start();
+        // Only the writer connection has the measuring busy handler
+        measureHandler = _busyHandlerTimeoutMs > 0 && isReaderQuery(query) == false;
+        _busyHandlerWaitUsecs = 0;
+    }
+
+    bool result = query.exec();
+    if(result || isSqlite() == false || BusyPolicy::isBusyError(query.lastError()) == false) {
+        // A lock which SQLite's busy handler outwaited shows only in the time the handler slept
+        if(measureHandler && _busyHandlerWaitUsecs > 0) {
+            _metrics.recordLockWait(query.lastQuery(), _busyHandlerWaitUsecs, 0, true);
+        }
+        return result;
+    }
+
+    int retries = 0;
+    int maxRetries = retryable ? _busyPolicy.maxRetries() : 0;
+    qint64 waitedUsecs = 0;
+    while(result == false && retries < maxRetries && BusyPolicy::isBusyError(query.lastError())) {
+        // Jitter keeps processes contending for the same lock from retrying in step
+        int backoff = _busyPolicy.backoffMs(retries);
+        QThread::msleep(backoff / 2 + QRandomGenerator::global()->bounded(backoff / 2 + 1));
+        retries++;
+        waitedUsecs = timer.isValid() ? timer.nsecsElapsed() / 1000 : 0;
+        result = query.exec();
+    }
+    if(result == false) {
+        waitedUsecs = timer.isValid() ? timer.nsecsElapsed() / 1000 : 0;
+        if(retries > 0) {
+            logText(LVL_WARNING, QString("Database still locked after %1 retries").arg(retries));
+        }
+    }
+
+    if(_metrics.isEnabled()) {
+        _metrics.recordLockWait(query.lastQuery(), waitedUsecs, retries, result);
+    }
+    return result;
+}
+
+bool DataSource::applyMigration(const SchemaMigrations::Migration& migration)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList statements;
+    if(migration.step == nullptr) {
+        SqlParser parser(migration.sql);
+        if(parser.isValid() == false) {
+            logText(LVL_ERROR, QString("Failed to parse migration %1 SQL\n%2").arg(migration.version).arg(migration.sql));
+            return false;
+        }
+        statements = parser.statements();
+    }
+
+    // A step run outside a transaction may turn foreign keys off to rebuild a table, so
+    // the connection's setting is put back once it is done
+    bool autocommit = requiresAutocommit(statements);
+    QVariant foreignKeys = autocommit && isSqlite() ? readPragma("foreign_keys") : QVariant();
+
+    // The step, its history record and the version update commit or roll back together
+    std::unique_ptr<Transaction> transaction;
+    if(autocommit == false) {
+        transaction = std::make_unique<Transaction>(this);
+        if(transaction->isActive() == false) {
+            return false;
+        }
+    }
+
+    bool result = migration.step != nullptr ? migration.step() : executeMultiple(statements);
+    qint64 elapsedMs = timer.elapsed();
+
+    if(result) {
+        QSqlQuery query = prepareQuery(QString("DELETE FROM %1 WHERE version = ?").arg(SchemaMigrations::HistoryTable), &result);
+        if(result) {
+            query.addBindValue(migration.version);
+            result = executeQuery(query);
+        }
+    }
+    if(result) {
+        QSqlQuery query = prepareQuery(QString("INSERT INTO %1 (version, description, checksum, applied_at, elapsed_ms) VALUES (?, ?, ?, ?, ?)")
+                                       .arg(SchemaMigrations::HistoryTable), &result);
+        if(result) {
+            query.addBindValue(migration.version);
+            query.addBindValue(migration.description);
+            query.addBindValue(migration.checksum);
+            query.addBindValue(QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs));
+            query.addBindValue(elapsedMs);
+            result = executeQuery(query);
+        }
+    }
+    if(result) {
+        result = setSchemaVersion(migration.version);
+    }
+    if(result && transaction != nullptr) {
+        result = transaction->commit();
+    }
+    if(foreignKeys.isValid() && readPragma("foreign_keys") != foreignKeys) {
+        setSqliteForeignKeyChecking(foreignKeys.toBool());
+    }
+
+    if(result) {
+        logText(LVL_DEBUG, QString("Applied migration %1 (%2) in %3ms").arg(migration.version).arg(migration.description).arg(elapsedMs));
+    }
+    return result;
+}
+
+bool DataSource::setSchemaVersion(int version)
+{
+    // Other engines take the version from the history table
+    if(isSqlite() == false) {
+        return true;
+    }
+
+    bool result;
+    executeQuery(QString("PRAGMA user_version = %1").arg(version), &result);
+    return result;
+}
+
+int DataSource::acquireInListTable(const QVariantList& values)
+{
+    // Integer keys are compared as integers on every engine; SQLite needs no column type at all
+    QString columnType;
+    if(isSqlite() == false) {
+        columnType = "BIGINT";
+        for(const QVariant& value : values) {
+            int type = value.typeId();
+            if(type != QMetaType::Int && type != QMetaType::LongLong && type != QMetaType::UInt && type != QMetaType::ULongLong) {
+                columnType = "TEXT";
+                break;
+            }
+        }
+    }
+
+    int table = -1;
+    for(int i = 0;i < _inListTables.count();i++) {
+        if(_inListTables.at(i).inUse == false && _inListTables.at(i).columnType == columnType) {
+            table = i;
+            break;
+        }
+    }
+
+    bool reused = table >= 0;
+    if(reused == false) {
+        InListTable entry;
+        entry.columnType = columnType;
+        _inListTables.append(entry);
+        table = _inListTables.count() - 1;
+    }
+
+    // A rolled back transaction may have dropped a table created inside it, so always
+    // make sure it exists. Not run through executeQuery(), which would discard the
+    // statement cache for a temporary table no cached statement can depend on.
+    QString name = inListTableName(table);
+    QString createSql = isSqlite()
+        ? QString("CREATE TEMP TABLE IF NOT EXISTS %1 (value)").arg(name)
+        : QString("CREATE TEMPORARY TABLE IF NOT EXISTS %1 (value %2)").arg(name, columnType);
+    bool result = executeTransactionControl(createSql);
+    if(result && reused) {
+        executeQuery(QString("DELETE FROM %1").arg(name), &result);
+    }
+    if(result) {
+        result = bulkInsert(name, { "value" }, { values });
+    }
+
+    if(result == false) {
+        logText(LVL_ERROR, QString("Failed to stage %1 IN list values: %2").arg(values.count()).arg(errorText()));
+        return -1;
+    }
+    _inListTables[table].inUse = true;
+    return table;
+}
+
+void DataSource::releaseInListTable(int table)
 {
-    return DateTimeUtil::currentToStandardString();
+    // Closing the connection drops its temporary tables and forgets them
+    if(table < _inListTables.count()) {
+        _inListTables[table].inUse = false;
+    }
 }
 
-QString DataSource::commaDelimitedIntList(const QList<int>& list)
+QString DataSource::multiRowInsertSql(const QString& table, const QStringList& columns, int rowCount)
 {
-    QString result;
-    QTextStream output(&result);
-    for(int i = 0;i < list.length();i++) {
-        output << list.at(i);
-        if(i < list.length() - 1) {
-            output << ',';
+    QString placeholders = QString("?,").repeated(columns.count());
+    placeholders.chop(1);
+
+    QString sql = QString("INSERT INTO %1 (%2) VALUES ").arg(table, columns.join(','));
+    sql.reserve(sql.length() + rowCount * (placeholders.length() + 3));
+    for(int i = 0;i < rowCount;i++) {
+        if(i > 0) {
+            sql.append(',');
         }
+        sql.append('(');
+        sql.append(placeholders);
+        sql.append(')');
     }
-    return result;
+    return sql;
 }
 
-QString DataSource::commaDelimitedUuidList(const QList<QUuid>& list)
+bool DataSource::executeBulkStatement(const QString& table, const QStringList& columns, const QList<QVariantList>& columnValues,
+                                      qsizetype firstRow, int rowsPerStatement, int executions, BulkInsertStatistics& statistics)
 {
-    QString result;
-    QTextStream output(&result);
-    for(int i = 0;i < list.length();i++) {
-        output << '\''
-               << list.at(i).toString(QUuid::WithoutBraces)
-               << '\'';
-        if(i < list.length() - 1) {
-            output << ',';
+    bool result;
+    QSqlQuery query = prepareQuery(multiRowInsertSql(table, columns, rowsPerStatement), &result);
+    if(result == false) {
+        return false;
+    }
+
+    // execBatch() binds one list per placeholder; execution N of a statement
+    // holding R rows takes row (firstRow + N * R + r) for placeholder row r.
+    int columnCount = columns.count();
+    for(int row = 0;row < rowsPerStatement;row++) {
+        for(int column = 0;column < columnCount;column++) {
+            const QVariantList& source = columnValues.at(column);
+            QVariantList values;
+            values.reserve(executions);
+            for(int execution = 0;execution < executions;execution++) {
+                values.append(source.at(firstRow + (qsizetype)execution * rowsPerStatement + row));
+            }
+            query.addBindValue(values);
         }
     }
+
+    QElapsedTimer timer;
+    bool timed = _metrics.isEnabled() || _metrics.slowQueryThresholdMs() >= 0;
+    if(timed) {
+        timer.start();
+    }
+    result = query.execBatch();
+    if(timed) {
+        recordExecution(query, timer.nsecsElapsed() / 1000, result, result ? (qint64)executions * rowsPerStatement : 0);
+    }
+    if(_resultCache.isEnabled()) {
+        // Earlier executions in the batch may have inserted rows even if a later one failed
+        invalidateResults(query.lastQuery());
+    }
+
+    if(result == false) {
+        recordQueryError(query);
+        logFailure(query);
+    }
+    else {
+        statistics.statements += executions;
+    }
     return result;
 }
 
-QString DataSource::commaDelimitedStringList(const QStringList& list)
+void DataSource::createSqliteDatabase()
 {
-    QString result;
-    QTextStream output(&result);
-    for(int i = 0;i < list.length();i++) {
-        output << '\''
-               << escapedString(list.at(i))
-               << '\'';
-        if(i < list.length() - 1) {
-            output << ',';
+    _db.setDatabaseName(_credentials.schema());
+    if(_db.open() == false) {
+        throw CommonException("Failed to open");
+    }
+
+    // Settings such as page_size only take effect before the first table is created
+    if(applySqliteProfile(true) == false) {
+        throw CommonException("Failed to apply SQLite performance profile");
+    }
+
+    QString filename = createSqlFile();
+    if(filename.isEmpty() == false) {
+        if(executeScriptFile(filename) == false) {
+            throw CommonException(QString("Failed to execute create script %1").arg(filename));
+        }
+    }
+    else {
+        QString sql = createSql();
+        if(sql.isEmpty()) {
+            throw CommonException("No createSql() implemented for dynamic creation");
+        }
+
+        SqlParser parser(sql);
+        if(parser.isValid() == false) {
+            throw CommonException(QString("Failed to parse create SQL\n%1").arg(sql));
         }
+
+        // Run the whole creation script in one transaction (one fsync on SQLite) unless it manages its own
+        QStringList statements = parser.statements();
+        if(executeMultiple(statements, requiresAutocommit(statements) == false) == false) {
+            throw CommonException("Failed to execute one or more create queries");
+        }
+    }
+
+    if(createSchemaVersion() > 0 && setSchemaVersion(createSchemaVersion()) == false) {
+        throw CommonException("Failed to set the schema version of the new database");
+    }
+
+    if(executePostCreateScripts() == false) {
+        throw CommonException("Failed to execute post create scripts");
     }
+}
+
+bool DataSource::setSqliteForeignKeyChecking(bool value)
+{
+    QString sql = QString("PRAGMA foreign_keys = %1;").arg(value ? "ON" : "OFF");
+    bool result;
+    executeQuery(sql, &result);
     return result;
 }
 
-QString DataSource::escapedString(const QString& unescaped)
+bool DataSource::applySqliteProfile(bool newDatabase)
 {
-    QString result;
-    QTextStream output(&result);
+    // Every path which opens the connection comes through here before anything native is called
+    verifyNativeSqlite();
+
+    SqlitePerformanceProfile profile = effectiveSqliteProfile();
+    for(const QString& pragma : profile.pragmas(newDatabase)) {
+        bool result;
+        executeQuery(pragma, &result);
+        if(result == false) {
+            return false;
+        }
+    }
+
+    // The busy policy's timeout takes precedence over the profile's
+    if(_busyPolicy.busyTimeout() >= 0) {
+        bool result;
+        executeQuery(QString("PRAGMA busy_timeout = %1").arg(_busyPolicy.busyTimeout()), &result);
+        if(result == false) {
+            return false;
+        }
+    }
+    installBusyHandler();
+
+    // journal_mode reports the mode actually in effect, which may differ (e.g. WAL on :memory:)
+    if(profile.journalMode() != SqlitePerformanceProfile::JournalModeUnset) {
+        SqlitePerformanceProfile::JournalMode journalMode = SqlitePerformanceProfile::journalModeFromString(readPragma("journal_mode").toString());
+        if(journalMode != profile.journalMode()) {
+            logText(LVL_WARNING, QString("Requested journal mode %1 but %2 is in effect")
+                    .arg(SqlitePerformanceProfile::journalModeToString(profile.journalMode()))
+                    .arg(SqlitePerformanceProfile::journalModeToString(journalMode)));
+        }
+    }
+    return true;
+}
+
+QString DataSource::backupPages(const QSqlDatabase& destination, const BackupProgressCallback& progress, BackupStatistics& statistics)
+{
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+    static const int BusyTimeoutMs = 30000;
+
+    sqlite3* source = sqliteHandle(_db);
+    sqlite3* target = sqliteHandle(destination);
+    if(source == nullptr || target == nullptr) {
+        return "The SQLite driver did not provide a native handle";
+    }
+
+    sqlite3_backup* backup = sqlite3_backup_init(target, "main", source, "main");
+    if(backup == nullptr) {
+        return QString("Failed to start backup: %1").arg(sqlite3_errmsg(target));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QElapsedTimer busyTimer;
+    busyTimer.start();
+    statistics.incremental = true;
 
-    for(int i = 0;i < unescaped.length();i++) {
-        QChar thisChar = unescaped.at(i);
-        if(thisChar == '\'') {
-            output << '\'';
-            output << thisChar;
+    // Each step holds a read lock on the source only while it copies its pages
+    bool cancelled = false;
+    int rc = SQLITE_OK;
+    while(rc != SQLITE_DONE) {
+        rc = sqlite3_backup_step(backup, _backupPagesPerStep);
+        statistics.steps++;
+        statistics.pageCount = sqlite3_backup_pagecount(backup);
+        statistics.pagesCopied = statistics.pageCount - sqlite3_backup_remaining(backup);
+        if(rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+            statistics.busyRetries++;
+            if(busyTimer.elapsed() > BusyTimeoutMs) {
+                break;
+            }
         }
-        else if(thisChar.isNull()) {
-            output << '?';
+        else if(rc == SQLITE_OK) {
+            busyTimer.restart();
         }
         else {
-            output << thisChar;
+            break;
+        }
+
+        if(rc != SQLITE_DONE) {
+            statistics.elapsedMs = timer.elapsed();
+            if(reportBackupProgress(progress, statistics) == false) {
+                cancelled = true;
+                break;
+            }
+            if(_backupStepDelayMs > 0) {
+                QThread::msleep(_backupStepDelayMs);
+            }
+            else {
+                QThread::yieldCurrentThread();
+            }
+        }
+    }
+
+    int finishRc = sqlite3_backup_finish(backup);
+    if(cancelled) {
+        return QString("Backup cancelled after %1 of %2 pages").arg(statistics.pagesCopied).arg(statistics.pageCount);
+    }
+    if(rc != SQLITE_DONE) {
+        return QString("Backup failed after %1 of %2 pages: %3").arg(statistics.pagesCopied).arg(statistics.pageCount).arg(sqlite3_errstr(rc));
+    }
+    if(finishRc != SQLITE_OK) {
+        return QString("Backup failed: %1").arg(sqlite3_errstr(finishRc));
+    }
+    return QString();
+#else
+    Q_UNUSED(destination);
+    Q_UNUSED(progress);
+    Q_UNUSED(statistics);
+    return "Built without the SQLite online backup API";
+#endif
+}
+
+bool DataSource::reportBackupProgress(const BackupProgressCallback& progress, const BackupStatistics& statistics)
+{
+    emit backupProgress(statistics.pagesCopied, statistics.pageCount);
+    return !progress || progress(statistics);
+}
+
+bool DataSource::copyFromAttached(const QString& filename)
+{
+    static const QString Source = "_kdb_backup_source";
+
+    // Foreign key checks would reject dropping and reloading related tables one at a time
+    bool foreignKeys = readPragma("foreign_keys").toBool();
+    if(foreignKeys) {
+        setSqliteForeignKeyChecking(false);
+    }
+
+    if(executeTransactionControl(QString("ATTACH DATABASE '%1' AS %2").arg(SqlBuilder::escaped(filename)).arg(Source)) == false) {
+        if(foreignKeys) {
+            setSqliteForeignKeyChecking(true);
+        }
+        return false;
+    }
+
+    bool result = false;
+    try
+    {
+        // Everything is read in one transaction, so the copy is a consistent snapshot
+        Transaction transaction(this);
+        if(transaction.isActive() == false) {
+            throw CommonException("Failed to begin backup transaction");
+        }
+
+        QSqlQuery query(_db);
+        auto execute = [this, &query](const QString& sql) {
+            if(query.exec(sql) == false) {
+                recordQueryError(query);
+                logFailure(query);
+                throw CommonException("Backup statement failed");
+            }
+        };
+        auto quoted = [](QString name) { return QString("\"%1\"").arg(name.replace('"', "\"\"")); };
+
+        QStringList statements;
+        execute("SELECT type, name FROM main.sqlite_master WHERE type IN ('table', 'view') AND name NOT LIKE 'sqlite_%'");
+        while(query.next()) {
+            statements.append(QString("DROP %1 IF EXISTS main.%2").arg(query.value(0).toString().toUpper()).arg(quoted(query.value(1).toString())));
+        }
+
+        QStringList tables;
+        execute(QString("SELECT name, sql FROM %1.sqlite_master WHERE type = 'table' AND name NOT LIKE 'sqlite_%' "
+                        "AND sql NOT LIKE 'CREATE VIRTUAL%' ORDER BY rowid").arg(Source));
+        while(query.next()) {
+            tables.append(query.value(0).toString());
+            statements.append(query.value(1).toString());
+        }
+        for(const QString& statement : std::as_const(statements)) {
+            execute(statement);
+        }
+
+        for(const QString& table : std::as_const(tables)) {
+            // Generated columns cannot be inserted into
+            QStringList columns;
+            execute(QString("PRAGMA %1.table_xinfo(%2)").arg(Source).arg(quoted(table)));
+            while(query.next()) {
+                if(query.value("hidden").toInt() == 0) {
+                    columns.append(quoted(query.value("name").toString()));
+                }
+            }
+            QString columnList = columns.join(',');
+            execute(QString("INSERT INTO main.%1 (%2) SELECT %2 FROM %3.%1").arg(quoted(table)).arg(columnList).arg(Source));
+        }
+
+        execute(QString("SELECT COUNT(*) FROM %1.sqlite_master WHERE name = 'sqlite_sequence'").arg(Source));
+        if(query.next() && query.value(0).toInt() > 0) {
+            execute("DELETE FROM main.sqlite_sequence");
+            execute(QString("INSERT INTO main.sqlite_sequence SELECT * FROM %1.sqlite_sequence").arg(Source));
+        }
+
+        statements.clear();
+        execute(QString("SELECT sql FROM %1.sqlite_master WHERE type IN ('index', 'view', 'trigger') AND sql IS NOT NULL "
+                        "ORDER BY CASE type WHEN 'index' THEN 0 WHEN 'view' THEN 1 ELSE 2 END, rowid").arg(Source));
+        while(query.next()) {
+            statements.append(query.value(0).toString());
+        }
+        for(const QString& statement : std::as_const(statements)) {
+            execute(statement);
         }
+
+        execute(QString("PRAGMA %1.user_version").arg(Source));
+        int version = query.next() ? query.value(0).toInt() : 0;
+        execute(QString("PRAGMA main.user_version = %1").arg(version));
+        query.finish();
+
+        if(transaction.commit() == false) {
+            throw CommonException("Failed to commit backup transaction");
+        }
+        result = true;
+    }
+    catch(const CommonException& e)
+    {
+        setDataSourceError(e.message());
+        logText(LVL_ERROR, e.message());
+    }
+
+    executeTransactionControl(QString("DETACH DATABASE %1").arg(Source));
+    if(foreignKeys) {
+        setSqliteForeignKeyChecking(true);
     }
     return result;
 }
 
-bool DataSource::checkExecutingThread() const
+bool DataSource::executeWriteBatch(const QList<WriteQueue::Write>& batch)
 {
-    bool result = (int64_t)QThread::currentThreadId() == _threadId;
+    QList<int> rowsAffected(batch.count(), -1);
+    QList<QString> errors(batch.count());
+    QString batchError;
+
+    if(_db.isOpen() == false) {
+        batchError = "Data source is not open";
+    }
+    else if(checkExecutingThread() == false) {
+        batchError = "Writes flushed from wrong thread";
+    }
+    else {
+        Transaction transaction(this);
+        if(transaction.isActive() == false) {
+            batchError = QString("Failed to begin write batch: %1").arg(errorText());
+        }
+        else {
+            for(int i = 0;i < batch.count();i++) {
+                // A failed write rolls back to its savepoint without disturbing the rest of the batch
+                Transaction savepoint(this);
+                bool success = savepoint.isActive();
+                if(success) {
+                    QSqlQuery query = executeForwardOnly(batch.at(i).sql, batch.at(i).bindings, &success);
+                    if(success) {
+                        rowsAffected[i] = query.numRowsAffected();
+                        query.finish();
+                        success = savepoint.commit();
+                    }
+                }
+                if(success == false) {
+                    errors[i] = QString("Write failed: %1").arg(errorText());
+                }
+            }
+            if(transaction.commit() == false) {
+                batchError = QString("Failed to commit write batch: %1").arg(errorText());
+            }
+        }
+    }
+
+    // Complete the futures only now that the batch is durable
+    int failures = 0;
+    for(int i = 0;i < batch.count();i++) {
+        QPromise<int>* promise = batch.at(i).promise.get();
+        QString error = batchError.isEmpty() ? errors.at(i) : batchError;
+        if(error.isEmpty()) {
+            promise->addResult(rowsAffected.at(i));
+        }
+        else {
+            failures++;
+            promise->setException(std::make_exception_ptr(CommonException(error)));
+        }
+        promise->finish();
+    }
+
+    _writeQueue.recordBatch(batch.count(), failures);
+    if(batchError.isEmpty() == false) {
+        logText(LVL_ERROR, batchError);
+    }
+    return failures == 0;
+}
+
+QueryRouting::Route DataSource::setQueryRoute(QueryRouting::Route route)
+{
+    QThread* thread = QThread::currentThread();
+    QMutexLocker locker(&_readMutex);
+    QueryRouting::Route previous = _queryRoutes.value(thread, QueryRouting::Automatic);
+    if(route == QueryRouting::Automatic) {
+        _queryRoutes.remove(thread);
+    }
+    else {
+        _queryRoutes.insert(thread, route);
+    }
+    return previous;
+}
+
+DataSource::ReadConnection* DataSource::routeToReader(const QString& sql)
+{
+    QThread* thread = QThread::currentThread();
+    QMutexLocker locker(&_readMutex);
+    QueryRouting::Route route = _queryRoutes.value(thread, QueryRouting::Automatic);
+    if(route == QueryRouting::Automatic) {
+        // Reads inside a transaction must see its uncommitted writes
+        bool inTransaction = (int64_t)QThread::currentThreadId() == _threadId && _transactionDepth > 0;
+        route = inTransaction == false && isReadStatement(sql) ? QueryRouting::Reader : QueryRouting::Writer;
+    }
+
+    // An in-memory database is private to the writer connection
+    QString schema = _credentials.schema();
+    if(route == QueryRouting::Writer || _db.isOpen() == false || isSqlite() == false || schema.isEmpty() || schema == ":memory:") {
+        return nullptr;
+    }
+
+    std::shared_ptr<ReadConnection> reader = _readConnections.value(thread);
+    if(reader == nullptr && _readConnections.count() < _readConnectionLimit) {
+        if((reader = openReadConnection()) != nullptr) {
+            // A connection may only be closed on the thread which opened it, so this one is
+            // closed by its thread as it finishes, before another thread can reuse the slot
+            reader->finishedHook = QObject::connect(thread, &QThread::finished, thread, [this, thread]() {
+                readerThreadFinished(thread);
+            }, Qt::DirectConnection);
+            _readConnections.insert(thread, reader);
+        }
+    }
+    return reader.get();
+}
+
+std::shared_ptr<DataSource::ReadConnection> DataSource::openReadConnection()
+{
+    std::shared_ptr<ReadConnection> reader = std::make_shared<ReadConnection>();
+    reader->connectionName = QString("%1-reader-%2").arg(_connectionName).arg(++_readConnectionSerial);
+    reader->statementCache.setCapacity(_statementCache.capacity());
+
+    QString options("QSQLITE_OPEN_READONLY");
+    int busyTimeout = _busyPolicy.busyTimeout() >= 0 ? _busyPolicy.busyTimeout() : effectiveSqliteProfile().busyTimeout();
+    if(busyTimeout >= 0) {
+        options.append(QString(";QSQLITE_BUSY_TIMEOUT=%1").arg(busyTimeout));
+    }
+
+    bool result;
+    reader->db = QSqlDatabase::addDatabase(_credentials.engine(), reader->connectionName);
+    reader->db.setConnectOptions(options);
+    reader->db.setDatabaseName(_credentials.schema());
+    if((result = reader->db.open()) == false) {
+        recordError(reader->db.lastError());
+    }
+    else {
+        // READONLY guards the file; query_only also refuses writes to TEMP tables
+        QSqlQuery query(reader->db);
+        if((result = query.exec("PRAGMA query_only = ON")) == false) {
+            recordQueryError(query);
+        }
+    }
+
     if(result == false) {
-        logText(LVL_ERROR, QString(
-                    "ERROR: Executing thread for database connection %1 is not the thread used to open the connection. "
-                    "QSqlDatabase is not thread-safe.")
-                .arg(_connectionName));
+        logText(LVL_ERROR, QString("Failed to open read connection: %1").arg(errorText()));
+        reader->db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(reader->connectionName);
+        reader.reset();
     }
-    return result;
+    return reader;
 }
 
-void DataSource::recordQueryError(const QSqlQuery& query)
+bool DataSource::isReaderQuery(const QSqlQuery& query) const
 {
-    _driverError = query.lastError().driverText();
-    _databaseError = query.lastError().databaseText();
-    _nativeError = query.lastError().nativeErrorCode();
+    if(_readConnectionLimit == 0 || query.driver() == nullptr) {
+        return false;
+    }
+    QMutexLocker locker(&_readMutex);
+    std::shared_ptr<ReadConnection> reader = _readConnections.value(QThread::currentThread());
+    return reader != nullptr && reader->db.driver() == query.driver();
 }
 
-void DataSource::createSqliteDatabase()
+void DataSource::closeReadConnections()
 {
-    _db.setDatabaseName(_credentials.schema());
-    if(_db.open() == false) {
-        throw CommonException("Failed to open");
+    QHash<QThread*, std::shared_ptr<ReadConnection>> readers;
+    {
+        QMutexLocker locker(&_readMutex);
+        readers.swap(_readConnections);
     }
+    for(auto it = readers.constBegin();it != readers.constEnd();it++) {
+        std::shared_ptr<ReadConnection> reader = it.value();
+        QObject::disconnect(reader->finishedHook);
+        if(it.key() == QThread::currentThread()) {
+            closeReadConnection(reader.get());
+        }
+        else {
+            // Another thread may still be reading from it. It is no longer handed out, and is
+            // closed by that thread when it finishes, without reference to this data source.
+            QThread* thread = it.key();
+            reader->finishedHook = QObject::connect(thread, &QThread::finished, thread, [reader]() {
+                closeReadConnection(reader.get());
+            }, Qt::DirectConnection);
+        }
+    }
+}
 
-    QString sql = createSql();
-    if(sql.isEmpty()) {
-        throw CommonException("No createSql() implemented for dynamic creation");
+void DataSource::readerThreadFinished(QThread* thread)
+{
+    std::shared_ptr<ReadConnection> reader;
+    {
+        QMutexLocker locker(&_readMutex);
+        reader = _readConnections.take(thread);
+        _queryRoutes.remove(thread);
+    }
+    if(reader != nullptr) {
+        closeReadConnection(reader.get());
     }
+}
+
+void DataSource::closeReadConnection(ReadConnection* reader)
+{
+    QObject::disconnect(reader->finishedHook);
+    reader->statementCache.clear();
+    reader->db.close();
+    reader->db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(reader->connectionName);
+}
 
-    SqlParser parser(sql);
-    if(parser.isValid() == false) {
-        throw CommonException(QString("Failed to parse create SQL\n%1").arg(sql));
+bool DataSource::isReadStatement(const QString& sql)
+{
+    // The InClause staging tables are TEMP tables on the writer connection, and these functions
+    // report on the connection which ran the last write, so a reader would quietly return 0
+    static const QRegularExpression writeKeyword("\\b(INSERT|UPDATE|DELETE|REPLACE)\\b", QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression connectionFunction("\\b(last_insert_rowid|changes|total_changes)\\s*\\(", QRegularExpression::CaseInsensitiveOption);
+    QStringView statement = QStringView(sql).trimmed();
+    if(statement.contains(QLatin1String("_kdb_inlist_")) || connectionFunction.match(sql).hasMatch()) {
+        return false;
     }
+    if(statement.startsWith(QLatin1String("SELECT"), Qt::CaseInsensitive)) {
+        return true;
+    }
+    // A common table expression may precede a write
+    return statement.startsWith(QLatin1String("WITH"), Qt::CaseInsensitive) && writeKeyword.match(sql).hasMatch() == false;
+}
 
-    if(executeMultiple(parser.statements()) == false) {
-        throw CommonException("Failed to execute one or more create queries");
+void DataSource::invalidateResults(const QString& sql)
+{
+    // Rows changed by triggers and foreign key actions are only known from the update hook
+    if(_hookedTables.isEmpty() == false) {
+        for(const QByteArray& table : std::as_const(_hookedTables)) {
+            recordTableWrite(QString::fromUtf8(table));
+        }
+        _hookedTables.clear();
     }
 
-    if(executePostCreateScripts() == false) {
-        throw CommonException("Failed to execute post create scripts");
+    if(isSchemaChange(sql)) {
+        _resultCache.invalidate();
+        QMutexLocker locker(&_viewMutex);
+        _viewTablesLoaded = false;
+    }
+    else {
+        QString table = ResultCache::tableWritten(sql);
+        if(table.isEmpty() == false) {
+            recordTableWrite(table);
+        }
     }
 }
 
-bool DataSource::setSqliteForeignKeyChecking(bool value)
+void DataSource::recordTableWrite(const QString& table)
 {
-    QString sql = QString("PRAGMA foreign_keys = %1;").arg(value ? "ON" : "OFF");
-    bool result;
-    executeQuery(sql, &result);
-    return result;
+    _resultCache.invalidateTable(table);
+    if(_transactionDepth > 0) {
+        _transactionWrites.insert(table.toLower());
+    }
 }
 
-template<typename T>
-QString DataSource::commaDelimitedList(const QList<T>& list)
+void DataSource::invalidateTransactionWrites()
 {
-    QString result;
-    QTextStream output(&result);
-    for(int i = 0;i < list.length();i++) {
-        output << list.at(i);
-        if(i < list.length() - 1) {
-            output << ',';
+    // Readers on other connections still saw the old rows until the transaction
+    // ended, and may have cached them after the writes were first invalidated
+    for(const QString& table : std::as_const(_transactionWrites)) {
+        _resultCache.invalidateTable(table);
+    }
+    _transactionWrites.clear();
+}
+
+QStringList DataSource::resultDependencies(const QString& sql)
+{
+    QStringList tables = ResultCache::tablesRead(sql);
+    if(isSqlite() == false) {
+        return tables;
+    }
+
+    QMutexLocker locker(&_viewMutex);
+    if(_viewTablesLoaded == false) {
+        bool success;
+        _viewTables.clear();
+        QSqlQuery query = executeForwardOnly("SELECT name, sql FROM sqlite_master WHERE type = 'view'", QVariantList(), &success);
+        while(success && query.next()) {
+            _viewTables.insert(query.value(0).toString().toLower(), ResultCache::tablesRead(query.value(1).toString()));
+        }
+        query.finish();
+        _viewTablesLoaded = success;
+    }
+
+    // A view depends on the tables behind it, which may themselves be views
+    for(int i = 0;i < tables.count();i++) {
+        const QStringList viewTables = _viewTables.value(tables.at(i));
+        for(const QString& table : viewTables) {
+            if(tables.contains(table) == false) {
+                tables.append(table);
+            }
         }
     }
+    return tables;
+}
+
+void DataSource::installUpdateHook()
+{
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+    sqlite3* handle = sqliteHandle(_db);
+    if(handle != nullptr) {
+        sqlite3_update_hook(handle, recordUpdatedTable, &_hookedTables);
+    }
+#endif
+}
+
+QVariant DataSource::readPragma(const QString& name)
+{
+    QVariant result;
+    QSqlQuery query(_db);
+    if(query.exec(QString("PRAGMA %1;").arg(name)) && query.next()) {
+        result = query.value(0);
+    }
     return result;
 }
 
+template<typename T>
+QString DataSource::commaDelimitedList(const QList<T>& list)
+{
+    SqlBuilder builder(list.count() * 8);
+    builder.appendNumberList(list);
+    return builder.take();
+}
+
 // Instantiations to allow in-source templates
 template QString DataSource::commaDelimitedList(const QList<uint8_t>&);
 template QString DataSource::commaDelimitedList(const QList<int>&);
@@ -0,0 +1,304 @@
+#include "datasourcemetrics.h"
+
+#include <QRegularExpression>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+
+const QString DataSourceMetrics::OtherStatement = QStringLiteral("(other)");
+
+const std::array<qint64, DataSourceMetrics::Histogram::BoundCount>& DataSourceMetrics::Histogram::bounds()
+{
+    static const std::array<qint64, BoundCount> result = {
+        50, 100, 250, 500,
+        1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+        1000000, 2500000, 5000000, 10000000
+    };
+    return result;
+}
+
+void DataSourceMetrics::Histogram::record(qint64 usecs)
+{
+    const std::array<qint64, BoundCount>& upper = bounds();
+    int bucket = std::lower_bound(upper.begin(), upper.end(), usecs) - upper.begin();
+    _buckets[bucket]++;
+    _count++;
+    _sumUsecs += usecs;
+    _maxUsecs = qMax(_maxUsecs, usecs);
+}
+
+void DataSourceMetrics::Histogram::merge(const Histogram& other)
+{
+    for(int i = 0;i <= BoundCount;i++) {
+        _buckets[i] += other._buckets[i];
+    }
+    _count += other._count;
+    _sumUsecs += other._sumUsecs;
+    _maxUsecs = qMax(_maxUsecs, other._maxUsecs);
+}
+
+double DataSourceMetrics::Histogram::percentile(double fraction) const
+{
+    if(_count == 0) {
+        return 0;
+    }
+
+    double rank = qMax(1.0, fraction * _count);
+    qint64 cumulative = 0;
+    for(int i = 0;i <= BoundCount;i++) {
+        qint64 inBucket = _buckets[i];
+        if(inBucket > 0 && cumulative + inBucket >= rank) {
+            // Assume samples are spread evenly across the bucket, which never extends past the maximum seen
+            double upper = qMin<double>(i < BoundCount ? bounds()[i] : _maxUsecs, _maxUsecs);
+            double lower = qMin<double>(i > 0 ? bounds()[i - 1] : 0, upper);
+            return lower + (upper - lower) * ((rank - cumulative) / inBucket);
+        }
+        cumulative += inBucket;
+    }
+    return _maxUsecs;
+}
+
+void DataSourceMetrics::recordPrepare(const QString& sql, qint64 usecs, bool success)
+{
+    QMutexLocker locker(&_mutex);
+    StatementStatistics& statistics = entry(sql);
+    statistics.prepares++;
+    statistics.prepareUsecs += usecs;
+    if(success == false) {
+        statistics.failures++;
+    }
+}
+
+void DataSourceMetrics::recordExecution(const QString& sql, qint64 usecs, bool success, qint64 rowsReturned, qint64 rowsAffected)
+{
+    QMutexLocker locker(&_mutex);
+    StatementStatistics& statistics = entry(sql);
+    statistics.executions++;
+    if(success == false) {
+        statistics.failures++;
+    }
+    statistics.rowsReturned += qMax(rowsReturned, qint64(0));
+    statistics.rowsAffected += qMax(rowsAffected, qint64(0));
+    statistics.latency.record(usecs);
+}
+
+void DataSourceMetrics::recordLockWait(const QString& sql, qint64 usecs, int retries, bool success)
+{
+    QMutexLocker locker(&_mutex);
+    StatementStatistics& statistics = entry(sql);
+    statistics.lockWaits++;
+    statistics.lockRetries += retries;
+    statistics.lockWaitUsecs += usecs;
+    if(success == false) {
+        statistics.lockTimeouts++;
+    }
+}
+
+void DataSourceMetrics::recordRowsReturned(const QString& sql, qint64 rows)
+{
+    QMutexLocker locker(&_mutex);
+    entry(sql).rowsReturned += rows;
+}
+
+QList<DataSourceMetrics::StatementStatistics> DataSourceMetrics::snapshot() const
+{
+    QList<StatementStatistics> result;
+    {
+        QMutexLocker locker(&_mutex);
+        result = _statements.values();
+    }
+    std::sort(result.begin(), result.end(), [](const StatementStatistics& a, const StatementStatistics& b) {
+        return a.latency.sumUsecs() > b.latency.sumUsecs();
+    });
+    return result;
+}
+
+DataSourceMetrics::StatementStatistics DataSourceMetrics::totals() const
+{
+    StatementStatistics result;
+    QMutexLocker locker(&_mutex);
+    for(const StatementStatistics& statistics : _statements) {
+        result.executions += statistics.executions;
+        result.failures += statistics.failures;
+        result.rowsReturned += statistics.rowsReturned;
+        result.rowsAffected += statistics.rowsAffected;
+        result.prepares += statistics.prepares;
+        result.prepareUsecs += statistics.prepareUsecs;
+        result.lockWaits += statistics.lockWaits;
+        result.lockRetries += statistics.lockRetries;
+        result.lockTimeouts += statistics.lockTimeouts;
+        result.lockWaitUsecs += statistics.lockWaitUsecs;
+        result.latency.merge(statistics.latency);
+    }
+    return result;
+}
+
+void DataSourceMetrics::reset()
+{
+    QMutexLocker locker(&_mutex);
+    _statements.clear();
+    _normalized.clear();
+}
+
+QString DataSourceMetrics::toPrometheus(const QString& prefix, const QMap<QString, QString>& labels) const
+{
+    auto escape = [](const QString& value) {
+        QString result = value;
+        result.replace('\\', QLatin1String("\\\\"));
+        result.replace('"', QLatin1String("\\\""));
+        result.replace('\n', QLatin1String("\\n"));
+        return result;
+    };
+
+    QString commonLabels;
+    for(auto it = labels.constBegin();it != labels.constEnd();++it) {
+        commonLabels += QString("%1=\"%2\",").arg(it.key(), escape(it.value()));
+    }
+
+    QList<StatementStatistics> statements = snapshot();
+    QString result;
+    QTextStream output(&result);
+
+    auto family = [&](const QString& name, const char* type, const char* help, const std::function<QString(const StatementStatistics&)>& sampleValue) {
+        output << "# HELP " << prefix << name << ' ' << help << '\n';
+        output << "# TYPE " << prefix << name << ' ' << type << '\n';
+        for(const StatementStatistics& statistics : std::as_const(statements)) {
+            output << prefix << name << '{' << commonLabels << "statement=\"" << escape(statistics.statement) << "\"} "
+                   << sampleValue(statistics) << '\n';
+        }
+    };
+
+    family("_statement_executions_total", "counter", "Statement executions.",
+           [](const StatementStatistics& s) { return QString::number(s.executions); });
+    family("_statement_failures_total", "counter", "Failed statement executions.",
+           [](const StatementStatistics& s) { return QString::number(s.failures); });
+    family("_statement_rows_returned_total", "counter", "Rows returned by statements, where known.",
+           [](const StatementStatistics& s) { return QString::number(s.rowsReturned); });
+    family("_statement_rows_affected_total", "counter", "Rows inserted, updated or deleted by statements.",
+           [](const StatementStatistics& s) { return QString::number(s.rowsAffected); });
+    family("_statement_prepares_total", "counter", "Statement preparations.",
+           [](const StatementStatistics& s) { return QString::number(s.prepares); });
+    family("_statement_prepare_seconds_total", "counter", "Time spent preparing statements.",
+           [](const StatementStatistics& s) { return QString::number(s.prepareUsecs / 1000000.0, 'g', 12); });
+    family("_statement_lock_waits_total", "counter", "Statement executions which found the database locked.",
+           [](const StatementStatistics& s) { return QString::number(s.lockWaits); });
+    family("_statement_lock_retries_total", "counter", "Statement retries after the database was found locked.",
+           [](const StatementStatistics& s) { return QString::number(s.lockRetries); });
+    family("_statement_lock_timeouts_total", "counter", "Statement executions which failed because the database stayed locked.",
+           [](const StatementStatistics& s) { return QString::number(s.lockTimeouts); });
+    family("_statement_lock_wait_seconds_total", "counter", "Time spent waiting for database locks.",
+           [](const StatementStatistics& s) { return QString::number(s.lockWaitUsecs / 1000000.0, 'g', 12); });
+
+    QString histogram = prefix + "_statement_duration_seconds";
+    output << "# HELP " << histogram << " Statement execution latency.\n";
+    output << "# TYPE " << histogram << " histogram\n";
+    for(const StatementStatistics& statistics : std::as_const(statements)) {
+        QString sampleLabels = QString("%1statement=\"%2\"").arg(commonLabels, escape(statistics.statement));
+        qint64 cumulative = 0;
+        for(int i = 0;i < Histogram::BoundCount;i++) {
+            cumulative += statistics.latency.bucketCount(i);
+            output << histogram << "_bucket{" << sampleLabels << ",le=\""
+                   << QString::number(Histogram::bounds()[i] / 1000000.0, 'g', 12) << "\"} " << cumulative << '\n';
+        }
+        output << histogram << "_bucket{" << sampleLabels << ",le=\"+Inf\"} " << statistics.latency.count() << '\n';
+        output << histogram << "_sum{" << sampleLabels << "} " << QString::number(statistics.latency.sumUsecs() / 1000000.0, 'g', 12) << '\n';
+        output << histogram << "_count{" << sampleLabels << "} " << statistics.latency.count() << '\n';
+    }
+    output.flush();
+    return result;
+}
+
+QString DataSourceMetrics::normalize(const QString& sql)
+{
+    auto isWordChar = [](QChar c) {
+        return c.isLetterOrNumber() || c == '_' || c == '$' || c == '?' || c == ':' || c == '@';
+    };
+
+    QString result;
+    result.reserve(sql.length());
+    bool pendingSpace = false;
+    int length = sql.length();
+    int i = 0;
+    while(i < length) {
+        QChar c = sql.at(i);
+        if(c.isSpace()) {
+            pendingSpace = result.isEmpty() == false;
+            i++;
+            continue;
+        }
+        if(pendingSpace) {
+            result.append(' ');
+            pendingSpace = false;
+        }
+
+        if(c == '\'') {
+            // String literal, with '' as an escaped quote
+            for(i++;i < length;i++) {
+                if(sql.at(i) == '\'') {
+                    if(i + 1 < length && sql.at(i + 1) == '\'') {
+                        i++;
+                        continue;
+                    }
+                    i++;
+                    break;
+                }
+            }
+            result.append('?');
+        }
+        else if(c == '"' || c == '`') {
+            // Quoted identifier, kept as written
+            int start = i;
+            for(i++;i < length && sql.at(i) != c;i++) {}
+            i = qMin(i + 1, length);
+            result.append(QStringView(sql).mid(start, i - start));
+        }
+        else if(c.isDigit() && (result.isEmpty() || isWordChar(result.back()) == false)) {
+            // Numeric literal, including decimals, exponents and hex
+            for(i++;i < length && (sql.at(i).isLetterOrNumber() || sql.at(i) == '.');i++) {}
+            result.append('?');
+        }
+        else {
+            result.append(c);
+            i++;
+        }
+    }
+
+    while(result.endsWith(';') || result.endsWith(' ')) {
+        result.chop(1);
+    }
+
+    static const QRegularExpression placeholderList(QStringLiteral("\\(\\s*\\?(?:\\s*,\\s*\\?)*\\s*\\)"));
+    static const QRegularExpression rowList(QStringLiteral("\\(\\?\\)(?:\\s*,\\s*\\(\\?\\))+"));
+    result.replace(placeholderList, QStringLiteral("(?)"));
+    result.replace(rowList, QStringLiteral("(?),..."));
+    return result;
+}
+
+DataSourceMetrics::StatementStatistics& DataSourceMetrics::entry(const QString& sql)
+{
+    QString key;
+    auto normalized = _normalized.constFind(sql);
+    if(normalized != _normalized.constEnd()) {
+        key = normalized.value();
+    }
+    else {
+        key = normalize(sql);
+        if(_normalized.count() >= _maxStatements * 4) {
+            _normalized.clear();
+        }
+        _normalized.insert(sql, key);
+    }
+
+    auto it = _statements.find(key);
+    if(it == _statements.end()) {
+        if(_statements.count() >= _maxStatements) {
+            key = OtherStatement;
+            it = _statements.find(key);
+        }
+        if(it == _statements.end()) {
+            it = _statements.insert(key, StatementStatistics());
+            it->statement = key;
+        }
+    }
+    return it.value();
+}
@@ -0,0 +1,305 @@
+#include "datasourcepool.h"
+#include "datasource.h"
+
+#include <QThread>
+#include <QUuid>
+
+DataSourceLease::DataSourceLease(DataSourceLease&& other) noexcept :
+    _pool(other._pool),
+    _dataSource(other._dataSource)
+{
+    other._pool = nullptr;
+    other._dataSource = nullptr;
+}
+
+DataSourceLease& DataSourceLease::operator=(DataSourceLease&& other) noexcept
+{
+    if(this != &other) {
+        release();
+        _pool = other._pool;
+        _dataSource = other._dataSource;
+        other._pool = nullptr;
+        other._dataSource = nullptr;
+    }
+    return *this;
+}
+
+DataSourceLease::~DataSourceLease()
+{
+    release();
+}
+
+void DataSourceLease::release()
+{
+    if(_pool != nullptr && _dataSource != nullptr) {
+        _pool->releaseLease(_dataSource);
+    }
+    _pool = nullptr;
+    _dataSource = nullptr;
+}
+
+DataSourcePool::DataSourcePool(const DatabaseCredentials& credentials, const Factory& factory) :
+    LoggingBaseClass("db"),
+    _credentials(credentials),
+    _factory(factory),
+    _connectionNamePrefix(QUuid::createUuid().toString(QUuid::WithoutBraces))
+{
+    _sweepTimer.start();
+}
+
+DataSourcePool::~DataSourcePool()
+{
+    QList<Connection*> connections;
+    {
+        QMutexLocker locker(&_mutex);
+        for(Connection* connection : std::as_const(_connections)) {
+            Q_ASSERT(connection->leaseCount == 0);
+            connections.append(connection);
+        }
+        _connections.clear();
+    }
+    closeConnections(connections);
+}
+
+DataSourceLease DataSourcePool::acquire(bool* success)
+{
+    QElapsedTimer waitTimer;
+    waitTimer.start();
+
+    QThread* thread = QThread::currentThread();
+
+    QMutexLocker locker(&_mutex);
+    if(_idleTimeout > 0 && _sweepTimer.elapsed() > _idleTimeout) {
+        locker.unlock();
+        evictIdleConnections();
+        locker.relock();
+    }
+
+    for(;;) {
+        Connection* connection = _connections.value(thread);
+        if(connection != nullptr && connection->dataSource != nullptr) {
+            // This thread already owns a connection (possibly leased further up the stack)
+            connection->leaseCount++;
+            _metrics.acquisitions++;
+            recordWait(waitTimer.nsecsElapsed() / 1000);
+            if(success != nullptr) {
+                *success = true;
+            }
+            return DataSourceLease(this, connection->dataSource);
+        }
+
+        if(_connections.count() < _maximumConnections) {
+            break;
+        }
+
+        // At capacity: close the longest-idle connection owned by another thread to make room
+        QThread* retireThread = findRetirableConnection();
+        if(retireThread != nullptr) {
+            Connection* retired = _connections.take(retireThread);
+            _metrics.connectionsEvicted++;
+            locker.unlock();
+            closeConnections(QList<Connection*>() << retired);
+            locker.relock();
+            continue;
+        }
+
+        qint64 remaining = _acquireTimeout - waitTimer.elapsed();
+        if(remaining <= 0 || _released.wait(&_mutex, static_cast<unsigned long>(remaining)) == false) {
+            _metrics.timeouts++;
+            locker.unlock();
+            logText(LVL_WARNING, QString("Timed out after %1ms waiting for a pooled connection").arg(_acquireTimeout));
+            if(success != nullptr) {
+                *success = false;
+            }
+            return DataSourceLease();
+        }
+    }
+
+    // Reserve this thread's slot while the connection opens outside the pool lock
+    Connection* connection = new Connection;
+    connection->leaseCount = 1;
+    // Emitted on the finishing thread itself, which is the only one allowed to close its connection
+    connection->finishedHook = QObject::connect(thread, &QThread::finished, thread, [this, thread]() {
+        threadFinished(thread);
+    }, Qt::DirectConnection);
+    _connections.insert(thread, connection);
+    QString connectionName = QString("%1-%2").arg(_connectionNamePrefix).arg(++_connectionSerial);
+    locker.unlock();
+
+    DataSource* dataSource = _factory ? _factory() : new DataSource();
+    dataSource->setCredentials(_credentials);
+    dataSource->setConnectionName(connectionName);
+
+    bool opened;
+    {
+        // Serialize opens so only one thread creates a missing SQLite database
+        QMutexLocker openLocker(&_openMutex);
+        opened = dataSource->openConnection();
+    }
+
+    locker.relock();
+    if(opened == false) {
+        _connections.remove(thread);
+        QObject::disconnect(connection->finishedHook);
+        delete connection;
+        _metrics.openFailures++;
+        _released.wakeAll();
+        locker.unlock();
+        logText(LVL_ERROR, QString("Failed to open pooled connection %1").arg(connectionName));
+        delete dataSource;
+        if(success != nullptr) {
+            *success = false;
+        }
+        return DataSourceLease();
+    }
+
+    connection->dataSource = dataSource;
+    _metrics.connectionsOpened++;
+    _metrics.acquisitions++;
+    recordWait(waitTimer.nsecsElapsed() / 1000);
+    if(success != nullptr) {
+        *success = true;
+    }
+    return DataSourceLease(this, dataSource);
+}
+
+int DataSourcePool::evictIdleConnections()
+{
+    QList<Connection*> connections;
+    {
+        QMutexLocker locker(&_mutex);
+        _sweepTimer.restart();
+        connections = takeIdleConnections(_idleTimeout, _minimumConnections);
+    }
+    closeConnections(connections);
+    return connections.count();
+}
+
+int DataSourcePool::closeIdleConnections()
+{
+    QList<Connection*> connections;
+    {
+        QMutexLocker locker(&_mutex);
+        connections = takeIdleConnections(0, 0);
+    }
+    closeConnections(connections);
+    return connections.count();
+}
+
+int DataSourcePool::connectionCount() const
+{
+    QMutexLocker locker(&_mutex);
+    return _connections.count();
+}
+
+DataSourcePool::Metrics DataSourcePool::metrics() const
+{
+    QMutexLocker locker(&_mutex);
+    Metrics result = _metrics;
+    result.connections = _connections.count();
+    result.activeConnections = 0;
+    for(const Connection* connection : _connections) {
+        if(connection->leaseCount > 0) {
+            result.activeConnections++;
+        }
+    }
+    return result;
+}
+
+void DataSourcePool::resetMetrics()
+{
+    QMutexLocker locker(&_mutex);
+    _metrics = Metrics();
+}
+
+void DataSourcePool::releaseLease(DataSource* dataSource)
+{
+    QMutexLocker locker(&_mutex);
+    for(Connection* connection : std::as_const(_connections)) {
+        if(connection->dataSource == dataSource) {
+            if(--connection->leaseCount == 0) {
+                connection->idleTimer.start();
+                _released.wakeAll();
+            }
+            break;
+        }
+    }
+}
+
+void DataSourcePool::threadFinished(QThread* thread)
+{
+    Connection* connection = nullptr;
+    {
+        QMutexLocker locker(&_mutex);
+        connection = _connections.value(thread);
+        if(connection == nullptr || connection->dataSource == nullptr) {
+            return;
+        }
+        _connections.remove(thread);
+        _metrics.connectionsEvicted++;
+        _released.wakeAll();
+    }
+
+    if(connection->leaseCount > 0) {
+        logText(LVL_WARNING, QString("Pooled connection %1 still leased when its thread finished").arg(connection->dataSource->connectionName()));
+    }
+    closeConnections(QList<Connection*>() << connection);
+}
+
+QThread* DataSourcePool::findRetirableConnection() const
+{
+    QThread* result = nullptr;
+    qint64 longestIdle = -1;
+    for(auto it = _connections.constBegin();it != _connections.constEnd();it++) {
+        const Connection* connection = it.value();
+        if(connection->leaseCount == 0 && connection->dataSource != nullptr && connection->idleTimer.elapsed() > longestIdle) {
+            longestIdle = connection->idleTimer.elapsed();
+            result = it.key();
+        }
+    }
+    return result;
+}
+
+QList<DataSourcePool::Connection*> DataSourcePool::takeIdleConnections(qint64 minimumIdleTime, int keep)
+{
+    QList<Connection*> result;
+    for(auto it = _connections.begin();it != _connections.end() && _connections.count() > keep;) {
+        Connection* connection = it.value();
+        if(connection->leaseCount == 0 && connection->dataSource != nullptr && connection->idleTimer.elapsed() >= minimumIdleTime) {
+            result.append(connection);
+            it = _connections.erase(it);
+            _metrics.connectionsEvicted++;
+        }
+        else {
+            it++;
+        }
+    }
+    return result;
+}
+
+void DataSourcePool::closeConnections(const QList<Connection*>& connections)
+{
+    for(Connection* connection : connections) {
+        QObject::disconnect(connection->finishedHook);
+        DataSource* dataSource = connection->dataSource;
+        delete connection;
+        if(dataSource == nullptr) {
+            continue;
+        }
+        // A connection of another thread is handed back to it; deleteLater() runs in that
+        // thread's event loop, or when it finishes, and ~DataSource() closes the connection
+        if(dataSource->thread() == QThread::currentThread()) {
+            dataSource->closeConnection();
+            delete dataSource;
+        }
+        else {
+            dataSource->deleteLater();
+        }
+    }
+}
+
+void DataSourcePool::recordWait(qint64 usecs)
+{
+    _metrics.totalWaitUsecs += usecs;
+    _metrics.maxWaitUsecs = qMax(_metrics.maxWaitUsecs, usecs);
+}
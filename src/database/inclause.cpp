@@ -0,0 +1,103 @@
+#include "inclause.h"
+#include "datasource.h"
+
+InClause::InClause(const QVariantList& values, int maxPlaceholders) :
+    _count(values.count())
+{
+    buildPlaceholders(values, maxPlaceholders);
+}
+
+InClause::InClause(DataSource* dataSource, const QVariantList& values) :
+    _dataSource(dataSource),
+    _count(values.count())
+{
+    int threshold = qMin(_dataSource->inClauseStagingThreshold(), _dataSource->maxBoundVariables());
+    if(values.count() <= threshold) {
+        buildPlaceholders(values, threshold);
+        return;
+    }
+
+    _table = _dataSource->acquireInListTable(values);
+    if(_table < 0) {
+        _valid = false;
+        _sql = QStringLiteral("(NULL)");
+        return;
+    }
+    _sql = QString("(SELECT value FROM %1)").arg(DataSource::inListTableName(_table));
+}
+
+InClause::~InClause()
+{
+    if(_table >= 0) {
+        _dataSource->releaseInListTable(_table);
+    }
+}
+
+int InClause::bucketSize(qsizetype count, int maxPlaceholders)
+{
+    if(count > maxPlaceholders) {
+        return (int)count;
+    }
+
+    int result = 1;
+    while(result < count) {
+        result <<= 1;
+    }
+    return qMin(result, qMax(maxPlaceholders, 1));
+}
+
+QVariantList InClause::values(const QList<int>& list)
+{
+    QVariantList result;
+    result.reserve(list.count());
+    for(int value : list) {
+        result.append(value);
+    }
+    return result;
+}
+
+QVariantList InClause::values(const QList<QUuid>& list)
+{
+    QVariantList result;
+    result.reserve(list.count());
+    for(const QUuid& value : list) {
+        result.append(value.toString(QUuid::WithoutBraces));
+    }
+    return result;
+}
+
+QVariantList InClause::values(const QStringList& list)
+{
+    QVariantList result;
+    result.reserve(list.count());
+    for(const QString& value : list) {
+        result.append(value);
+    }
+    return result;
+}
+
+void InClause::buildPlaceholders(const QVariantList& values, int maxPlaceholders)
+{
+    if(values.isEmpty()) {
+        _sql = QStringLiteral("(NULL)");
+        return;
+    }
+
+    // Repeating the last value does not change which rows match
+    int placeholders = bucketSize(values.count(), maxPlaceholders);
+    _bindings = values;
+    _bindings.reserve(placeholders);
+    while(_bindings.count() < placeholders) {
+        _bindings.append(values.last());
+    }
+
+    _sql.reserve(placeholders * 2 + 1);
+    _sql.append('(');
+    for(int i = 0;i < placeholders;i++) {
+        if(i > 0) {
+            _sql.append(',');
+        }
+        _sql.append('?');
+    }
+    _sql.append(')');
+}
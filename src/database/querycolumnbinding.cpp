@@ -0,0 +1,52 @@
+#include "querycolumnbinding.h"
+
+bool QueryColumnBindingBase::needsResolve(const QSqlQuery& query)
+{
+    // Called for every row, so the SQL text is only compared on the first row of a result set
+    const QSqlResult* result = query.result();
+    if(result != nullptr && result == _result && (query.at() > 0 || query.lastQuery() == _lastQuery)) {
+        return false;
+    }
+
+    _result = result;
+    _lastQuery = query.lastQuery();
+    _resolveCount++;
+    return true;
+}
+
+QueryColumnBinding::QueryColumnBinding(const QStringList& columns)
+{
+    setColumns(columns);
+}
+
+void QueryColumnBinding::setColumns(const QStringList& value)
+{
+    _columns = value;
+    _indexes = QList<int>(_columns.count(), -1);
+    _complete = false;
+    reset();
+}
+
+bool QueryColumnBinding::bind(const QSqlQuery& query)
+{
+    if(needsResolve(query)) {
+        QSqlRecord record = query.record();
+        _complete = true;
+        for(int i = 0;i < _columns.count();i++) {
+            _indexes[i] = record.indexOf(_columns.at(i));
+            _complete = _complete && _indexes.at(i) >= 0;
+        }
+    }
+    return _complete;
+}
+
+QStringList QueryColumnBinding::missingColumns() const
+{
+    QStringList result;
+    for(int i = 0;i < _columns.count();i++) {
+        if(_indexes.at(i) < 0) {
+            result.append(_columns.at(i));
+        }
+    }
+    return result;
+}
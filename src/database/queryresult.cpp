@@ -0,0 +1,63 @@
+#include "queryresult.h"
+
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+QueryResult QueryResult::fromQuery(QSqlQuery& query, bool* success)
+{
+    QueryResult result;
+    if(success != nullptr) {
+        *success = true;
+    }
+    result._numRowsAffected = query.numRowsAffected();
+    result._lastInsertId = query.lastInsertId();
+
+    if(query.isSelect() == false) {
+        return result;
+    }
+
+    QSqlRecord record = query.record();
+    int columnCount = record.count();
+    result._columns.reserve(columnCount);
+    for(int i = 0;i < columnCount;i++) {
+        result._columns.append(record.fieldName(i));
+    }
+
+    int size = query.size();
+    if(size > 0) {
+        result._rows.reserve(size);
+    }
+
+    while(query.next()) {
+        QVariantList values;
+        values.reserve(columnCount);
+        for(int i = 0;i < columnCount;i++) {
+            values.append(query.value(i));
+        }
+        result._rows.append(values);
+    }
+    // next() also returns false when reading a row fails
+    if(success != nullptr && query.lastError().type() != QSqlError::NoError) {
+        *success = false;
+    }
+    return result;
+}
+
+int QueryResult::columnIndex(const QString& name) const
+{
+    for(int i = 0;i < _columns.count();i++) {
+        if(_columns.at(i).compare(name, Qt::CaseInsensitive) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QVariant QueryResult::value(int row, int column) const
+{
+    if(row < 0 || row >= _rows.count() || column < 0) {
+        return QVariant();
+    }
+    return _rows.at(row).value(column);
+}
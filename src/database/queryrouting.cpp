@@ -0,0 +1,13 @@
+#include "queryrouting.h"
+#include "datasource.h"
+
+QueryRouting::QueryRouting(DataSource* dataSource, Route route) :
+    _dataSource(dataSource)
+{
+    _previous = _dataSource->setQueryRoute(route);
+}
+
+QueryRouting::~QueryRouting()
+{
+    _dataSource->setQueryRoute(_previous);
+}
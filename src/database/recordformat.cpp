@@ -0,0 +1,9 @@
+#include "recordformat.h"
+
+RecordFormat RecordFormat::csv(char delimiter, bool header)
+{
+    RecordFormat format(Csv);
+    format.setDelimiter(delimiter);
+    format.setHeader(header);
+    return format;
+}
@@ -0,0 +1,370 @@
+#include "recordparser.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <cmath>
+
+RecordParser::RecordParser(const ImportSpec& spec) :
+    _spec(spec),
+    _specColumns(spec.columns())
+{
+    for(const ImportSpec::Column& column : std::as_const(_specColumns)) {
+        _columns.append(column.column);
+    }
+
+    if(spec.format().type() == RecordFormat::Csv && spec.format().hasHeader() == false) {
+        // Fields are matched to columns by position
+        for(int i = 0;i < _specColumns.count();i++) {
+            _fieldIndexes.append(i);
+        }
+        _fieldCount = _specColumns.count();
+        _headerParsed = true;
+        if(_specColumns.isEmpty()) {
+            _errorText = "Columns must be specified to import CSV without a header";
+        }
+    }
+}
+
+bool RecordParser::parse(const QByteArray& data, bool atEnd, QList<QVariantList>& rows)
+{
+    if(_errorText.isEmpty() == false) {
+        return false;
+    }
+    _buffer.append(data);
+    if(_line == 1 && _buffer.startsWith("\xEF\xBB\xBF")) {
+        // UTF-8 byte order mark
+        _buffer.remove(0, 3);
+    }
+
+    return _spec.format().type() == RecordFormat::Ndjson ? parseNdjson(atEnd, rows) : parseCsv(atEnd, rows);
+}
+
+QList<RecordParser::Error> RecordParser::takeErrors()
+{
+    QList<Error> result;
+    result.swap(_errors);
+    return result;
+}
+
+QVariant RecordParser::convertText(const QString& text, QMetaType::Type type, bool* ok)
+{
+    *ok = true;
+    switch(type) {
+    case QMetaType::UnknownType:
+    case QMetaType::QString:
+        return text;
+    case QMetaType::Int:
+        return text.trimmed().toInt(ok);
+    case QMetaType::UInt:
+        return text.trimmed().toUInt(ok);
+    case QMetaType::LongLong:
+        return text.trimmed().toLongLong(ok);
+    case QMetaType::ULongLong:
+        return text.trimmed().toULongLong(ok);
+    case QMetaType::Double:
+        return text.trimmed().toDouble(ok);
+    case QMetaType::Float:
+        return text.trimmed().toFloat(ok);
+    case QMetaType::Bool:
+    {
+        QString value = text.trimmed().toLower();
+        if(value == "true" || value == "t" || value == "yes" || value == "y" || value == "1") {
+            return true;
+        }
+        if(value == "false" || value == "f" || value == "no" || value == "n" || value == "0") {
+            return false;
+        }
+        *ok = false;
+        return QVariant();
+    }
+    case QMetaType::QDate:
+    {
+        QDate date = QDate::fromString(text.trimmed(), Qt::ISODate);
+        *ok = date.isValid();
+        return date;
+    }
+    case QMetaType::QTime:
+    {
+        QTime time = QTime::fromString(text.trimmed(), Qt::ISODateWithMs);
+        *ok = time.isValid();
+        return time;
+    }
+    case QMetaType::QDateTime:
+    {
+        QDateTime dateTime = QDateTime::fromString(text.trimmed(), Qt::ISODateWithMs);
+        *ok = dateTime.isValid();
+        return dateTime;
+    }
+    case QMetaType::QByteArray:
+    {
+        QByteArray::FromBase64Result decoded = QByteArray::fromBase64Encoding(text.toLatin1(), QByteArray::AbortOnBase64DecodingErrors);
+        *ok = decoded.decodingStatus == QByteArray::Base64DecodingStatus::Ok;
+        return decoded.decoded;
+    }
+    default:
+    {
+        QVariant value(text);
+        *ok = value.convert(QMetaType(type));
+        return value;
+    }
+    }
+}
+
+bool RecordParser::parseCsv(bool atEnd, QList<QVariantList>& rows)
+{
+    QByteArray nullText = _spec.format().nullText().toUtf8();
+    QList<Field> fields;
+    qsizetype start = 0;
+    while(start < _buffer.size()) {
+        int lines = 0;
+        qsizetype end = scanCsvRecord(start, atEnd, fields, &lines);
+        if(end < 0) {
+            if(atEnd) {
+                _errorText = QString("Quoted field starting on line %1 is not closed").arg(_line);
+                return false;
+            }
+            break;
+        }
+        qint64 line = _line;
+        _line += lines;
+        start = end;
+
+        if(fields.count() == 1 && fields.at(0).quoted == false && fields.at(0).text.isEmpty()) {
+            // Blank line
+            continue;
+        }
+
+        if(_headerParsed == false) {
+            if(resolveHeader(fields) == false) {
+                return false;
+            }
+            continue;
+        }
+
+        if(fields.count() != _fieldCount) {
+            addError(line, QString("Expected %1 fields but found %2").arg(_fieldCount).arg(fields.count()));
+            continue;
+        }
+
+        QVariantList row;
+        row.reserve(_fieldIndexes.count());
+        bool ok = true;
+        for(int i = 0;ok && i < _fieldIndexes.count();i++) {
+            const Field& field = fields.at(_fieldIndexes.at(i));
+            QMetaType::Type type = _specColumns.at(i).type;
+            if(field.quoted == false && field.text == nullText) {
+                row.append(type == QMetaType::UnknownType ? QVariant() : QVariant(QMetaType(type)));
+                continue;
+            }
+
+            QString text = QString::fromUtf8(field.text);
+            row.append(convertText(text, type, &ok));
+            if(ok == false) {
+                addError(line, QString("Field %1 value \"%2\" is not a valid %3").arg(_specColumns.at(i).field, text, QString::fromLatin1(QMetaType(type).name())));
+            }
+        }
+        if(ok) {
+            rows.append(row);
+        }
+    }
+    _buffer.remove(0, start);
+    return true;
+}
+
+bool RecordParser::parseNdjson(bool atEnd, QList<QVariantList>& rows)
+{
+    qsizetype start = 0;
+    while(start < _buffer.size()) {
+        qsizetype end = _buffer.indexOf('\n', start);
+        if(end < 0) {
+            if(atEnd == false) {
+                break;
+            }
+            end = _buffer.size();
+        }
+        qint64 line = _line++;
+        QByteArray text = QByteArray::fromRawData(_buffer.constData() + start, end - start).trimmed();
+        start = end + 1;
+        if(text.isEmpty()) {
+            continue;
+        }
+
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(text, &error);
+        if(error.error != QJsonParseError::NoError) {
+            addError(line, QString("Invalid JSON at offset %1: %2").arg(error.offset).arg(error.errorString()));
+            continue;
+        }
+        if(document.isObject() == false) {
+            addError(line, "Not a JSON object");
+            continue;
+        }
+
+        QJsonObject object = document.object();
+        if(_headerParsed == false) {
+            if(_specColumns.isEmpty()) {
+                const QStringList keys = object.keys();
+                for(const QString& key : keys) {
+                    _specColumns.append(ImportSpec::Column{ key, key, QMetaType::UnknownType });
+                    _columns.append(key);
+                }
+            }
+            _headerParsed = true;
+        }
+
+        QVariantList row;
+        row.reserve(_specColumns.count());
+        bool ok = true;
+        for(int i = 0;ok && i < _specColumns.count();i++) {
+            const ImportSpec::Column& column = _specColumns.at(i);
+            row.append(convertJson(object.value(column.field), column.type, &ok));
+            if(ok == false) {
+                addError(line, QString("Field %1 is not a valid %2").arg(column.field, QString::fromLatin1(QMetaType(column.type).name())));
+            }
+        }
+        if(ok) {
+            rows.append(row);
+        }
+    }
+    _buffer.remove(0, qMin(start, _buffer.size()));
+    return true;
+}
+
+qsizetype RecordParser::scanCsvRecord(qsizetype start, bool atEnd, QList<Field>& fields, int* lines)
+{
+    const char* data = _buffer.constData();
+    qsizetype length = _buffer.size();
+    char delimiter = _spec.format().delimiter();
+
+    fields.clear();
+    *lines = 0;
+    qsizetype i = start;
+    forever {
+        Field field;
+        if(i < length && data[i] == '"') {
+            field.quoted = true;
+            for(i++;;) {
+                if(i >= length) {
+                    return -1;
+                }
+                char c = data[i];
+                if(c == '"') {
+                    if(i + 1 >= length && atEnd == false) {
+                        // Can't yet tell a closing quote from the first of a doubled one
+                        return -1;
+                    }
+                    if(i + 1 < length && data[i + 1] == '"') {
+                        field.text.append('"');
+                        i += 2;
+                        continue;
+                    }
+                    i++;
+                    break;
+                }
+                if(c == '\n') {
+                    (*lines)++;
+                }
+                field.text.append(c);
+                i++;
+            }
+        }
+
+        // Unquoted text, or anything after a closing quote, up to the delimiter or line break
+        qsizetype textStart = i;
+        while(i < length && data[i] != delimiter && data[i] != '\n') {
+            i++;
+        }
+        if(i >= length && atEnd == false) {
+            return -1;
+        }
+        qsizetype textEnd = i;
+        if((i >= length || data[i] == '\n') && textEnd > textStart && data[textEnd - 1] == '\r') {
+            textEnd--;
+        }
+        field.text.append(data + textStart, textEnd - textStart);
+        fields.append(field);
+
+        if(i >= length) {
+            return i;
+        }
+        if(data[i] == '\n') {
+            (*lines)++;
+            return i + 1;
+        }
+        i++;
+    }
+}
+
+bool RecordParser::resolveHeader(const QList<Field>& header)
+{
+    QStringList names;
+    for(const Field& field : header) {
+        names.append(QString::fromUtf8(field.text).trimmed());
+    }
+    _fieldCount = names.count();
+
+    if(_specColumns.isEmpty()) {
+        for(int i = 0;i < names.count();i++) {
+            _specColumns.append(ImportSpec::Column{ names.at(i), names.at(i), QMetaType::UnknownType });
+            _columns.append(names.at(i));
+            _fieldIndexes.append(i);
+        }
+    }
+    else {
+        for(const ImportSpec::Column& column : std::as_const(_specColumns)) {
+            int index = names.indexOf(column.field);
+            if(index < 0) {
+                _errorText = QString("Field %1 is not in the header").arg(column.field);
+                return false;
+            }
+            _fieldIndexes.append(index);
+        }
+    }
+    _headerParsed = true;
+    return true;
+}
+
+QVariant RecordParser::convertJson(const QJsonValue& value, QMetaType::Type type, bool* ok)
+{
+    *ok = true;
+    switch(value.type()) {
+    case QJsonValue::Null:
+    case QJsonValue::Undefined:
+        return type == QMetaType::UnknownType ? QVariant() : QVariant(QMetaType(type));
+    case QJsonValue::String:
+        return convertText(value.toString(), type, ok);
+    case QJsonValue::Array:
+    case QJsonValue::Object:
+    {
+        // Nested values are imported as their JSON text
+        QJsonDocument document = value.isArray() ? QJsonDocument(value.toArray()) : QJsonDocument(value.toObject());
+        return convertText(QString::fromUtf8(document.toJson(QJsonDocument::Compact)), type, ok);
+    }
+    default:
+        break;
+    }
+
+    QVariant result = value.toVariant();
+    if(type == QMetaType::UnknownType) {
+        return result;
+    }
+    if(result.typeId() == QMetaType::Double &&
+       (type == QMetaType::Int || type == QMetaType::UInt || type == QMetaType::LongLong || type == QMetaType::ULongLong)) {
+        // Don't silently truncate 1.5 or overflow 1e300
+        double number = result.toDouble();
+        if(std::trunc(number) != number || std::fabs(number) >= 9.2e18) {
+            *ok = false;
+            return QVariant();
+        }
+    }
+    *ok = result.convert(QMetaType(type));
+    return result;
+}
+
+void RecordParser::addError(qint64 line, const QString& message)
+{
+    _errors.append(Error{ line, message });
+    _errorCount++;
+}
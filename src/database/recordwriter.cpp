@@ -0,0 +1,318 @@
+#include "recordwriter.h"
+
+#include <QDateTime>
+#include <QLocale>
+#include <QSqlQuery>
+#include <cmath>
+
+#ifdef KANOOP_DATABASE_HAVE_ZLIB
+#include <zlib.h>
+
+struct RecordWriter::GzipStream
+{
+    z_stream stream;
+    QByteArray output;
+};
+#else
+struct RecordWriter::GzipStream {};
+#endif
+
+RecordWriter::RecordWriter(QIODevice* device, const RecordFormat& format, Compression compression, int flushSize) :
+    _device(device),
+    _format(format),
+    _flushSize(qMax(1, flushSize)),
+    _nullText(format.nullText().toUtf8())
+{
+    if(device == nullptr || device->isWritable() == false) {
+        _errorText = "Export device is not open for writing";
+    }
+    else if(compression == Gzip) {
+#ifdef KANOOP_DATABASE_HAVE_ZLIB
+        _gzip = std::make_unique<GzipStream>();
+        // Adding 16 to the window bits selects the gzip wrapper rather than zlib's
+        if(deflateInit2(&_gzip->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            _gzip.reset();
+            _errorText = "Failed to initialize gzip compression";
+        }
+        else {
+            _gzip->output.resize(64 * 1024);
+        }
+#else
+        _errorText = "gzip compression is not available (built without zlib)";
+#endif
+    }
+
+    // Room for the flush size and the row which crosses it
+    _buffer.reserve(_flushSize + 4096);
+}
+
+RecordWriter::~RecordWriter()
+{
+#ifdef KANOOP_DATABASE_HAVE_ZLIB
+    if(_gzip != nullptr) {
+        deflateEnd(&_gzip->stream);
+    }
+#endif
+}
+
+bool RecordWriter::isGzipAvailable()
+{
+#ifdef KANOOP_DATABASE_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool RecordWriter::begin(const QStringList& columns)
+{
+    if(_errorText.isEmpty() == false) {
+        return false;
+    }
+
+    _columnCount = columns.count();
+    _jsonKeys.clear();
+    if(_format.type() == RecordFormat::Ndjson) {
+        // Each key is encoded once, with the punctuation which precedes it
+        for(int i = 0;i < _columnCount;i++) {
+            QByteArray key(i == 0 ? "{" : ",");
+            appendJsonString(key, columns.at(i).toUtf8());
+            key.append(':');
+            _jsonKeys.append(key);
+        }
+        return true;
+    }
+
+    if(_format.hasHeader() == false) {
+        return true;
+    }
+    for(int i = 0;i < _columnCount;i++) {
+        if(i > 0) {
+            _buffer.append(_format.delimiter());
+        }
+        appendCsvText(columns.at(i).toUtf8());
+    }
+    _buffer.append('\n');
+    return _buffer.size() < _flushSize || flush(false);
+}
+
+bool RecordWriter::writeRow(const QSqlQuery& query)
+{
+    if(_errorText.isEmpty() == false) {
+        return false;
+    }
+    for(int i = 0;i < _columnCount;i++) {
+        appendValue(query.value(i), i);
+    }
+    return endRow();
+}
+
+bool RecordWriter::writeRow(const QVariantList& values)
+{
+    if(_errorText.isEmpty() == false) {
+        return false;
+    }
+    for(int i = 0;i < _columnCount;i++) {
+        appendValue(values.value(i), i);
+    }
+    return endRow();
+}
+
+bool RecordWriter::finish()
+{
+    if(_errorText.isEmpty() == false) {
+        return false;
+    }
+    return flush(true);
+}
+
+void RecordWriter::appendValue(const QVariant& value, int column)
+{
+    bool null = value.isNull();
+    int type = value.typeId();
+    bool number = null == false &&
+                  (type == QMetaType::Int || type == QMetaType::LongLong || type == QMetaType::UInt ||
+                   type == QMetaType::ULongLong || type == QMetaType::Double || type == QMetaType::Float);
+
+    if(_format.type() == RecordFormat::Ndjson) {
+        _buffer.append(_jsonKeys.at(column));
+        if(null || (number && std::isfinite(value.toDouble()) == false)) {
+            _buffer.append("null");
+        }
+        else if(number || type == QMetaType::Bool) {
+            _buffer.append(textOf(value));
+        }
+        else {
+            appendJsonString(_buffer, textOf(value));
+        }
+        return;
+    }
+
+    if(column > 0) {
+        _buffer.append(_format.delimiter());
+    }
+    if(null) {
+        _buffer.append(_nullText);
+    }
+    else if(number) {
+        _buffer.append(textOf(value));
+    }
+    else {
+        appendCsvText(textOf(value));
+    }
+}
+
+void RecordWriter::appendCsvText(const QByteArray& text)
+{
+    // An empty string is quoted when NULL is written as nothing, so the two stay distinct
+    bool quote = text == _nullText;
+    char delimiter = _format.delimiter();
+    for(qsizetype i = 0;quote == false && i < text.size();i++) {
+        char c = text.at(i);
+        quote = c == delimiter || c == '"' || c == '\n' || c == '\r';
+    }
+    if(quote == false) {
+        _buffer.append(text);
+        return;
+    }
+
+    _buffer.append('"');
+    qsizetype start = 0;
+    for(qsizetype i = text.indexOf('"');i >= 0;i = text.indexOf('"', i + 1)) {
+        _buffer.append(text.constData() + start, i + 1 - start);
+        _buffer.append('"');
+        start = i + 1;
+    }
+    _buffer.append(text.constData() + start, text.size() - start);
+    _buffer.append('"');
+}
+
+void RecordWriter::appendJsonString(QByteArray& out, const QByteArray& utf8)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out.append('"');
+    qsizetype start = 0;
+    for(qsizetype i = 0;i < utf8.size();i++) {
+        unsigned char c = (unsigned char)utf8.at(i);
+        if(c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        out.append(utf8.constData() + start, i - start);
+        switch(c) {
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        case '\r':
+            out.append("\\r");
+            break;
+        case '\t':
+            out.append("\\t");
+            break;
+        default:
+        {
+            const char escape[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            out.append(escape, sizeof(escape));
+            break;
+        }
+        }
+        start = i + 1;
+    }
+    out.append(utf8.constData() + start, utf8.size() - start);
+    out.append('"');
+}
+
+bool RecordWriter::endRow()
+{
+    if(_format.type() == RecordFormat::Ndjson) {
+        _buffer.append(_columnCount > 0 ? "}\n" : "{}\n");
+    }
+    else {
+        _buffer.append('\n');
+    }
+    _rowCount++;
+    return _buffer.size() < _flushSize || flush(false);
+}
+
+bool RecordWriter::flush(bool finish)
+{
+    _bytesEncoded += _buffer.size();
+
+    bool result = true;
+    if(_gzip == nullptr) {
+        result = writeToDevice(_buffer.constData(), _buffer.size());
+    }
+#ifdef KANOOP_DATABASE_HAVE_ZLIB
+    else {
+        z_stream& stream = _gzip->stream;
+        stream.next_in = reinterpret_cast<Bytef*>(_buffer.data());
+        stream.avail_in = (uInt)_buffer.size();
+        int status;
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(_gzip->output.data());
+            stream.avail_out = (uInt)_gzip->output.size();
+            status = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+            if(status == Z_STREAM_ERROR) {
+                _errorText = "gzip compression failed";
+                return false;
+            }
+            qint64 produced = _gzip->output.size() - stream.avail_out;
+            if(produced > 0 && writeToDevice(_gzip->output.constData(), produced) == false) {
+                return false;
+            }
+        } while(finish ? status != Z_STREAM_END : stream.avail_out == 0);
+    }
+#else
+    Q_UNUSED(finish);
+#endif
+
+    // Keeps the buffer's capacity for the next rows
+    _buffer.resize(0);
+    return result;
+}
+
+bool RecordWriter::writeToDevice(const char* data, qint64 size)
+{
+    if(_device->write(data, size) != size) {
+        _errorText = QString("Failed to write export: %1").arg(_device->errorString());
+        return false;
+    }
+    _bytesWritten += size;
+    return true;
+}
+
+QByteArray RecordWriter::textOf(const QVariant& value)
+{
+    switch(value.typeId()) {
+    case QMetaType::QString:
+        return value.toString().toUtf8();
+    case QMetaType::QByteArray:
+        return value.toByteArray().toBase64();
+    case QMetaType::Int:
+    case QMetaType::LongLong:
+        return QByteArray::number(value.toLongLong());
+    case QMetaType::UInt:
+    case QMetaType::ULongLong:
+        return QByteArray::number(value.toULongLong());
+    case QMetaType::Double:
+    case QMetaType::Float:
+        return QByteArray::number(value.toDouble(), 'g', QLocale::FloatingPointShortest);
+    case QMetaType::Bool:
+        return value.toBool() ? QByteArray("true") : QByteArray("false");
+    case QMetaType::QDate:
+        return value.toDate().toString(Qt::ISODate).toLatin1();
+    case QMetaType::QTime:
+        return value.toTime().toString(Qt::ISODateWithMs).toLatin1();
+    case QMetaType::QDateTime:
+        return value.toDateTime().toString(Qt::ISODateWithMs).toLatin1();
+    default:
+        return value.toString().toUtf8();
+    }
+}
@@ -0,0 +1,401 @@
+#include "resultcache.h"
+
+#include <QDataStream>
+#include <iterator>
+
+qint64 ResultCache::budget() const
+{
+    QMutexLocker locker(&_mutex);
+    return _budget;
+}
+
+void ResultCache::setBudget(qint64 value)
+{
+    QMutexLocker locker(&_mutex);
+    _budget = qMax(qint64(0), value);
+    evict(_budget);
+}
+
+QByteArray ResultCache::key(const QString& sql, const QVariantList& bindings)
+{
+    QByteArray result = sql.toUtf8();
+    if(bindings.isEmpty() == false) {
+        // Serialized with their types, so that 1 and '1' are different keys
+        QByteArray values;
+        QDataStream stream(&values, QIODevice::WriteOnly);
+        stream << bindings;
+        result.append('\0');
+        result.append(values);
+    }
+    return result;
+}
+
+bool ResultCache::find(const QByteArray& key, QueryResult& result)
+{
+    QMutexLocker locker(&_mutex);
+    if(_budget == 0) {
+        return false;
+    }
+
+    auto it = _index.constFind(key);
+    if(it == _index.constEnd()) {
+        _statistics.misses++;
+        return false;
+    }
+
+    EntryList::iterator entry = it.value();
+    if(entry != _entries.begin()) {
+        _entries.splice(_entries.begin(), _entries, entry);
+    }
+    result = entry->result;
+    _statistics.hits++;
+    return true;
+}
+
+quint64 ResultCache::generation() const
+{
+    QMutexLocker locker(&_mutex);
+    return _generation;
+}
+
+bool ResultCache::insert(const QByteArray& key, const QueryResult& result, const QStringList& tables, quint64 generation)
+{
+    QMutexLocker locker(&_mutex);
+    if(_budget == 0) {
+        return false;
+    }
+
+    qint64 bytes = estimateSize(result) + key.size();
+    if(generation != _generation || bytes > _budget) {
+        _statistics.rejections++;
+        return false;
+    }
+
+    auto it = _index.find(key);
+    if(it != _index.end()) {
+        remove(it.value());
+    }
+    evict(_budget - bytes);
+
+    Entry entry;
+    entry.key = key;
+    entry.result = result;
+    entry.tables = tables;
+    entry.bytes = bytes;
+    _entries.push_front(std::move(entry));
+    _index.insert(key, _entries.begin());
+    for(const QString& table : tables) {
+        _tableIndex.insert(table, key);
+    }
+    _bytes += bytes;
+    return true;
+}
+
+void ResultCache::invalidateTable(const QString& table)
+{
+    QMutexLocker locker(&_mutex);
+    _generation++;
+
+    QList<QByteArray> keys = _tableIndex.values(table.toLower());
+    for(const QByteArray& key : keys) {
+        auto it = _index.find(key);
+        if(it != _index.end()) {
+            remove(it.value());
+            _statistics.invalidations++;
+        }
+    }
+}
+
+void ResultCache::invalidate()
+{
+    QMutexLocker locker(&_mutex);
+    _generation++;
+    _statistics.invalidations += _index.count();
+    _index.clear();
+    _tableIndex.clear();
+    _entries.clear();
+    _bytes = 0;
+}
+
+void ResultCache::clear()
+{
+    QMutexLocker locker(&_mutex);
+    _generation++;
+    _index.clear();
+    _tableIndex.clear();
+    _entries.clear();
+    _bytes = 0;
+}
+
+int ResultCache::size() const
+{
+    QMutexLocker locker(&_mutex);
+    return _index.count();
+}
+
+ResultCache::Statistics ResultCache::statistics() const
+{
+    QMutexLocker locker(&_mutex);
+    Statistics result = _statistics;
+    result.size = _index.count();
+    result.bytes = _bytes;
+    result.budget = _budget;
+    return result;
+}
+
+void ResultCache::resetStatistics()
+{
+    QMutexLocker locker(&_mutex);
+    _statistics = Statistics();
+}
+
+qint64 ResultCache::estimateSize(const QueryResult& result)
+{
+    qint64 bytes = sizeof(Entry);
+    for(const QString& column : result.columns()) {
+        bytes += sizeof(QString) + column.size() * sizeof(QChar);
+    }
+    for(const QVariantList& row : result.rows()) {
+        bytes += sizeof(QVariantList) + row.count() * sizeof(QVariant);
+        for(const QVariant& value : row) {
+            // Only strings and blobs hold data outside the QVariant itself
+            switch(value.typeId()) {
+            case QMetaType::QString:
+                bytes += value.toString().size() * sizeof(QChar);
+                break;
+            case QMetaType::QByteArray:
+                bytes += value.toByteArray().size();
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return bytes;
+}
+
+QStringList ResultCache::tablesRead(const QString& sql)
+{
+    static const QStringList clauseEnds = {
+        ",", ";", "WHERE", "GROUP", "ORDER", "LIMIT", "HAVING", "WINDOW", "JOIN", "ON", "USING",
+        "UNION", "EXCEPT", "INTERSECT", "LEFT", "RIGHT", "INNER", "CROSS", "NATURAL", "FULL",
+    };
+
+    QStringList result;
+    QStringList words = tokens(sql);
+    int count = words.count();
+    for(int i = 0;i < count;i++) {
+        bool from = words.at(i).compare(QLatin1String("FROM"), Qt::CaseInsensitive) == 0;
+        if(from == false && words.at(i).compare(QLatin1String("JOIN"), Qt::CaseInsensitive) != 0) {
+            continue;
+        }
+
+        // Walk a FROM list; subqueries are skipped here and found by the outer loop
+        int j = i + 1;
+        while(j < count) {
+            if(words.at(j) == "(") {
+                for(int depth = 0;j < count;j++) {
+                    if(words.at(j) == "(") {
+                        depth++;
+                    }
+                    else if(words.at(j) == ")" && --depth == 0) {
+                        j++;
+                        break;
+                    }
+                }
+            }
+            else {
+                QString table = tableName(words.at(j++));
+                if(table.isEmpty() == false && result.contains(table) == false) {
+                    result.append(table);
+                }
+            }
+            if(from == false) {
+                break;
+            }
+
+            // Skip an alias or function arguments up to the next comma or clause
+            int depth = 0;
+            for(;j < count;j++) {
+                const QString& word = words.at(j);
+                if(word == "(") {
+                    depth++;
+                }
+                else if(word == ")") {
+                    if(depth == 0) {
+                        break;
+                    }
+                    depth--;
+                }
+                else if(depth == 0 && clauseEnds.contains(word, Qt::CaseInsensitive)) {
+                    break;
+                }
+            }
+            if(j < count && words.at(j) == ",") {
+                j++;
+            }
+            else {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+QString ResultCache::tableWritten(const QString& sql)
+{
+    static const QStringList writes = { "INSERT", "REPLACE", "UPDATE", "DELETE", "WITH" };
+
+    // Most statements are ruled out without tokenizing them
+    QStringView statement = QStringView(sql).trimmed();
+    bool candidate = false;
+    for(const QString& write : writes) {
+        if(statement.startsWith(write, Qt::CaseInsensitive)) {
+            candidate = true;
+            break;
+        }
+    }
+    if(candidate == false) {
+        return QString();
+    }
+
+    QStringList words = tokens(sql);
+    int count = words.count();
+    int depth = 0;
+    for(int i = 0;i < count;i++) {
+        const QString& word = words.at(i);
+        if(word == "(") {
+            depth++;
+        }
+        else if(word == ")") {
+            depth--;
+        }
+        else if(depth > 0) {
+            continue;
+        }
+        else if(word.compare(QLatin1String("INSERT"), Qt::CaseInsensitive) == 0 || word.compare(QLatin1String("REPLACE"), Qt::CaseInsensitive) == 0) {
+            for(int j = i + 1;j < count - 1;j++) {
+                if(words.at(j).compare(QLatin1String("INTO"), Qt::CaseInsensitive) == 0) {
+                    return tableName(words.at(j + 1));
+                }
+            }
+            return QString();
+        }
+        else if(word.compare(QLatin1String("UPDATE"), Qt::CaseInsensitive) == 0) {
+            // UPDATE OR <conflict> table
+            int j = i + 1;
+            if(j < count && words.at(j).compare(QLatin1String("OR"), Qt::CaseInsensitive) == 0) {
+                j += 2;
+            }
+            return j < count ? tableName(words.at(j)) : QString();
+        }
+        else if(word.compare(QLatin1String("DELETE"), Qt::CaseInsensitive) == 0) {
+            return i + 2 < count ? tableName(words.at(i + 2)) : QString();
+        }
+    }
+    return QString();
+}
+
+void ResultCache::remove(EntryList::iterator entry)
+{
+    for(const QString& table : std::as_const(entry->tables)) {
+        _tableIndex.remove(table, entry->key);
+    }
+    _index.remove(entry->key);
+    _bytes -= entry->bytes;
+    _entries.erase(entry);
+}
+
+void ResultCache::evict(qint64 keepBytes)
+{
+    while(_entries.empty() == false && _bytes > qMax(qint64(0), keepBytes)) {
+        remove(std::prev(_entries.end()));
+        _statistics.evictions++;
+    }
+}
+
+QStringList ResultCache::tokens(const QString& sql)
+{
+    auto isWordChar = [](QChar c) {
+        return c.isLetterOrNumber() || c == '_' || c == '$' || c == '.';
+    };
+
+    QStringList result;
+    int length = sql.length();
+    int i = 0;
+    while(i < length) {
+        QChar c = sql.at(i);
+        QChar next = i + 1 < length ? sql.at(i + 1) : QChar();
+        if(c.isSpace()) {
+            i++;
+        }
+        else if(c == '-' && next == '-') {
+            while(i < length && sql.at(i) != '\n') {
+                i++;
+            }
+        }
+        else if(c == '/' && next == '*') {
+            int end = sql.indexOf(QLatin1String("*/"), i + 2);
+            i = end < 0 ? length : end + 2;
+        }
+        else if(c == '\'') {
+            // String literal, with '' as an escaped quote
+            for(i++;i < length;i++) {
+                if(sql.at(i) == '\'') {
+                    if(i + 1 < length && sql.at(i + 1) == '\'') {
+                        i++;
+                        continue;
+                    }
+                    i++;
+                    break;
+                }
+            }
+            result.append(QStringLiteral("?"));
+        }
+        else if(c == '"' || c == '`' || c == '[') {
+            // Quoted identifier, possibly with a schema prefix glued on after it
+            QChar close = c == '[' ? QChar(']') : c;
+            int end = sql.indexOf(close, i + 1);
+            end = end < 0 ? length : end + 1;
+            while(end < length && isWordChar(sql.at(end))) {
+                end++;
+            }
+            result.append(sql.mid(i, end - i));
+            i = end;
+        }
+        else if(isWordChar(c)) {
+            int start = i;
+            while(i < length && (isWordChar(sql.at(i)) || sql.at(i) == '"' || sql.at(i) == '`' || sql.at(i) == '[')) {
+                if(sql.at(i) == '"' || sql.at(i) == '`' || sql.at(i) == '[') {
+                    // schema."table"
+                    QChar close = sql.at(i) == '[' ? QChar(']') : sql.at(i);
+                    int end = sql.indexOf(close, i + 1);
+                    i = end < 0 ? length : end + 1;
+                }
+                else {
+                    i++;
+                }
+            }
+            result.append(sql.mid(start, i - start));
+        }
+        else {
+            result.append(QString(c));
+            i++;
+        }
+    }
+    return result;
+}
+
+QString ResultCache::tableName(const QString& token)
+{
+    QString name = token;
+    name.remove('"').remove('`').remove('[').remove(']');
+    int dot = name.lastIndexOf('.');
+    if(dot >= 0) {
+        name = name.mid(dot + 1);
+    }
+    if(name.isEmpty() || name == "?" || (name.at(0).isLetter() == false && name.at(0) != '_')) {
+        return QString();
+    }
+    return name.toLower();
+}
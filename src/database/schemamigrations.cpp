@@ -0,0 +1,55 @@
+#include "schemamigrations.h"
+
+#include <QCryptographicHash>
+
+const QString SchemaMigrations::HistoryTable = QStringLiteral("_kdb_migrations");
+
+bool SchemaMigrations::add(int version, const QString& description, const QString& sql)
+{
+    if(version <= 0 || _migrations.contains(version)) {
+        return false;
+    }
+
+    Migration migration;
+    migration.version = version;
+    migration.description = description;
+    migration.sql = sql;
+    migration.checksum = checksum(sql);
+    _migrations.insert(version, migration);
+    return true;
+}
+
+bool SchemaMigrations::add(int version, const QString& description, const Step& step, const QString& checksumSource)
+{
+    if(version <= 0 || _migrations.contains(version) || step == nullptr) {
+        return false;
+    }
+
+    Migration migration;
+    migration.version = version;
+    migration.description = description;
+    migration.step = step;
+    migration.checksum = checksum(checksumSource.isEmpty() ? description : checksumSource);
+    _migrations.insert(version, migration);
+    return true;
+}
+
+QList<SchemaMigrations::Migration> SchemaMigrations::pending(int currentVersion) const
+{
+    QList<Migration> result;
+    for(auto it = _migrations.upperBound(currentVersion);it != _migrations.constEnd();++it) {
+        result.append(it.value());
+    }
+    return result;
+}
+
+const SchemaMigrations::Migration* SchemaMigrations::find(int version) const
+{
+    auto it = _migrations.constFind(version);
+    return it != _migrations.constEnd() ? &it.value() : nullptr;
+}
+
+QString SchemaMigrations::checksum(const QString& text)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(text.toUtf8(), QCryptographicHash::Sha256).toHex());
+}
@@ -0,0 +1,164 @@
+#include "sqlbuilder.h"
+
+#include <QLocale>
+
+SqlBuilder& SqlBuilder::appendUuid(const QUuid& value)
+{
+    static const char Hex[] = "0123456789abcdef";
+
+    // Same layout as QUuid::toString(QUuid::WithoutBraces), quoted
+    char16_t text[38];
+    int pos = 0;
+    text[pos++] = u'\'';
+    auto hex = [&text, &pos](quint64 bits, int digits) {
+        for(int i = digits - 1;i >= 0;i--) {
+            text[pos++] = Hex[(bits >> (i * 4)) & 0xf];
+        }
+    };
+    hex(value.data1, 8);
+    text[pos++] = u'-';
+    hex(value.data2, 4);
+    text[pos++] = u'-';
+    hex(value.data3, 4);
+    text[pos++] = u'-';
+    hex((quint64(value.data4[0]) << 8) | value.data4[1], 4);
+    text[pos++] = u'-';
+    for(int i = 2;i < 8;i++) {
+        hex(value.data4[i], 2);
+    }
+    text[pos++] = u'\'';
+    _buffer.append(QStringView(text, pos));
+    return *this;
+}
+
+SqlBuilder& SqlBuilder::appendTimestamp(const QDateTime& value)
+{
+    QDateTime utc = value.toUTC();
+    QDate date = utc.date();
+    QTime time = utc.time();
+
+    _buffer.append('\'');
+    appendDigits(qMax(date.year(), 0), 4);
+    _buffer.append('-');
+    appendDigits(date.month(), 2);
+    _buffer.append('-');
+    appendDigits(date.day(), 2);
+    _buffer.append(' ');
+    appendDigits(time.hour(), 2);
+    _buffer.append(':');
+    appendDigits(time.minute(), 2);
+    _buffer.append(':');
+    appendDigits(time.second(), 2);
+    _buffer.append('.');
+    appendDigits(time.msec(), 3);
+    _buffer.append('\'');
+    return *this;
+}
+
+SqlBuilder& SqlBuilder::appendEscaped(QStringView value)
+{
+    qsizetype quote = value.indexOf(QChar('\''));
+    qsizetype nul = value.indexOf(QChar(QChar::Null));
+    if(quote < 0 && nul < 0) {
+        _buffer.append(value);
+        return *this;
+    }
+
+    // Copy the runs between special characters whole, each next position found by indexOf()
+    _buffer.reserve(_buffer.length() + value.length() + 8);
+    qsizetype start = 0;
+    while(quote >= 0 || nul >= 0) {
+        if(nul < 0 || (quote >= 0 && quote < nul)) {
+            _buffer.append(value.mid(start, quote + 1 - start));
+            _buffer.append('\'');
+            start = quote + 1;
+            quote = value.indexOf(QChar('\''), start);
+        }
+        else {
+            _buffer.append(value.mid(start, nul - start));
+            _buffer.append('?');
+            start = nul + 1;
+            nul = value.indexOf(QChar(QChar::Null), start);
+        }
+    }
+    _buffer.append(value.mid(start));
+    return *this;
+}
+
+SqlBuilder& SqlBuilder::appendUuidList(const QList<QUuid>& list)
+{
+    _buffer.reserve(_buffer.length() + list.count() * 39);
+    for(qsizetype i = 0;i < list.count();i++) {
+        if(i > 0) {
+            _buffer.append(',');
+        }
+        appendUuid(list.at(i));
+    }
+    return *this;
+}
+
+SqlBuilder& SqlBuilder::appendStringList(const QStringList& list)
+{
+    for(qsizetype i = 0;i < list.count();i++) {
+        if(i > 0) {
+            _buffer.append(',');
+        }
+        appendString(list.at(i));
+    }
+    return *this;
+}
+
+qsizetype SqlBuilder::findEscape(QStringView value)
+{
+    // QStringView::indexOf() is vectorized, so two passes beat one per-character loop
+    qsizetype quote = value.indexOf(QChar('\''));
+    qsizetype nul = value.indexOf(QChar(QChar::Null));
+    if(quote < 0) {
+        return nul;
+    }
+    return nul < 0 ? quote : qMin(quote, nul);
+}
+
+QString SqlBuilder::escaped(const QString& unescaped)
+{
+    if(findEscape(unescaped) < 0) {
+        return unescaped;
+    }
+    SqlBuilder builder(unescaped.length() + 8);
+    builder.appendEscaped(unescaped);
+    return builder.take();
+}
+
+void SqlBuilder::appendSigned(qint64 value)
+{
+    if(value < 0) {
+        _buffer.append('-');
+        // Negate in unsigned arithmetic so the minimum value does not overflow
+        appendDigits(0 - quint64(value), 1);
+    }
+    else {
+        appendDigits(quint64(value), 1);
+    }
+}
+
+void SqlBuilder::appendUnsigned(quint64 value)
+{
+    appendDigits(value, 1);
+}
+
+void SqlBuilder::appendDouble(double value)
+{
+    // Shortest representation which reads back as the same value
+    _buffer.append(QString::number(value, 'g', QLocale::FloatingPointShortest));
+}
+
+void SqlBuilder::appendDigits(quint64 value, int minimumDigits)
+{
+    char16_t digits[20];
+    int count = 0;
+    do {
+        digits[sizeof(digits) / sizeof(digits[0]) - ++count] = u'0' + value % 10;
+        value /= 10;
+    } while(value > 0 || count < minimumDigits);
+    _buffer.append(QStringView(digits + sizeof(digits) / sizeof(digits[0]) - count, count));
+}
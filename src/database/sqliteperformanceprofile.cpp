@@ -0,0 +1,119 @@
+#include "sqliteperformanceprofile.h"
+
+SqlitePerformanceProfile SqlitePerformanceProfile::durable()
+{
+    SqlitePerformanceProfile profile;
+    profile.setJournalMode(JournalWal);
+    profile.setSynchronous(SynchronousFull);
+    profile.setBusyTimeout(5000);
+    return profile;
+}
+
+SqlitePerformanceProfile SqlitePerformanceProfile::balanced()
+{
+    SqlitePerformanceProfile profile;
+    profile.setJournalMode(JournalWal);
+    profile.setSynchronous(SynchronousNormal);
+    profile.setCacheSizeKiB(64 * 1024);
+    profile.setMmapSize(256LL * 1024 * 1024);
+    profile.setTempStore(TempStoreMemory);
+    profile.setBusyTimeout(5000);
+    profile.setWalAutoCheckpoint(1000);
+    return profile;
+}
+
+SqlitePerformanceProfile SqlitePerformanceProfile::bulkLoad()
+{
+    SqlitePerformanceProfile profile;
+    profile.setJournalMode(JournalWal);
+    profile.setSynchronous(SynchronousOff);
+    profile.setCacheSizeKiB(256 * 1024);
+    profile.setMmapSize(1024LL * 1024 * 1024);
+    profile.setTempStore(TempStoreMemory);
+    profile.setBusyTimeout(5000);
+    profile.setWalAutoCheckpoint(10000);
+    return profile;
+}
+
+bool SqlitePerformanceProfile::isEmpty() const
+{
+    return *this == SqlitePerformanceProfile();
+}
+
+QStringList SqlitePerformanceProfile::pragmas(bool newDatabase) const
+{
+    QStringList result;
+
+    // page_size must precede journal_mode: a WAL database cannot change its page size
+    if(newDatabase && _pageSize > 0) {
+        result.append(QString("PRAGMA page_size = %1;").arg(_pageSize));
+    }
+    if(_journalMode != JournalModeUnset) {
+        result.append(QString("PRAGMA journal_mode = %1;").arg(journalModeToString(_journalMode)));
+    }
+    if(_synchronous != SynchronousUnset) {
+        result.append(QString("PRAGMA synchronous = %1;").arg(static_cast<int>(_synchronous)));
+    }
+    if(_cacheSizeKiB >= 0) {
+        // Negative cache_size values are in KiB rather than pages
+        result.append(QString("PRAGMA cache_size = %1;").arg(-_cacheSizeKiB));
+    }
+    if(_mmapSize >= 0) {
+        result.append(QString("PRAGMA mmap_size = %1;").arg(_mmapSize));
+    }
+    if(_tempStore != TempStoreUnset) {
+        result.append(QString("PRAGMA temp_store = %1;").arg(static_cast<int>(_tempStore)));
+    }
+    if(_busyTimeout >= 0) {
+        result.append(QString("PRAGMA busy_timeout = %1;").arg(_busyTimeout));
+    }
+    if(_walAutoCheckpoint >= 0) {
+        result.append(QString("PRAGMA wal_autocheckpoint = %1;").arg(_walAutoCheckpoint));
+    }
+    return result;
+}
+
+QString SqlitePerformanceProfile::journalModeToString(JournalMode value)
+{
+    switch(value) {
+    case JournalDelete:
+        return "DELETE";
+    case JournalTruncate:
+        return "TRUNCATE";
+    case JournalPersist:
+        return "PERSIST";
+    case JournalMemory:
+        return "MEMORY";
+    case JournalWal:
+        return "WAL";
+    case JournalOff:
+        return "OFF";
+    default:
+        return QString();
+    }
+}
+
+SqlitePerformanceProfile::JournalMode SqlitePerformanceProfile::journalModeFromString(const QString& value)
+{
+    static const QList<JournalMode> modes = {
+        JournalDelete, JournalTruncate, JournalPersist, JournalMemory, JournalWal, JournalOff
+    };
+    for(JournalMode mode : modes) {
+        if(value.compare(journalModeToString(mode), Qt::CaseInsensitive) == 0) {
+            return mode;
+        }
+    }
+    return JournalModeUnset;
+}
+
+bool SqlitePerformanceProfile::operator==(const SqlitePerformanceProfile& other) const
+{
+    return  _journalMode == other._journalMode &&
+            _synchronous == other._synchronous &&
+            _cacheSizeKiB == other._cacheSizeKiB &&
+            _mmapSize == other._mmapSize &&
+            _tempStore == other._tempStore &&
+            _pageSize == other._pageSize &&
+            _busyTimeout == other._busyTimeout &&
+            _walAutoCheckpoint == other._walAutoCheckpoint;
+}
@@ -0,0 +1,341 @@
+#include "sqlitestatement.h"
+#include "datasource.h"
+
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+#include <sqlite3.h>
+#endif
+
+struct SqliteStatement::Handle
+{
+    QString sql;
+    sqlite3_stmt* stmt = nullptr;
+    // True once stepped since the last reset, so the next step after the end starts over
+    bool started = false;
+    bool failed = false;
+    QString error;
+};
+
+bool SqliteStatement::isAvailable()
+{
+    return DataSource::isNativeSqliteAvailable();
+}
+
+bool SqliteStatement::isValid() const
+{
+    return _handle != nullptr && _handle->stmt != nullptr;
+}
+
+QString SqliteStatement::sql() const
+{
+    return _handle != nullptr ? _handle->sql : QString();
+}
+
+QString SqliteStatement::errorText() const
+{
+    return _handle != nullptr ? _handle->error : QString();
+}
+
+bool SqliteStatement::hasError() const
+{
+    return _handle != nullptr && _handle->failed;
+}
+
+bool SqliteStatement::bindText(int index, const QString& value)
+{
+    if(value.isNull()) {
+        return bindNull(index);
+    }
+    return bindUtf8(index, value.toUtf8());
+}
+
+bool SqliteStatement::bind(int index, const QVariant& value)
+{
+    if(value.isNull()) {
+        return bindNull(index);
+    }
+    switch(value.typeId()) {
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Long:
+    case QMetaType::ULong:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+    case QMetaType::Char:
+    case QMetaType::SChar:
+    case QMetaType::UChar:
+        return bindInteger(index, value.toLongLong());
+    case QMetaType::Float:
+    case QMetaType::Double:
+        return bindReal(index, value.toDouble());
+    case QMetaType::QByteArray:
+        return bindBlob(index, value.toByteArray());
+    default:
+        return bindText(index, value.toString());
+    }
+}
+
+bool SqliteStatement::bindAll(const QVariantList& values)
+{
+    bool result = true;
+    for(int i = 0;result && i < values.count();i++) {
+        result = bind(i + 1, values.at(i));
+    }
+    return result;
+}
+
+bool SqliteStatement::exec()
+{
+    if(isValid() == false) {
+        return false;
+    }
+    // Rows are not wanted, so do not leave the statement holding a read lock
+    if(step()) {
+        reset();
+    }
+    return hasError() == false;
+}
+
+#ifdef KANOOP_DATABASE_HAVE_SQLITE3
+
+std::shared_ptr<SqliteStatement::Handle> SqliteStatement::prepare(sqlite3* db, const QString& sql, QString* error)
+{
+    QByteArray utf8 = sql.toUtf8();
+    sqlite3_stmt* stmt = nullptr;
+    const char* tail = nullptr;
+    int rc = sqlite3_prepare_v3(db, utf8.constData(), utf8.size() + 1, SQLITE_PREPARE_PERSISTENT, &stmt, &tail);
+    if(rc == SQLITE_OK && stmt != nullptr && QByteArrayView(tail).trimmed().isEmpty() == false) {
+        sqlite3_finalize(stmt);
+        *error = QString("Native statements hold one SQL statement: %1").arg(sql);
+        return nullptr;
+    }
+    if(rc != SQLITE_OK || stmt == nullptr) {
+        sqlite3_finalize(stmt);
+        *error = rc != SQLITE_OK ? QString::fromUtf8(sqlite3_errmsg(db)) : QString("No SQL statement in: %1").arg(sql);
+        return nullptr;
+    }
+
+    std::shared_ptr<Handle> handle = std::make_shared<Handle>();
+    handle->sql = sql;
+    handle->stmt = stmt;
+    return handle;
+}
+
+void SqliteStatement::finalize(Handle* handle)
+{
+    sqlite3_finalize(handle->stmt);
+    handle->stmt = nullptr;
+    handle->started = false;
+}
+
+bool SqliteStatement::bindResult(int rc)
+{
+    if(rc != SQLITE_OK) {
+        _handle->error = QString::fromUtf8(sqlite3_errmsg(sqlite3_db_handle(_handle->stmt)));
+        _dataSource->recordNativeError(_handle->sql, rc, _handle->error);
+        return false;
+    }
+    return true;
+}
+
+int SqliteStatement::parameterCount() const
+{
+    return isValid() ? sqlite3_bind_parameter_count(_handle->stmt) : 0;
+}
+
+int SqliteStatement::parameterIndex(const QString& name) const
+{
+    return isValid() ? sqlite3_bind_parameter_index(_handle->stmt, name.toUtf8().constData()) : 0;
+}
+
+bool SqliteStatement::bindNull(int index)
+{
+    return isValid() && bindResult(sqlite3_bind_null(_handle->stmt, index));
+}
+
+bool SqliteStatement::bindInteger(int index, qint64 value)
+{
+    return isValid() && bindResult(sqlite3_bind_int64(_handle->stmt, index, value));
+}
+
+bool SqliteStatement::bindReal(int index, double value)
+{
+    return isValid() && bindResult(sqlite3_bind_double(_handle->stmt, index, value));
+}
+
+bool SqliteStatement::bindUtf8(int index, QByteArrayView value)
+{
+    // A null pointer would bind NULL rather than an empty string
+    return isValid() && bindResult(sqlite3_bind_text64(_handle->stmt, index, value.data() != nullptr ? value.data() : "",
+                                                       value.size(), SQLITE_TRANSIENT, SQLITE_UTF8));
+}
+
+bool SqliteStatement::bindBlob(int index, QByteArrayView value)
+{
+    return isValid() && bindResult(sqlite3_bind_blob64(_handle->stmt, index, value.data() != nullptr ? value.data() : "",
+                                                       value.size(), SQLITE_TRANSIENT));
+}
+
+bool SqliteStatement::step()
+{
+    if(isValid() == false) {
+        return false;
+    }
+    if(_dataSource->checkExecutingThread() == false) {
+        _handle->failed = true;
+        _handle->error = "Native statement stepped from wrong thread";
+        return false;
+    }
+
+    bool first = _handle->started == false;
+    _handle->started = true;
+    int rc = sqlite3_step(_handle->stmt);
+    _handle->failed = rc != SQLITE_ROW && rc != SQLITE_DONE;
+    if(_handle->failed) {
+        _handle->error = QString::fromUtf8(sqlite3_errmsg(sqlite3_db_handle(_handle->stmt)));
+        _dataSource->recordNativeError(_handle->sql, rc, _handle->error);
+        sqlite3_reset(_handle->stmt);
+        _handle->started = false;
+        return false;
+    }
+
+    _handle->error.clear();
+    if(first && sqlite3_stmt_readonly(_handle->stmt) == 0) {
+        _dataSource->recordNativeWrite(_handle->sql);
+    }
+    if(rc == SQLITE_DONE) {
+        // Leave the statement ready to run again, and release any read lock it held
+        sqlite3_reset(_handle->stmt);
+        _handle->started = false;
+    }
+    return rc == SQLITE_ROW;
+}
+
+bool SqliteStatement::reset()
+{
+    if(isValid() == false) {
+        return false;
+    }
+    sqlite3_reset(_handle->stmt);
+    _handle->started = false;
+    _handle->failed = false;
+    _handle->error.clear();
+    return true;
+}
+
+bool SqliteStatement::clearBindings()
+{
+    return reset() && sqlite3_clear_bindings(_handle->stmt) == SQLITE_OK;
+}
+
+int SqliteStatement::columnCount() const
+{
+    return isValid() ? sqlite3_column_count(_handle->stmt) : 0;
+}
+
+QString SqliteStatement::columnName(int column) const
+{
+    return isValid() ? QString::fromUtf8(sqlite3_column_name(_handle->stmt, column)) : QString();
+}
+
+bool SqliteStatement::isNull(int column) const
+{
+    return isValid() == false || sqlite3_column_type(_handle->stmt, column) == SQLITE_NULL;
+}
+
+qint64 SqliteStatement::integer(int column) const
+{
+    return isValid() ? sqlite3_column_int64(_handle->stmt, column) : 0;
+}
+
+double SqliteStatement::real(int column) const
+{
+    return isValid() ? sqlite3_column_double(_handle->stmt, column) : 0;
+}
+
+QString SqliteStatement::text(int column) const
+{
+    if(isNull(column)) {
+        return QString();
+    }
+    const char* data = reinterpret_cast<const char*>(sqlite3_column_text(_handle->stmt, column));
+    return QString::fromUtf8(data, sqlite3_column_bytes(_handle->stmt, column));
+}
+
+QByteArrayView SqliteStatement::bytes(int column) const
+{
+    if(isNull(column)) {
+        return QByteArrayView();
+    }
+    // Fetch the pointer before the size, as SQLite documents
+    const char* data = static_cast<const char*>(sqlite3_column_blob(_handle->stmt, column));
+    return QByteArrayView(data, sqlite3_column_bytes(_handle->stmt, column));
+}
+
+QVariant SqliteStatement::value(int column) const
+{
+    if(isValid() == false) {
+        return QVariant();
+    }
+    switch(sqlite3_column_type(_handle->stmt, column)) {
+    case SQLITE_INTEGER:
+        return integer(column);
+    case SQLITE_FLOAT:
+        return real(column);
+    case SQLITE_BLOB:
+        return blob(column);
+    case SQLITE_TEXT:
+        return text(column);
+    default:
+        return QVariant();
+    }
+}
+
+int SqliteStatement::rowsAffected() const
+{
+    return isValid() ? sqlite3_changes(sqlite3_db_handle(_handle->stmt)) : 0;
+}
+
+qint64 SqliteStatement::lastInsertId() const
+{
+    return isValid() ? sqlite3_last_insert_rowid(sqlite3_db_handle(_handle->stmt)) : 0;
+}
+
+#else
+
+// Without the native SQLite link DataSource::prepareSqlite() never returns a valid statement
+
+std::shared_ptr<SqliteStatement::Handle> SqliteStatement::prepare(sqlite3* db, const QString& sql, QString* error)
+{
+    Q_UNUSED(db);
+    Q_UNUSED(sql);
+    *error = "Native SQLite statements require KANOOP_DATABASE_NATIVE_SQLITE";
+    return nullptr;
+}
+
+void SqliteStatement::finalize(Handle* handle) { handle->stmt = nullptr; }
+bool SqliteStatement::bindResult(int rc) { return rc == 0; }
+int SqliteStatement::parameterCount() const { return 0; }
+int SqliteStatement::parameterIndex(const QString& name) const { Q_UNUSED(name); return 0; }
+bool SqliteStatement::bindNull(int index) { Q_UNUSED(index); return false; }
+bool SqliteStatement::bindInteger(int index, qint64 value) { Q_UNUSED(index); Q_UNUSED(value); return false; }
+bool SqliteStatement::bindReal(int index, double value) { Q_UNUSED(index); Q_UNUSED(value); return false; }
+bool SqliteStatement::bindUtf8(int index, QByteArrayView value) { Q_UNUSED(index); Q_UNUSED(value); return false; }
+bool SqliteStatement::bindBlob(int index, QByteArrayView value) { Q_UNUSED(index); Q_UNUSED(value); return false; }
+bool SqliteStatement::step() { return false; }
+bool SqliteStatement::reset() { return false; }
+bool SqliteStatement::clearBindings() { return false; }
+int SqliteStatement::columnCount() const { return 0; }
+QString SqliteStatement::columnName(int column) const { Q_UNUSED(column); return QString(); }
+bool SqliteStatement::isNull(int column) const { Q_UNUSED(column); return true; }
+qint64 SqliteStatement::integer(int column) const { Q_UNUSED(column); return 0; }
+double SqliteStatement::real(int column) const { Q_UNUSED(column); return 0; }
+QString SqliteStatement::text(int column) const { Q_UNUSED(column); return QString(); }
+QByteArrayView SqliteStatement::bytes(int column) const { Q_UNUSED(column); return QByteArrayView(); }
+QVariant SqliteStatement::value(int column) const { Q_UNUSED(column); return QVariant(); }
+int SqliteStatement::rowsAffected() const { return 0; }
+qint64 SqliteStatement::lastInsertId() const { return 0; }
+
+#endif
@@ -1,55 +1,32 @@
 #include "sqlparser.h"
 
-#include <QTextStream>
-
-
-SqlParser::SqlParser(const QString& sql)
+SqlParser::SqlParser(const QString& sql) :
+    _sql(sql)
 {
-    parse(sql);
+    SqlScanner scanner;
+    SqlScanner::Statement statement;
+    while(scanner.next(_sql, true, &statement)) {
+        _ranges.append(statement);
+    }
+    _valid = _ranges.count() > 0 && scanner.isComplete();
 }
 
-void SqlParser::parse(const QString& sql)
+QStringList SqlParser::statements() const
 {
-    QTextStream input(sql.toUtf8());
-
-    while(!input.atEnd()) {
-        QString line = input.readLine();
-        if( line.startsWith("--") ||
-            line.startsWith('#') ||
-            line.isEmpty()) {
-            // Only flush if we have no accumulated lines (between statements).
-            // If we're mid-statement, just skip the comment/blank line.
-            if(_working.isEmpty()) {
-                continue;
-            }
-            // Inside a statement — skip comment but don't flush
-            continue;
-        }
-
-        _working.append(line);
-
-        if(line.endsWith(';')) {
-            startNewStatement();
-        }
+    QStringList result;
+    result.reserve(_ranges.count());
+    for(const SqlScanner::Statement& statement : _ranges) {
+        result.append(statement.text(_sql));
     }
-
-    startNewStatement();
-
-    _valid = _statements.count() > 0;
+    return result;
 }
 
-void SqlParser::startNewStatement()
+QList<QStringView> SqlParser::statementViews() const
 {
-    if(_working.count() == 0) {
-        return;
+    QList<QStringView> result;
+    result.reserve(_ranges.count());
+    for(const SqlScanner::Statement& statement : _ranges) {
+        result.append(statement.view(_sql));
     }
-
-    QString statement;
-    for(const QString& line : _working) {
-        statement.append(line);
-        statement.append('\n');
-    }
-
-    _statements.append(statement);
-    _working.clear();
+    return result;
 }
@@ -0,0 +1,306 @@
+#include "sqlscanner.h"
+
+QString SqlScanner::Statement::text(QStringView buffer) const
+{
+    if(comments.isEmpty()) {
+        return view(buffer).toString();
+    }
+
+    QString result;
+    result.reserve(length());
+    qsizetype pos = start;
+    for(const Comment& comment : comments) {
+        result.append(buffer.mid(pos, comment.start - pos));
+        // A block comment may be the only thing separating two tokens
+        if(buffer.at(comment.start) == '/' && result.isEmpty() == false && result.back().isSpace() == false) {
+            result.append(' ');
+        }
+        pos = qMin(comment.end, end);
+    }
+    result.append(buffer.mid(pos, end - pos));
+    return result.trimmed();
+}
+
+bool SqlScanner::next(QStringView buffer, bool atEnd, Statement* statement)
+{
+    const qsizetype size = buffer.size();
+    while(_pos < size) {
+        switch(_state) {
+        case Normal:
+        {
+            QChar c = buffer.at(_pos);
+            if(c.isSpace()) {
+                if(c == '\n') {
+                    _lineStart = true;
+                }
+                _afterWordChar = false;
+                _pos++;
+                continue;
+            }
+
+            if(c == '-' || c == '/') {
+                // Need the next character to tell an operator from a comment
+                if(_pos + 1 >= size && atEnd == false) {
+                    return false;
+                }
+                QChar following = _pos + 1 < size ? buffer.at(_pos + 1) : QChar();
+                if(c == '-' && following == '-') {
+                    _state = LineComment;
+                    _commentStart = _pos;
+                    _pos += 2;
+                    continue;
+                }
+                if(c == '/' && following == '*') {
+                    _state = BlockComment;
+                    _commentStart = _pos;
+                    _pos += 2;
+                    continue;
+                }
+            }
+            else if(c == '#' && _lineStart) {
+                _state = LineComment;
+                _commentStart = _pos;
+                _pos++;
+                continue;
+            }
+
+            _lineStart = false;
+            if(c == ';') {
+                _afterWordChar = false;
+                if(_start >= 0 && _depth == 0) {
+                    finishStatement(_pos + 1, statement);
+                    _pos++;
+                    return true;
+                }
+                // Empty statement, or a semicolon inside a trigger body
+                _pos++;
+                continue;
+            }
+
+            if(_start < 0) {
+                beginStatement();
+            }
+
+            if(c == '\'') {
+                _state = SingleQuote;
+                _pos++;
+            }
+            else if(c == '"') {
+                _state = DoubleQuote;
+                _pos++;
+            }
+            else if(c == '`') {
+                _state = Backtick;
+                _pos++;
+            }
+            else if(c == '$' && _afterWordChar == false) {
+                // $$ or $tag$ opens a dollar-quoted string; $1 is a positional parameter
+                qsizetype end = _pos + 1;
+                while(end < size && (buffer.at(end).isLetterOrNumber() || buffer.at(end) == '_')) {
+                    end++;
+                }
+                if(end >= size && atEnd == false) {
+                    return false;
+                }
+                if(end < size && buffer.at(end) == '$' && (end == _pos + 1 || buffer.at(_pos + 1).isDigit() == false)) {
+                    _dollarTag = buffer.mid(_pos, end + 1 - _pos).toString();
+                    _state = DollarQuote;
+                    _pos = end + 1;
+                }
+                else {
+                    _afterWordChar = true;
+                    _pos++;
+                }
+            }
+            else if((c.isLetter() || c == '_') && _afterWordChar == false) {
+                qsizetype end = _pos + 1;
+                while(end < size && isWordChar(buffer.at(end))) {
+                    end++;
+                }
+                if(end >= size && atEnd == false) {
+                    return false;
+                }
+                keyword(buffer.mid(_pos, end - _pos));
+                _afterWordChar = true;
+                _pos = end;
+            }
+            else {
+                _afterWordChar = isWordChar(c);
+                _pos++;
+            }
+            break;
+        }
+
+        case SingleQuote:
+        case DoubleQuote:
+        case Backtick:
+        {
+            QChar quote = _state == SingleQuote ? QChar('\'') : _state == DoubleQuote ? QChar('"') : QChar('`');
+            qsizetype end = buffer.indexOf(quote, _pos);
+            if(end < 0) {
+                _pos = size;
+                break;
+            }
+            // A doubled quote is an escaped quote, so look at the following character first
+            if(end + 1 >= size && atEnd == false) {
+                _pos = end;
+                return false;
+            }
+            if(end + 1 < size && buffer.at(end + 1) == quote) {
+                _pos = end + 2;
+                break;
+            }
+            _state = Normal;
+            _afterWordChar = false;
+            _pos = end + 1;
+            break;
+        }
+
+        case LineComment:
+        {
+            qsizetype end = buffer.indexOf(QChar('\n'), _pos);
+            if(end < 0) {
+                _pos = size;
+                break;
+            }
+            endComment(end);
+            _state = Normal;
+            _pos = end;
+            break;
+        }
+
+        case BlockComment:
+        {
+            qsizetype end = buffer.indexOf(u"*/", _pos);
+            if(end < 0) {
+                if(atEnd == false) {
+                    // Keep a trailing '*' which may be completed by the next chunk
+                    _pos = qMax(_pos, size - 1);
+                    return false;
+                }
+                _pos = size;
+                break;
+            }
+            endComment(end + 2);
+            _state = Normal;
+            _afterWordChar = false;
+            _pos = end + 2;
+            break;
+        }
+
+        case DollarQuote:
+        {
+            qsizetype end = buffer.indexOf(QStringView(_dollarTag), _pos);
+            if(end < 0) {
+                if(atEnd == false) {
+                    // Keep a partial closing tag which may be completed by the next chunk
+                    _pos = qMax(_pos, size - _dollarTag.size() + 1);
+                    return false;
+                }
+                _pos = size;
+                break;
+            }
+            _state = Normal;
+            _afterWordChar = false;
+            _pos = end + _dollarTag.size();
+            break;
+        }
+        }
+    }
+
+    if(atEnd == false) {
+        return false;
+    }
+
+    if(_state == LineComment) {
+        endComment(size);
+        _state = Normal;
+    }
+
+    if(_start >= 0) {
+        qsizetype end = size;
+        while(end > _start && buffer.at(end - 1).isSpace()) {
+            end--;
+        }
+        finishStatement(end, statement);
+        return true;
+    }
+    return false;
+}
+
+void SqlScanner::discard(qsizetype count)
+{
+    _pos -= count;
+    if(_start >= 0) {
+        _start -= count;
+    }
+    if(_commentStart >= 0) {
+        _commentStart = qMax(_commentStart - count, qsizetype(0));
+    }
+    for(Statement::Comment& comment : _comments) {
+        comment.start -= count;
+        comment.end -= count;
+    }
+}
+
+void SqlScanner::beginStatement()
+{
+    _start = _pos;
+    _wordIndex = 0;
+    _createStatement = false;
+    _compound = false;
+    _depth = 0;
+    _caseDepth = 0;
+    _comments.clear();
+}
+
+void SqlScanner::endComment(qsizetype end)
+{
+    if(_start >= 0) {
+        Statement::Comment comment;
+        comment.start = _commentStart;
+        comment.end = end;
+        _comments.append(comment);
+    }
+    _commentStart = -1;
+}
+
+void SqlScanner::keyword(QStringView word)
+{
+    if(_wordIndex++ == 0) {
+        _createStatement = word.compare(u"CREATE", Qt::CaseInsensitive) == 0;
+        return;
+    }
+    if(_createStatement == false) {
+        return;
+    }
+
+    // Only trigger bodies contain semicolons outside of quotes; track BEGIN ... END
+    // nesting within them, not counting the END of CASE expressions.
+    if(_compound == false) {
+        _compound = word.compare(u"TRIGGER", Qt::CaseInsensitive) == 0;
+    }
+    else if(word.compare(u"BEGIN", Qt::CaseInsensitive) == 0) {
+        _depth++;
+    }
+    else if(word.compare(u"CASE", Qt::CaseInsensitive) == 0) {
+        _caseDepth++;
+    }
+    else if(word.compare(u"END", Qt::CaseInsensitive) == 0) {
+        if(_caseDepth > 0) {
+            _caseDepth--;
+        }
+        else if(_depth > 0) {
+            _depth--;
+        }
+    }
+}
+
+void SqlScanner::finishStatement(qsizetype end, Statement* statement)
+{
+    statement->start = _start;
+    statement->end = end;
+    statement->comments.swap(_comments);
+    _comments.clear();
+    _start = -1;
+}
@@ -0,0 +1,102 @@
+#include "statementcache.h"
+
+#include <QVariant>
+
+void StatementCache::setCapacity(int value)
+{
+    _capacity = qMax(0, value);
+    evict(_capacity);
+}
+
+const QSqlQuery* StatementCache::find(const QString& sql)
+{
+    if(_capacity == 0) {
+        return nullptr;
+    }
+
+    auto it = _index.constFind(sql);
+    if(it == _index.constEnd()) {
+        _statistics.misses++;
+        return nullptr;
+    }
+
+    EntryList::iterator entry = it.value();
+    if(entry->query.isActive() && entry->query.isSelect()) {
+        // Someone may still be reading rows from it, e.g. an outer loop over the same SQL
+        _statistics.busy++;
+        return nullptr;
+    }
+    if(entry != _entries.begin()) {
+        _entries.splice(_entries.begin(), _entries, entry);
+    }
+
+    QSqlQuery& cached = entry->query;
+    cached.finish();
+    cached.setForwardOnly(false);
+    int boundCount = cached.boundValues().count();
+    for(int i = 0;i < boundCount;i++) {
+        cached.bindValue(i, QVariant());
+    }
+
+    _statistics.hits++;
+    return &cached;
+}
+
+void StatementCache::insert(const QString& sql, const QSqlQuery& query)
+{
+    if(_capacity == 0) {
+        return;
+    }
+
+    auto it = _index.find(sql);
+    if(it != _index.end()) {
+        _entries.erase(it.value());
+        _index.erase(it);
+    }
+
+    evict(_capacity - 1);
+
+    _entries.emplace_front(sql, share(query));
+    _index.insert(sql, _entries.begin());
+}
+
+void StatementCache::clear()
+{
+    _index.clear();
+    _entries.clear();
+}
+
+void StatementCache::invalidate()
+{
+    if(_entries.empty() == false) {
+        _statistics.invalidations++;
+    }
+    clear();
+}
+
+StatementCache::Statistics StatementCache::statistics() const
+{
+    Statistics result = _statistics;
+    result.size = _index.count();
+    result.capacity = _capacity;
+    return result;
+}
+
+QSqlQuery StatementCache::share(const QSqlQuery& query)
+{
+    // QSqlQuery copies share the prepared result, which is exactly what the cache
+    // relies on. Qt discourages copying for that reason, so keep it in one place.
+QT_WARNING_PUSH
+QT_WARNING_DISABLE_DEPRECATED
+    return QSqlQuery(query);
+QT_WARNING_POP
+}
+
+void StatementCache::evict(int keep)
+{
+    while(_index.count() > qMax(0, keep)) {
+        _index.remove(_entries.back().sql);
+        _entries.pop_back();
+        _statistics.evictions++;
+    }
+}
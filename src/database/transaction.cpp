@@ -0,0 +1,35 @@
+#include "transaction.h"
+#include "datasource.h"
+
+Transaction::Transaction(DataSource* dataSource) :
+    _dataSource(dataSource)
+{
+    _depth = _dataSource->beginTransaction();
+}
+
+Transaction::~Transaction()
+{
+    if(isActive()) {
+        rollback();
+    }
+}
+
+bool Transaction::commit()
+{
+    bool result = false;
+    if(isActive()) {
+        result = _dataSource->commitTransaction(_depth);
+        _depth = 0;
+    }
+    return result;
+}
+
+bool Transaction::rollback()
+{
+    bool result = false;
+    if(isActive()) {
+        result = _dataSource->rollbackTransaction(_depth);
+        _depth = 0;
+    }
+    return result;
+}
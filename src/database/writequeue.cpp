@@ -0,0 +1,49 @@
+#include "writequeue.h"
+
+int WriteQueue::enqueue(const Write& write)
+{
+    QMutexLocker locker(&_mutex);
+    _pending.append(write);
+    return _pending.count();
+}
+
+QList<WriteQueue::Write> WriteQueue::take(int maxCount)
+{
+    QMutexLocker locker(&_mutex);
+    QList<Write> result;
+    if(_pending.count() <= maxCount) {
+        result.swap(_pending);
+    }
+    else {
+        result = _pending.mid(0, maxCount);
+        _pending.remove(0, maxCount);
+    }
+    return result;
+}
+
+int WriteQueue::count() const
+{
+    QMutexLocker locker(&_mutex);
+    return _pending.count();
+}
+
+void WriteQueue::recordBatch(int writes, int failures)
+{
+    QMutexLocker locker(&_mutex);
+    _statistics.writes += writes;
+    _statistics.failures += failures;
+    _statistics.batches++;
+    _statistics.largestBatch = qMax(_statistics.largestBatch, writes);
+}
+
+WriteQueue::Statistics WriteQueue::statistics() const
+{
+    QMutexLocker locker(&_mutex);
+    return _statistics;
+}
+
+void WriteQueue::resetStatistics()
+{
+    QMutexLocker locker(&_mutex);
+    _statistics = Statistics();
+}
@@ -0,0 +1,394 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <QUuid>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/querycolumnbinding.h>
+#include <Kanoop/database/sqlbuilder.h>
+#include <Kanoop/database/sqlparser.h>
+#include <QTextStream>
+
+// Benchmarks for regression tracking between releases.
+//
+// Not run by ctest. Build the run_bench_kanoopdatabase target, which writes
+// bench_kanoopdatabase.xml and bench_kanoopdatabase.csv to the build directory,
+// or run the executable directly with any QtTest output options.
+
+class BenchDataSource : public DataSource
+{
+public:
+    BenchDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::prepareQuery;
+    using DataSource::executeQuery;
+    using DataSource::bulkInsert;
+    using DataSource::loadAll;
+    using DataSource::escapedString;
+    using DataSource::commaDelimitedIntList;
+    using DataSource::commaDelimitedStringList;
+    using DataSource::commaDelimitedUuidList;
+
+protected:
+    QString createSql() const override
+    {
+        return
+            "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT, a INTEGER, b INTEGER, c REAL, d TEXT);\n"
+            "CREATE TABLE bulk (id INTEGER PRIMARY KEY, name TEXT, value REAL);";
+    }
+};
+
+class BenchItem : public QueryLoadable
+{
+public:
+    bool loadFromQuery(const QSqlQuery& query) override
+    {
+        id = query.value("id").toInt();
+        name = query.value("name").toString();
+        a = query.value("a").toInt();
+        b = query.value("b").toInt();
+        c = query.value("c").toDouble();
+        d = query.value("d").toString();
+        return true;
+    }
+
+    int id = 0;
+    QString name;
+    int a = 0;
+    int b = 0;
+    double c = 0;
+    QString d;
+};
+
+class BoundBenchItem : public BenchItem
+{
+public:
+    bool loadFromQuery(const QSqlQuery& query) override
+    {
+        enum { Id, Name, A, B, C, D };
+        static constexpr const char* Columns[] = { "id", "name", "a", "b", "c", "d" };
+        const auto& columns = bindColumns<BoundBenchItem>(query, Columns);
+        id = columns.value(query, Id).toInt();
+        name = columns.value(query, Name).toString();
+        a = columns.value(query, A).toInt();
+        b = columns.value(query, B).toInt();
+        c = columns.value(query, C).toDouble();
+        d = columns.value(query, D).toString();
+        return columns.isComplete();
+    }
+};
+
+class DynamicBoundBenchItem : public BenchItem
+{
+public:
+    bool loadFromQuery(const QSqlQuery& query) override
+    {
+        enum { Id, Name, A, B, C, D };
+        static thread_local QueryColumnBinding binding({ "id", "name", "a", "b", "c", "d" });
+        binding.bind(query);
+        id = binding.value(query, Id).toInt();
+        name = binding.value(query, Name).toString();
+        a = binding.value(query, A).toInt();
+        b = binding.value(query, B).toInt();
+        c = binding.value(query, C).toDouble();
+        d = binding.value(query, D).toString();
+        return binding.isComplete();
+    }
+};
+
+static const int LoadRowCount = 10000;
+
+// The QTextStream implementations SqlBuilder replaced, kept as a baseline
+static QString textStreamEscapedString(const QString& unescaped)
+{
+    QString result;
+    QTextStream output(&result);
+    for(int i = 0;i < unescaped.length();i++) {
+        QChar thisChar = unescaped.at(i);
+        if(thisChar == '\'') {
+            output << '\'';
+            output << thisChar;
+        }
+        else if(thisChar.isNull()) {
+            output << '?';
+        }
+        else {
+            output << thisChar;
+        }
+    }
+    return result;
+}
+
+static QString textStreamIntList(const QList<int>& list)
+{
+    QString result;
+    QTextStream output(&result);
+    for(int i = 0;i < list.length();i++) {
+        output << list.at(i);
+        if(i < list.length() - 1) {
+            output << ',';
+        }
+    }
+    return result;
+}
+
+class BenchKanoopDatabase : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(_tmpDir.isValid());
+        _ds = new BenchDataSource(DatabaseCredentials(_tmpDir.path() + "/bench.db"));
+        QVERIFY(_ds->openConnection());
+        _ds->setStatementCacheSize(16);
+
+        QList<QVariantList> columns(6);
+        for(int i = 0;i < LoadRowCount;i++) {
+            columns[0].append(i);
+            columns[1].append(QString("name%1").arg(i));
+            columns[2].append(i * 2);
+            columns[3].append(i * 3);
+            columns[4].append(i / 3.0);
+            columns[5].append(QString("d%1").arg(i));
+        }
+        QVERIFY(_ds->bulkInsert("items", { "id", "name", "a", "b", "c", "d" }, columns));
+    }
+
+    void cleanupTestCase()
+    {
+        _ds->closeConnection();
+        delete _ds;
+        _ds = nullptr;
+    }
+
+    void openClose()
+    {
+        BenchDataSource ds(_ds->credentials());
+        QBENCHMARK {
+            QVERIFY(ds.openConnection());
+            QVERIFY(ds.closeConnection());
+        }
+    }
+
+    void insertSingleRow_data()
+    {
+        QTest::addColumn<int>("cacheSize");
+        QTest::newRow("uncached") << 0;
+        QTest::newRow("statementCache") << 16;
+    }
+
+    void insertSingleRow()
+    {
+        QFETCH(int, cacheSize);
+        _ds->setStatementCacheSize(cacheSize);
+        QBENCHMARK {
+            bool success;
+            QSqlQuery query = _ds->prepareQuery("INSERT INTO bulk (name, value) VALUES (?, ?)", &success);
+            query.addBindValue(QStringLiteral("single"));
+            query.addBindValue(1.5);
+            QVERIFY(success && _ds->executeQuery(query));
+        }
+        _ds->setStatementCacheSize(16);
+    }
+
+    void selectSingleRow_data()
+    {
+        QTest::addColumn<bool>("metrics");
+        QTest::newRow("plain") << false;
+        QTest::newRow("metricsEnabled") << true;
+    }
+
+    void selectSingleRow()
+    {
+        QFETCH(bool, metrics);
+        _ds->setMetricsEnabled(metrics);
+        int id = 0;
+        QBENCHMARK {
+            bool success;
+            QSqlQuery query = _ds->prepareQuery("SELECT name FROM items WHERE id = ?", &success);
+            query.addBindValue(id++ % LoadRowCount);
+            QVERIFY(success && _ds->executeQuery(query));
+            QVERIFY(query.next());
+            query.finish();
+        }
+        _ds->setMetricsEnabled(false);
+        _ds->metrics().reset();
+    }
+
+    void batchInsert_data()
+    {
+        QTest::addColumn<int>("rows");
+        QTest::newRow("1000") << 1000;
+        QTest::newRow("100000") << 100000;
+    }
+
+    void batchInsert()
+    {
+        QFETCH(int, rows);
+        QList<QVariantList> columns(2);
+        for(int i = 0;i < rows;i++) {
+            columns[0].append(QString("bulk%1").arg(i));
+            columns[1].append(i * 0.5);
+        }
+        QBENCHMARK {
+            QVERIFY(_ds->bulkInsert("bulk", { "name", "value" }, columns));
+        }
+    }
+
+    void loadAll_data()
+    {
+        QTest::addColumn<int>("mode");
+        QTest::newRow("byName") << 0;
+        QTest::newRow("dynamicBinding") << 1;
+        QTest::newRow("boundColumns") << 2;
+    }
+
+    void loadAll()
+    {
+        QFETCH(int, mode);
+        const QString sql = "SELECT id, name, a, b, c, d FROM items";
+        QBENCHMARK {
+            bool success;
+            int count;
+            switch(mode) {
+            case 0:
+                count = _ds->loadAll<BenchItem>(sql, {}, LoadRowCount, &success).count();
+                break;
+            case 1:
+                count = _ds->loadAll<DynamicBoundBenchItem>(sql, {}, LoadRowCount, &success).count();
+                break;
+            default:
+                count = _ds->loadAll<BoundBenchItem>(sql, {}, LoadRowCount, &success).count();
+                break;
+            }
+            QVERIFY(success && count == LoadRowCount);
+        }
+    }
+
+    void sqlParser_largeScript()
+    {
+        QString script;
+        for(int i = 0;i < 5000;i++) {
+            script += QString("-- table %1\n"
+                              "CREATE TABLE t%1 (\n"
+                              "    id INTEGER PRIMARY KEY,\n"
+                              "    name TEXT NOT NULL DEFAULT 'x;y'\n"
+                              ");\n"
+                              "INSERT INTO t%1 (id, name) VALUES (%1, 'row %1');\n\n").arg(i);
+        }
+        QBENCHMARK {
+            SqlParser parser(script);
+            QVERIFY(parser.isValid());
+        }
+    }
+
+    void escapedString_large()
+    {
+        QString input = QString("It's a 'quoted' \\ string ").repeated(40000);
+        QBENCHMARK {
+            QString escaped = BenchDataSource::escapedString(input);
+            QVERIFY(escaped.length() > input.length());
+        }
+    }
+
+    void commaDelimitedIntList_large()
+    {
+        QList<int> values;
+        for(int i = 0;i < 100000;i++) {
+            values.append(i);
+        }
+        QBENCHMARK {
+            QVERIFY(BenchDataSource::commaDelimitedIntList(values).isEmpty() == false);
+        }
+    }
+
+    void commaDelimitedStringList_large()
+    {
+        QStringList values;
+        for(int i = 0;i < 100000;i++) {
+            values.append(QString("name'%1").arg(i));
+        }
+        QBENCHMARK {
+            QVERIFY(BenchDataSource::commaDelimitedStringList(values).isEmpty() == false);
+        }
+    }
+
+    void commaDelimitedUuidList_large()
+    {
+        QList<QUuid> values;
+        for(int i = 0;i < 100000;i++) {
+            values.append(QUuid::createUuid());
+        }
+        QBENCHMARK {
+            QVERIFY(BenchDataSource::commaDelimitedUuidList(values).isEmpty() == false);
+        }
+    }
+
+    void escapedString_vsTextStream_data()
+    {
+        QTest::addColumn<bool>("builder");
+        QTest::addColumn<QString>("input");
+        QString quoted = QString("It's a 'quoted' string ").repeated(40000);
+        QString plain = QString("An unquoted string ").repeated(40000);
+        QTest::newRow("textStream/quoted") << false << quoted;
+        QTest::newRow("sqlBuilder/quoted") << true << quoted;
+        QTest::newRow("textStream/plain") << false << plain;
+        QTest::newRow("sqlBuilder/plain") << true << plain;
+    }
+
+    void escapedString_vsTextStream()
+    {
+        QFETCH(bool, builder);
+        QFETCH(QString, input);
+        QBENCHMARK {
+            QString escaped = builder ? SqlBuilder::escaped(input) : textStreamEscapedString(input);
+            QVERIFY(escaped.length() >= input.length());
+        }
+    }
+
+    void commaDelimitedIntList_vsTextStream_data()
+    {
+        QTest::addColumn<bool>("builder");
+        QTest::newRow("textStream") << false;
+        QTest::newRow("sqlBuilder") << true;
+    }
+
+    void commaDelimitedIntList_vsTextStream()
+    {
+        QFETCH(bool, builder);
+        QList<int> values;
+        for(int i = 0;i < 100000;i++) {
+            values.append(i * 7919);
+        }
+        QBENCHMARK {
+            QString list = builder ? BenchDataSource::commaDelimitedIntList(values) : textStreamIntList(values);
+            QVERIFY(list.isEmpty() == false);
+        }
+    }
+
+    void sqlBuilder_insertStatement()
+    {
+        QUuid uuid = QUuid::createUuid();
+        QDateTime timestamp = QDateTime::currentDateTimeUtc();
+        QBENCHMARK {
+            SqlBuilder builder(16 * 1024);
+            builder.append(u"INSERT INTO events (id, uuid, at, note) VALUES ");
+            for(int i = 0;i < 100;i++) {
+                if(i > 0) {
+                    builder.append(u',');
+                }
+                builder.append(u'(').appendNumber(i).append(u',').appendUuid(uuid).append(u',')
+                       .appendTimestamp(timestamp).append(u',').appendString(u"it's row").append(u')');
+            }
+            QVERIFY(builder.length() > 0);
+        }
+    }
+
+private:
+    QTemporaryDir _tmpDir;
+    BenchDataSource* _ds = nullptr;
+};
+
+QTEST_MAIN(BenchKanoopDatabase)
+#include "bench_kanoopdatabase.moc"
@@ -0,0 +1,178 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <QThread>
+#include <Kanoop/commonexception.h>
+#include <Kanoop/database/asyncdatasource.h>
+#include <Kanoop/database/datasource.h>
+
+class AsyncTestDataSource : public DataSource
+{
+public:
+    using DataSource::executeQuery;
+
+    Qt::HANDLE openedOnThread() const { return _openedOnThread; }
+
+protected:
+    QString createSql() const override
+    {
+        return "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT);";
+    }
+
+    bool migrate() override
+    {
+        _openedOnThread = QThread::currentThreadId();
+        return true;
+    }
+
+private:
+    Qt::HANDLE _openedOnThread = nullptr;
+};
+
+class TstAsyncDataSource : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        QVERIFY(_tmpDir.isValid());
+        _async = new AsyncDataSource(DatabaseCredentials(_tmpDir.path() + QString("/async%1.db").arg(_serial++)),
+                                     AsyncDataSource::factory<AsyncTestDataSource>());
+        QVERIFY(_async->start());
+        QVERIFY(_async->isRunning());
+    }
+
+    void cleanup()
+    {
+        delete _async;
+        _async = nullptr;
+    }
+
+    void submit_runsOnWorkerThread()
+    {
+        Qt::HANDLE caller = QThread::currentThreadId();
+        QFuture<QList<Qt::HANDLE>> future = _async->submit([](DataSource* dataSource) {
+            AsyncTestDataSource* ds = static_cast<AsyncTestDataSource*>(dataSource);
+            return QList<Qt::HANDLE>({ ds->openedOnThread(), QThread::currentThreadId() });
+        });
+        QList<Qt::HANDLE> threads = future.result();
+        QCOMPARE(threads.at(0), threads.at(1));
+        QVERIFY(threads.at(1) != caller);
+    }
+
+    void submit_void()
+    {
+        QFuture<void> future = _async->submit([](DataSource* dataSource) {
+            static_cast<AsyncTestDataSource*>(dataSource)->executeQuery("INSERT INTO items (id, name) VALUES (1, 'one')");
+        });
+        future.waitForFinished();
+
+        QueryResult result = _async->execute("SELECT COUNT(*) FROM items").result();
+        QCOMPARE(result.value(0, 0).toInt(), 1);
+    }
+
+    void execute_withBindings()
+    {
+        _async->execute("INSERT INTO items (id, name) VALUES (?, ?)", { 1, "one" });
+        _async->execute("INSERT INTO items (id, name) VALUES (?, ?)", { 2, "two" });
+        QueryResult result = _async->execute("SELECT id, name FROM items WHERE id = ?", { 2 }).result();
+
+        QCOMPARE(result.columns(), QStringList({ "id", "name" }));
+        QCOMPARE(result.rowCount(), 1);
+        QCOMPARE(result.value(0, "NAME").toString(), QString("two"));
+        QCOMPARE(result.columnIndex("missing"), -1);
+        QVERIFY(!result.value(0, "missing").isValid());
+    }
+
+    void execute_failureSurfacesAsException()
+    {
+        QFuture<QueryResult> future = _async->execute("SELECT * FROM no_such_table");
+        bool caught = false;
+        try
+        {
+            future.waitForFinished();
+        }
+        catch(const CommonException& e)
+        {
+            caught = true;
+            QVERIFY(!e.message().isEmpty());
+        }
+        QVERIFY(caught);
+
+        // The worker carries on after a failure
+        QCOMPARE(_async->execute("SELECT 1").result().value(0, 0).toInt(), 1);
+    }
+
+    void execute_readFailureSurfacesAsException()
+    {
+        // Fails with "integer overflow" on the third row, after two have been read
+        QFuture<QueryResult> future = _async->execute("WITH n (id) AS (VALUES (1), (2), (3)) "
+                                                      "SELECT id, abs(id - 9223372036854775807 - 4) FROM n");
+        QVERIFY_THROWS_EXCEPTION(CommonException, future.waitForFinished());
+    }
+
+    void execute_continuation()
+    {
+        QFuture<int> future = _async->execute("SELECT 41")
+            .then([](const QueryResult& result) { return result.value(0, 0).toInt() + 1; });
+        QCOMPARE(future.result(), 42);
+    }
+
+    void execute_preservesSubmissionOrder()
+    {
+        const int count = 200;
+        QList<QFuture<QueryResult>> futures;
+        for(int i = 0;i < count;i++) {
+            futures.append(_async->execute("INSERT INTO items (id, name) VALUES (?, ?)", { i, QString::number(i) }));
+        }
+        for(const QFuture<QueryResult>& future : std::as_const(futures)) {
+            QCOMPARE(future.result().numRowsAffected(), 1);
+        }
+
+        QueryResult result = _async->execute("SELECT id FROM items ORDER BY rowid").result();
+        QCOMPARE(result.rowCount(), count);
+        for(int i = 0;i < count;i++) {
+            QCOMPARE(result.value(i, 0).toInt(), i);
+        }
+        QCOMPARE(_async->pendingCount(), 0);
+    }
+
+    void submit_queuedWriteCompletes()
+    {
+        // The batch is flushed by the worker's event loop
+        QFuture<int> write = _async->submit([](DataSource* dataSource) {
+            return dataSource->queueWrite("INSERT INTO items (id, name) VALUES (?, ?)", { 1, "one" });
+        }).result();
+        QTRY_VERIFY_WITH_TIMEOUT(write.isFinished(), 5000);
+        QCOMPARE(write.result(), 1);
+
+        QueryResult result = _async->execute("SELECT COUNT(*) FROM items").result();
+        QCOMPARE(result.value(0, 0).toInt(), 1);
+    }
+
+    void stop_completesQueuedWork()
+    {
+        QFuture<QueryResult> future = _async->execute("INSERT INTO items (id, name) VALUES (1, 'one')");
+        _async->stop();
+        QVERIFY(!_async->isRunning());
+        QVERIFY(future.isFinished());
+        QCOMPARE(future.result().numRowsAffected(), 1);
+    }
+
+    void submit_whenNotRunning()
+    {
+        _async->stop();
+        QFuture<int> future = _async->submit([](DataSource*) { return 1; });
+        QVERIFY(future.isFinished());
+        QVERIFY_THROWS_EXCEPTION(CommonException, future.result());
+    }
+
+private:
+    QTemporaryDir _tmpDir;
+    AsyncDataSource* _async = nullptr;
+    int _serial = 0;
+};
+
+QTEST_MAIN(TstAsyncDataSource)
+#include "tst_asyncdatasource.moc"
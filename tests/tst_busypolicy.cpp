@@ -0,0 +1,286 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QUuid>
+#include <Kanoop/database/busypolicy.h>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/transaction.h>
+
+class LockedDataSource : public DataSource
+{
+public:
+    LockedDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::executeQuery;
+
+    bool insert(const QString& name)
+    {
+        bool success;
+        executeQuery(QString("INSERT INTO items (name) VALUES ('%1')").arg(name), &success);
+        return success;
+    }
+
+    int count()
+    {
+        bool success;
+        QSqlQuery query = executeQuery("SELECT COUNT(*) FROM items", &success);
+        return success && query.next() ? query.value(0).toInt() : -1;
+    }
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT);"; }
+};
+
+// A policy which fails fast inside SQLite, so that only the policy's retries wait
+static BusyPolicy noTimeoutPolicy(int maxRetries)
+{
+    BusyPolicy policy;
+    policy.setBusyTimeout(0);
+    policy.setMaxRetries(maxRetries);
+    policy.setInitialBackoffMs(5);
+    policy.setMaxBackoffMs(20);
+    policy.setRetryWrites(true);
+    return policy;
+}
+
+class TstBusyPolicy : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        QVERIFY(_tmpDir.isValid());
+        _path = QString("%1/%2.db").arg(_tmpDir.path()).arg(QTest::currentTestFunction());
+        _holder = new LockedDataSource((DatabaseCredentials(_path)));
+        QVERIFY(_holder->openConnection());
+    }
+
+    void cleanup()
+    {
+        _holder->closeConnection();
+        delete _holder;
+        _holder = nullptr;
+    }
+
+    void defaults()
+    {
+        BusyPolicy policy;
+        QCOMPARE(policy.busyTimeout(), -1);
+        QCOMPARE(policy.maxRetries(), 0);
+        QVERIFY(!policy.retryWrites());
+        QVERIFY(!policy.immediateTransactions());
+        QVERIFY(BusyPolicy::contended().immediateTransactions());
+        QVERIFY(BusyPolicy::contended().maxRetries() > 0);
+    }
+
+    void backoff_doublesToLimit()
+    {
+        BusyPolicy policy;
+        policy.setInitialBackoffMs(10);
+        policy.setMaxBackoffMs(100);
+        QCOMPARE(policy.backoffMs(0), 10);
+        QCOMPARE(policy.backoffMs(1), 20);
+        QCOMPARE(policy.backoffMs(3), 80);
+        QCOMPARE(policy.backoffMs(4), 100);
+        QCOMPARE(policy.backoffMs(1000), 100);
+    }
+
+    void isBusyError_codes()
+    {
+        QVERIFY(BusyPolicy::isBusyError(QSqlError("database is locked", QString(), QSqlError::StatementError, "5")));
+        QVERIFY(BusyPolicy::isBusyError(QSqlError("database table is locked", QString(), QSqlError::StatementError, "6")));
+        // SQLITE_BUSY_SNAPSHOT
+        QVERIFY(BusyPolicy::isBusyError(QSqlError(QString(), QString(), QSqlError::StatementError, "517")));
+        QVERIFY(!BusyPolicy::isBusyError(QSqlError("constraint failed", QString(), QSqlError::StatementError, "19")));
+        QVERIFY(!BusyPolicy::isBusyError(QSqlError()));
+    }
+
+    void busyTimeout_applied()
+    {
+        LockedDataSource ds((DatabaseCredentials(_path)));
+        BusyPolicy policy;
+        policy.setBusyTimeout(1234);
+        ds.setBusyPolicy(policy);
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.currentSqliteProfile().busyTimeout(), 1234);
+        ds.closeConnection();
+    }
+
+    void locked_givesUpAfterRetries()
+    {
+        LockedDataSource ds((DatabaseCredentials(_path)));
+        ds.setBusyPolicy(noTimeoutPolicy(3));
+        ds.setMetricsEnabled(true);
+        QVERIFY(ds.openConnection());
+
+        Transaction transaction(_holder);
+        QVERIFY(_holder->insert("held"));
+        QVERIFY(!ds.insert("blocked"));
+
+        DataSourceMetrics::StatementStatistics totals = ds.metrics().totals();
+        QCOMPARE(totals.lockWaits, qint64(1));
+        QCOMPARE(totals.lockRetries, qint64(3));
+        QCOMPARE(totals.lockTimeouts, qint64(1));
+        QVERIFY(totals.lockWaitUsecs > 0);
+        QVERIFY(ds.metrics().toPrometheus().contains("kanoop_db_statement_lock_retries_total"));
+        ds.closeConnection();
+    }
+
+    void locked_writesNotRetriedByDefault()
+    {
+        LockedDataSource ds((DatabaseCredentials(_path)));
+        BusyPolicy policy = noTimeoutPolicy(3);
+        policy.setRetryWrites(false);
+        ds.setBusyPolicy(policy);
+        ds.setMetricsEnabled(true);
+        QVERIFY(ds.openConnection());
+
+        Transaction transaction(_holder);
+        QVERIFY(_holder->insert("held"));
+        QVERIFY(!ds.insert("blocked"));
+        QCOMPARE(ds.metrics().totals().lockWaits, qint64(1));
+        QCOMPARE(ds.metrics().totals().lockRetries, qint64(0));
+        ds.closeConnection();
+    }
+
+    void locked_retrySucceedsOnceReleased()
+    {
+        _holder->closeConnection();
+
+        // Another connection holds the write lock for a while on its own thread
+        QSemaphore locked;
+        QString path = _path;
+        QThread* thread = QThread::create([path, &locked]() {
+            QString connectionName = QUuid::createUuid().toString(QUuid::WithoutBraces);
+            {
+                QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+                db.setDatabaseName(path);
+                db.open();
+                QSqlQuery query(db);
+                query.exec("BEGIN IMMEDIATE");
+                query.exec("INSERT INTO items (name) VALUES ('first')");
+                locked.release();
+                QThread::msleep(100);
+                query.exec("COMMIT");
+                db.close();
+            }
+            QSqlDatabase::removeDatabase(connectionName);
+        });
+        thread->start();
+        locked.acquire();
+
+        LockedDataSource ds((DatabaseCredentials(_path)));
+        BusyPolicy policy = noTimeoutPolicy(50);
+        policy.setMaxBackoffMs(10);
+        ds.setBusyPolicy(policy);
+        ds.setMetricsEnabled(true);
+        QVERIFY(ds.openConnection());
+        QVERIFY(ds.insert("second"));
+        QVERIFY(thread->wait(5000));
+        delete thread;
+
+        QCOMPARE(ds.count(), 2);
+        QVERIFY(ds.metrics().totals().lockRetries > 0);
+        QCOMPARE(ds.metrics().totals().lockTimeouts, qint64(0));
+        ds.closeConnection();
+    }
+
+    void locked_busyTimeoutWaitCounted()
+    {
+        _holder->closeConnection();
+
+        QSemaphore locked;
+        QString path = _path;
+        QThread* thread = QThread::create([path, &locked]() {
+            QString connectionName = QUuid::createUuid().toString(QUuid::WithoutBraces);
+            {
+                QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+                db.setDatabaseName(path);
+                db.open();
+                QSqlQuery query(db);
+                query.exec("BEGIN IMMEDIATE");
+                locked.release();
+                QThread::msleep(100);
+                query.exec("COMMIT");
+                db.close();
+            }
+            QSqlDatabase::removeDatabase(connectionName);
+        });
+        thread->start();
+        locked.acquire();
+
+        // SQLite's busy timeout outwaits the lock, so the statement never reports it was locked
+        LockedDataSource ds((DatabaseCredentials(_path)));
+        BusyPolicy policy;
+        policy.setBusyTimeout(5000);
+        ds.setBusyPolicy(policy);
+        ds.setMetricsEnabled(true);
+        QVERIFY(ds.openConnection());
+        QVERIFY(ds.insert("waited"));
+        QVERIFY(thread->wait(5000));
+        delete thread;
+
+        DataSourceMetrics::StatementStatistics totals = ds.metrics().totals();
+        QCOMPARE(totals.lockRetries, qint64(0));
+        QCOMPARE(totals.lockTimeouts, qint64(0));
+        if(DataSource::isNativeSqliteAvailable()) {
+            QCOMPARE(totals.lockWaits, qint64(1));
+            QVERIFY(totals.lockWaitUsecs > 0);
+        }
+        else {
+            // Documented limitation: the wait happens entirely inside SQLite
+            QCOMPARE(totals.lockWaits, qint64(0));
+        }
+        ds.closeConnection();
+    }
+
+    void immediateTransactions_failAtBegin()
+    {
+        LockedDataSource deferred((DatabaseCredentials(_path)));
+        deferred.setBusyPolicy(noTimeoutPolicy(0));
+        QVERIFY(deferred.openConnection());
+
+        BusyPolicy policy = noTimeoutPolicy(0);
+        policy.setImmediateTransactions(true);
+        LockedDataSource immediate((DatabaseCredentials(_path)));
+        immediate.setBusyPolicy(policy);
+        QVERIFY(immediate.openConnection());
+
+        {
+            Transaction held(_holder);
+            QVERIFY(_holder->insert("held"));
+
+            // A deferred transaction begins, then fails at its first write
+            Transaction first(&deferred);
+            QVERIFY(first.isActive());
+            QVERIFY(!deferred.insert("late"));
+            first.rollback();
+
+            // An immediate transaction fails at BEGIN, before any work is done
+            Transaction second(&immediate);
+            QVERIFY(!second.isActive());
+        }
+
+        Transaction transaction(&immediate);
+        QVERIFY(transaction.isActive());
+        QVERIFY(immediate.insert("now"));
+        QVERIFY(transaction.commit());
+        QCOMPARE(immediate.count(), 1);
+        deferred.closeConnection();
+        immediate.closeConnection();
+    }
+
+private:
+    QTemporaryDir _tmpDir;
+    QString _path;
+    LockedDataSource* _holder = nullptr;
+};
+
+QTEST_MAIN(TstBusyPolicy)
+#include "tst_busypolicy.moc"
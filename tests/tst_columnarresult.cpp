@@ -0,0 +1,179 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <Kanoop/database/columnarresult.h>
+#include <Kanoop/database/datasource.h>
+
+class ColumnarDataSource : public DataSource
+{
+public:
+    ColumnarDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::fetchColumns;
+    using DataSource::bulkInsertRows;
+
+    bool fill(int count)
+    {
+        QList<QVariantList> rows;
+        for(int i = 0;i < count;i++) {
+            rows.append({ i, i * 0.5, QString("name %1").arg(i), QByteArray(i % 4, char(i)), i % 10 == 0 ? QVariant() : QVariant(i) });
+        }
+        return bulkInsertRows("items", { "id", "price", "name", "data", "maybe" }, rows);
+    }
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, price REAL, name TEXT, data BLOB, maybe INTEGER);"; }
+};
+
+class TstColumnarResult : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void column_appendsAndReads()
+    {
+        ColumnarResult::Column integers("n", ColumnarResult::Integer);
+        for(int i = 0;i < 20;i++) {
+            if(i % 7 == 3) {
+                integers.appendNull();
+            }
+            else {
+                integers.appendInteger(i);
+            }
+        }
+        QCOMPARE(integers.rowCount(), 20);
+        QCOMPARE(integers.nullCount(), 3);
+        QCOMPARE(integers.nullBitmap().size(), 3);
+        QVERIFY(integers.isNull(3));
+        QVERIFY(integers.isNull(17));
+        QVERIFY(!integers.isNull(16));
+        QCOMPARE(integers.integer(16), qint64(16));
+        QCOMPARE(integers.integer(3), qint64(0));
+        QCOMPARE(integers.value(5), QVariant(qint64(5)));
+        QVERIFY(!integers.value(10).isValid());
+
+        ColumnarResult::Column text("s", ColumnarResult::Text);
+        text.appendValue(QString::fromUtf8("caf\xc3\xa9"));
+        text.appendNull();
+        text.appendValue(QString(""));
+        text.appendBytes("abc", 3);
+        QCOMPARE(text.offsets(), QVector<qint64>({ 0, 5, 5, 5, 8 }));
+        QCOMPARE(text.arena(), QByteArray("caf\xc3\xa9" "abc"));
+        QCOMPARE(text.text(0), QString::fromUtf8("caf\xc3\xa9"));
+        QVERIFY(text.text(1).isNull());
+        QVERIFY(!text.text(2).isNull());
+        QVERIFY(text.text(2).isEmpty());
+        QCOMPARE(text.bytes(3).toByteArray(), QByteArray("abc"));
+    }
+
+    void typeFor_mapsMetaTypes()
+    {
+        QCOMPARE(ColumnarResult::typeFor(QMetaType(QMetaType::Int)), ColumnarResult::Integer);
+        QCOMPARE(ColumnarResult::typeFor(QMetaType(QMetaType::LongLong)), ColumnarResult::Integer);
+        QCOMPARE(ColumnarResult::typeFor(QMetaType(QMetaType::Bool)), ColumnarResult::Integer);
+        QCOMPARE(ColumnarResult::typeFor(QMetaType(QMetaType::Double)), ColumnarResult::Real);
+        QCOMPARE(ColumnarResult::typeFor(QMetaType(QMetaType::QByteArray)), ColumnarResult::Blob);
+        QCOMPARE(ColumnarResult::typeFor(QMetaType(QMetaType::QString)), ColumnarResult::Text);
+        QCOMPARE(ColumnarResult::typeFor(QMetaType()), ColumnarResult::Text);
+    }
+
+    void fetchColumns_decodesTable()
+    {
+        static const int Rows = 10000;
+
+        QTemporaryDir tmpDir;
+        ColumnarDataSource ds((DatabaseCredentials(tmpDir.path() + "/columns.db")));
+        QVERIFY(ds.openConnection());
+        QVERIFY(ds.fill(Rows));
+
+        bool success;
+        ColumnarResult result = ds.fetchColumns("SELECT id, price, name, data, maybe FROM items ORDER BY id", QVariantList(), QList<ColumnarResult::Type>(), &success);
+        QVERIFY(success);
+        QCOMPARE(result.isNative(), DataSource::isNativeSqliteAvailable());
+        QCOMPARE(result.rowCount(), Rows);
+        QCOMPARE(result.columnNames(), QStringList({ "id", "price", "name", "data", "maybe" }));
+        QCOMPARE(result.columnIndex("NAME"), 2);
+        QCOMPARE(result.columnIndex("missing"), -1);
+
+        const ColumnarResult::Column& ids = result.column(0);
+        const ColumnarResult::Column& prices = result.column(1);
+        const ColumnarResult::Column& names = result.column(2);
+        const ColumnarResult::Column& data = result.column(3);
+        const ColumnarResult::Column& maybe = result.column(4);
+        QCOMPARE(ids.type(), ColumnarResult::Integer);
+        QCOMPARE(prices.type(), ColumnarResult::Real);
+        QCOMPARE(names.type(), ColumnarResult::Text);
+        QCOMPARE(maybe.type(), ColumnarResult::Integer);
+
+        qint64 idSum = 0;
+        double priceSum = 0;
+        qint64 maybeSum = 0;
+        for(int i = 0;i < Rows;i++) {
+            idSum += ids.integer(i);
+            priceSum += prices.real(i);
+            maybeSum += maybe.integer(i);
+        }
+        QCOMPARE(idSum, qint64(Rows) * (Rows - 1) / 2);
+        QCOMPARE(priceSum, idSum * 0.5);
+        QCOMPARE(maybe.nullCount(), Rows / 10);
+        QVERIFY(maybe.isNull(0));
+        QVERIFY(!maybe.isNull(1));
+        QCOMPARE(maybeSum, idSum - qint64(Rows / 10) * (Rows - 10) / 2);
+        QCOMPARE(names.text(1234), QStringLiteral("name 1234"));
+        QCOMPARE(names.nullCount(), 0);
+        QCOMPARE(data.bytes(7).toByteArray(), QByteArray(3, char(7)));
+        QCOMPARE(data.bytes(8).size(), qsizetype(0));
+        ds.closeConnection();
+    }
+
+    void fetchColumns_typeOverridesAndBindings()
+    {
+        QTemporaryDir tmpDir;
+        ColumnarDataSource ds((DatabaseCredentials(tmpDir.path() + "/override.db")));
+        QVERIFY(ds.openConnection());
+        QVERIFY(ds.fill(100));
+
+        bool success;
+        ColumnarResult result = ds.fetchColumns("SELECT id, price FROM items WHERE id >= ? ORDER BY id", { 90 },
+                                                { ColumnarResult::Text, ColumnarResult::Integer }, &success);
+        QVERIFY(success);
+        QCOMPARE(result.rowCount(), 10);
+        QCOMPARE(result.column(0).type(), ColumnarResult::Text);
+        QCOMPARE(result.column(0).text(0), QStringLiteral("90"));
+        QCOMPARE(result.column(1).type(), ColumnarResult::Integer);
+        QCOMPARE(result.column(1).integer(2), qint64(46));
+        ds.closeConnection();
+    }
+
+    void fetchColumns_emptyResultKeepsColumns()
+    {
+        QTemporaryDir tmpDir;
+        ColumnarDataSource ds((DatabaseCredentials(tmpDir.path() + "/empty.db")));
+        QVERIFY(ds.openConnection());
+
+        bool success;
+        ColumnarResult result = ds.fetchColumns("SELECT id, name FROM items", QVariantList(), QList<ColumnarResult::Type>(), &success);
+        QVERIFY(success);
+        QCOMPARE(result.rowCount(), 0);
+        QCOMPARE(result.columnCount(), 2);
+        QCOMPARE(result.column(1).offsets(), QVector<qint64>({ 0 }));
+        ds.closeConnection();
+    }
+
+    void fetchColumns_failsOnBadSql()
+    {
+        QTemporaryDir tmpDir;
+        ColumnarDataSource ds((DatabaseCredentials(tmpDir.path() + "/bad.db")));
+        QVERIFY(ds.openConnection());
+
+        bool success;
+        ColumnarResult result = ds.fetchColumns("SELECT nothing FROM nowhere", QVariantList(), QList<ColumnarResult::Type>(), &success);
+        QVERIFY(!success);
+        QCOMPARE(result.columnCount(), 0);
+        QVERIFY(!ds.errorText().isEmpty());
+        ds.closeConnection();
+    }
+};
+
+QTEST_MAIN(TstColumnarResult)
+#include "tst_columnarresult.moc"
@@ -90,6 +90,19 @@ private slots:
         QVERIFY(!creds.isSqlite());
     }
 
+    void sqliteProfile_defaultEmpty()
+    {
+        DatabaseCredentials creds("/tmp/test.db");
+        QVERIFY(creds.sqliteProfile().isEmpty());
+    }
+
+    void setSqliteProfile_works()
+    {
+        DatabaseCredentials creds("/tmp/test.db");
+        creds.setSqliteProfile(SqlitePerformanceProfile::balanced());
+        QVERIFY(creds.sqliteProfile() == SqlitePerformanceProfile::balanced());
+    }
+
     void engineConstants_haveExpectedValues()
     {
         QCOMPARE(DatabaseCredentials::SQLENG_SQLITE, QStringLiteral("QSQLITE"));
@@ -0,0 +1,204 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QUuid>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/databasevalidator.h>
+
+class ValidatedDataSource : public DataSource
+{
+public:
+    ValidatedDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT);"; }
+};
+
+static const int PageSize = 4096;
+
+// Create a database of tables t0..tN-1 with a few pages of rows each
+static bool createDatabase(const QString& path, int tableCount)
+{
+    QString connectionName = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    bool result = true;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(path);
+        result = db.open();
+        QSqlQuery query(db);
+        result = result && query.exec(QString("PRAGMA page_size = %1").arg(PageSize));
+        for(int i = 0;result && i < tableCount;i++) {
+            result = query.exec(QString("CREATE TABLE t%1 (id INTEGER PRIMARY KEY, name TEXT)").arg(i));
+        }
+        result = result && db.transaction();
+        for(int i = 0;result && i < tableCount;i++) {
+            for(int row = 0;result && row < 200;row++) {
+                result = query.exec(QString("INSERT INTO t%1 (id, name) VALUES (%2, 'row %2 of table %1')").arg(i).arg(row));
+            }
+        }
+        result = result && db.commit();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return result;
+}
+
+// Zero whole pages after the first, leaving the header and schema intact
+static bool corruptPages(const QString& path, int firstPage, int count)
+{
+    QFile file(path);
+    if(file.open(QIODevice::ReadWrite) == false || file.seek((qint64)(firstPage - 1) * PageSize) == false) {
+        return false;
+    }
+    return file.write(QByteArray(PageSize * count, '\0')) == PageSize * count;
+}
+
+class TstDatabaseValidator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void hasSqliteHeader_validFile()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/valid.db";
+        QVERIFY(createDatabase(path, 1));
+        QVERIFY(DatabaseValidator::hasSqliteHeader(path));
+    }
+
+    void hasSqliteHeader_rejectsOtherFiles()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(!DatabaseValidator::hasSqliteHeader(tmpDir.path() + "/missing.db"));
+
+        QFile empty(tmpDir.path() + "/empty.db");
+        QVERIFY(empty.open(QIODevice::WriteOnly));
+        empty.close();
+        QVERIFY(!DatabaseValidator::hasSqliteHeader(empty.fileName()));
+
+        QFile text(tmpDir.path() + "/text.db");
+        QVERIFY(text.open(QIODevice::WriteOnly));
+        text.write(QByteArray("This is not a database. ").repeated(10));
+        text.close();
+        QVERIFY(!DatabaseValidator::hasSqliteHeader(text.fileName()));
+
+        // Right magic, impossible page size
+        QByteArray header(DatabaseValidator::HeaderSize, '\0');
+        header.replace(0, 16, QByteArray("SQLite format 3\0", 16));
+        header[16] = 0x03;
+        header[17] = 0x00;
+        QFile bad(tmpDir.path() + "/badpagesize.db");
+        QVERIFY(bad.open(QIODevice::WriteOnly));
+        bad.write(header);
+        bad.close();
+        QVERIFY(!DatabaseValidator::hasSqliteHeader(bad.fileName()));
+    }
+
+    void isSqlite_levels()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/levels.db";
+        QVERIFY(createDatabase(path, 2));
+        QVERIFY(DataSource::isSqlite(path, DatabaseValidator::HeaderOnly));
+        QVERIFY(DataSource::isSqlite(path, DatabaseValidator::QuickCheck));
+        QVERIFY(DataSource::isSqlite(path, DatabaseValidator::IntegrityCheck));
+        QVERIFY(!DataSource::isSqlite(tmpDir.path() + "/missing.db", DatabaseValidator::NoValidation));
+    }
+
+    void validate_detectsCorruption()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/corrupt.db";
+        QVERIFY(createDatabase(path, 2));
+        QVERIFY(corruptPages(path, 2, 1));
+
+        QVERIFY(DataSource::isSqlite(path, DatabaseValidator::HeaderOnly));
+        DatabaseValidator::Result result = DatabaseValidator(path, DatabaseValidator::QuickCheck).validate();
+        QVERIFY(!result.valid);
+        QVERIFY(!result.errors.isEmpty());
+        QVERIFY(!DataSource::isSqlite(path, DatabaseValidator::IntegrityCheck));
+    }
+
+    void validate_limitsErrors()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/many.db";
+        QVERIFY(createDatabase(path, 4));
+        QVERIFY(corruptPages(path, 2, 4));
+
+        DatabaseValidator validator(path, DatabaseValidator::IntegrityCheck, 1);
+        DatabaseValidator::Result result = validator.validate();
+        QVERIFY(!result.valid);
+        QCOMPARE(result.errors.count(), 1);
+    }
+
+    void validate_reportsProgressPerTable()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/progress.db";
+        QVERIFY(createDatabase(path, 3));
+
+        QList<int> reported;
+        DatabaseValidator validator(path, DatabaseValidator::IntegrityCheck);
+        DatabaseValidator::Result result = validator.validate([&reported](int tablesChecked, int tableCount) {
+            reported.append(tablesChecked);
+            return tableCount == 3;
+        });
+        QVERIFY(result.valid);
+        QCOMPARE(result.tableCount, 3);
+        QCOMPARE(result.tablesChecked, 3);
+        QCOMPARE(reported, QList<int>({ 0, 1, 2, 3 }));
+    }
+
+    void validate_cancelsBetweenTables()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/cancel.db";
+        QVERIFY(createDatabase(path, 3));
+
+        DatabaseValidator validator(path, DatabaseValidator::QuickCheck);
+        DatabaseValidator::Result result = validator.validate([](int tablesChecked, int) { return tablesChecked < 1; });
+        QVERIFY(result.cancelled);
+        QVERIFY(!result.valid);
+        QVERIFY(result.errors.isEmpty());
+        QCOMPARE(result.tablesChecked, 1);
+    }
+
+    void validateInBackground_completes()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/background.db";
+        QVERIFY(createDatabase(path, 3));
+
+        QFuture<DatabaseValidator::Result> future = DatabaseValidator(path, DatabaseValidator::IntegrityCheck).validateInBackground();
+        future.waitForFinished();
+        QVERIFY(!future.isCanceled());
+        DatabaseValidator::Result result = future.result();
+        QVERIFY(result.valid);
+        QCOMPARE(result.tablesChecked, 3);
+        QCOMPARE(future.progressMaximum(), 3);
+        QCOMPARE(future.progressValue(), 3);
+    }
+
+    void dataSource_integrityCheckOnOpen()
+    {
+        QTemporaryDir tmpDir;
+        ValidatedDataSource ds((DatabaseCredentials(tmpDir.path() + "/open.db")));
+        QCOMPARE(ds.integrityCheckLevel(), DatabaseValidator::NoValidation);
+        ds.setIntegrityCheckLevel(DatabaseValidator::IntegrityCheck);
+        QVERIFY(ds.openConnection());
+        ds.closeConnection();
+
+        QString path = tmpDir.path() + "/corruptopen.db";
+        QVERIFY(createDatabase(path, 2));
+        QVERIFY(corruptPages(path, 2, 2));
+        ValidatedDataSource corrupt((DatabaseCredentials(path)));
+        corrupt.setIntegrityCheckLevel(DatabaseValidator::QuickCheck);
+        QVERIFY(!corrupt.openConnection());
+    }
+};
+
+QTEST_MAIN(TstDatabaseValidator)
+#include "tst_databasevalidator.moc"
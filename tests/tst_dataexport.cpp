@@ -0,0 +1,250 @@
+#include <QTest>
+#include <QBuffer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <QtEndian>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/recordparser.h>
+#include <Kanoop/database/recordwriter.h>
+#include <limits>
+
+class ExportDataSource : public DataSource
+{
+public:
+    ExportDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::exportData;
+    using DataSource::exportFile;
+    using DataSource::executeForwardOnly;
+    using DataSource::importData;
+    using DataSource::bulkInsertRows;
+
+    bool fill(int count)
+    {
+        QList<QVariantList> rows;
+        for(int i = 1;i <= count;i++) {
+            rows.append({ i, QString("item %1, \"quoted\"").arg(i), i * 0.25, i % 3 == 0 ? QVariant() : QVariant(i % 2) });
+        }
+        return bulkInsertRows("items", { "id", "name", "price", "active" }, rows);
+    }
+
+protected:
+    QString createSql() const override
+    {
+        return
+            "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT, price REAL, active INTEGER);\n"
+            "CREATE TABLE copy (id INTEGER PRIMARY KEY, name TEXT, price REAL, active INTEGER);";
+    }
+};
+
+static QList<QVariantList> sampleRows()
+{
+    return {
+        { 1, "plain", 1.5, QByteArray("\x00\x01\xff", 3) },
+        { 2, "comma, \"quote\"\nand line", -0.1, QVariant() },
+        { 3, "", QVariant(), QByteArray("x") },
+        { 4, QVariant(), 1e300, QByteArray("") },
+        { 5, QString::fromUtf8("caf\xc3\xa9 \xe2\x82\xac"), 3.0, QByteArray("y") },
+    };
+}
+
+class TstDataExport : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void writer_csvRoundTripsThroughParser()
+    {
+        QByteArray csv;
+        QBuffer buffer(&csv);
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        RecordWriter writer(&buffer, RecordFormat::csv(';'));
+        QVERIFY(writer.begin({ "id", "name", "price", "data" }));
+        const QList<QVariantList> rows = sampleRows();
+        for(const QVariantList& row : rows) {
+            QVERIFY(writer.writeRow(row));
+        }
+        QVERIFY(writer.finish());
+        QCOMPARE(writer.rowCount(), qint64(5));
+        QCOMPARE(writer.bytesWritten(), qint64(csv.size()));
+        QVERIFY(csv.startsWith("id;name;price;data\n1;plain;1.5;AAH/\n"));
+
+        ImportSpec spec("t", RecordFormat::csv(';'));
+        spec.addColumn("id", QMetaType::Int);
+        spec.addColumn("name");
+        spec.addColumn("price", QMetaType::Double);
+        spec.addColumn("data", QMetaType::QByteArray);
+        RecordParser parser(spec);
+        QList<QVariantList> parsed;
+        QVERIFY(parser.parse(csv, true, parsed));
+        QCOMPARE(parser.errorCount(), qint64(0));
+        QCOMPARE(parsed.count(), rows.count());
+        for(int i = 0;i < rows.count();i++) {
+            for(int column = 0;column < 3;column++) {
+                QCOMPARE(parsed.at(i).at(column).isNull(), rows.at(i).at(column).isNull());
+                if(rows.at(i).at(column).isNull() == false) {
+                    QCOMPARE(parsed.at(i).at(column), rows.at(i).at(column));
+                }
+            }
+        }
+        QCOMPARE(parsed.at(0).at(3).toByteArray(), QByteArray("\x00\x01\xff", 3));
+        QVERIFY(parsed.at(1).at(3).isNull());
+        QCOMPARE(parsed.at(2).at(1), QVariant(QString("")));
+    }
+
+    void writer_ndjsonEscaping()
+    {
+        QByteArray json;
+        QBuffer buffer(&json);
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        RecordWriter writer(&buffer, RecordFormat::ndjson());
+        QVERIFY(writer.begin({ "id", "text \"key\"", "value" }));
+        QVERIFY(writer.writeRow({ 1, QString("tab\there\\ \x01 \"q\""), true }));
+        QVERIFY(writer.writeRow({ 2, QVariant(), std::numeric_limits<double>::infinity() }));
+        QVERIFY(writer.writeRow({ 3, QDate(2024, 2, 29), 2.5 }));
+        QVERIFY(writer.finish());
+
+        QList<QByteArray> lines = json.split('\n');
+        QCOMPARE(lines.count(), 4);
+        QVERIFY(lines.last().isEmpty());
+
+        QJsonObject first = QJsonDocument::fromJson(lines.at(0)).object();
+        QCOMPARE(first.value("id").toInt(), 1);
+        QCOMPARE(first.value("text \"key\"").toString(), QString("tab\there\\ \x01 \"q\""));
+        QCOMPARE(first.value("value").toBool(), true);
+
+        QJsonObject second = QJsonDocument::fromJson(lines.at(1)).object();
+        QVERIFY(second.value("text \"key\"").isNull());
+        QVERIFY(second.value("value").isNull());
+
+        QJsonObject third = QJsonDocument::fromJson(lines.at(2)).object();
+        QCOMPARE(third.value("text \"key\"").toString(), QStringLiteral("2024-02-29"));
+        QCOMPARE(third.value("value").toDouble(), 2.5);
+    }
+
+    void writer_flushesAtFlushSize()
+    {
+        QByteArray csv;
+        QBuffer buffer(&csv);
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        RecordWriter writer(&buffer, RecordFormat::csv(), RecordWriter::NoCompression, 1000);
+        QVERIFY(writer.begin({ "value" }));
+        for(int i = 0;i < 1000;i++) {
+            QVERIFY(writer.writeRow({ QString(20, 'x') }));
+            // Never a full flush size waiting
+            QVERIFY(6 + writer.rowCount() * 21 - writer.bytesWritten() < 1000);
+        }
+        QVERIFY(writer.bytesWritten() > 19000);
+        QVERIFY(writer.finish());
+        QCOMPARE(csv.size(), 6 + 1000 * 21);
+    }
+
+    void writer_rejectsUnwritableDevice()
+    {
+        QByteArray data;
+        QBuffer buffer(&data);
+        RecordWriter writer(&buffer, RecordFormat());
+        QVERIFY(!writer.begin({ "a" }));
+        QVERIFY(!writer.errorText().isEmpty());
+    }
+
+    void exportData_csvRoundTrip()
+    {
+        QTemporaryDir tmpDir;
+        ExportDataSource ds((DatabaseCredentials(tmpDir.path() + "/export.db")));
+        QVERIFY(ds.openConnection());
+        QVERIFY(ds.fill(20000));
+        ds.setExportFlushSize(64 * 1024);
+
+        QByteArray csv;
+        QBuffer buffer(&csv);
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        int progressCalls = 0;
+        DataSource::ExportStatistics stats;
+        QVERIFY(ds.exportData(&buffer, "SELECT id, name, price, active FROM items WHERE id > ? ORDER BY id", { 0 }, RecordFormat(),
+                              RecordWriter::NoCompression, [&progressCalls](const DataSource::ExportStatistics&) {
+            progressCalls++;
+            return true;
+        }, &stats));
+        QCOMPARE(stats.rows, qint64(20000));
+        QCOMPARE(stats.bytesWritten, qint64(csv.size()));
+        QCOMPARE(stats.bytesEncoded, stats.bytesWritten);
+        QVERIFY(progressCalls > 0);
+        QVERIFY(csv.startsWith("id,name,price,active\n1,\"item 1, \"\"quoted\"\"\",0.25,1\n2,"));
+
+        buffer.close();
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        ImportSpec spec("copy");
+        DataSource::ImportStatistics imported;
+        QVERIFY(ds.importData(&buffer, spec, DataSource::ImportProgressCallback(), &imported));
+        QCOMPARE(imported.rowsInserted, qint64(20000));
+
+        bool success;
+        QSqlQuery query = ds.executeForwardOnly(
+            "SELECT COUNT(*) FROM items i JOIN copy c ON c.id = i.id "
+            "WHERE c.name = i.name AND c.price = i.price AND c.active IS i.active", QVariantList(), &success);
+        QVERIFY(success && query.next());
+        QCOMPARE(query.value(0).toInt(), 20000);
+        query.finish();
+        ds.closeConnection();
+    }
+
+    void exportFile_ndjsonAndCancel()
+    {
+        QTemporaryDir tmpDir;
+        ExportDataSource ds((DatabaseCredentials(tmpDir.path() + "/ndjson.db")));
+        QVERIFY(ds.openConnection());
+        QVERIFY(ds.fill(1000));
+
+        QString path = tmpDir.path() + "/items.ndjson";
+        QVERIFY(ds.exportFile(path, "SELECT id, price FROM items WHERE active IS NULL", QVariantList(), RecordFormat::ndjson()));
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QList<QByteArray> lines = file.readAll().trimmed().split('\n');
+        QCOMPARE(lines.count(), 333);
+        QCOMPARE(lines.first(), QByteArray("{\"id\":3,\"price\":0.75}"));
+        file.close();
+
+        ds.setExportFlushSize(100);
+        DataSource::ExportStatistics stats;
+        QVERIFY(!ds.exportFile(path, "SELECT * FROM items", QVariantList(), RecordFormat::ndjson(), RecordWriter::NoCompression,
+                               [](const DataSource::ExportStatistics& progress) { return progress.rows < 10; }, &stats));
+        QVERIFY(stats.rows >= 10 && stats.rows < 20);
+
+        QVERIFY(!ds.exportFile(path, "SELECT * FROM missing", QVariantList(), RecordFormat()));
+        ds.closeConnection();
+    }
+
+    void exportData_gzip()
+    {
+        QTemporaryDir tmpDir;
+        ExportDataSource ds((DatabaseCredentials(tmpDir.path() + "/gzip.db")));
+        QVERIFY(ds.openConnection());
+        QVERIFY(ds.fill(5000));
+
+        QByteArray compressed;
+        QBuffer buffer(&compressed);
+        QVERIFY(buffer.open(QIODevice::WriteOnly));
+        DataSource::ExportStatistics stats;
+        bool exported = ds.exportData(&buffer, "SELECT * FROM items", QVariantList(), RecordFormat(), RecordWriter::Gzip,
+                                      DataSource::ExportProgressCallback(), &stats);
+        if(RecordWriter::isGzipAvailable() == false) {
+            QVERIFY(!exported);
+            QVERIFY(compressed.isEmpty());
+            return;
+        }
+
+        QVERIFY(exported);
+        QCOMPARE(stats.bytesWritten, qint64(compressed.size()));
+        QVERIFY(stats.bytesWritten < stats.bytesEncoded / 2);
+        QVERIFY(compressed.startsWith("\x1f\x8b"));
+        // The gzip trailer ends with the uncompressed size
+        QCOMPARE(qint64(qFromLittleEndian<quint32>(compressed.constData() + compressed.size() - 4)), stats.bytesEncoded);
+        ds.closeConnection();
+    }
+};
+
+QTEST_MAIN(TstDataExport)
+#include "tst_dataexport.moc"
@@ -0,0 +1,411 @@
+#include <QTest>
+#include <QBuffer>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <QThread>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/recordparser.h>
+
+class ImportDataSource : public DataSource
+{
+public:
+    ImportDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::importData;
+    using DataSource::importFile;
+    using DataSource::executeQuery;
+
+    bool execute(const QString& sql)
+    {
+        bool success;
+        executeQuery(sql, &success);
+        return success;
+    }
+
+    QVariant scalar(const QString& sql)
+    {
+        bool success;
+        QSqlQuery query = executeQuery(sql, &success);
+        return success && query.next() ? query.value(0) : QVariant();
+    }
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT, price REAL, active INTEGER);"; }
+};
+
+// Sequential device which only receives its next chunk when waited on, like a slow pipe.
+// Records the threads it is read from.
+class TrickleDevice : public QIODevice
+{
+public:
+    explicit TrickleDevice(const QList<QByteArray>& chunks) : _chunks(chunks) {}
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return _pending.size() + QIODevice::bytesAvailable(); }
+
+    bool waitForReadyRead(int msecs) override
+    {
+        Q_UNUSED(msecs);
+        readers.insert(QThread::currentThread());
+        if(_chunks.isEmpty()) {
+            return false;
+        }
+        _pending.append(_chunks.takeFirst());
+        return true;
+    }
+
+    QSet<QThread*> readers;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override
+    {
+        readers.insert(QThread::currentThread());
+        qint64 size = qMin(maxSize, qint64(_pending.size()));
+        memcpy(data, _pending.constData(), size);
+        _pending.remove(0, size);
+        return size;
+    }
+    qint64 writeData(const char*, qint64) override { return -1; }
+
+private:
+    QList<QByteArray> _chunks;
+    QByteArray _pending;
+};
+
+// Feed the parser a byte at a time, so every record straddles chunks
+static QList<QVariantList> parseBytewise(RecordParser& parser, const QByteArray& data, bool* success)
+{
+    QList<QVariantList> rows;
+    *success = true;
+    for(int i = 0;*success && i < data.size();i++) {
+        *success = parser.parse(data.mid(i, 1), false, rows);
+    }
+    *success = *success && parser.parse(QByteArray(), true, rows);
+    return rows;
+}
+
+static QByteArray itemsCsv(int count, int badEvery = 0)
+{
+    QByteArray result("id,name,price,active\n");
+    for(int i = 1;i <= count;i++) {
+        if(badEvery > 0 && i % badEvery == 0) {
+            result.append(QString("%1,\"item %1\",not a price,1\n").arg(i).toUtf8());
+        }
+        else {
+            result.append(QString("%1,\"item %1\",%2,%3\n").arg(i).arg(i * 0.5).arg(i % 2).toUtf8());
+        }
+    }
+    return result;
+}
+
+static ImportSpec itemsSpec(const RecordFormat& format = RecordFormat())
+{
+    ImportSpec spec("items", format);
+    spec.addColumn("id", QMetaType::LongLong);
+    spec.addColumn("name");
+    spec.addColumn("price", QMetaType::Double);
+    spec.addColumn("active", QMetaType::Bool);
+    return spec;
+}
+
+class TstDataImport : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parser_csvQuotingAcrossChunks()
+    {
+        QByteArray csv =
+            "\xEF\xBB\xBF" "id,name,note\r\n"
+            "1,\"Smith, John\",\"said \"\"hi\"\"\"\r\n"
+            "\r\n"
+            "2,plain,\"two\nlines\"\r\n"
+            "3,,\"\"";
+
+        ImportSpec spec("t");
+        spec.addColumn("note");
+        spec.addColumn("name");
+        spec.addColumn("id", "key", QMetaType::Int);
+        RecordParser parser(spec);
+        bool success;
+        QList<QVariantList> rows = parseBytewise(parser, csv, &success);
+        QVERIFY2(success, qPrintable(parser.errorText()));
+        QCOMPARE(parser.columns(), QStringList({ "note", "name", "key" }));
+        QCOMPARE(rows.count(), 3);
+        QCOMPARE(rows.at(0), QVariantList({ "said \"hi\"", "Smith, John", 1 }));
+        QCOMPARE(rows.at(1), QVariantList({ "two\nlines", "plain", 2 }));
+        QCOMPARE(rows.at(2).at(0), QVariant(QString("")));
+        QVERIFY(rows.at(2).at(1).isNull());
+        QCOMPARE(parser.errorCount(), qint64(0));
+    }
+
+    void parser_csvErrorsAreSkipped()
+    {
+        QByteArray csv =
+            "1\tone\t2024-01-02\tyes\n"
+            "2\ttwo\n"
+            "x\tthree\t2024-01-03\tno\n"
+            "4\tfour\t\\N\tf\n"
+            "5\tfive\t2024-13-01\tt\n";
+
+        ImportSpec spec("t", RecordFormat::csv('\t', false));
+        spec.addColumn("id", QMetaType::Int);
+        spec.addColumn("name");
+        spec.addColumn("day", QMetaType::QDate);
+        spec.addColumn("flag", QMetaType::Bool);
+        RecordFormat format = spec.format();
+        format.setNullText("\\N");
+        spec.setFormat(format);
+
+        RecordParser parser(spec);
+        QList<QVariantList> rows;
+        QVERIFY(parser.parse(csv, true, rows));
+        QCOMPARE(rows.count(), 2);
+        QCOMPARE(rows.at(0), QVariantList({ 1, "one", QDate(2024, 1, 2), true }));
+        QCOMPARE(rows.at(1).at(2).typeId(), int(QMetaType::QDate));
+        QVERIFY(rows.at(1).at(2).isNull());
+        QCOMPARE(rows.at(1).at(3), QVariant(false));
+
+        QList<RecordParser::Error> errors = parser.takeErrors();
+        QCOMPARE(errors.count(), 3);
+        QCOMPARE(errors.at(0).line, qint64(2));
+        QCOMPARE(errors.at(1).line, qint64(3));
+        QCOMPARE(errors.at(2).line, qint64(5));
+        QVERIFY(parser.takeErrors().isEmpty());
+        QCOMPARE(parser.errorCount(), qint64(3));
+    }
+
+    void parser_csvMalformedFile()
+    {
+        ImportSpec spec("t");
+        spec.addColumn("missing");
+        RecordParser parser(spec);
+        QList<QVariantList> rows;
+        QVERIFY(!parser.parse("id,name\n1,x\n", true, rows));
+        QVERIFY(parser.errorText().contains("missing"));
+
+        RecordParser unterminated((ImportSpec("t")));
+        QVERIFY(unterminated.parse("id,name\n1,\"open", false, rows));
+        QVERIFY(!unterminated.parse(QByteArray(), true, rows));
+        QVERIFY(rows.isEmpty());
+
+        RecordParser noColumns((ImportSpec("t", RecordFormat::csv(',', false))));
+        QVERIFY(!noColumns.parse("1,2\n", true, rows));
+    }
+
+    void parser_ndjson()
+    {
+        QByteArray json =
+            "{\"id\": 1, \"name\": \"one\", \"tags\": [\"a\", \"b\"], \"price\": 1.5}\n"
+            "\n"
+            "{\"id\": 2, \"name\": null}\n"
+            "[1, 2]\n"
+            "{\"id\": 3.5, \"name\": \"bad id\"}\n"
+            "{\"id\": \"4\", \"name\": \"string id\"}\n"
+            "{not json}\n"
+            "{\"id\": 5}";
+
+        ImportSpec spec("t", RecordFormat::ndjson());
+        spec.addColumn("id", QMetaType::LongLong);
+        spec.addColumn("name");
+        spec.addColumn("tags");
+        spec.addColumn("price", QMetaType::Double);
+        RecordParser parser(spec);
+        bool success;
+        QList<QVariantList> rows = parseBytewise(parser, json, &success);
+        QVERIFY(success);
+        QCOMPARE(rows.count(), 4);
+        QCOMPARE(rows.at(0), QVariantList({ qint64(1), "one", "[\"a\",\"b\"]", 1.5 }));
+        QCOMPARE(rows.at(1).at(0), QVariant(qint64(2)));
+        QVERIFY(rows.at(1).at(1).isNull());
+        QVERIFY(rows.at(1).at(3).isNull());
+        QCOMPARE(rows.at(2).at(0), QVariant(qint64(4)));
+        QCOMPARE(rows.at(3).at(0), QVariant(qint64(5)));
+
+        QList<RecordParser::Error> errors = parser.takeErrors();
+        QCOMPARE(errors.count(), 3);
+        QCOMPARE(errors.at(0).line, qint64(4));
+        QCOMPARE(errors.at(1).line, qint64(5));
+        QCOMPARE(errors.at(2).line, qint64(7));
+    }
+
+    void parser_ndjsonColumnsFromFirstObject()
+    {
+        RecordParser parser((ImportSpec("t", RecordFormat::ndjson())));
+        QList<QVariantList> rows;
+        QVERIFY(parser.parse("{\"b\": true, \"a\": \"x\"}\n{\"a\": \"y\", \"c\": 1}\n", true, rows));
+        QCOMPARE(parser.columns(), QStringList({ "a", "b" }));
+        QCOMPARE(rows.at(0), QVariantList({ "x", true }));
+        QCOMPARE(rows.at(1).at(0), QVariant("y"));
+        QVERIFY(rows.at(1).at(1).isNull());
+    }
+
+    void importData_insertsInTransactions_data()
+    {
+        QTest::addColumn<bool>("parseThread");
+        QTest::newRow("inline") << false;
+        QTest::newRow("parse thread") << true;
+    }
+
+    void importData_insertsInTransactions()
+    {
+        QFETCH(bool, parseThread);
+        QTemporaryDir tmpDir;
+        ImportDataSource ds((DatabaseCredentials(tmpDir.path() + "/import.db")));
+        QVERIFY(ds.openConnection());
+        ds.setBulkInsertChunkSize(1000);
+
+        QByteArray csv = itemsCsv(25000);
+        QBuffer buffer(&csv);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        ImportSpec spec = itemsSpec();
+        spec.setParseThread(parseThread);
+
+        int progressCalls = 0;
+        DataSource::ImportStatistics stats;
+        QVERIFY(ds.importData(&buffer, spec, [&progressCalls](const DataSource::ImportStatistics&) {
+            progressCalls++;
+            return true;
+        }, &stats));
+
+        QCOMPARE(stats.rowsRead, qint64(25000));
+        QCOMPARE(stats.rowsInserted, qint64(25000));
+        QCOMPARE(stats.errorRows, qint64(0));
+        QCOMPARE(stats.bytesRead, qint64(csv.size()));
+        QCOMPARE(stats.fractionRead(), 1.0);
+        QVERIFY(stats.transactions >= 25);
+        QVERIFY(progressCalls > 0);
+        QVERIFY(stats.rowsPerSecond() > 0);
+
+        QCOMPARE(ds.scalar("SELECT COUNT(*) FROM items").toInt(), 25000);
+        QCOMPARE(ds.scalar("SELECT price FROM items WHERE id = 3").toDouble(), 1.5);
+        QCOMPARE(ds.scalar("SELECT name FROM items WHERE id = 25000").toString(), QStringLiteral("item 25000"));
+        QCOMPARE(ds.scalar("SELECT SUM(active) FROM items").toInt(), 12500);
+        ds.closeConnection();
+    }
+
+    void importData_errorRowLimit_data()
+    {
+        QTest::addColumn<bool>("parseThread");
+        QTest::newRow("inline") << false;
+        QTest::newRow("parse thread") << true;
+    }
+
+    void importData_errorRowLimit()
+    {
+        QFETCH(bool, parseThread);
+        QTemporaryDir tmpDir;
+        ImportDataSource ds((DatabaseCredentials(tmpDir.path() + "/errors.db")));
+        QVERIFY(ds.openConnection());
+
+        QByteArray csv = itemsCsv(1000, 100);
+        ImportSpec spec = itemsSpec();
+        spec.setParseThread(parseThread);
+        spec.setMaxErrorRows(10);
+
+        QBuffer buffer(&csv);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        DataSource::ImportStatistics stats;
+        QVERIFY(ds.importData(&buffer, spec, DataSource::ImportProgressCallback(), &stats));
+        QCOMPARE(stats.rowsInserted, qint64(990));
+        QCOMPARE(stats.errorRows, qint64(10));
+        QCOMPARE(stats.errors.count(), 10);
+        QCOMPARE(stats.errors.first().line, qint64(101));
+        QVERIFY(stats.errors.first().message.contains("price"));
+
+        QVERIFY(ds.execute("DELETE FROM items"));
+        spec.setMaxErrorRows(9);
+        QBuffer again(&csv);
+        QVERIFY(again.open(QIODevice::ReadOnly));
+        QVERIFY(!ds.importData(&again, spec, DataSource::ImportProgressCallback(), &stats));
+        QCOMPARE(stats.errorRows, qint64(10));
+        QCOMPARE(ds.scalar("SELECT COUNT(*) FROM items").toInt(), 0);
+        ds.closeConnection();
+    }
+
+    void importData_sequentialDevice_data()
+    {
+        QTest::addColumn<bool>("parseThread");
+        QTest::newRow("inline") << false;
+        QTest::newRow("parse thread") << true;
+    }
+
+    void importData_sequentialDevice()
+    {
+        QFETCH(bool, parseThread);
+        QTemporaryDir tmpDir;
+        ImportDataSource ds((DatabaseCredentials(tmpDir.path() + "/pipe.db")));
+        QVERIFY(ds.openConnection());
+
+        // Nothing is readable until each wait, as with a pipe still being written
+        QByteArray csv = itemsCsv(3000);
+        QList<QByteArray> chunks;
+        for(int i = 0;i < csv.size();i += 5000) {
+            chunks.append(csv.mid(i, 5000));
+        }
+        TrickleDevice device(chunks);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        ImportSpec spec = itemsSpec();
+        spec.setParseThread(parseThread);
+
+        DataSource::ImportStatistics stats;
+        QVERIFY(ds.importData(&device, spec, DataSource::ImportProgressCallback(), &stats));
+        QCOMPARE(stats.rowsInserted, qint64(3000));
+        QCOMPARE(stats.bytesRead, qint64(csv.size()));
+        QCOMPARE(device.readers, QSet<QThread*>({ QThread::currentThread() }));
+        QCOMPARE(ds.scalar("SELECT name FROM items WHERE id = 3000").toString(), QStringLiteral("item 3000"));
+        ds.closeConnection();
+    }
+
+    void importData_constraintFailureAndCancel()
+    {
+        QTemporaryDir tmpDir;
+        ImportDataSource ds((DatabaseCredentials(tmpDir.path() + "/fail.db")));
+        QVERIFY(ds.openConnection());
+        ds.setBulkInsertChunkSize(100);
+
+        QByteArray csv = itemsCsv(300) + itemsCsv(1).mid(QByteArray("id,name,price,active\n").size());
+        QBuffer buffer(&csv);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        DataSource::ImportStatistics stats;
+        QVERIFY(!ds.importData(&buffer, itemsSpec(), DataSource::ImportProgressCallback(), &stats));
+        QCOMPARE(stats.rowsInserted, qint64(300));
+        QCOMPARE(ds.scalar("SELECT COUNT(*) FROM items").toInt(), 300);
+
+        QVERIFY(ds.execute("DELETE FROM items"));
+        QByteArray large = itemsCsv(50000);
+        QBuffer cancelled(&large);
+        QVERIFY(cancelled.open(QIODevice::ReadOnly));
+        ImportSpec spec = itemsSpec();
+        spec.setParseThread(true);
+        QVERIFY(!ds.importData(&cancelled, spec, [](const DataSource::ImportStatistics& progress) { return progress.rowsInserted < 200; }, &stats));
+        QCOMPARE(stats.rowsInserted, qint64(200));
+        QCOMPARE(ds.scalar("SELECT COUNT(*) FROM items").toInt(), 200);
+        ds.closeConnection();
+    }
+
+    void importFile_ndjson()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/items.ndjson";
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        for(int i = 1;i <= 500;i++) {
+            file.write(QString("{\"id\": %1, \"name\": \"item %1\", \"price\": %2, \"active\": %3}\n").arg(i).arg(i * 2).arg(i % 5 == 0 ? "true" : "false").toUtf8());
+        }
+        file.close();
+
+        ImportDataSource ds((DatabaseCredentials(tmpDir.path() + "/ndjson.db")));
+        QVERIFY(ds.openConnection());
+        DataSource::ImportStatistics stats;
+        QVERIFY(ds.importFile(path, itemsSpec(RecordFormat::ndjson()), DataSource::ImportProgressCallback(), &stats));
+        QCOMPARE(stats.rowsInserted, qint64(500));
+        QCOMPARE(ds.scalar("SELECT SUM(active) FROM items").toInt(), 100);
+        QCOMPARE(ds.scalar("SELECT price FROM items WHERE id = 7").toDouble(), 14.0);
+        QVERIFY(!ds.importFile(tmpDir.path() + "/missing.csv", itemsSpec()));
+        ds.closeConnection();
+    }
+};
+
+QTEST_MAIN(TstDataImport)
+#include "tst_dataimport.moc"
@@ -1,4 +1,5 @@
 #include <QTest>
+#include <QBuffer>
 #include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QFile>
@@ -17,6 +18,14 @@ public:
     using DataSource::executeQuery;
     using DataSource::querySuccessful;
     using DataSource::executeMultiple;
+    using DataSource::bulkInsert;
+    using DataSource::bulkInsertRows;
+    using DataSource::executeForwardOnly;
+    using DataSource::forEachRow;
+    using DataSource::forEachChunk;
+    using DataSource::loadAll;
+    using DataSource::executeScript;
+    using DataSource::executeScriptFile;
     using DataSource::escapedString;
     using DataSource::commaDelimitedIntList;
     using DataSource::commaDelimitedUuidList;
@@ -26,9 +35,60 @@ public:
     using DataSource::_db;
 
     QString testCreateSql;
+    QString testCreateSqlFile;
 
 protected:
     QString createSql() const override { return testCreateSql; }
+    QString createSqlFile() const override { return testCreateSqlFile; }
+};
+
+// Row type for the typed loader tests. Rows with a negative id fail to load.
+class TestItem : public QueryLoadable
+{
+public:
+    bool loadFromQuery(const QSqlQuery& query) override
+    {
+        id = query.value(0).toInt();
+        value = query.value(1).toString();
+        return id >= 0;
+    }
+
+    int id = 0;
+    QString value;
+};
+
+// Sequential device which only receives its next chunk when waited on, like a slow pipe
+class TrickleDevice : public QIODevice
+{
+public:
+    explicit TrickleDevice(const QList<QByteArray>& chunks) : _chunks(chunks) {}
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return _pending.size() + QIODevice::bytesAvailable(); }
+
+    bool waitForReadyRead(int msecs) override
+    {
+        Q_UNUSED(msecs);
+        if(_chunks.isEmpty()) {
+            return false;
+        }
+        _pending.append(_chunks.takeFirst());
+        return true;
+    }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override
+    {
+        qint64 size = qMin(maxSize, qint64(_pending.size()));
+        memcpy(data, _pending.constData(), size);
+        _pending.remove(0, size);
+        return size;
+    }
+    qint64 writeData(const char*, qint64) override { return -1; }
+
+private:
+    QList<QByteArray> _chunks;
+    QByteArray _pending;
 };
 
 class TstDataSource : public QObject
@@ -98,6 +158,28 @@ private slots:
         QVERIFY(!ds.isOpen());
     }
 
+    void openConnection_sqlite_createScriptManagingOwnTransaction()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+
+        DatabaseCredentials creds(tmpDir.path() + "/own_txn.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql =
+            "BEGIN TRANSACTION;\n"
+            "CREATE TABLE test (id INTEGER PRIMARY KEY);\n"
+            "INSERT INTO test (id) VALUES (1);\n"
+            "COMMIT;";
+
+        QVERIFY(ds.openConnection());
+        bool success = false;
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM test", &success);
+        QVERIFY(success);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 1);
+        ds.closeConnection();
+    }
+
     void openConnection_sqlite_autoGeneratesConnectionName()
     {
         QTemporaryDir tmpDir;
@@ -260,6 +342,720 @@ private slots:
         ds.closeConnection();
     }
 
+    void statementCache_disabledByDefault()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/cache_off.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        QCOMPARE(ds.statementCacheSize(), 0);
+        ds.prepareQuery("SELECT value FROM items WHERE id = ?");
+        ds.prepareQuery("SELECT value FROM items WHERE id = ?");
+        QCOMPARE(ds.statementCacheStatistics().hits, qint64(0));
+        QCOMPARE(ds.statementCacheStatistics().size, 0);
+
+        ds.closeConnection();
+    }
+
+    void statementCache_hitReusesStatement()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/cache_hit.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+        ds.setStatementCacheSize(8);
+
+        for(int i = 1;i <= 3;i++) {
+            bool success = false;
+            QSqlQuery query = ds.prepareQuery("INSERT INTO items (id, value) VALUES (?, ?)", &success);
+            QVERIFY(success);
+            query.addBindValue(i);
+            query.addBindValue(QString("value%1").arg(i));
+            QVERIFY(ds.executeQuery(query));
+        }
+
+        StatementCache::Statistics stats = ds.statementCacheStatistics();
+        QCOMPARE(stats.misses, qint64(1));
+        QCOMPARE(stats.hits, qint64(2));
+        QCOMPARE(stats.size, 1);
+
+        bool success = false;
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM items", &success);
+        QVERIFY(success);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 3);
+
+        ds.closeConnection();
+    }
+
+    void statementCache_hitIsUnbound()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/cache_unbound.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+        ds.setStatementCacheSize(8);
+
+        QSqlQuery first = ds.prepareQuery("INSERT INTO items (id, value) VALUES (?, ?)");
+        first.addBindValue(1);
+        first.addBindValue("bound");
+        QVERIFY(ds.executeQuery(first));
+
+        QSqlQuery second = ds.prepareQuery("INSERT INTO items (id, value) VALUES (?, ?)");
+        QCOMPARE(second.boundValues().count(), 2);
+        QVERIFY(second.boundValues().at(0).isNull());
+        QVERIFY(second.boundValues().at(1).isNull());
+
+        ds.closeConnection();
+    }
+
+    void statementCache_skipsActiveResult()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/cache_active.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+        ds.setStatementCacheSize(8);
+        bool success = false;
+        for(int i = 1;i <= 3;i++) {
+            ds.executeQuery(QString("INSERT INTO items (id, value) VALUES (%1, 'v')").arg(i), &success);
+            QVERIFY(success);
+        }
+
+        // The inner query must not reset the outer one, which is still being read
+        int pairs = 0;
+        QSqlQuery outer = ds.executeQuery("SELECT id FROM items ORDER BY id", &success);
+        QVERIFY(success);
+        while(outer.next()) {
+            QSqlQuery inner = ds.executeQuery("SELECT id FROM items ORDER BY id", &success);
+            QVERIFY(success);
+            while(inner.next()) {
+                pairs++;
+            }
+            inner.finish();
+        }
+        QCOMPARE(pairs, 9);
+        QVERIFY(ds.statementCacheStatistics().busy >= 1);
+
+        outer.finish();
+        qint64 hits = ds.statementCacheStatistics().hits;
+        ds.prepareQuery("SELECT id FROM items ORDER BY id");
+        QCOMPARE(ds.statementCacheStatistics().hits, hits + 1);
+
+        ds.closeConnection();
+    }
+
+    void statementCache_evictsLeastRecentlyUsed()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/cache_lru.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+        ds.setStatementCacheSize(2);
+
+        ds.prepareQuery("SELECT id FROM items");
+        ds.prepareQuery("SELECT value FROM items");
+        ds.prepareQuery("SELECT id FROM items");
+        ds.prepareQuery("SELECT id, value FROM items");
+
+        StatementCache::Statistics stats = ds.statementCacheStatistics();
+        QCOMPARE(stats.evictions, qint64(1));
+        QCOMPARE(stats.size, 2);
+
+        // "SELECT id" was used more recently than "SELECT value", so it survived
+        ds.prepareQuery("SELECT id FROM items");
+        QCOMPARE(ds.statementCacheStatistics().hits, qint64(2));
+        ds.prepareQuery("SELECT value FROM items");
+        QCOMPARE(ds.statementCacheStatistics().misses, qint64(4));
+
+        ds.closeConnection();
+    }
+
+    void statementCache_invalidatedBySchemaChangeAndClose()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/cache_invalidate.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+        ds.setStatementCacheSize(8);
+
+        ds.prepareQuery("SELECT id FROM items");
+        QCOMPARE(ds.statementCacheStatistics().size, 1);
+
+        bool success = false;
+        ds.executeQuery("CREATE TABLE other (id INTEGER PRIMARY KEY)", &success);
+        QVERIFY(success);
+        QCOMPARE(ds.statementCacheStatistics().size, 0);
+        QCOMPARE(ds.statementCacheStatistics().invalidations, qint64(1));
+
+        ds.prepareQuery("SELECT id FROM items");
+        QCOMPARE(ds.statementCacheStatistics().size, 1);
+        ds.closeConnection();
+        QCOMPARE(ds.statementCacheStatistics().size, 0);
+    }
+
+    void bulkInsert_columnar_insertsAllRows()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/bulk.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        // Small limits so the rows span several statements, executions and transactions
+        ds.setMaxBoundVariables(10);
+        ds.setBulkInsertChunkSize(100);
+
+        const int rowCount = 2503;
+        QVariantList ids;
+        QVariantList values;
+        for(int i = 0;i < rowCount;i++) {
+            ids.append(i);
+            values.append(QString("value%1").arg(i));
+        }
+
+        TestDataSource::BulkInsertStatistics stats;
+        QVERIFY(ds.bulkInsert("items", {"id", "value"}, {ids, values}, &stats));
+        QCOMPARE(stats.rows, qint64(rowCount));
+        QCOMPARE(stats.transactions, 26);
+        QCOMPARE(stats.statements, qint64(501));
+
+        bool success = false;
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*), MIN(id), MAX(id) FROM items", &success);
+        QVERIFY(success);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), rowCount);
+        QCOMPARE(query.value(1).toInt(), 0);
+        QCOMPARE(query.value(2).toInt(), rowCount - 1);
+
+        query = ds.executeQuery("SELECT value FROM items WHERE id = 1234", &success);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toString(), QStringLiteral("value1234"));
+
+        ds.closeConnection();
+    }
+
+    void bulkInsertRows_insertsAllRows()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/bulk_rows.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        QList<QVariantList> rows;
+        for(int i = 0;i < 50;i++) {
+            rows.append(QVariantList() << i << QString("row%1").arg(i));
+        }
+        QVERIFY(ds.bulkInsertRows("items", {"id", "value"}, rows));
+
+        bool success = false;
+        QSqlQuery query = ds.executeQuery("SELECT value FROM items WHERE id = 49", &success);
+        QVERIFY(success);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toString(), QStringLiteral("row49"));
+
+        ds.closeConnection();
+    }
+
+    void bulkInsert_mismatchedLengths_fails()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/bulk_bad.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        QVERIFY(!ds.bulkInsert("items", {"id", "value"}, {QVariantList() << 1 << 2, QVariantList() << "a"}));
+        QVERIFY(!ds.bulkInsertRows("items", {"id", "value"}, {QVariantList() << 1}));
+        QVERIFY(!ds.errorText().isEmpty());
+
+        ds.closeConnection();
+    }
+
+    void bulkInsert_failedChunk_rollsBack()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DatabaseCredentials creds(tmpDir.path() + "/bulk_rollback.db");
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);";
+        QVERIFY(ds.openConnection());
+        ds.setBulkInsertChunkSize(10);
+
+        // Duplicate primary key in the second chunk
+        QVariantList ids;
+        QVariantList values;
+        for(int i = 0;i < 20;i++) {
+            ids.append(i == 15 ? 11 : i);
+            values.append("x");
+        }
+        QVERIFY(!ds.bulkInsert("items", {"id", "value"}, {ids, values}));
+
+        bool success = false;
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM items", &success);
+        QVERIFY(success);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 10);
+
+        ds.closeConnection();
+    }
+
+    void sqliteProfile_appliedOnOpen()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+
+        SqlitePerformanceProfile profile = SqlitePerformanceProfile::balanced();
+        profile.setPageSize(8192);
+
+        DatabaseCredentials creds(tmpDir.path() + "/profile.db");
+        creds.setSqliteProfile(profile);
+        TestDataSource ds(creds);
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY);";
+        QVERIFY(ds.openConnection());
+
+        SqlitePerformanceProfile current = ds.currentSqliteProfile();
+        QCOMPARE(current.journalMode(), SqlitePerformanceProfile::JournalWal);
+        QCOMPARE(current.synchronous(), SqlitePerformanceProfile::SynchronousNormal);
+        QCOMPARE(current.cacheSizeKiB(), profile.cacheSizeKiB());
+        QCOMPARE(current.tempStore(), SqlitePerformanceProfile::TempStoreMemory);
+        QCOMPARE(current.pageSize(), 8192);
+        QCOMPARE(current.busyTimeout(), profile.busyTimeout());
+        QCOMPARE(current.walAutoCheckpoint(), profile.walAutoCheckpoint());
+
+        ds.closeConnection();
+    }
+
+    void sqliteProfile_dataSourceOverridesCredentials()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+
+        DatabaseCredentials creds(tmpDir.path() + "/profile_override.db");
+        creds.setSqliteProfile(SqlitePerformanceProfile::balanced());
+        TestDataSource ds(creds);
+        ds.setSqliteProfile(SqlitePerformanceProfile::durable());
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER PRIMARY KEY);";
+        QVERIFY(ds.effectiveSqliteProfile() == SqlitePerformanceProfile::durable());
+        QVERIFY(ds.openConnection());
+
+        SqlitePerformanceProfile current = ds.currentSqliteProfile();
+        QCOMPARE(current.journalMode(), SqlitePerformanceProfile::JournalWal);
+        QCOMPARE(current.synchronous(), SqlitePerformanceProfile::SynchronousFull);
+
+        ds.closeConnection();
+    }
+
+    void loadAll_loadsRowsInOrder()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/load_all.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+        createItems(ds, 1000);
+
+        bool success = false;
+        QList<TestItem> items = ds.loadAll<TestItem>("SELECT id, value FROM items WHERE id >= ? ORDER BY id", { 10 }, 990, &success);
+        QVERIFY(success);
+        QCOMPARE(items.count(), 990);
+        QCOMPARE(items.first().id, 10);
+        QCOMPARE(items.last().value, QStringLiteral("value999"));
+
+        items = ds.loadAll<TestItem>("SELECT id, value FROM no_such_table", {}, 0, &success);
+        QVERIFY(!success);
+        QVERIFY(items.isEmpty());
+
+        ds.closeConnection();
+    }
+
+    void forEachRow_stopsWhenCallbackReturnsFalse()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/for_each.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+        createItems(ds, 100);
+
+        int seen = 0;
+        QVERIFY(ds.forEachRow<TestItem>("SELECT id, value FROM items ORDER BY id", {}, [&seen](TestItem& item) {
+            seen++;
+            return item.id < 9;
+        }));
+        QCOMPARE(seen, 10);
+
+        ds.closeConnection();
+    }
+
+    void forEachRow_loadFailure_returnsFalse()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/for_each_fail.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+        createItems(ds, 10);
+        ds.executeQuery("UPDATE items SET id = -1 WHERE id = 5");
+
+        int seen = 0;
+        QVERIFY(!ds.forEachRow<TestItem>("SELECT id, value FROM items ORDER BY rowid", {}, [&seen](TestItem&) {
+            seen++;
+            return true;
+        }));
+        QCOMPARE(seen, 5);
+        QVERIFY(!ds.errorText().isEmpty());
+
+        ds.closeConnection();
+    }
+
+    void forEachRow_readFailure_returnsFalse()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/for_each_read_fail.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+        createItems(ds, 10);
+
+        // abs() of the smallest 64-bit integer fails with "integer overflow", here on the row with id 5
+        int seen = 0;
+        QVERIFY(!ds.forEachRow<TestItem>("SELECT id, value, abs(id - 9223372036854775807 - 6) FROM items ORDER BY rowid", {},
+                                         [&seen](TestItem&) {
+            seen++;
+            return true;
+        }));
+        QCOMPARE(seen, 5);
+        QVERIFY(ds.errorText().contains("overflow"));
+
+        bool success = true;
+        QList<TestItem> items = ds.loadAll<TestItem>("SELECT id, value, abs(id - 9223372036854775807 - 6) FROM items ORDER BY rowid",
+                                                     {}, 0, &success);
+        QVERIFY(!success);
+        QCOMPARE(items.count(), 5);
+
+        ds.closeConnection();
+    }
+
+    void forEachChunk_deliversBoundedChunks()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/chunks.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+        createItems(ds, 10);
+
+        QList<int> sizes;
+        int nextId = 0;
+        bool ordered = true;
+        QVERIFY(ds.forEachChunk<TestItem>("SELECT id, value FROM items ORDER BY id", {}, 4, [&](QList<TestItem>& chunk) {
+            sizes.append(chunk.count());
+            for(const TestItem& item : std::as_const(chunk)) {
+                ordered = ordered && item.id == nextId++;
+            }
+            return true;
+        }));
+        QCOMPARE(sizes, QList<int>({ 4, 4, 2 }));
+        QVERIFY(ordered);
+
+        ds.closeConnection();
+    }
+
+    void executeForwardOnly_doesNotLeakIntoCachedStatement()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/forward_only.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+        ds.setStatementCacheSize(8);
+        createItems(ds, 3);
+
+        bool success = false;
+        QSqlQuery query = ds.executeForwardOnly("SELECT id FROM items WHERE id > ?", { 0 }, &success);
+        QVERIFY(success);
+        QVERIFY(query.isForwardOnly());
+        QVERIFY(query.next());
+        query.finish();
+
+        query = ds.prepareQuery("SELECT id FROM items WHERE id > ?", &success);
+        QVERIFY(success);
+        QVERIFY(!query.isForwardOnly());
+
+        ds.closeConnection();
+    }
+
+    void executeScript_streamsInBatches()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/script.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+        ds.setScriptBatchSize(1000);
+
+        QByteArray script =
+            "CREATE TABLE log (id INTEGER);\n"
+            "CREATE TRIGGER items_log AFTER INSERT ON items BEGIN INSERT INTO log VALUES (new.id); END;\n";
+        for(int i = 0;i < 2500;i++) {
+            script += QString("INSERT INTO items (id, value) VALUES (%1, 'v;%1'); -- row %1\n").arg(i).toUtf8();
+        }
+        QBuffer buffer(&script);
+        QVERIFY(buffer.open(QBuffer::ReadOnly));
+
+        int progressCalls = 0;
+        qint64 lastBytesRead = 0;
+        DataSource::ScriptStatistics statistics;
+        QVERIFY(ds.executeScript(&buffer, [&](const DataSource::ScriptStatistics& progress) {
+            progressCalls++;
+            lastBytesRead = progress.bytesRead;
+            return true;
+        }, &statistics));
+
+        QVERIFY(progressCalls > 1);
+        QCOMPARE(lastBytesRead, qint64(script.size()));
+        QCOMPARE(statistics.statements, qint64(2502));
+        QCOMPARE(statistics.transactions, 3);
+        QCOMPARE(statistics.bytesTotal, qint64(script.size()));
+        QCOMPARE(statistics.fractionRead(), 1.0);
+
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*), MAX(value) FROM items");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 2500);
+        QCOMPARE(query.value(1).toString(), QStringLiteral("v;999"));
+        query = ds.executeQuery("SELECT COUNT(*) FROM log");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 2500);
+
+        ds.closeConnection();
+    }
+
+    void executeScript_failureRollsBackOpenBatch()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/script_fail.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+        ds.setScriptBatchSize(2);
+
+        QByteArray script =
+            "INSERT INTO items VALUES (1, 'a');\n"
+            "INSERT INTO items VALUES (2, 'b');\n"
+            "INSERT INTO items VALUES (3, 'c');\n"
+            "INSERT INTO no_such_table VALUES (4);\n"
+            "INSERT INTO items VALUES (5, 'e');\n";
+        QBuffer buffer(&script);
+        QVERIFY(buffer.open(QBuffer::ReadOnly));
+
+        DataSource::ScriptStatistics statistics;
+        QVERIFY(!ds.executeScript(&buffer, DataSource::ScriptProgressCallback(), &statistics));
+        QCOMPARE(statistics.statements, qint64(3));
+        QCOMPARE(statistics.transactions, 1);
+        QVERIFY(!ds.errorText().isEmpty());
+
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM items");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 2);
+
+        ds.closeConnection();
+    }
+
+    void executeScript_cancelledByProgress()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/script_cancel.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        QByteArray script = "INSERT INTO items VALUES (1, 'a');";
+        QBuffer buffer(&script);
+        QVERIFY(buffer.open(QBuffer::ReadOnly));
+
+        QVERIFY(!ds.executeScript(&buffer, [](const DataSource::ScriptStatistics&) { return false; }));
+        QVERIFY(ds.errorText().contains("cancelled"));
+
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM items");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 0);
+
+        ds.closeConnection();
+    }
+
+    void executeScript_selfManagedTransactions()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/script_self.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        QByteArray script =
+            "INSERT INTO items VALUES (1, 'a');\n"
+            "BEGIN;\n"
+            "INSERT INTO items VALUES (2, 'b');\n"
+            "COMMIT;\n"
+            "INSERT INTO items VALUES (3, 'c')";
+        QBuffer buffer(&script);
+        QVERIFY(buffer.open(QBuffer::ReadOnly));
+        QVERIFY(ds.executeScript(&buffer));
+
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM items");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 3);
+
+        ds.closeConnection();
+    }
+
+    void executeScript_replaysDump()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/script_dump.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        // As written by sqlite3 .dump: tables in name order, so the child refers forward to its parent
+        QByteArray script =
+            "PRAGMA foreign_keys=OFF;\n"
+            "BEGIN TRANSACTION;\n"
+            "CREATE TABLE child (id INTEGER PRIMARY KEY, parent_id INTEGER REFERENCES parent (id));\n"
+            "INSERT INTO child VALUES(1,1);\n"
+            "CREATE TABLE parent (id INTEGER PRIMARY KEY);\n"
+            "INSERT INTO parent VALUES(1);\n"
+            "COMMIT;\n";
+        QBuffer buffer(&script);
+        QVERIFY(buffer.open(QBuffer::ReadOnly));
+        QVERIFY(ds.executeScript(&buffer));
+
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM child");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 1);
+
+        query = ds.executeQuery("PRAGMA foreign_keys");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 1);
+
+        ds.closeConnection();
+    }
+
+    void executeScript_unterminatedStatement_fails()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/script_unterminated.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        QByteArray script = "INSERT INTO items VALUES (1, 'a');\nINSERT INTO items VALUES (2, 'oops);";
+        QBuffer buffer(&script);
+        QVERIFY(buffer.open(QBuffer::ReadOnly));
+        QVERIFY(!ds.executeScript(&buffer));
+
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM items");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 0);
+
+        ds.closeConnection();
+    }
+
+    void executeScript_sequentialDevice_readsUntilNoMoreData()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/script_pipe.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        // Nothing is readable until each wait, and the multi-byte character is split between chunks
+        QByteArray accented = QString("INSERT INTO items VALUES (2, '%1');\n").arg(QChar(0xe9)).toUtf8();
+        int split = accented.indexOf(char(0xc3)) + 1;
+        TrickleDevice device({ "INSERT INTO items VALUES (1, 'a');\n", accented.left(split), accented.mid(split) });
+        QVERIFY(device.open(QIODevice::ReadOnly));
+
+        DataSource::ScriptStatistics statistics;
+        QVERIFY(ds.executeScript(&device, DataSource::ScriptProgressCallback(), &statistics));
+        QCOMPARE(statistics.statements, qint64(2));
+        QCOMPARE(statistics.bytesTotal, qint64(-1));
+
+        QSqlQuery query = ds.executeQuery("SELECT value FROM items WHERE id = 2");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toString(), QString(QChar(0xe9)));
+
+        ds.closeConnection();
+    }
+
+    void executeScript_truncatedUtf8_fails()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/script_utf8.db"));
+        ds.testCreateSql = "CREATE TABLE items (id INTEGER, value TEXT);";
+        QVERIFY(ds.openConnection());
+
+        QByteArray script = "INSERT INTO items VALUES (1, 'a');\n\xc3";
+        QBuffer buffer(&script);
+        QVERIFY(buffer.open(QBuffer::ReadOnly));
+        QVERIFY(!ds.executeScript(&buffer));
+        QVERIFY(ds.errorText().contains("UTF-8"));
+
+        ds.closeConnection();
+    }
+
+    void createSqlFile_takesPrecedence()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+
+        QFile file(tmpDir.path() + "/create.sql");
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write("-- schema\nCREATE TABLE from_file (id INTEGER);\nINSERT INTO from_file VALUES (1);\n");
+        file.close();
+
+        TestDataSource ds(DatabaseCredentials(tmpDir.path() + "/create_file.db"));
+        ds.testCreateSql = "CREATE TABLE from_string (id INTEGER);";
+        ds.testCreateSqlFile = file.fileName();
+        QVERIFY(ds.openConnection());
+
+        bool success = false;
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM from_file", &success);
+        QVERIFY(success && query.next());
+        QCOMPARE(query.value(0).toInt(), 1);
+        ds.executeQuery("SELECT * FROM from_string", &success);
+        QVERIFY(!success);
+
+        ds.closeConnection();
+
+        TestDataSource missing(DatabaseCredentials(tmpDir.path() + "/create_missing.db"));
+        missing.testCreateSqlFile = tmpDir.path() + "/no_such_file.sql";
+        QVERIFY(!missing.openConnection());
+    }
+
+    void currentSqliteProfile_notOpen_isEmpty()
+    {
+        TestDataSource ds;
+        QVERIFY(ds.currentSqliteProfile().isEmpty());
+    }
+
     void escapedString_singleQuotes_doubled()
     {
         QCOMPARE(TestDataSource::escapedString("it's"), QStringLiteral("it''s"));
@@ -418,6 +1214,18 @@ private slots:
 
         ds.closeConnection();
     }
+
+private:
+    static void createItems(TestDataSource& ds, int count)
+    {
+        QVariantList ids;
+        QVariantList values;
+        for(int i = 0;i < count;i++) {
+            ids.append(i);
+            values.append(QString("value%1").arg(i));
+        }
+        QVERIFY(ds.bulkInsert("items", {"id", "value"}, {ids, values}));
+    }
 };
 
 QTEST_MAIN(TstDataSource)
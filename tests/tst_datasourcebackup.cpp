@@ -0,0 +1,164 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include <QSqlQuery>
+#include <Kanoop/database/datasource.h>
+
+class BackupDataSource : public DataSource
+{
+public:
+    BackupDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::executeQuery;
+
+    int scalar(const QString& sql)
+    {
+        bool success;
+        QSqlQuery query = executeQuery(sql, &success);
+        return success && query.next() ? query.value(0).toInt() : -1;
+    }
+
+    bool insertRows(int count)
+    {
+        bool success = true;
+        for(int i = 0;success && i < count;i++) {
+            executeQuery(QString("INSERT INTO items (name) VALUES ('item %1 %2')").arg(i).arg(QString(40, 'x')), &success);
+        }
+        return success;
+    }
+
+protected:
+    QString createSql() const override
+    {
+        return
+            "CREATE TABLE items (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL);\n"
+            "CREATE INDEX idx_items_name ON items (name);\n"
+            "CREATE TABLE audit (item_id INTEGER REFERENCES items (id));\n"
+            "CREATE VIEW item_names AS SELECT name FROM items;\n"
+            "CREATE TRIGGER items_audit AFTER INSERT ON items BEGIN INSERT INTO audit (item_id) VALUES (new.id); END;";
+    }
+};
+
+class TstDataSourceBackup : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        QVERIFY(_tmpDir.isValid());
+        _ds = new BackupDataSource(DatabaseCredentials(QString("%1/%2.db").arg(_tmpDir.path()).arg(QTest::currentTestFunction())));
+        QVERIFY(_ds->openConnection());
+        QVERIFY(_ds->insertRows(500));
+    }
+
+    void cleanup()
+    {
+        _ds->closeConnection();
+        delete _ds;
+        _ds = nullptr;
+    }
+
+    void backupTo_fileCopiesEverything()
+    {
+        QString path = _tmpDir.path() + "/copy.db";
+        DataSource::BackupStatistics stats;
+        QVERIFY(_ds->backupTo(path, DataSource::BackupProgressCallback(), &stats));
+        QVERIFY(stats.pageCount > 0);
+        QCOMPARE(stats.pagesCopied, stats.pageCount);
+        QCOMPARE(stats.fractionCopied(), 1.0);
+        QCOMPARE(stats.incremental, DataSource::isOnlineBackupAvailable());
+        QVERIFY(!QFile::exists(path + ".partial"));
+
+        BackupDataSource copy((DatabaseCredentials(path)));
+        QVERIFY(copy.openConnection());
+        QCOMPARE(copy.scalar("SELECT COUNT(*) FROM items"), 500);
+        QCOMPARE(copy.scalar("SELECT COUNT(*) FROM item_names"), 500);
+        QCOMPARE(copy.scalar("SELECT COUNT(*) FROM audit"), 500);
+        QVERIFY(copy.insertRows(1));
+        QCOMPARE(copy.scalar("SELECT COUNT(*) FROM audit"), 501);
+        copy.closeConnection();
+    }
+
+    void backupTo_fileReplacesPreviousBackup()
+    {
+        QString path = _tmpDir.path() + "/replaced.db";
+        QVERIFY(_ds->backupTo(path));
+        QVERIFY(_ds->insertRows(10));
+        QVERIFY(_ds->backupTo(path));
+
+        BackupDataSource copy((DatabaseCredentials(path)));
+        QVERIFY(copy.openConnection());
+        QCOMPARE(copy.scalar("SELECT COUNT(*) FROM items"), 510);
+        copy.closeConnection();
+    }
+
+    void backupTo_stepsAndSignals()
+    {
+        _ds->setBackupPagesPerStep(1);
+        _ds->setBackupStepDelayMs(0);
+        QSignalSpy spy(_ds, &DataSource::backupProgress);
+        int callbacks = 0;
+        DataSource::BackupStatistics stats;
+        QVERIFY(_ds->backupTo(_tmpDir.path() + "/stepped.db", [&callbacks](const DataSource::BackupStatistics&) {
+            callbacks++;
+            return true;
+        }, &stats));
+
+        if(stats.incremental) {
+            QVERIFY(stats.steps >= stats.pageCount);
+        }
+        else {
+            QCOMPARE(stats.steps, 1);
+        }
+        QVERIFY(callbacks >= 2);
+        QCOMPARE(spy.count(), callbacks);
+        QList<QVariant> last = spy.last();
+        QCOMPARE(last.at(0).toLongLong(), stats.pageCount);
+        QCOMPARE(last.at(1).toLongLong(), stats.pageCount);
+    }
+
+    void backupTo_cancelLeavesNoFile()
+    {
+        QString path = _tmpDir.path() + "/cancelled.db";
+        _ds->setBackupPagesPerStep(1);
+        QVERIFY(!_ds->backupTo(path, [](const DataSource::BackupStatistics&) { return false; }));
+        QVERIFY(!QFile::exists(path));
+        QVERIFY(!QFile::exists(path + ".partial"));
+    }
+
+    void backupTo_inMemorySnapshot()
+    {
+        BackupDataSource snapshot((DatabaseCredentials(":memory:")));
+        QVERIFY(snapshot.openConnection());
+        QVERIFY(snapshot.insertRows(3));
+
+        QVERIFY(_ds->backupTo(&snapshot));
+        QCOMPARE(snapshot.scalar("SELECT COUNT(*) FROM items"), 500);
+        QCOMPARE(snapshot.scalar("SELECT COUNT(*) FROM item_names"), 500);
+
+        // Independent of later writes to the source, and AUTOINCREMENT carries on from the source
+        QVERIFY(_ds->insertRows(5));
+        QCOMPARE(snapshot.scalar("SELECT COUNT(*) FROM items"), 500);
+        QVERIFY(snapshot.insertRows(1));
+        QCOMPARE(snapshot.scalar("SELECT MAX(id) FROM items"), 501);
+        snapshot.closeConnection();
+    }
+
+    void backupTo_rejectsInvalidDestinations()
+    {
+        QVERIFY(!_ds->backupTo(_ds));
+        QVERIFY(!_ds->backupTo(static_cast<DataSource*>(nullptr)));
+        QVERIFY(!_ds->backupTo(_ds->credentials().schema()));
+
+        BackupDataSource closed((DatabaseCredentials(_tmpDir.path() + "/closed.db")));
+        QVERIFY(!_ds->backupTo(&closed));
+    }
+
+private:
+    QTemporaryDir _tmpDir;
+    BackupDataSource* _ds = nullptr;
+};
+
+QTEST_MAIN(TstDataSourceBackup)
+#include "tst_datasourcebackup.moc"
@@ -0,0 +1,224 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/datasourcemetrics.h>
+
+class MetricsItem : public QueryLoadable
+{
+public:
+    bool loadFromQuery(const QSqlQuery& query) override
+    {
+        id = query.value(0).toInt();
+        return true;
+    }
+
+    int id = 0;
+};
+
+class MetricsDataSource : public DataSource
+{
+public:
+    MetricsDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::executeQuery;
+    using DataSource::prepareQuery;
+    using DataSource::bulkInsertRows;
+    using DataSource::loadAll;
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT);"; }
+};
+
+class TstDataSourceMetrics : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void normalize_replacesLiterals()
+    {
+        QCOMPARE(DataSourceMetrics::normalize("SELECT * FROM items WHERE id = 42 AND name = 'it''s'"),
+                 QStringLiteral("SELECT * FROM items WHERE id = ? AND name = ?"));
+        QCOMPARE(DataSourceMetrics::normalize("  SELECT   a,\n\tb FROM t1 WHERE x > -1.5e3;  "),
+                 QStringLiteral("SELECT a, b FROM t1 WHERE x > -?"));
+    }
+
+    void normalize_keepsIdentifiersAndPlaceholders()
+    {
+        QCOMPARE(DataSourceMetrics::normalize("SELECT col2 FROM \"table 1\" WHERE c = ?1 AND d = :name2"),
+                 QStringLiteral("SELECT col2 FROM \"table 1\" WHERE c = ?1 AND d = :name2"));
+    }
+
+    void normalize_collapsesLists()
+    {
+        QCOMPARE(DataSourceMetrics::normalize("SELECT * FROM t WHERE id IN (1, 2, 3)"),
+                 DataSourceMetrics::normalize("SELECT * FROM t WHERE id IN (?,?)"));
+        QCOMPARE(DataSourceMetrics::normalize("INSERT INTO t (a, b) VALUES (?,?),(?,?),(?,?)"),
+                 QStringLiteral("INSERT INTO t (a, b) VALUES (?),..."));
+        QCOMPARE(DataSourceMetrics::normalize("INSERT INTO t (a, b) VALUES (?,?),(?,?)"),
+                 QStringLiteral("INSERT INTO t (a, b) VALUES (?),..."));
+    }
+
+    void histogram_percentiles()
+    {
+        DataSourceMetrics::Histogram histogram;
+        QCOMPARE(histogram.percentile(0.5), 0.0);
+
+        // 90 fast samples, 10 slow
+        for(int i = 0;i < 90;i++) {
+            histogram.record(80);
+        }
+        for(int i = 0;i < 10;i++) {
+            histogram.record(20000);
+        }
+        QCOMPARE(histogram.count(), qint64(100));
+        QCOMPARE(histogram.maxUsecs(), qint64(20000));
+        QCOMPARE(histogram.sumUsecs(), qint64(90 * 80 + 10 * 20000));
+
+        double p50 = histogram.percentile(0.50);
+        QVERIFY(p50 > 50 && p50 <= 100);
+        double p95 = histogram.percentile(0.95);
+        QVERIFY(p95 > 10000 && p95 <= 20000);
+        QCOMPARE(histogram.percentile(1.0), 20000.0);
+    }
+
+    void record_groupsByNormalizedStatement()
+    {
+        DataSourceMetrics metrics;
+        metrics.recordPrepare("SELECT * FROM t WHERE id = 1", 10);
+        metrics.recordExecution("SELECT * FROM t WHERE id = 1", 100, true, 1, 0);
+        metrics.recordExecution("SELECT * FROM t WHERE id = 2", 300, true, 0, 0);
+        metrics.recordExecution("DELETE FROM t", 50, false, 0, 0);
+        metrics.recordRowsReturned("SELECT * FROM t WHERE id = 3", 4);
+
+        QList<DataSourceMetrics::StatementStatistics> statements = metrics.snapshot();
+        QCOMPARE(statements.count(), 2);
+        const DataSourceMetrics::StatementStatistics& select = statements.at(0);
+        QCOMPARE(select.statement, QStringLiteral("SELECT * FROM t WHERE id = ?"));
+        QCOMPARE(select.executions, qint64(2));
+        QCOMPARE(select.rowsReturned, qint64(5));
+        QCOMPARE(select.prepares, qint64(1));
+        QCOMPARE(select.prepareUsecs, qint64(10));
+        QCOMPARE(select.latency.sumUsecs(), qint64(400));
+        QCOMPARE(statements.at(1).failures, qint64(1));
+
+        DataSourceMetrics::StatementStatistics totals = metrics.totals();
+        QCOMPARE(totals.executions, qint64(3));
+        QCOMPARE(totals.latency.count(), qint64(3));
+
+        metrics.reset();
+        QVERIFY(metrics.snapshot().isEmpty());
+    }
+
+    void record_limitsDistinctStatements()
+    {
+        DataSourceMetrics metrics;
+        metrics.setMaxStatements(2);
+        metrics.recordExecution("SELECT a FROM t", 1, true, 0, 0);
+        metrics.recordExecution("SELECT b FROM t", 1, true, 0, 0);
+        metrics.recordExecution("SELECT c FROM t", 1, true, 0, 0);
+        metrics.recordExecution("SELECT d FROM t", 1, true, 0, 0);
+
+        QList<DataSourceMetrics::StatementStatistics> statements = metrics.snapshot();
+        QCOMPARE(statements.count(), 3);
+        bool foundOther = false;
+        for(const DataSourceMetrics::StatementStatistics& statistics : std::as_const(statements)) {
+            if(statistics.statement == DataSourceMetrics::OtherStatement) {
+                foundOther = true;
+                QCOMPARE(statistics.executions, qint64(2));
+            }
+        }
+        QVERIFY(foundOther);
+    }
+
+    void toPrometheus_format()
+    {
+        DataSourceMetrics metrics;
+        metrics.recordExecution("SELECT \"x\" FROM t WHERE id = 7", 1500, true, 1, 0);
+
+        QString text = metrics.toPrometheus("app_db", { { "datasource", "main" } });
+        QString labels = "datasource=\"main\",statement=\"SELECT \\\"x\\\" FROM t WHERE id = ?\"";
+        QVERIFY(text.contains("# TYPE app_db_statement_executions_total counter\n"));
+        QVERIFY(text.contains(QString("app_db_statement_executions_total{%1} 1\n").arg(labels)));
+        QVERIFY(text.contains(QString("app_db_statement_rows_returned_total{%1} 1\n").arg(labels)));
+        QVERIFY(text.contains("# TYPE app_db_statement_duration_seconds histogram\n"));
+        QVERIFY(text.contains(QString("app_db_statement_duration_seconds_bucket{%1,le=\"0.001\"} 0\n").arg(labels)));
+        QVERIFY(text.contains(QString("app_db_statement_duration_seconds_bucket{%1,le=\"0.0025\"} 1\n").arg(labels)));
+        QVERIFY(text.contains(QString("app_db_statement_duration_seconds_bucket{%1,le=\"+Inf\"} 1\n").arg(labels)));
+        QVERIFY(text.contains(QString("app_db_statement_duration_seconds_sum{%1} 0.0015\n").arg(labels)));
+        QVERIFY(text.contains(QString("app_db_statement_duration_seconds_count{%1} 1\n").arg(labels)));
+    }
+
+    void dataSource_disabledByDefault()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        MetricsDataSource ds(DatabaseCredentials(tmpDir.path() + "/disabled.db"));
+        QVERIFY(ds.openConnection());
+        QVERIFY(!ds.metricsEnabled());
+        QCOMPARE(ds.slowQueryThresholdMs(), -1);
+
+        ds.executeQuery("INSERT INTO items (id, name) VALUES (1, 'one')");
+        QVERIFY(ds.metrics().snapshot().isEmpty());
+
+        ds.closeConnection();
+    }
+
+    void dataSource_recordsExecutions()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        MetricsDataSource ds(DatabaseCredentials(tmpDir.path() + "/enabled.db"));
+        QVERIFY(ds.openConnection());
+        ds.setMetricsEnabled(true);
+        ds.setSlowQueryThresholdMs(0);
+        ds.setStatementCacheSize(8);
+
+        for(int i = 0;i < 5;i++) {
+            bool success = false;
+            QSqlQuery query = ds.prepareQuery("INSERT INTO items (id, name) VALUES (?, ?)", &success);
+            QVERIFY(success);
+            query.addBindValue(i);
+            query.addBindValue(QString("name%1").arg(i));
+            QVERIFY(ds.executeQuery(query));
+        }
+        QVERIFY(ds.bulkInsertRows("items", { "id", "name" }, { { 10, "ten" }, { 11, "eleven" } }));
+
+        bool success = false;
+        QList<MetricsItem> items = ds.loadAll<MetricsItem>("SELECT id FROM items WHERE id < ?", { 100 }, 0, &success);
+        QVERIFY(success);
+        QCOMPARE(items.count(), 7);
+
+        ds.executeQuery("SELECT * FROM no_such_table", &success);
+        QVERIFY(!success);
+
+        DataSourceMetrics::StatementStatistics insert;
+        DataSourceMetrics::StatementStatistics bulk;
+        DataSourceMetrics::StatementStatistics select;
+        for(const DataSourceMetrics::StatementStatistics& statistics : ds.metrics().snapshot()) {
+            if(statistics.statement == "INSERT INTO items (id, name) VALUES (?)") {
+                insert = statistics;
+            }
+            else if(statistics.statement == "INSERT INTO items (id,name) VALUES (?),...") {
+                bulk = statistics;
+            }
+            else if(statistics.statement == "SELECT id FROM items WHERE id < ?") {
+                select = statistics;
+            }
+        }
+        QCOMPARE(insert.executions, qint64(5));
+        QCOMPARE(insert.prepares, qint64(1));
+        QCOMPARE(insert.rowsAffected, qint64(5));
+        QCOMPARE(insert.latency.count(), qint64(5));
+        QCOMPARE(bulk.executions, qint64(1));
+        QCOMPARE(bulk.rowsAffected, qint64(2));
+        QCOMPARE(select.executions, qint64(1));
+        QCOMPARE(select.rowsReturned, qint64(7));
+        QCOMPARE(ds.metrics().totals().failures, qint64(1));
+
+        ds.closeConnection();
+    }
+};
+
+QTEST_MAIN(TstDataSourceMetrics)
+#include "tst_datasourcemetrics.moc"
@@ -0,0 +1,233 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QThread>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/datasourcepool.h>
+#include <functional>
+
+class PooledDataSource : public DataSource
+{
+public:
+    PooledDataSource() : DataSource() {}
+
+    using DataSource::executeQuery;
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, value TEXT);"; }
+};
+
+// Run a function on a thread with a running event loop, and wait for it
+static void runOn(QThread* thread, const std::function<void()>& function)
+{
+    QObject* context = new QObject;
+    context->moveToThread(thread);
+    QMetaObject::invokeMethod(context, function, Qt::BlockingQueuedConnection);
+    context->deleteLater();
+}
+
+// Acquire and release a connection on a thread, and note the thread its data source is destroyed on
+static void leaseOn(QThread* thread, DataSourcePool& pool, QThread** destroyedOn)
+{
+    runOn(thread, [&pool, destroyedOn]() {
+        DataSourceLease lease = pool.acquire();
+        QObject::connect(lease.dataSource(), &QObject::destroyed, lease.dataSource(), [destroyedOn]() {
+            *destroyedOn = QThread::currentThread();
+        }, Qt::DirectConnection);
+    });
+}
+
+class TstDataSourcePool : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void acquire_opensConnection()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DataSourcePool pool(DatabaseCredentials(tmpDir.path() + "/pool.db"), DataSourcePool::factory<PooledDataSource>());
+
+        bool success = false;
+        DataSourceLease lease = pool.acquire(&success);
+        QVERIFY(success);
+        QVERIFY(lease.isValid());
+        QVERIFY(lease->isOpen());
+        QVERIFY(lease.as<PooledDataSource>() != nullptr);
+
+        lease.as<PooledDataSource>()->executeQuery("INSERT INTO items (id, value) VALUES (1, 'a')", &success);
+        QVERIFY(success);
+        QCOMPARE(pool.connectionCount(), 1);
+    }
+
+    void acquire_sameThread_sharesConnection()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DataSourcePool pool(DatabaseCredentials(tmpDir.path() + "/pool.db"), DataSourcePool::factory<PooledDataSource>());
+
+        DataSourceLease outer = pool.acquire();
+        DataSourceLease inner = pool.acquire();
+        QVERIFY(outer.isValid());
+        QCOMPARE(inner.dataSource(), outer.dataSource());
+        QCOMPARE(pool.connectionCount(), 1);
+        QCOMPARE(pool.metrics().activeConnections, 1);
+
+        inner.release();
+        QCOMPARE(pool.metrics().activeConnections, 1);
+        outer.release();
+        QCOMPARE(pool.metrics().activeConnections, 0);
+    }
+
+    void acquire_otherThread_getsOwnConnection()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DataSourcePool pool(DatabaseCredentials(tmpDir.path() + "/pool.db"), DataSourcePool::factory<PooledDataSource>());
+
+        DataSourceLease lease = pool.acquire();
+        QVERIFY(lease.isValid());
+        QString mainConnection = lease->connectionName();
+
+        QString workerConnection;
+        bool workerSuccess = false;
+        QThread* worker = QThread::create([&pool, &workerConnection, &workerSuccess]() {
+            DataSourceLease workerLease = pool.acquire();
+            if(workerLease.isValid()) {
+                workerConnection = workerLease->connectionName();
+                workerLease.as<PooledDataSource>()->executeQuery("INSERT INTO items (id, value) VALUES (2, 'b')", &workerSuccess);
+            }
+        });
+        worker->start();
+        QVERIFY(worker->wait(10000));
+        delete worker;
+
+        QVERIFY(workerSuccess);
+        QVERIFY(!workerConnection.isEmpty());
+        QVERIFY(workerConnection != mainConnection);
+        QCOMPARE(pool.metrics().connectionsOpened, qint64(2));
+
+        // The worker's connection was closed as the worker finished
+        QCOMPARE(pool.connectionCount(), 1);
+        QCOMPARE(pool.metrics().connectionsEvicted, qint64(1));
+    }
+
+    void acquire_finishedThreadsFreeTheirSlots()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DataSourcePool pool(DatabaseCredentials(tmpDir.path() + "/pool.db"), DataSourcePool::factory<PooledDataSource>());
+        pool.setMaximumConnections(1);
+        pool.setAcquireTimeout(50);
+
+        for(int i = 0;i < 3;i++) {
+            bool workerSuccess = false;
+            QThread* destroyedOn = nullptr;
+            QThread* worker = QThread::create([&pool, &workerSuccess, &destroyedOn]() {
+                DataSourceLease workerLease = pool.acquire(&workerSuccess);
+                QObject::connect(workerLease.dataSource(), &QObject::destroyed, workerLease.dataSource(), [&destroyedOn]() {
+                    destroyedOn = QThread::currentThread();
+                }, Qt::DirectConnection);
+            });
+            worker->start();
+            QVERIFY(worker->wait(10000));
+            QVERIFY(workerSuccess);
+            QCOMPARE(destroyedOn, worker);
+            delete worker;
+            QCOMPARE(pool.connectionCount(), 0);
+        }
+        QCOMPARE(pool.metrics().timeouts, qint64(0));
+        QCOMPARE(pool.metrics().connectionsEvicted, qint64(3));
+    }
+
+    void acquire_atCapacity_timesOut()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DataSourcePool pool(DatabaseCredentials(tmpDir.path() + "/pool.db"), DataSourcePool::factory<PooledDataSource>());
+        pool.setMaximumConnections(1);
+        pool.setAcquireTimeout(50);
+
+        DataSourceLease lease = pool.acquire();
+        QVERIFY(lease.isValid());
+
+        bool workerSuccess = true;
+        QThread* worker = QThread::create([&pool, &workerSuccess]() {
+            DataSourceLease workerLease = pool.acquire(&workerSuccess);
+        });
+        worker->start();
+        QVERIFY(worker->wait(10000));
+        delete worker;
+
+        QVERIFY(!workerSuccess);
+        QCOMPARE(pool.metrics().timeouts, qint64(1));
+    }
+
+    void acquire_atCapacity_retiresIdleConnection()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DataSourcePool pool(DatabaseCredentials(tmpDir.path() + "/pool.db"), DataSourcePool::factory<PooledDataSource>());
+        pool.setMaximumConnections(1);
+
+        QThread worker;
+        worker.start();
+        QThread* destroyedOn = nullptr;
+        leaseOn(&worker, pool, &destroyedOn);
+        QCOMPARE(pool.connectionCount(), 1);
+
+        DataSourceLease lease = pool.acquire();
+        QVERIFY(lease.isValid());
+        QCOMPARE(pool.connectionCount(), 1);
+        QCOMPARE(pool.metrics().connectionsEvicted, qint64(1));
+
+        // The retired connection is closed by its own thread
+        QTRY_COMPARE(destroyedOn, &worker);
+        worker.quit();
+        QVERIFY(worker.wait(10000));
+    }
+
+    void evictIdleConnections_respectsMinimum()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        DataSourcePool pool(DatabaseCredentials(tmpDir.path() + "/pool.db"), DataSourcePool::factory<PooledDataSource>());
+
+        QThread worker;
+        worker.start();
+        QThread* destroyedOn = nullptr;
+        leaseOn(&worker, pool, &destroyedOn);
+        {
+            DataSourceLease lease = pool.acquire();
+        }
+        QCOMPARE(pool.connectionCount(), 2);
+
+        QThread::msleep(10);
+        pool.setIdleTimeout(1);
+        pool.setMinimumConnections(1);
+        QCOMPARE(pool.evictIdleConnections(), 1);
+        QCOMPARE(pool.connectionCount(), 1);
+
+        pool.setMinimumConnections(0);
+        QCOMPARE(pool.evictIdleConnections(), 1);
+        QCOMPARE(pool.connectionCount(), 0);
+
+        QTRY_COMPARE(destroyedOn, &worker);
+        worker.quit();
+        QVERIFY(worker.wait(10000));
+    }
+
+    void acquire_openFailure_reportsFailure()
+    {
+        DataSourcePool pool(DatabaseCredentials("host", "db", "user", "pass", "QNOSUCHDRIVER"));
+
+        bool success = true;
+        DataSourceLease lease = pool.acquire(&success);
+        QVERIFY(!success);
+        QVERIFY(!lease.isValid());
+        QCOMPARE(pool.connectionCount(), 0);
+        QCOMPARE(pool.metrics().openFailures, qint64(1));
+    }
+};
+
+QTEST_MAIN(TstDataSourcePool)
+#include "tst_datasourcepool.moc"
@@ -0,0 +1,219 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QSqlQuery>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/inclause.h>
+#include <Kanoop/database/transaction.h>
+
+class InClauseDataSource : public DataSource
+{
+public:
+    InClauseDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::executeQuery;
+    using DataSource::executeForwardOnly;
+    using DataSource::bulkInsert;
+    using DataSource::recreateSqliteDatabase;
+
+    // Count the matching rows of an IN query
+    int countIn(const InClause& clause, bool* success)
+    {
+        QSqlQuery query = executeForwardOnly("SELECT COUNT(*) FROM items WHERE id IN " + clause.sql(), clause.bindings(), success);
+        int result = *success && query.next() ? query.value(0).toInt() : -1;
+        query.finish();
+        return result;
+    }
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT);"; }
+};
+
+class TstInClause : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void bucketSize_roundsUpToPowerOfTwo()
+    {
+        QCOMPARE(InClause::bucketSize(1), 1);
+        QCOMPARE(InClause::bucketSize(3), 4);
+        QCOMPARE(InClause::bucketSize(4), 4);
+        QCOMPARE(InClause::bucketSize(5), 8);
+        QCOMPARE(InClause::bucketSize(513), 999);
+        QCOMPARE(InClause::bucketSize(600, 100), 600);
+        QCOMPARE(InClause::bucketSize(60, 100), 64);
+    }
+
+    void placeholders_paddedWithLastValue()
+    {
+        InClause clause(InClause::values(QList<int>({ 7, 8, 9 })));
+        QCOMPARE(clause.sql(), QStringLiteral("(?,?,?,?)"));
+        QCOMPARE(clause.bindings(), QVariantList({ 7, 8, 9, 9 }));
+        QCOMPARE(clause.count(), qsizetype(3));
+        QVERIFY(!clause.isStaged());
+        QVERIFY(clause.isValid());
+    }
+
+    void similarLengths_shareSql()
+    {
+        InClause five(InClause::values(QStringList({ "a", "b", "c", "d", "e" })));
+        InClause seven(InClause::values(QStringList({ "a", "b", "c", "d", "e", "f", "g" })));
+        QCOMPARE(five.sql(), seven.sql());
+        QCOMPARE(five.bindings().count(), 8);
+    }
+
+    void emptyList_matchesNothing()
+    {
+        InClause clause((QVariantList()));
+        QVERIFY(clause.isEmpty());
+        QCOMPARE(clause.sql(), QStringLiteral("(NULL)"));
+        QVERIFY(clause.bindings().isEmpty());
+    }
+
+    void uuidValues_withoutBraces()
+    {
+        QUuid uuid = QUuid::createUuid();
+        QCOMPARE(InClause::values(QList<QUuid>({ uuid })).first().toString(), uuid.toString(QUuid::WithoutBraces));
+    }
+
+    void dataSource_boundListsReuseStatements()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        InClauseDataSource ds(DatabaseCredentials(tmpDir.path() + "/bound.db"));
+        QVERIFY(ds.openConnection());
+        ds.setStatementCacheSize(8);
+        createItems(ds, 100);
+
+        bool success = false;
+        InClause first(&ds, InClause::values(QList<int>({ 1, 2, 3, 500 })));
+        QCOMPARE(ds.countIn(first, &success), 3);
+        QVERIFY(success);
+
+        qint64 misses = ds.statementCacheStatistics().misses;
+        InClause second(&ds, InClause::values(QList<int>({ 10, 20, 30 })));
+        QCOMPARE(second.sql(), first.sql());
+        QCOMPARE(ds.countIn(second, &success), 3);
+        QCOMPARE(ds.statementCacheStatistics().misses, misses);
+
+        ds.closeConnection();
+    }
+
+    void dataSource_largeListsStaged()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        InClauseDataSource ds(DatabaseCredentials(tmpDir.path() + "/staged.db"));
+        QVERIFY(ds.openConnection());
+        ds.setInClauseStagingThreshold(50);
+        createItems(ds, 1000);
+
+        QList<int> evens;
+        QList<int> odds;
+        for(int i = 0;i < 1200;i++) {
+            (i % 2 == 0 ? evens : odds).append(i);
+        }
+
+        bool success = false;
+        QString firstSql;
+        {
+            InClause even(&ds, InClause::values(evens));
+            InClause odd(&ds, InClause::values(odds));
+            QVERIFY(even.isStaged() && even.isValid());
+            QVERIFY(even.bindings().isEmpty());
+            QVERIFY(even.sql() != odd.sql());
+            QCOMPARE(ds.countIn(even, &success), 500);
+            QCOMPARE(ds.countIn(odd, &success), 500);
+            firstSql = even.sql();
+        }
+
+        // Released tables are emptied and reused
+        InClause few(&ds, InClause::values(QList<int>({ 1, 2, 3 })));
+        QVERIFY(!few.isStaged());
+        QList<int> range;
+        for(int i = 900;i < 1100;i++) {
+            range.append(i);
+        }
+        InClause reused(&ds, InClause::values(range));
+        QCOMPARE(reused.sql(), firstSql);
+        QCOMPARE(ds.countIn(reused, &success), 100);
+
+        ds.closeConnection();
+    }
+
+    void dataSource_stagedTableSurvivesRollback()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        InClauseDataSource ds(DatabaseCredentials(tmpDir.path() + "/rollback.db"));
+        QVERIFY(ds.openConnection());
+        ds.setInClauseStagingThreshold(10);
+        createItems(ds, 100);
+
+        QList<int> ids;
+        for(int i = 0;i < 20;i++) {
+            ids.append(i);
+        }
+
+        bool success = false;
+        {
+            Transaction transaction(&ds);
+            InClause clause(&ds, InClause::values(ids));
+            QCOMPARE(ds.countIn(clause, &success), 20);
+        }
+
+        InClause clause(&ds, InClause::values(ids));
+        QVERIFY(clause.isValid());
+        QCOMPARE(ds.countIn(clause, &success), 20);
+
+        ds.closeConnection();
+    }
+
+    void dataSource_recreateForgetsStagedTables()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        QString path = tmpDir.path() + "/recreate.db";
+        InClauseDataSource ds((DatabaseCredentials(path)));
+        QVERIFY(ds.openConnection());
+        ds.setInClauseStagingThreshold(10);
+        createItems(ds, 100);
+
+        QList<int> ids;
+        for(int i = 0;i < 20;i++) {
+            ids.append(i);
+        }
+
+        // A clause still alive when the database is replaced no longer holds its table
+        bool success = false;
+        InClause stale(&ds, InClause::values(ids));
+        QVERIFY(stale.isValid());
+        QVERIFY(QFile::remove(path));
+        QVERIFY(ds.recreateSqliteDatabase());
+        createItems(ds, 50);
+
+        InClause clause(&ds, InClause::values(ids));
+        QVERIFY(clause.isValid());
+        QCOMPARE(clause.sql(), stale.sql());
+        QCOMPARE(ds.countIn(clause, &success), 20);
+        QVERIFY(success);
+
+        ds.closeConnection();
+    }
+
+private:
+    static void createItems(InClauseDataSource& ds, int count)
+    {
+        QVariantList ids;
+        QVariantList names;
+        for(int i = 0;i < count;i++) {
+            ids.append(i);
+            names.append(QString("name%1").arg(i));
+        }
+        QVERIFY(ds.bulkInsert("items", { "id", "name" }, { ids, names }));
+    }
+};
+
+QTEST_MAIN(TstInClause)
+#include "tst_inclause.moc"
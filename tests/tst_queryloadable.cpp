@@ -0,0 +1,183 @@
+#include <QTest>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <Kanoop/database/queryloadable.h>
+#include <Kanoop/database/querycolumnbinding.h>
+
+static const int RowCount = 5000;
+static const char* const ConnectionName = "tst_queryloadable";
+
+// Decodes with QSqlQuery::value(name): one record search per column per row
+class NamedItem : public QueryLoadable
+{
+public:
+    bool loadFromQuery(const QSqlQuery& query) override
+    {
+        id = query.value("id").toInt();
+        name = query.value("name").toString();
+        a = query.value("a").toInt();
+        b = query.value("b").toInt();
+        c = query.value("c").toDouble();
+        d = query.value("d").toString();
+        return true;
+    }
+
+    int id = 0;
+    QString name;
+    int a = 0;
+    int b = 0;
+    double c = 0;
+    QString d;
+};
+
+// Decodes by index cached in a runtime binding
+class DynamicBoundItem : public NamedItem
+{
+public:
+    bool loadFromQuery(const QSqlQuery& query) override
+    {
+        enum { Id, Name, A, B, C, D };
+        static thread_local QueryColumnBinding binding({ "id", "name", "a", "b", "c", "d" });
+        binding.bind(query);
+        id = binding.value(query, Id).toInt();
+        name = binding.value(query, Name).toString();
+        a = binding.value(query, A).toInt();
+        b = binding.value(query, B).toInt();
+        c = binding.value(query, C).toDouble();
+        d = binding.value(query, D).toString();
+        return binding.isComplete();
+    }
+};
+
+// Decodes by index cached in a compile-time binding
+class StaticBoundItem : public NamedItem
+{
+public:
+    bool loadFromQuery(const QSqlQuery& query) override
+    {
+        enum { Id, Name, A, B, C, D };
+        static constexpr const char* Columns[] = { "id", "name", "a", "b", "c", "d" };
+        const StaticQueryColumnBinding<6>& binding = bindColumns<StaticBoundItem>(query, Columns);
+        id = binding.value(query, Id).toInt();
+        name = binding.value(query, Name).toString();
+        a = binding.value(query, A).toInt();
+        b = binding.value(query, B).toInt();
+        c = binding.value(query, C).toDouble();
+        d = binding.value(query, D).toString();
+        resolveCount = binding.resolveCount();
+        return binding.isComplete();
+    }
+
+    static int resolveCount;
+};
+
+int StaticBoundItem::resolveCount = 0;
+
+class TstQueryLoadable : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", ConnectionName);
+        db.setDatabaseName(":memory:");
+        QVERIFY(db.open());
+
+        QSqlQuery query(db);
+        QVERIFY(query.exec("CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT, a INTEGER, b INTEGER, c REAL, d TEXT)"));
+        QVERIFY(db.transaction());
+        QVERIFY(query.prepare("INSERT INTO items (id, name, a, b, c, d) VALUES (?, ?, ?, ?, ?, ?)"));
+        for(int i = 0;i < RowCount;i++) {
+            query.addBindValue(i);
+            query.addBindValue(QString("name%1").arg(i));
+            query.addBindValue(i * 2);
+            query.addBindValue(i * 3);
+            query.addBindValue(i / 2.0);
+            query.addBindValue(QString("d%1").arg(i));
+            QVERIFY(query.exec());
+        }
+        QVERIFY(db.commit());
+    }
+
+    void cleanupTestCase()
+    {
+        QSqlDatabase::database(ConnectionName).close();
+        QSqlDatabase::removeDatabase(ConnectionName);
+    }
+
+    void dynamicBinding_resolvesOncePerResultSet()
+    {
+        QueryColumnBinding binding({ "ID", "name" });
+        QSqlQuery query(QSqlDatabase::database(ConnectionName));
+        QVERIFY(query.prepare("SELECT name, id FROM items WHERE id < ?"));
+
+        for(int pass = 0;pass < 2;pass++) {
+            query.addBindValue(10);
+            QVERIFY(query.exec());
+            int rows = 0;
+            while(query.next()) {
+                QVERIFY(binding.bind(query));
+                QCOMPARE(binding.index(0), 1);
+                QCOMPARE(binding.value(query, 0).toInt(), rows);
+                QCOMPARE(binding.value(query, 1).toString(), QString("name%1").arg(rows));
+                rows++;
+            }
+            QCOMPARE(rows, 10);
+        }
+        QCOMPARE(binding.resolveCount(), 1);
+
+        QSqlQuery other(QSqlDatabase::database(ConnectionName));
+        QVERIFY(other.exec("SELECT id, name FROM items LIMIT 1"));
+        QVERIFY(other.next());
+        QVERIFY(binding.bind(other));
+        QCOMPARE(binding.index(0), 0);
+        QCOMPARE(binding.resolveCount(), 2);
+
+        // The same query object running different SQL is a new result set
+        QVERIFY(other.exec("SELECT name, id FROM items LIMIT 2"));
+        QVERIFY(other.next());
+        QVERIFY(binding.bind(other));
+        QCOMPARE(binding.index(0), 1);
+        QVERIFY(other.next());
+        QVERIFY(binding.bind(other));
+        QCOMPARE(binding.resolveCount(), 3);
+    }
+
+    void dynamicBinding_reportsMissingColumns()
+    {
+        QueryColumnBinding binding({ "id", "missing" });
+        QSqlQuery query(QSqlDatabase::database(ConnectionName));
+        QVERIFY(query.exec("SELECT id FROM items LIMIT 1"));
+        QVERIFY(query.next());
+        QVERIFY(!binding.bind(query));
+        QVERIFY(!binding.isComplete());
+        QCOMPARE(binding.missingColumns(), QStringList({ "missing" }));
+        QCOMPARE(binding.value(query, 0).toInt(), 0);
+        QVERIFY(!binding.value(query, 1).isValid());
+    }
+
+    void staticBinding_decodesSameAsNames()
+    {
+        QSqlQuery query(QSqlDatabase::database(ConnectionName));
+        QVERIFY(query.exec("SELECT d, c, b, a, name, id FROM items ORDER BY id"));
+        int before = StaticBoundItem::resolveCount;
+        int rows = 0;
+        while(query.next()) {
+            NamedItem expected;
+            StaticBoundItem actual;
+            QVERIFY(expected.loadFromQuery(query));
+            QVERIFY(actual.loadFromQuery(query));
+            QCOMPARE(actual.id, expected.id);
+            QCOMPARE(actual.name, expected.name);
+            QCOMPARE(actual.c, expected.c);
+            QCOMPARE(actual.d, expected.d);
+            rows++;
+        }
+        QCOMPARE(rows, RowCount);
+        QCOMPARE(StaticBoundItem::resolveCount, before + 1);
+    }
+};
+
+QTEST_MAIN(TstQueryLoadable)
+#include "tst_queryloadable.moc"
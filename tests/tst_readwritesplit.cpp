@@ -0,0 +1,245 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <QThread>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/queryrouting.h>
+#include <Kanoop/database/transaction.h>
+
+class SplitDataSource : public DataSource
+{
+public:
+    SplitDataSource(const DatabaseCredentials& creds) : DataSource(creds)
+    {
+        setSqliteProfile(SqlitePerformanceProfile::balanced());
+    }
+
+    using DataSource::executeQuery;
+
+    int count()
+    {
+        bool success;
+        QSqlQuery query = executeQuery("SELECT COUNT(*) FROM items", &success);
+        return success && query.next() ? query.value(0).toInt() : -1;
+    }
+
+    bool insert(const QString& name)
+    {
+        bool success;
+        executeQuery(QString("INSERT INTO items (name) VALUES ('%1')").arg(name), &success);
+        return success;
+    }
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT);"; }
+};
+
+// Run a function on a new thread and wait for it
+static void runOnThread(const std::function<void()>& function)
+{
+    QThread* thread = QThread::create(function);
+    thread->start();
+    thread->wait();
+    delete thread;
+}
+
+// Run a function on a running thread and wait for it
+static void runOn(QThread* thread, const std::function<void()>& function)
+{
+    QObject* context = new QObject;
+    context->moveToThread(thread);
+    QMetaObject::invokeMethod(context, function, Qt::BlockingQueuedConnection);
+    context->deleteLater();
+}
+
+// Names of the read connections still registered with Qt
+static QStringList readerConnectionNames()
+{
+    return QSqlDatabase::connectionNames().filter("-reader-");
+}
+
+class TstReadWriteSplit : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        QVERIFY(_tmpDir.isValid());
+        _ds = new SplitDataSource(DatabaseCredentials(QString("%1/%2.db").arg(_tmpDir.path()).arg(QTest::currentTestFunction())));
+        _ds->setReadConnectionLimit(2);
+        QVERIFY(_ds->openConnection());
+        QVERIFY(_ds->insert("one"));
+        QVERIFY(_ds->insert("two"));
+    }
+
+    void cleanup()
+    {
+        _ds->closeConnection();
+        delete _ds;
+        _ds = nullptr;
+    }
+
+    void defaults_disabled()
+    {
+        DataSource ds;
+        QCOMPARE(ds.readConnectionLimit(), 0);
+        QCOMPARE(ds.readConnectionCount(), 0);
+    }
+
+    void reads_fromOtherThreadsUseReaders()
+    {
+        QThread first;
+        QThread second;
+        first.start();
+        second.start();
+
+        int counts[2] = { 0, 0 };
+        runOn(&first, [this, &counts]() { counts[0] = _ds->count(); });
+        runOn(&second, [this, &counts]() { counts[1] = _ds->count(); });
+        QCOMPARE(counts[0], 2);
+        QCOMPARE(counts[1], 2);
+        QCOMPARE(_ds->readConnectionCount(), 2);
+
+        // Past the limit, other threads fall back to the writer, which they cannot use
+        int overflow = 0;
+        runOnThread([this, &overflow]() { overflow = _ds->count(); });
+        QCOMPARE(overflow, -1);
+        QCOMPARE(_ds->readConnectionCount(), 2);
+
+        first.quit();
+        second.quit();
+        QVERIFY(first.wait(10000));
+        QVERIFY(second.wait(10000));
+    }
+
+    void readers_closedWhenThreadFinishes()
+    {
+        QThread worker;
+        worker.start();
+        runOn(&worker, [this]() { _ds->count(); });
+        QCOMPARE(_ds->readConnectionCount(), 1);
+        QCOMPARE(readerConnectionNames().count(), 1);
+
+        // The slot is freed for other threads, and the connection closed by the thread which opened it
+        worker.quit();
+        QVERIFY(worker.wait(10000));
+        QCOMPARE(_ds->readConnectionCount(), 0);
+        QVERIFY(readerConnectionNames().isEmpty());
+
+        int count = 0;
+        runOnThread([this, &count]() { count = _ds->count(); });
+        QCOMPARE(count, 2);
+        QCOMPARE(_ds->readConnectionCount(), 0);
+    }
+
+    void reads_concurrentWithWriteTransaction()
+    {
+        Transaction transaction(_ds);
+        QVERIFY(transaction.isActive());
+        QVERIFY(_ds->insert("three"));
+
+        // Inside the transaction the owning thread reads its own writes from the writer
+        QCOMPARE(_ds->count(), 3);
+        QCOMPARE(_ds->readConnectionCount(), 0);
+
+        // A reader sees the last committed state without waiting for the writer
+        int count = 0;
+        runOnThread([this, &count]() { count = _ds->count(); });
+        QCOMPARE(count, 2);
+
+        QVERIFY(transaction.commit());
+        runOnThread([this, &count]() { count = _ds->count(); });
+        QCOMPARE(count, 3);
+    }
+
+    void writes_goToWriter()
+    {
+        QCOMPARE(_ds->count(), 2);
+        QCOMPARE(_ds->readConnectionCount(), 1);
+
+        QVERIFY(_ds->insert("three"));
+        bool success;
+        _ds->executeQuery("WITH names (name) AS (SELECT 'four') INSERT INTO items (name) SELECT name FROM names", &success);
+        QVERIFY(success);
+        QCOMPARE(_ds->count(), 4);
+    }
+
+    void connectionFunctions_readFromWriter()
+    {
+        QVERIFY(_ds->insert("three"));
+
+        bool success;
+        QSqlQuery query = _ds->executeQuery("SELECT last_insert_rowid(), changes()", &success);
+        QVERIFY(success);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toLongLong(), qint64(3));
+        QCOMPARE(query.value(1).toInt(), 1);
+        QCOMPARE(_ds->readConnectionCount(), 0);
+    }
+
+    void queryRouting_overrides()
+    {
+        {
+            QueryRouting routing(_ds, QueryRouting::Writer);
+            QCOMPARE(_ds->count(), 2);
+            QCOMPARE(_ds->readConnectionCount(), 0);
+            {
+                // Read connections refuse writes
+                QueryRouting inner(_ds, QueryRouting::Reader);
+                QVERIFY(!_ds->insert("refused"));
+                QCOMPARE(_ds->readConnectionCount(), 1);
+            }
+            QVERIFY(_ds->insert("three"));
+        }
+        QCOMPARE(_ds->count(), 3);
+    }
+
+    void statementCache_perReader()
+    {
+        _ds->setStatementCacheSize(8);
+        QCOMPARE(_ds->count(), 2);
+        QCOMPARE(_ds->count(), 2);
+        // The owning thread's reads were cached by its reader, not the writer
+        QCOMPARE(_ds->statementCacheStatistics().hits, qint64(0));
+        QCOMPARE(_ds->readConnectionCount(), 1);
+    }
+
+    void closeConnection_closesReaders()
+    {
+        QThread worker;
+        worker.start();
+        QCOMPARE(_ds->count(), 2);
+        runOn(&worker, [this]() { _ds->count(); });
+        QCOMPARE(_ds->readConnectionCount(), 2);
+        QVERIFY(_ds->closeConnection());
+        QCOMPARE(_ds->readConnectionCount(), 0);
+
+        // The worker's reader is left to the worker, which closes it as it finishes
+        QCOMPARE(readerConnectionNames().count(), 1);
+        worker.quit();
+        QVERIFY(worker.wait(10000));
+        QVERIFY(readerConnectionNames().isEmpty());
+
+        QVERIFY(_ds->openConnection());
+        QCOMPARE(_ds->count(), 2);
+    }
+
+    void inMemory_usesWriterOnly()
+    {
+        SplitDataSource ds((DatabaseCredentials(":memory:")));
+        ds.setReadConnectionLimit(2);
+        QVERIFY(ds.openConnection());
+        QVERIFY(ds.insert("one"));
+        QCOMPARE(ds.count(), 1);
+        QCOMPARE(ds.readConnectionCount(), 0);
+        ds.closeConnection();
+    }
+
+private:
+    QTemporaryDir _tmpDir;
+    SplitDataSource* _ds = nullptr;
+};
+
+QTEST_MAIN(TstReadWriteSplit)
+#include "tst_readwritesplit.moc"
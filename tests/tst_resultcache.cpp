@@ -0,0 +1,251 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/resultcache.h>
+#include <Kanoop/database/transaction.h>
+
+class CachedDataSource : public DataSource
+{
+public:
+    CachedDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::executeCached;
+    using DataSource::executeQuery;
+    using DataSource::bulkInsertRows;
+
+    int count(const QString& table)
+    {
+        bool success;
+        QueryResult result = executeCached(QString("SELECT COUNT(*) FROM %1").arg(table), QVariantList(), &success);
+        return success ? result.value(0, 0).toInt() : -1;
+    }
+
+    bool execute(const QString& sql)
+    {
+        bool success;
+        executeQuery(sql, &success);
+        return success;
+    }
+
+protected:
+    QString createSql() const override
+    {
+        return
+            "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT);\n"
+            "CREATE TABLE other (id INTEGER PRIMARY KEY);\n"
+            "CREATE TABLE audit (item_id INTEGER);\n"
+            "CREATE VIEW item_names AS SELECT name FROM items;\n"
+            "CREATE TRIGGER items_audit AFTER INSERT ON items BEGIN INSERT INTO audit (item_id) VALUES (new.id); END;";
+    }
+};
+
+static QueryResult resultOfSize(int rows)
+{
+    QueryResult result;
+    result.setColumns({ "value" });
+    for(int i = 0;i < rows;i++) {
+        result.appendRow({ QString(100, 'x') });
+    }
+    return result;
+}
+
+class TstResultCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void tablesRead_parsesFromLists()
+    {
+        QCOMPARE(ResultCache::tablesRead("SELECT * FROM items"), QStringList({ "items" }));
+        QCOMPARE(ResultCache::tablesRead("SELECT a.x FROM Items a, \"Other\" AS o WHERE a.id = o.id"), QStringList({ "items", "other" }));
+        QCOMPARE(ResultCache::tablesRead("SELECT * FROM main.items i LEFT JOIN [audit] ON i.id = audit.item_id"), QStringList({ "items", "audit" }));
+        QCOMPARE(ResultCache::tablesRead("SELECT * FROM (SELECT id FROM items) s, other WHERE name = 'FROM fake'"), QStringList({ "other", "items" }));
+        QCOMPARE(ResultCache::tablesRead("SELECT 1"), QStringList());
+    }
+
+    void tableWritten_findsTarget()
+    {
+        QCOMPARE(ResultCache::tableWritten("INSERT INTO items (name) VALUES ('x')"), QStringLiteral("items"));
+        QCOMPARE(ResultCache::tableWritten("insert or replace into \"Items\" VALUES (1)"), QStringLiteral("items"));
+        QCOMPARE(ResultCache::tableWritten("REPLACE INTO items VALUES (1)"), QStringLiteral("items"));
+        QCOMPARE(ResultCache::tableWritten("UPDATE OR IGNORE main.items SET name = 'x'"), QStringLiteral("items"));
+        QCOMPARE(ResultCache::tableWritten("DELETE FROM items WHERE id = 1"), QStringLiteral("items"));
+        QCOMPARE(ResultCache::tableWritten("WITH n AS (SELECT 1 FROM other) INSERT INTO items SELECT * FROM n"), QStringLiteral("items"));
+        QCOMPARE(ResultCache::tableWritten("WITH n AS (SELECT 1) SELECT replace(name, 'a', 'b') FROM items"), QString());
+        QCOMPARE(ResultCache::tableWritten("SELECT * FROM items"), QString());
+    }
+
+    void key_includesBindingTypes()
+    {
+        QVERIFY(ResultCache::key("SELECT ?", { 1 }) != ResultCache::key("SELECT ?", { QString("1") }));
+        QVERIFY(ResultCache::key("SELECT ?", { 1 }) != ResultCache::key("SELECT ?", { 2 }));
+        QCOMPARE(ResultCache::key("SELECT ?", { 1 }), ResultCache::key("SELECT ?", { 1 }));
+    }
+
+    void cache_evictsLeastRecentlyUsedWithinBudget()
+    {
+        qint64 entrySize = ResultCache::estimateSize(resultOfSize(10)) + ResultCache::key("a", QVariantList()).size();
+        ResultCache cache(entrySize * 2);
+        QVERIFY(cache.insert("a", resultOfSize(10), { "t" }, cache.generation()));
+        QVERIFY(cache.insert("b", resultOfSize(10), { "t" }, cache.generation()));
+
+        QueryResult found;
+        QVERIFY(cache.find("a", found));
+        QVERIFY(cache.insert("c", resultOfSize(10), { "u" }, cache.generation()));
+        QVERIFY(cache.find("a", found));
+        QVERIFY(!cache.find("b", found));
+        QCOMPARE(found.rowCount(), 10);
+
+        ResultCache::Statistics statistics = cache.statistics();
+        QCOMPARE(statistics.size, 2);
+        QCOMPARE(statistics.evictions, qint64(1));
+        QVERIFY(statistics.bytes <= statistics.budget);
+
+        // Too big for the budget at all
+        QVERIFY(!cache.insert("d", resultOfSize(100), { "t" }, cache.generation()));
+    }
+
+    void cache_invalidatesByTableAndGeneration()
+    {
+        ResultCache cache(1024 * 1024);
+        quint64 generation = cache.generation();
+        QVERIFY(cache.insert("a", resultOfSize(1), { "t", "u" }, generation));
+        QVERIFY(cache.insert("b", resultOfSize(1), { "u" }, generation));
+
+        cache.invalidateTable("T");
+        QueryResult found;
+        QVERIFY(!cache.find("a", found));
+        QVERIFY(cache.find("b", found));
+        QCOMPARE(cache.statistics().invalidations, qint64(1));
+
+        // Read before the invalidation, so possibly stale
+        QVERIFY(!cache.insert("c", resultOfSize(1), { "v" }, generation));
+        QCOMPARE(cache.statistics().rejections, qint64(1));
+    }
+
+    void dataSource_cachesAndInvalidatesOnWrite()
+    {
+        QTemporaryDir tmpDir;
+        CachedDataSource ds((DatabaseCredentials(tmpDir.path() + "/cache.db")));
+        ds.setResultCacheBudget(1024 * 1024);
+        QVERIFY(ds.openConnection());
+
+        QCOMPARE(ds.count("items"), 0);
+        QCOMPARE(ds.count("items"), 0);
+        QCOMPARE(ds.resultCacheStatistics().hits, qint64(1));
+
+        // Bound values are part of the key
+        QCOMPARE(ds.executeCached("SELECT COUNT(*) FROM items WHERE id > ?", { 0 }).value(0, 0).toInt(), 0);
+        QCOMPARE(ds.resultCacheStatistics().hits, qint64(1));
+
+        QVERIFY(ds.execute("INSERT INTO other (id) VALUES (1)"));
+        QCOMPARE(ds.count("items"), 0);
+        QCOMPARE(ds.resultCacheStatistics().hits, qint64(2));
+
+        QVERIFY(ds.execute("INSERT INTO items (name) VALUES ('one')"));
+        QCOMPARE(ds.count("items"), 1);
+        QCOMPARE(ds.count("item_names"), 1);
+        QCOMPARE(ds.executeCached("SELECT COUNT(*) FROM items WHERE id > ?", { 0 }).value(0, 0).toInt(), 1);
+
+        // Through the view
+        QVERIFY(ds.execute("UPDATE items SET name = 'two'"));
+        QCOMPARE(ds.executeCached("SELECT name FROM item_names").value(0, 0).toString(), QStringLiteral("two"));
+        QVERIFY(ds.execute("DELETE FROM items"));
+        QCOMPARE(ds.count("item_names"), 0);
+
+        QVERIFY(ds.bulkInsertRows("items", { "name" }, { { "a" }, { "b" } }));
+        QCOMPARE(ds.count("items"), 2);
+        ds.closeConnection();
+    }
+
+    void dataSource_transactions()
+    {
+        QTemporaryDir tmpDir;
+        CachedDataSource ds((DatabaseCredentials(tmpDir.path() + "/transaction.db")));
+        ds.setResultCacheBudget(1024 * 1024);
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.count("items"), 0);
+
+        {
+            Transaction transaction(&ds);
+            QVERIFY(ds.execute("INSERT INTO items (name) VALUES ('one')"));
+            QCOMPARE(ds.count("items"), 1);
+            QCOMPARE(ds.resultCacheStatistics().size, 0);
+        }
+
+        // The rolled back insert was never cached
+        QCOMPARE(ds.count("items"), 0);
+        QCOMPARE(ds.resultCacheStatistics().size, 1);
+        ds.closeConnection();
+    }
+
+    void dataSource_schemaChangeInvalidatesAll()
+    {
+        QTemporaryDir tmpDir;
+        CachedDataSource ds((DatabaseCredentials(tmpDir.path() + "/schema.db")));
+        ds.setResultCacheBudget(1024 * 1024);
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.count("items"), 0);
+        QCOMPARE(ds.count("other"), 0);
+        QVERIFY(ds.execute("CREATE TABLE extra (id INTEGER)"));
+        QCOMPARE(ds.resultCacheStatistics().size, 0);
+
+        QCOMPARE(ds.count("other"), 0);
+        ds.invalidateResultCache("OTHER");
+        QCOMPARE(ds.resultCacheStatistics().size, 0);
+        ds.closeConnection();
+    }
+
+    void dataSource_triggerWrites()
+    {
+        QTemporaryDir tmpDir;
+        CachedDataSource ds((DatabaseCredentials(tmpDir.path() + "/trigger.db")));
+        ds.setResultCacheBudget(1024 * 1024);
+        QVERIFY(ds.openConnection());
+        // Known only once a connection has compared the driver's SQLite with the linked one
+        if(DataSource::isNativeSqliteAvailable() == false) {
+            QSKIP("Needs the SQLite update hook (KANOOP_DATABASE_NATIVE_SQLITE)");
+        }
+        QCOMPARE(ds.count("audit"), 0);
+        QVERIFY(ds.execute("INSERT INTO items (name) VALUES ('one')"));
+        QCOMPARE(ds.count("audit"), 1);
+        ds.closeConnection();
+    }
+
+    void dataSource_failedReadNotCached()
+    {
+        QTemporaryDir tmpDir;
+        CachedDataSource ds((DatabaseCredentials(tmpDir.path() + "/failed.db")));
+        ds.setResultCacheBudget(1024 * 1024);
+        QVERIFY(ds.openConnection());
+
+        // Fails with "integer overflow" on the third row, after two have been read
+        QString sql("WITH n (id) AS (VALUES (1), (2), (3)) SELECT id, abs(id - 9223372036854775807 - 4) FROM n");
+        for(int i = 0;i < 2;i++) {
+            bool success = true;
+            QueryResult result = ds.executeCached(sql, QVariantList(), &success);
+            QVERIFY(!success);
+            QCOMPARE(result.rowCount(), 0);
+        }
+        QCOMPARE(ds.resultCacheStatistics().hits, qint64(0));
+        QVERIFY(ds.errorText().contains("overflow"));
+        ds.closeConnection();
+    }
+
+    void dataSource_disabledByDefault()
+    {
+        QTemporaryDir tmpDir;
+        CachedDataSource ds((DatabaseCredentials(tmpDir.path() + "/disabled.db")));
+        QCOMPARE(ds.resultCacheBudget(), qint64(0));
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.count("items"), 0);
+        QCOMPARE(ds.count("items"), 0);
+        QCOMPARE(ds.resultCacheStatistics().hits, qint64(0));
+        QCOMPARE(ds.resultCacheStatistics().misses, qint64(0));
+        ds.closeConnection();
+    }
+};
+
+QTEST_MAIN(TstResultCache)
+#include "tst_resultcache.moc"
@@ -0,0 +1,225 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/schemamigrations.h>
+
+class MigratingDataSource : public DataSource
+{
+public:
+    MigratingDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::executeQuery;
+    using DataSource::registerMigration;
+    using DataSource::migrations;
+    using DataSource::schemaVersion;
+    using DataSource::migrationHistory;
+    using DataSource::changedMigrations;
+
+    // Register the standard three steps
+    void registerAll(const QString& step2Sql = "ALTER TABLE items ADD COLUMN name TEXT;\nCREATE INDEX idx_items_name ON items (name);")
+    {
+        registerMigration(1, "Add tags", "CREATE TABLE tags (id INTEGER PRIMARY KEY, tag TEXT);");
+        registerMigration(2, "Add item names", step2Sql);
+        registerMigration(3, "Seed tags", [this]() {
+            closureRuns++;
+            bool success;
+            executeQuery("INSERT INTO tags (tag) VALUES ('default')", &success);
+            return success;
+        }, "seed-tags-v1");
+    }
+
+    bool tableExists(const QString& name)
+    {
+        return _db.tables().contains(name);
+    }
+
+    int baseVersion = 0;
+    int closureRuns = 0;
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY);"; }
+    int createSchemaVersion() const override { return baseVersion; }
+};
+
+class TstSchemaMigrations : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void registry_ordersAndRejectsDuplicates()
+    {
+        SchemaMigrations migrations;
+        QVERIFY(migrations.isEmpty());
+        QCOMPARE(migrations.latestVersion(), 0);
+
+        QVERIFY(migrations.add(3, "three", "SELECT 3;"));
+        QVERIFY(migrations.add(1, "one", "SELECT 1;"));
+        QVERIFY(migrations.add(2, "two", []() { return true; }));
+        QVERIFY(!migrations.add(2, "again", "SELECT 2;"));
+        QVERIFY(!migrations.add(0, "zero", "SELECT 0;"));
+        QVERIFY(!migrations.add(-1, "negative", "SELECT 0;"));
+        QVERIFY(!migrations.add(4, "empty", SchemaMigrations::Step()));
+
+        QCOMPARE(migrations.count(), qsizetype(3));
+        QCOMPARE(migrations.latestVersion(), 3);
+
+        QList<SchemaMigrations::Migration> pending = migrations.pending(1);
+        QCOMPARE(pending.count(), 2);
+        QCOMPARE(pending.at(0).version, 2);
+        QCOMPARE(pending.at(1).version, 3);
+        QVERIFY(migrations.pending(3).isEmpty());
+
+        QCOMPARE(migrations.find(1)->checksum, SchemaMigrations::checksum("SELECT 1;"));
+        QCOMPARE(migrations.find(2)->checksum, SchemaMigrations::checksum("two"));
+        QCOMPARE(SchemaMigrations::checksum("SELECT 1;").length(), 64);
+        QVERIFY(migrations.find(5) == nullptr);
+    }
+
+    void applyMigrations_appliesPendingStepsOnce()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        QString path = tmpDir.path() + "/migrate.db";
+
+        {
+            MigratingDataSource ds((DatabaseCredentials(path)));
+            ds.registerAll();
+            QVERIFY(ds.openConnection());
+            QCOMPARE(ds.schemaVersion(), 3);
+            QCOMPARE(ds.closureRuns, 1);
+
+            bool success = false;
+            QList<SchemaMigrations::AppliedMigration> history = ds.migrationHistory(&success);
+            QVERIFY(success);
+            QCOMPARE(history.count(), 3);
+            QCOMPARE(history.at(1).version, 2);
+            QCOMPARE(history.at(1).description, QStringLiteral("Add item names"));
+            QCOMPARE(history.at(1).checksum, ds.migrations().find(2)->checksum);
+            QVERIFY(history.at(1).appliedAt.isValid());
+            QVERIFY(history.at(1).elapsedMs >= 0);
+            QVERIFY(ds.changedMigrations().isEmpty());
+            ds.closeConnection();
+        }
+
+        // Reopening runs nothing: the steps would fail if they ran again
+        MigratingDataSource ds((DatabaseCredentials(path)));
+        ds.registerAll();
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.closureRuns, 0);
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM tags");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 1);
+
+        // A newly registered step is applied on its own
+        ds.closeConnection();
+        ds.registerMigration(4, "Add labels", "CREATE TABLE labels (id INTEGER);");
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.schemaVersion(), 4);
+        QVERIFY(ds.tableExists("labels"));
+        QCOMPARE(ds.migrationHistory().count(), 4);
+        ds.closeConnection();
+    }
+
+    void applyMigrations_failedStepRollsBack()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        QString path = tmpDir.path() + "/failed.db";
+
+        MigratingDataSource ds((DatabaseCredentials(path)));
+        ds.registerAll("CREATE TABLE partial (id INTEGER);\nINSERT INTO no_such_table VALUES (1);");
+        QVERIFY(!ds.openConnection());
+
+        MigratingDataSource check((DatabaseCredentials(path)));
+        QVERIFY(check.openConnection());
+        QCOMPARE(check.schemaVersion(), 1);
+        QVERIFY(check.tableExists("tags"));
+        QVERIFY(!check.tableExists("partial"));
+        QCOMPARE(check.migrationHistory().count(), 1);
+        check.closeConnection();
+    }
+
+    void applyMigrations_rebuildKeepsCascadingChildren()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        QString path = tmpDir.path() + "/rebuild.db";
+
+        MigratingDataSource ds((DatabaseCredentials(path)));
+        ds.registerMigration(1, "Add parents", "CREATE TABLE parent (id INTEGER PRIMARY KEY, name TEXT);\n"
+                                               "CREATE TABLE child (id INTEGER PRIMARY KEY, parent_id INTEGER REFERENCES parent (id) ON DELETE CASCADE);\n"
+                                               "INSERT INTO parent VALUES (1, 'one');\n"
+                                               "INSERT INTO child VALUES (1, 1);\n"
+                                               "INSERT INTO child VALUES (2, 1);");
+        // The usual table rebuild, which only works with foreign keys off for the whole step
+        ds.registerMigration(2, "Rebuild parents", "PRAGMA foreign_keys=OFF;\n"
+                                                   "CREATE TABLE parent_new (id INTEGER PRIMARY KEY, name TEXT, code TEXT);\n"
+                                                   "INSERT INTO parent_new (id, name) SELECT id, name FROM parent;\n"
+                                                   "DROP TABLE parent;\n"
+                                                   "ALTER TABLE parent_new RENAME TO parent;");
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.schemaVersion(), 2);
+
+        QSqlQuery query = ds.executeQuery("SELECT COUNT(*) FROM child");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 2);
+
+        // The step left foreign keys off; the connection's setting is restored
+        query = ds.executeQuery("PRAGMA foreign_keys");
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 1);
+        ds.closeConnection();
+    }
+
+    void createSchemaVersion_skipsIncludedSteps()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+
+        MigratingDataSource ds(DatabaseCredentials(tmpDir.path() + "/baseline.db"));
+        ds.baseVersion = 2;
+        ds.registerMigration(1, "Never run", "INSERT INTO no_such_table VALUES (1);");
+        ds.registerMigration(2, "Never run either", "INSERT INTO no_such_table VALUES (2);");
+        ds.registerMigration(3, "Add labels", "CREATE TABLE labels (id INTEGER);");
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.schemaVersion(), 3);
+        QVERIFY(ds.tableExists("labels"));
+        QCOMPARE(ds.migrationHistory().count(), 1);
+        ds.closeConnection();
+    }
+
+    void changedMigrations_detectsEditedSteps()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        QString path = tmpDir.path() + "/changed.db";
+
+        {
+            MigratingDataSource ds((DatabaseCredentials(path)));
+            ds.registerAll();
+            QVERIFY(ds.openConnection());
+            ds.closeConnection();
+        }
+
+        MigratingDataSource ds((DatabaseCredentials(path)));
+        ds.registerAll("ALTER TABLE items ADD COLUMN name TEXT NOT NULL DEFAULT '';");
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.changedMigrations(), QList<int>({ 2 }));
+        ds.closeConnection();
+    }
+
+    void noMigrations_leavesVersionAlone()
+    {
+        QTemporaryDir tmpDir;
+        QVERIFY(tmpDir.isValid());
+        MigratingDataSource ds(DatabaseCredentials(tmpDir.path() + "/none.db"));
+        QVERIFY(ds.openConnection());
+        QCOMPARE(ds.schemaVersion(), 0);
+        QVERIFY(!ds.tableExists(SchemaMigrations::HistoryTable));
+        ds.closeConnection();
+    }
+};
+
+QTEST_MAIN(TstSchemaMigrations)
+#include "tst_schemamigrations.moc"
@@ -0,0 +1,92 @@
+#include <QTest>
+#include <Kanoop/database/sqlbuilder.h>
+#include <QTimeZone>
+#include <limits>
+
+class TstSqlBuilder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void escaped_doublesQuotesAndReplacesNul()
+    {
+        QCOMPARE(SqlBuilder::escaped("it's a 'test'"), QStringLiteral("it''s a ''test''"));
+        QCOMPARE(SqlBuilder::escaped("'"), QStringLiteral("''"));
+        QString withNul = QString("a") + QChar(QChar::Null) + QString("b'");
+        QCOMPARE(SqlBuilder::escaped(withNul), QStringLiteral("a?b''"));
+        QString mixed = QString("x''y") + QChar(QChar::Null) + QString("z'") + QChar(QChar::Null);
+        QCOMPARE(SqlBuilder::escaped(mixed), QStringLiteral("x''''y?z''?"));
+    }
+
+    void escaped_noSpecialChars_returnsInput()
+    {
+        QString input = QString("plain text, nothing to escape").repeated(10);
+        QString result = SqlBuilder::escaped(input);
+        QCOMPARE(result, input);
+        QCOMPARE(result.constData(), input.constData());
+        QCOMPARE(SqlBuilder::findEscape(input), qsizetype(-1));
+        QCOMPARE(SqlBuilder::findEscape(u"ab'c"), qsizetype(2));
+    }
+
+    void appendNumber_integers()
+    {
+        SqlBuilder builder;
+        builder.appendNumber(0).append(u",")
+               .appendNumber(-42).append(u",")
+               .appendNumber(std::numeric_limits<qint64>::min()).append(u",")
+               .appendNumber(std::numeric_limits<quint64>::max()).append(u",")
+               .appendNumber(uint8_t(200));
+        QCOMPARE(builder.toString(), QStringLiteral("0,-42,-9223372036854775808,18446744073709551615,200"));
+    }
+
+    void appendNumber_doubles()
+    {
+        SqlBuilder builder;
+        builder.appendNumber(0.1).append(u',').appendNumber(-2.5).append(u',').appendNumber(1e20);
+        QCOMPARE(builder.toString(), QStringLiteral("0.1,-2.5,1e+20"));
+    }
+
+    void appendUuid_matchesQUuid()
+    {
+        for(int i = 0;i < 10;i++) {
+            QUuid uuid = QUuid::createUuid();
+            SqlBuilder builder;
+            builder.appendUuid(uuid);
+            QCOMPARE(builder.toString(), QString("'%1'").arg(uuid.toString(QUuid::WithoutBraces)));
+        }
+    }
+
+    void appendTimestamp_utc()
+    {
+        QDateTime local(QDate(2025, 1, 11), QTime(14, 3, 7, 25), QTimeZone::fromSecondsAheadOfUtc(3600));
+        SqlBuilder builder;
+        builder.appendTimestamp(local);
+        QCOMPARE(builder.toString(), QStringLiteral("'2025-01-11 13:03:07.025'"));
+    }
+
+    void appendLists()
+    {
+        SqlBuilder builder;
+        builder.append(u"IN (").appendNumberList(QList<int>({ 1, 2, 3 })).append(u") AND name IN (")
+               .appendStringList({ "a'b", "c" }).append(u')');
+        QCOMPARE(builder.toString(), QStringLiteral("IN (1,2,3) AND name IN ('a''b','c')"));
+
+        QUuid uuid = QUuid::createUuid();
+        builder.clear();
+        builder.appendUuidList({ uuid, uuid });
+        QString quoted = QString("'%1'").arg(uuid.toString(QUuid::WithoutBraces));
+        QCOMPARE(builder.toString(), quoted + "," + quoted);
+    }
+
+    void take_leavesBuilderEmpty()
+    {
+        SqlBuilder builder(64);
+        builder.appendString(u"x").append(u' ').appendNull();
+        QCOMPARE(builder.length(), qsizetype(8));
+        QCOMPARE(builder.take(), QStringLiteral("'x' NULL"));
+        QCOMPARE(builder.length(), qsizetype(0));
+    }
+};
+
+QTEST_MAIN(TstSqlBuilder)
+#include "tst_sqlbuilder.moc"
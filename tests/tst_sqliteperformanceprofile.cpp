@@ -0,0 +1,83 @@
+#include <QTest>
+#include <Kanoop/database/sqliteperformanceprofile.h>
+
+class TstSqlitePerformanceProfile : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void defaultConstructor_isEmpty()
+    {
+        SqlitePerformanceProfile profile;
+        QVERIFY(profile.isEmpty());
+        QCOMPARE(profile.journalMode(), SqlitePerformanceProfile::JournalModeUnset);
+        QCOMPARE(profile.synchronous(), SqlitePerformanceProfile::SynchronousUnset);
+        QCOMPARE(profile.tempStore(), SqlitePerformanceProfile::TempStoreUnset);
+        QCOMPARE(profile.cacheSizeKiB(), qint64(-1));
+        QCOMPARE(profile.mmapSize(), qint64(-1));
+        QCOMPARE(profile.pageSize(), -1);
+        QCOMPARE(profile.busyTimeout(), -1);
+        QCOMPARE(profile.walAutoCheckpoint(), -1);
+        QVERIFY(profile.pragmas(true).isEmpty());
+    }
+
+    void presets_useWal()
+    {
+        QCOMPARE(SqlitePerformanceProfile::durable().journalMode(), SqlitePerformanceProfile::JournalWal);
+        QCOMPARE(SqlitePerformanceProfile::balanced().journalMode(), SqlitePerformanceProfile::JournalWal);
+        QCOMPARE(SqlitePerformanceProfile::bulkLoad().journalMode(), SqlitePerformanceProfile::JournalWal);
+    }
+
+    void presets_orderedByDurability()
+    {
+        QCOMPARE(SqlitePerformanceProfile::durable().synchronous(), SqlitePerformanceProfile::SynchronousFull);
+        QCOMPARE(SqlitePerformanceProfile::balanced().synchronous(), SqlitePerformanceProfile::SynchronousNormal);
+        QCOMPARE(SqlitePerformanceProfile::bulkLoad().synchronous(), SqlitePerformanceProfile::SynchronousOff);
+        QVERIFY(SqlitePerformanceProfile::durable() != SqlitePerformanceProfile::balanced());
+    }
+
+    void pragmas_pageSizeOnlyForNewDatabase()
+    {
+        SqlitePerformanceProfile profile;
+        profile.setPageSize(8192);
+        profile.setJournalMode(SqlitePerformanceProfile::JournalWal);
+
+        QStringList created = profile.pragmas(true);
+        QCOMPARE(created.count(), 2);
+        QCOMPARE(created.at(0), QStringLiteral("PRAGMA page_size = 8192;"));
+        QCOMPARE(created.at(1), QStringLiteral("PRAGMA journal_mode = WAL;"));
+
+        QStringList opened = profile.pragmas(false);
+        QCOMPARE(opened.count(), 1);
+        QCOMPARE(opened.at(0), QStringLiteral("PRAGMA journal_mode = WAL;"));
+    }
+
+    void pragmas_cacheSizeInKiB()
+    {
+        SqlitePerformanceProfile profile;
+        profile.setCacheSizeKiB(2048);
+        QCOMPARE(profile.pragmas(false), QStringList() << "PRAGMA cache_size = -2048;");
+    }
+
+    void pragmas_allSettings()
+    {
+        QStringList pragmas = SqlitePerformanceProfile::balanced().pragmas(false);
+        QCOMPARE(pragmas.count(), 7);
+        QVERIFY(pragmas.contains("PRAGMA synchronous = 1;"));
+        QVERIFY(pragmas.contains("PRAGMA temp_store = 2;"));
+        QVERIFY(pragmas.contains("PRAGMA busy_timeout = 5000;"));
+        QVERIFY(pragmas.contains("PRAGMA wal_autocheckpoint = 1000;"));
+    }
+
+    void journalMode_roundTrips()
+    {
+        QCOMPARE(SqlitePerformanceProfile::journalModeFromString("wal"), SqlitePerformanceProfile::JournalWal);
+        QCOMPARE(SqlitePerformanceProfile::journalModeFromString("DELETE"), SqlitePerformanceProfile::JournalDelete);
+        QCOMPARE(SqlitePerformanceProfile::journalModeFromString("bogus"), SqlitePerformanceProfile::JournalModeUnset);
+        QCOMPARE(SqlitePerformanceProfile::journalModeToString(SqlitePerformanceProfile::JournalOff), QStringLiteral("OFF"));
+        QVERIFY(SqlitePerformanceProfile::journalModeToString(SqlitePerformanceProfile::JournalModeUnset).isEmpty());
+    }
+};
+
+QTEST_MAIN(TstSqlitePerformanceProfile)
+#include "tst_sqliteperformanceprofile.moc"
@@ -0,0 +1,266 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <QThread>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/sqlitestatement.h>
+#include <Kanoop/database/transaction.h>
+
+class NativeDataSource : public DataSource
+{
+public:
+    NativeDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::prepareSqlite;
+    using DataSource::executeCached;
+    using DataSource::bulkInsertRows;
+
+    bool fill(int count)
+    {
+        QList<QVariantList> rows;
+        for(int i = 1;i <= count;i++) {
+            rows.append({ i, QString("name %1").arg(i), i * 0.5, QByteArray(i % 3, 'b') });
+        }
+        return bulkInsertRows("items", { "id", "name", "price", "data" }, rows);
+    }
+
+    int cachedCount()
+    {
+        bool success;
+        QueryResult result = executeCached("SELECT COUNT(*) FROM items", QVariantList(), &success);
+        return success ? result.value(0, 0).toInt() : -1;
+    }
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT UNIQUE, price REAL, data BLOB);"; }
+};
+
+// CI's native SQLite job sets KANOOP_DATABASE_REQUIRE_NATIVE_SQLITE, so that a build which
+// quietly lost the native link fails rather than skipping
+#define REQUIRE_NATIVE_SQLITE() \
+    if(SqliteStatement::isAvailable() == false) { \
+        if(qEnvironmentVariableIsSet("KANOOP_DATABASE_REQUIRE_NATIVE_SQLITE")) { \
+            QFAIL("Native SQLite statements are not available"); \
+        } \
+        QSKIP("Native SQLite statements need KANOOP_DATABASE_NATIVE_SQLITE"); \
+    }
+
+class TstSqliteStatement : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        QVERIFY(_tmpDir.isValid());
+        _ds = new NativeDataSource(DatabaseCredentials(QString("%1/%2.db").arg(_tmpDir.path()).arg(QTest::currentTestFunction())));
+        QVERIFY(_ds->openConnection());
+        QVERIFY(_ds->fill(100));
+    }
+
+    void cleanup()
+    {
+        _ds->closeConnection();
+        delete _ds;
+        _ds = nullptr;
+    }
+
+    void prepareSqlite_availability()
+    {
+        bool success;
+        SqliteStatement statement = _ds->prepareSqlite("SELECT name FROM items WHERE id = ?", &success);
+        QCOMPARE(success, SqliteStatement::isAvailable());
+        QCOMPARE(statement.isValid(), SqliteStatement::isAvailable());
+        QVERIFY(!SqliteStatement().isValid());
+        QVERIFY(!SqliteStatement().step());
+    }
+
+    void step_pointLookups()
+    {
+        REQUIRE_NATIVE_SQLITE();
+        SqliteStatement statement = _ds->prepareSqlite("SELECT id, name, price, data FROM items WHERE id = ?");
+        QVERIFY(statement.isValid());
+        QCOMPARE(statement.parameterCount(), 1);
+        QCOMPARE(statement.columnCount(), 4);
+        QCOMPARE(statement.columnName(1), QStringLiteral("name"));
+
+        for(int id = 1;id <= 100;id++) {
+            QVERIFY(statement.bindInteger(1, id));
+            QVERIFY(statement.step());
+            QCOMPARE(statement.integer(0), qint64(id));
+            QCOMPARE(statement.text(1), QString("name %1").arg(id));
+            QCOMPARE(statement.real(2), id * 0.5);
+            QCOMPARE(statement.bytes(3).size(), qsizetype(id % 3));
+            QCOMPARE(statement.value(0), QVariant(qint64(id)));
+            QVERIFY(!statement.step());
+            QVERIFY(!statement.hasError());
+        }
+
+        QVERIFY(statement.bindInteger(1, 1000));
+        QVERIFY(!statement.step());
+        QVERIFY(!statement.hasError());
+    }
+
+    void prepareSqlite_reusesStatement()
+    {
+        REQUIRE_NATIVE_SQLITE();
+        SqliteStatement first = _ds->prepareSqlite("SELECT name FROM items WHERE id >= ? ORDER BY id");
+        QVERIFY(first.bindInteger(1, 99));
+        QVERIFY(first.step());
+        QCOMPARE(first.text(0), QStringLiteral("name 99"));
+        first = SqliteStatement();
+
+        // The same statement, reset to its first row with its bindings kept
+        SqliteStatement second = _ds->prepareSqlite("SELECT name FROM items WHERE id >= ? ORDER BY id");
+        QVERIFY(second.step());
+        QCOMPARE(second.text(0), QStringLiteral("name 99"));
+        QVERIFY(second.step());
+        QCOMPARE(second.text(0), QStringLiteral("name 100"));
+        QVERIFY(!second.step());
+
+        QVERIFY(second.clearBindings());
+        QVERIFY(!second.step());
+
+        _ds->closeConnection();
+        QVERIFY(!second.isValid());
+        QVERIFY(!second.step());
+        QVERIFY(_ds->openConnection());
+        QVERIFY(!second.isValid());
+        QVERIFY(_ds->prepareSqlite("SELECT name FROM items WHERE id >= ? ORDER BY id").isValid());
+    }
+
+    void prepareSqlite_liveStatementsNotShared()
+    {
+        REQUIRE_NATIVE_SQLITE();
+        QString sql("SELECT name FROM items WHERE id >= ? ORDER BY id");
+        SqliteStatement outer = _ds->prepareSqlite(sql);
+        QVERIFY(outer.bindInteger(1, 99));
+        QVERIFY(outer.step());
+
+        // A nested use of the same SQL gets a statement of its own and leaves the outer rows alone
+        SqliteStatement inner = _ds->prepareSqlite(sql);
+        QVERIFY(inner.isValid());
+        QVERIFY(inner.bindInteger(1, 50));
+        QVERIFY(inner.step());
+        QCOMPARE(inner.text(0), QStringLiteral("name 50"));
+        QCOMPARE(outer.text(0), QStringLiteral("name 99"));
+        QVERIFY(outer.step());
+        QCOMPARE(outer.text(0), QStringLiteral("name 100"));
+        QVERIFY(!outer.step());
+
+        // Bindings are not shared either, even before either statement has stepped
+        QString insertSql("INSERT INTO items (name) VALUES (?)");
+        SqliteStatement insertA = _ds->prepareSqlite(insertSql);
+        QVERIFY(insertA.bindText(1, "a"));
+        SqliteStatement insertB = _ds->prepareSqlite(insertSql);
+        QVERIFY(insertB.bindText(1, "b"));
+        QVERIFY(insertA.exec());
+        QVERIFY(inner.reset());
+        QVERIFY(inner.bindInteger(1, insertA.lastInsertId()));
+        QVERIFY(inner.step());
+        QCOMPARE(inner.text(0), QStringLiteral("a"));
+        QVERIFY(insertB.exec());
+        QVERIFY(inner.reset());
+        QVERIFY(inner.bindInteger(1, insertB.lastInsertId()));
+        QVERIFY(inner.step());
+        QCOMPARE(inner.text(0), QStringLiteral("b"));
+
+        // Once nothing else holds it, the cached statement is handed out again with its bindings
+        outer = SqliteStatement();
+        inner = SqliteStatement();
+        SqliteStatement reused = _ds->prepareSqlite(sql);
+        QVERIFY(reused.step());
+        QCOMPARE(reused.text(0), QStringLiteral("name 99"));
+    }
+
+    void exec_writesInTransactions()
+    {
+        REQUIRE_NATIVE_SQLITE();
+        SqliteStatement insert = _ds->prepareSqlite("INSERT INTO items (name, price, data) VALUES (:name, :price, :data)");
+        QCOMPARE(insert.parameterIndex(":price"), 2);
+        QCOMPARE(insert.parameterIndex(":missing"), 0);
+        QVERIFY(insert.bindText(insert.parameterIndex(":name"), "native"));
+        QVERIFY(insert.bindReal(2, 2.5));
+        QVERIFY(insert.bind(3, QVariant()));
+        QVERIFY(insert.exec());
+        QCOMPARE(insert.rowsAffected(), 1);
+        QCOMPARE(insert.lastInsertId(), qint64(101));
+
+        SqliteStatement select = _ds->prepareSqlite("SELECT name, price, data FROM items WHERE id = ?");
+        QVERIFY(select.bindAll({ 101 }));
+        QVERIFY(select.step());
+        QCOMPARE(select.text(0), QStringLiteral("native"));
+        QCOMPARE(select.value(1), QVariant(2.5));
+        QVERIFY(select.isNull(2));
+        QVERIFY(select.text(2).isNull());
+        select.reset();
+
+        {
+            Transaction transaction(_ds);
+            QVERIFY(insert.bindText(1, "rolled back"));
+            QVERIFY(insert.exec());
+        }
+        QVERIFY(select.bindInteger(1, 102));
+        QVERIFY(!select.step());
+        QVERIFY(!select.hasError());
+    }
+
+    void exec_reportsErrors()
+    {
+        REQUIRE_NATIVE_SQLITE();
+        SqliteStatement insert = _ds->prepareSqlite("INSERT INTO items (name) VALUES (?)");
+        QVERIFY(insert.bindText(1, "name 1"));
+        QVERIFY(!insert.exec());
+        QVERIFY(insert.hasError());
+        QVERIFY(insert.errorText().contains("UNIQUE"));
+        QVERIFY(_ds->errorText().contains("UNIQUE"));
+
+        // The failed statement is reset and can run again
+        QVERIFY(insert.bindText(1, "unique"));
+        QVERIFY(insert.exec());
+        QVERIFY(!insert.hasError());
+
+        bool success;
+        QVERIFY(!_ds->prepareSqlite("SELECT nothing FROM nowhere", &success).isValid());
+        QVERIFY(!success);
+        QVERIFY(!_ds->prepareSqlite("DELETE FROM items; DELETE FROM items", &success).isValid());
+        QVERIFY(!success);
+    }
+
+    void step_invalidatesResultCache()
+    {
+        REQUIRE_NATIVE_SQLITE();
+        _ds->setResultCacheBudget(1024 * 1024);
+        QCOMPARE(_ds->cachedCount(), 100);
+
+        SqliteStatement remove = _ds->prepareSqlite("DELETE FROM items WHERE id <= ?");
+        QVERIFY(remove.bindInteger(1, 10));
+        QVERIFY(remove.exec());
+        QCOMPARE(remove.rowsAffected(), 10);
+        QCOMPARE(_ds->cachedCount(), 90);
+    }
+
+    void step_failsFromWrongThread()
+    {
+        REQUIRE_NATIVE_SQLITE();
+        SqliteStatement statement = _ds->prepareSqlite("SELECT COUNT(*) FROM items");
+        bool stepped = true;
+        QThread* thread = QThread::create([&statement, &stepped]() { stepped = statement.step(); });
+        thread->start();
+        QVERIFY(thread->wait(10000));
+        delete thread;
+        QVERIFY(!stepped);
+        QVERIFY(statement.hasError());
+
+        QVERIFY(statement.reset());
+        QVERIFY(statement.step());
+        QCOMPARE(statement.integer(0), qint64(100));
+    }
+
+private:
+    QTemporaryDir _tmpDir;
+    NativeDataSource* _ds = nullptr;
+};
+
+QTEST_MAIN(TstSqliteStatement)
+#include "tst_sqlitestatement.moc"
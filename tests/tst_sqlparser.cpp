@@ -142,6 +142,97 @@ private slots:
         QVERIFY(parser.isValid());
         QCOMPARE(parser.statements().count(), 2);
     }
+
+    void semicolonInString_notSplit()
+    {
+        QString sql =
+            "INSERT INTO foo VALUES ('a;b', 'it''s; here');\n"
+            "SELECT \"odd;name\" FROM foo;";
+
+        SqlParser parser(sql);
+        QVERIFY(parser.isValid());
+        QCOMPARE(parser.statements().count(), 2);
+        QVERIFY(parser.statements().at(0).contains("'it''s; here'"));
+        QVERIFY(parser.statements().at(1).contains("\"odd;name\""));
+    }
+
+    void blockComment_stripped()
+    {
+        QString sql =
+            "/* header; comment */\n"
+            "SELECT 1 /* inline; comment */ FROM foo;\n"
+            "SELECT 2;";
+
+        SqlParser parser(sql);
+        QVERIFY(parser.isValid());
+        QCOMPARE(parser.statements().count(), 2);
+        QVERIFY(!parser.statements().at(0).contains("comment"));
+        QVERIFY(parser.statements().at(0).contains("FROM foo"));
+    }
+
+    void triggerBody_notSplit()
+    {
+        QString sql =
+            "CREATE TRIGGER foo_insert AFTER INSERT ON foo\n"
+            "BEGIN\n"
+            "    UPDATE bar SET n = CASE WHEN new.id > 0 THEN n + 1 ELSE n END;\n"
+            "    INSERT INTO log VALUES (new.id);\n"
+            "END;\n"
+            "CREATE TABLE baz (id INTEGER);";
+
+        SqlParser parser(sql);
+        QVERIFY(parser.isValid());
+        QCOMPARE(parser.statements().count(), 2);
+        QVERIFY(parser.statements().at(0).endsWith("END;"));
+        QVERIFY(parser.statements().at(1).startsWith("CREATE TABLE baz"));
+    }
+
+    void dollarQuoting_notSplit()
+    {
+        QString sql =
+            "CREATE FUNCTION f() RETURNS int AS $$ SELECT 1; $$ LANGUAGE sql;\n"
+            "CREATE FUNCTION g() RETURNS int AS $body$ SELECT $$;$$; $body$ LANGUAGE sql;\n"
+            "SELECT $1;";
+
+        SqlParser parser(sql);
+        QVERIFY(parser.isValid());
+        QCOMPARE(parser.statements().count(), 3);
+        QVERIFY(parser.statements().at(1).endsWith("LANGUAGE sql;"));
+        QCOMPARE(parser.statements().at(2), QStringLiteral("SELECT $1;"));
+    }
+
+    void emptyStatements_skipped()
+    {
+        SqlParser parser("SELECT 1;;\n;SELECT 2;");
+        QVERIFY(parser.isValid());
+        QCOMPARE(parser.statements().count(), 2);
+    }
+
+    void statementViews_referenceSource()
+    {
+        QString sql = "  -- comment\nSELECT 1;\n\nSELECT 2";
+        SqlParser parser(sql);
+        QCOMPARE(parser.count(), 2);
+
+        QList<QStringView> views = parser.statementViews();
+        QCOMPARE(views.at(0), QStringView(u"SELECT 1;"));
+        QCOMPARE(views.at(1), QStringView(u"SELECT 2"));
+        QCOMPARE(views.at(0).constData(), parser.sql().constData() + sql.indexOf("SELECT 1"));
+        QCOMPARE(parser.statementRanges().at(1).start, sql.indexOf("SELECT 2"));
+    }
+
+    void unterminatedString_isInvalid()
+    {
+        SqlParser parser("SELECT 'unterminated;");
+        QVERIFY(!parser.isValid());
+        QCOMPARE(parser.statements().count(), 1);
+    }
+
+    void unterminatedTrigger_isInvalid()
+    {
+        SqlParser parser("CREATE TRIGGER t AFTER INSERT ON foo BEGIN DELETE FROM bar;");
+        QVERIFY(!parser.isValid());
+    }
 };
 
 QTEST_MAIN(TstSqlParser)
@@ -0,0 +1,119 @@
+#include <QTest>
+#include <Kanoop/database/sqlscanner.h>
+
+class TstSqlScanner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void chunkedInput_matchesOneShot_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+        QTest::newRow("1") << 1;
+        QTest::newRow("2") << 2;
+        QTest::newRow("3") << 3;
+        QTest::newRow("7") << 7;
+        QTest::newRow("64") << 64;
+    }
+
+    void chunkedInput_matchesOneShot()
+    {
+        QFETCH(int, chunkSize);
+
+        QStringList expected = scanAll(script());
+        QCOMPARE(expected.count(), 7);
+
+        // Feed the script a chunk at a time, discarding consumed text as it goes
+        SqlScanner scanner;
+        SqlScanner::Statement statement;
+        QString source = script();
+        QString buffer;
+        QStringList actual;
+        qsizetype offset = 0;
+        qsizetype maxBuffer = 0;
+        bool atEnd = false;
+        while(atEnd == false) {
+            buffer.append(QStringView(source).mid(offset, chunkSize));
+            offset += chunkSize;
+            atEnd = offset >= source.length();
+            maxBuffer = qMax(maxBuffer, buffer.length());
+
+            while(scanner.next(buffer, atEnd, &statement)) {
+                actual.append(statement.text(buffer));
+            }
+            qsizetype consumed = scanner.consumed();
+            buffer.remove(0, consumed);
+            scanner.discard(consumed);
+        }
+
+        QCOMPARE(actual, expected);
+        QVERIFY(scanner.isComplete());
+        // Only the statement in progress is retained
+        QVERIFY(maxBuffer < source.length() / 2);
+    }
+
+    void incompleteInput_waitsForMore()
+    {
+        SqlScanner scanner;
+        SqlScanner::Statement statement;
+        QString buffer = "SELECT 'a;";
+        QVERIFY(!scanner.next(buffer, false, &statement));
+        QVERIFY(!scanner.isComplete());
+
+        buffer += "b'; SELECT 2";
+        QVERIFY(scanner.next(buffer, false, &statement));
+        QCOMPARE(statement.view(buffer), QStringView(u"SELECT 'a;b';"));
+        QVERIFY(!scanner.next(buffer, false, &statement));
+        QVERIFY(scanner.next(buffer, true, &statement));
+        QCOMPARE(statement.view(buffer), QStringView(u"SELECT 2"));
+        QVERIFY(!scanner.next(buffer, true, &statement));
+        QVERIFY(scanner.isComplete());
+    }
+
+    void reset_startsOver()
+    {
+        SqlScanner scanner;
+        SqlScanner::Statement statement;
+        QString buffer = "SELECT '";
+        QVERIFY(scanner.next(buffer, true, &statement));
+        QVERIFY(!scanner.isComplete());
+
+        scanner.reset();
+        buffer = "SELECT 1";
+        QVERIFY(scanner.next(buffer, true, &statement));
+        QCOMPARE(statement.start, qsizetype(0));
+        QVERIFY(scanner.isComplete());
+    }
+
+private:
+    static QString script()
+    {
+        return
+            "-- header\n"
+            "# hash comment\n"
+            "CREATE TABLE foo (id INTEGER, name TEXT DEFAULT 'a;b');\n"
+            "/* block; comment */\n"
+            "INSERT INTO foo VALUES (1, 'it''s; quoted');\n"
+            "CREATE TRIGGER foo_insert AFTER INSERT ON foo BEGIN\n"
+            "    UPDATE foo SET name = CASE WHEN new.id > 0 THEN 'x' END;\n"
+            "END;\n"
+            "SELECT \"odd;name\", `tick;` FROM foo; -- trailing\n"
+            "CREATE FUNCTION f() AS $body$ SELECT 1; $body$;\n"
+            "SELECT 1 - 2 / 3;\n"
+            "SELECT $$ a;b $$";
+    }
+
+    static QStringList scanAll(const QString& sql)
+    {
+        SqlScanner scanner;
+        SqlScanner::Statement statement;
+        QStringList result;
+        while(scanner.next(sql, true, &statement)) {
+            result.append(statement.text(sql));
+        }
+        return result;
+    }
+};
+
+QTEST_MAIN(TstSqlScanner)
+#include "tst_sqlscanner.moc"
@@ -0,0 +1,161 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/transaction.h>
+
+class TransactionDataSource : public DataSource
+{
+public:
+    TransactionDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::executeQuery;
+    using DataSource::executeMultiple;
+    using DataSource::inTransaction;
+
+    int count()
+    {
+        QSqlQuery query = executeQuery("SELECT COUNT(*) FROM items");
+        return query.next() ? query.value(0).toInt() : -1;
+    }
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY);"; }
+};
+
+class TstTransaction : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        QVERIFY(_tmpDir.isValid());
+        _ds = new TransactionDataSource(DatabaseCredentials(_tmpDir.path() + QString("/txn%1.db").arg(_serial++)));
+        QVERIFY(_ds->openConnection());
+    }
+
+    void cleanup()
+    {
+        _ds->closeConnection();
+        delete _ds;
+        _ds = nullptr;
+    }
+
+    void commit_persistsChanges()
+    {
+        {
+            Transaction transaction(_ds);
+            QVERIFY(transaction.isActive());
+            QVERIFY(!transaction.isNested());
+            QVERIFY(_ds->inTransaction());
+            _ds->executeQuery("INSERT INTO items (id) VALUES (1)");
+            QVERIFY(transaction.commit());
+            QVERIFY(!transaction.isActive());
+        }
+        QVERIFY(!_ds->inTransaction());
+        QCOMPARE(_ds->count(), 1);
+    }
+
+    void destructor_rollsBack()
+    {
+        {
+            Transaction transaction(_ds);
+            _ds->executeQuery("INSERT INTO items (id) VALUES (1)");
+        }
+        QVERIFY(!_ds->inTransaction());
+        QCOMPARE(_ds->count(), 0);
+    }
+
+    void rollback_discardsChanges()
+    {
+        Transaction transaction(_ds);
+        _ds->executeQuery("INSERT INTO items (id) VALUES (1)");
+        QVERIFY(transaction.rollback());
+        QVERIFY(!transaction.commit());
+        QCOMPARE(_ds->count(), 0);
+    }
+
+    void nested_rollbackKeepsOuterWork()
+    {
+        {
+            Transaction outer(_ds);
+            _ds->executeQuery("INSERT INTO items (id) VALUES (1)");
+            {
+                Transaction inner(_ds);
+                QVERIFY(inner.isActive());
+                QVERIFY(inner.isNested());
+                _ds->executeQuery("INSERT INTO items (id) VALUES (2)");
+            }
+            QVERIFY(_ds->inTransaction());
+            QCOMPARE(_ds->count(), 1);
+            QVERIFY(outer.commit());
+        }
+        QCOMPARE(_ds->count(), 1);
+    }
+
+    void nested_commitThenOuterRollback_discardsAll()
+    {
+        {
+            Transaction outer(_ds);
+            {
+                Transaction inner(_ds);
+                _ds->executeQuery("INSERT INTO items (id) VALUES (1)");
+                QVERIFY(inner.commit());
+            }
+            QCOMPARE(_ds->count(), 1);
+        }
+        QCOMPARE(_ds->count(), 0);
+    }
+
+    void outOfOrder_rollsBackAbandonedNested()
+    {
+        Transaction* inner = nullptr;
+        {
+            Transaction outer(_ds);
+            _ds->executeQuery("INSERT INTO items (id) VALUES (1)");
+            inner = new Transaction(_ds);
+            _ds->executeQuery("INSERT INTO items (id) VALUES (2)");
+
+            // Ending the outer transaction first rolls back both, rather than leaving it open
+            QVERIFY(!outer.commit());
+            QVERIFY(!_ds->inTransaction());
+        }
+        QCOMPARE(_ds->count(), 0);
+
+        {
+            Transaction next(_ds);
+            _ds->executeQuery("INSERT INTO items (id) VALUES (3)");
+            QVERIFY(next.commit());
+        }
+        QCOMPARE(_ds->count(), 1);
+
+        // The abandoned transaction has already ended
+        QVERIFY(!inner->rollback());
+        delete inner;
+        QCOMPARE(_ds->count(), 1);
+        QVERIFY(!_ds->inTransaction());
+    }
+
+    void executeMultiple_atomic_rollsBackOnFailure()
+    {
+        QStringList queries = {
+            "INSERT INTO items (id) VALUES (1);",
+            "INSERT INTO nonexistent (id) VALUES (2);"
+        };
+        QVERIFY(!_ds->executeMultiple(queries, true));
+        QVERIFY(!_ds->inTransaction());
+        QCOMPARE(_ds->count(), 0);
+
+        QVERIFY(!_ds->executeMultiple(queries, false));
+        QCOMPARE(_ds->count(), 1);
+    }
+
+private:
+    QTemporaryDir _tmpDir;
+    TransactionDataSource* _ds = nullptr;
+    int _serial = 0;
+};
+
+QTEST_MAIN(TstTransaction)
+#include "tst_transaction.moc"
@@ -0,0 +1,233 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSqlQuery>
+#include <QThread>
+#include <Kanoop/commonexception.h>
+#include <Kanoop/database/datasource.h>
+#include <Kanoop/database/transaction.h>
+#include <Kanoop/database/writequeue.h>
+
+class QueuedDataSource : public DataSource
+{
+public:
+    QueuedDataSource(const DatabaseCredentials& creds) : DataSource(creds) {}
+
+    using DataSource::executeQuery;
+
+    int count()
+    {
+        bool success;
+        QSqlQuery query = executeQuery("SELECT COUNT(*) FROM items", &success);
+        return success && query.next() ? query.value(0).toInt() : -1;
+    }
+
+protected:
+    QString createSql() const override { return "CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE);"; }
+};
+
+static WriteQueue::Write write(const QString& sql)
+{
+    return WriteQueue::Write{ sql, QVariantList(), std::make_shared<QPromise<int>>() };
+}
+
+class TstWriteQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void queue_takesInOrder()
+    {
+        WriteQueue queue;
+        QCOMPARE(queue.enqueue(write("A")), 1);
+        QCOMPARE(queue.enqueue(write("B")), 2);
+        QCOMPARE(queue.enqueue(write("C")), 3);
+
+        QList<WriteQueue::Write> batch = queue.take(2);
+        QCOMPARE(batch.count(), 2);
+        QCOMPARE(batch.at(0).sql, QStringLiteral("A"));
+        QCOMPARE(batch.at(1).sql, QStringLiteral("B"));
+        QCOMPARE(queue.count(), 1);
+        QCOMPARE(queue.take(10).at(0).sql, QStringLiteral("C"));
+        QVERIFY(queue.take(10).isEmpty());
+
+        queue.recordBatch(4, 1);
+        queue.recordBatch(2, 0);
+        WriteQueue::Statistics statistics = queue.statistics();
+        QCOMPARE(statistics.writes, qint64(6));
+        QCOMPARE(statistics.failures, qint64(1));
+        QCOMPARE(statistics.batches, qint64(2));
+        QCOMPARE(statistics.largestBatch, 4);
+        QCOMPARE(statistics.writesPerBatch(), 3.0);
+        queue.resetStatistics();
+        QCOMPARE(queue.statistics().batches, qint64(0));
+    }
+
+    void queueWrite_coalescesIntoOneTransaction()
+    {
+        QTemporaryDir tmpDir;
+        QueuedDataSource ds((DatabaseCredentials(tmpDir.path() + "/coalesce.db")));
+        QVERIFY(ds.openConnection());
+
+        QList<QFuture<int>> futures;
+        for(int i = 0;i < 100;i++) {
+            futures.append(ds.queueWrite("INSERT INTO items (id, name) VALUES (?, ?)", { i, QString("name%1").arg(i) }));
+        }
+        QCOMPARE(ds.pendingWriteCount(), 100);
+        QTRY_VERIFY(futures.last().isFinished());
+
+        for(const QFuture<int>& future : std::as_const(futures)) {
+            QVERIFY(future.isFinished());
+            QCOMPARE(future.result(), 1);
+        }
+        QCOMPARE(ds.count(), 100);
+        QCOMPARE(ds.pendingWriteCount(), 0);
+        QCOMPARE(ds.writeQueueStatistics().batches, qint64(1));
+        QCOMPARE(ds.writeQueueStatistics().writes, qint64(100));
+        ds.closeConnection();
+    }
+
+    void queueWrite_failureIsIsolated()
+    {
+        QTemporaryDir tmpDir;
+        QueuedDataSource ds((DatabaseCredentials(tmpDir.path() + "/isolated.db")));
+        QVERIFY(ds.openConnection());
+
+        QFuture<int> first = ds.queueWrite("INSERT INTO items (name) VALUES ('one')");
+        QFuture<int> duplicate = ds.queueWrite("INSERT INTO items (name) VALUES ('one')");
+        QFuture<int> last = ds.queueWrite("UPDATE items SET name = 'two' WHERE name = 'one'");
+        QVERIFY(!ds.flushWrites());
+
+        QCOMPARE(first.result(), 1);
+        QVERIFY_THROWS_EXCEPTION(CommonException, duplicate.result());
+        QCOMPARE(last.result(), 1);
+        QCOMPARE(ds.count(), 1);
+        QCOMPARE(ds.writeQueueStatistics().failures, qint64(1));
+        ds.closeConnection();
+    }
+
+    void flushWrites_splitsIntoBatches()
+    {
+        QTemporaryDir tmpDir;
+        QueuedDataSource ds((DatabaseCredentials(tmpDir.path() + "/batches.db")));
+        QVERIFY(ds.openConnection());
+        ds.setWriteBatchSize(10);
+
+        for(int i = 0;i < 35;i++) {
+            ds.queueWrite("INSERT INTO items (name) VALUES (?)", { QString("name%1").arg(i) });
+        }
+        QVERIFY(ds.flushWrites());
+        QCOMPARE(ds.count(), 35);
+        WriteQueue::Statistics statistics = ds.writeQueueStatistics();
+        QCOMPARE(statistics.batches, qint64(4));
+        QCOMPARE(statistics.largestBatch, 10);
+        ds.closeConnection();
+    }
+
+    void flushWrites_deferredInsideTransaction()
+    {
+        QTemporaryDir tmpDir;
+        QueuedDataSource ds((DatabaseCredentials(tmpDir.path() + "/deferred.db")));
+        QVERIFY(ds.openConnection());
+        ds.setWriteBatchWindowMs(60000);
+
+        // Flushed inside the rolled back transaction, the write would be undone after its future completed
+        QFuture<int> future = ds.queueWrite("INSERT INTO items (name) VALUES ('queued')");
+        {
+            Transaction transaction(&ds);
+            ds.executeQuery("INSERT INTO items (name) VALUES ('discarded')");
+            QVERIFY(ds.flushWrites());
+            QCOMPARE(ds.pendingWriteCount(), 1);
+            QVERIFY(!future.isFinished());
+        }
+
+        QTRY_VERIFY(future.isFinished());
+        QCOMPARE(future.result(), 1);
+        QCOMPARE(ds.count(), 1);
+        ds.closeConnection();
+    }
+
+    void closeConnection_endsTransactionAndFlushes()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/close_open.db";
+        QueuedDataSource ds((DatabaseCredentials(path)));
+        QVERIFY(ds.openConnection());
+        ds.setWriteBatchWindowMs(60000);
+
+        Transaction transaction(&ds);
+        ds.executeQuery("INSERT INTO items (name) VALUES ('discarded')");
+        QFuture<int> future = ds.queueWrite("INSERT INTO items (name) VALUES ('queued')");
+        QVERIFY(ds.closeConnection());
+        QVERIFY(future.isFinished());
+        QCOMPARE(future.result(), 1);
+
+        QueuedDataSource reopened((DatabaseCredentials(path)));
+        QVERIFY(reopened.openConnection());
+        QCOMPARE(reopened.count(), 1);
+        reopened.closeConnection();
+    }
+
+    void queueWrite_fromManyThreads()
+    {
+        static const int Producers = 4;
+        static const int WritesEach = 250;
+
+        QTemporaryDir tmpDir;
+        QueuedDataSource ds((DatabaseCredentials(tmpDir.path() + "/threads.db")));
+        QVERIFY(ds.openConnection());
+
+        QList<QThread*> threads;
+        QFuture<int> lastFutures[Producers];
+        for(int t = 0;t < Producers;t++) {
+            threads.append(QThread::create([&ds, &lastFutures, t]() {
+                for(int i = 0;i < WritesEach;i++) {
+                    lastFutures[t] = ds.queueWrite("INSERT INTO items (name) VALUES (?)", { QString("t%1-%2").arg(t).arg(i) });
+                }
+            }));
+            threads.last()->start();
+        }
+        for(QThread* thread : std::as_const(threads)) {
+            QVERIFY(thread->wait(10000));
+            delete thread;
+        }
+
+        QTRY_VERIFY(ds.pendingWriteCount() == 0 && lastFutures[0].isFinished() && lastFutures[Producers - 1].isFinished());
+        QCOMPARE(ds.count(), Producers * WritesEach);
+        QVERIFY(ds.writeQueueStatistics().batches < Producers * WritesEach);
+        ds.closeConnection();
+    }
+
+    void closeConnection_flushesPendingWrites()
+    {
+        QTemporaryDir tmpDir;
+        QString path = tmpDir.path() + "/close.db";
+        QFuture<int> future;
+        {
+            QueuedDataSource ds((DatabaseCredentials(path)));
+            QVERIFY(ds.openConnection());
+            ds.setWriteBatchWindowMs(60000);
+            future = ds.queueWrite("INSERT INTO items (name) VALUES ('pending')");
+            QVERIFY(ds.closeConnection());
+        }
+        QVERIFY(future.isFinished());
+        QCOMPARE(future.result(), 1);
+
+        QueuedDataSource reopened((DatabaseCredentials(path)));
+        QVERIFY(reopened.openConnection());
+        QCOMPARE(reopened.count(), 1);
+        reopened.closeConnection();
+    }
+
+    void queueWrite_failsWhenClosed()
+    {
+        QTemporaryDir tmpDir;
+        QueuedDataSource ds((DatabaseCredentials(tmpDir.path() + "/closed.db")));
+        QFuture<int> future = ds.queueWrite("INSERT INTO items (name) VALUES ('x')");
+        QVERIFY(!ds.flushWrites());
+        QVERIFY(future.isFinished());
+        QVERIFY_THROWS_EXCEPTION(CommonException, future.result());
+    }
+};
+
+QTEST_MAIN(TstWriteQueue)
+#include "tst_writequeue.moc"